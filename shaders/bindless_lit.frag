@@ -0,0 +1,73 @@
+#version 460
+
+#extension GL_EXT_nonuniform_qualifier : require
+#extension GL_GOOGLE_include_directive : require
+
+// fragment stage of every bindless material : the material is read from the material buffer, its texture and sampler from the bindless set.
+// note : draws of one multi draw can use different materials, so resource indices are non uniform.
+
+layout (location = 0) in vec3 in_color;
+layout (location = 1) in vec3 in_normal;
+layout (location = 2) in vec2 in_uv;
+layout (location = 3) flat in uint in_material_index;
+layout (location = 4) in vec3 in_world_position;
+
+layout (location = 0) out vec4 frag_color;
+
+layout (set = 0, binding = 1) uniform EnvironmentData
+{
+	vec4 m_fog_color;
+	vec4 m_fog_distance;
+	vec4 m_ambient_color;
+	vec4 m_sunlight_direction;
+	vec4 m_sunlight_color;
+	vec4 m_light_cluster_params;
+} environment_data;
+
+#include "clustered_lighting.glsl"
+#include "shadows.glsl"
+
+struct MaterialData
+{
+	vec4 m_base_color;
+
+	uint m_diffuse_texture_index;
+	uint m_sampler_index;
+	uint m_padding[2];
+};
+
+// storage buffer slot 0 is the material buffer
+const uint MATERIAL_BUFFER_SLOT = 0;
+const uint INVALID_INDEX = 0xffffffff;
+
+layout (std430, set = 2, binding = 0) readonly buffer MaterialBuffer
+{
+	MaterialData materials[];
+} materialBuffers[];
+
+layout (set = 2, binding = 1) uniform texture2D textures[];
+layout (set = 2, binding = 2) uniform sampler samplers[];
+
+void main() 
+{
+	MaterialData material = materialBuffers[MATERIAL_BUFFER_SLOT].materials[in_material_index];
+
+	// untextured materials : vertex color, unlit (like default_mesh.frag)
+	if (material.m_diffuse_texture_index == INVALID_INDEX)
+	{
+		frag_color = vec4(in_color * material.m_base_color.rgb, material.m_base_color.a);
+		return;
+	}
+
+	vec4 albedo = texture(sampler2D(textures[nonuniformEXT(material.m_diffuse_texture_index)], samplers[nonuniformEXT(material.m_sampler_index)]), in_uv) * material.m_base_color;
+
+	// sunlight_direction points from the sun towards the scene (set by the engine)
+	vec3 normal = normalize(in_normal);
+	float diffuse = max(dot(normal, -normalize(environment_data.m_sunlight_direction.xyz)), 0.0f);
+	diffuse *= evaluate_sun_shadow(in_world_position, normal);
+
+	vec3 lighting = environment_data.m_ambient_color.xyz + diffuse * environment_data.m_sunlight_color.xyz;
+	lighting += evaluate_clustered_lights(in_world_position, normal, environment_data.m_light_cluster_params);
+
+	frag_color = vec4(albedo.rgb * lighting, 1.0f);
+}
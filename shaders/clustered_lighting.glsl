@@ -0,0 +1,81 @@
+// clustered lighting, included by the lit fragment shaders : only the lights binned into the fragment's cluster by light_cull.comp are evaluated.
+// note : the cluster grid must match engine.h and light_cull.comp
+
+const uint LIGHT_CLUSTER_COUNT_X = 16;
+const uint LIGHT_CLUSTER_COUNT_Y = 9;
+const uint LIGHT_CLUSTER_COUNT_Z = 24;
+const uint MAX_LIGHTS_PER_CLUSTER = 256;
+
+const uint LIGHT_TYPE_SPOT = 1;
+
+struct LightData
+{
+	vec4 m_position_range;
+	vec4 m_color;
+	vec4 m_direction;
+
+	uint m_type;
+	float m_spot_cos_inner;
+	float m_spot_cos_outer;
+	uint m_padding;
+};
+
+layout (std430, set = 0, binding = 2) readonly buffer LightBuffer
+{
+	LightData lights[];
+} lightBuffer;
+
+layout (std430, set = 0, binding = 3) readonly buffer LightClusterBuffer
+{
+	uint light_counts[];
+} lightClusterBuffer;
+
+layout (std430, set = 0, binding = 4) readonly buffer LightIndexBuffer
+{
+	uint light_indices[];
+} lightIndexBuffer;
+
+// diffuse lighting of the clustered lights at a world space position. cluster_params is EnvironmentData::m_light_cluster_params.
+vec3 evaluate_clustered_lights(vec3 world_position, vec3 normal, vec4 cluster_params)
+{
+	// clip space w is the view depth (see math::perpective)
+	float view_depth = 1.0f / gl_FragCoord.w;
+
+	uvec2 tile = min(uvec2(gl_FragCoord.xy * cluster_params.xy), uvec2(LIGHT_CLUSTER_COUNT_X - 1, LIGHT_CLUSTER_COUNT_Y - 1));
+	uint slice = uint(clamp(log(view_depth) * cluster_params.z + cluster_params.w, 0.0f, float(LIGHT_CLUSTER_COUNT_Z - 1)));
+
+	uint cluster_index = tile.x + LIGHT_CLUSTER_COUNT_X * (tile.y + LIGHT_CLUSTER_COUNT_Y * slice);
+	uint light_count = lightClusterBuffer.light_counts[cluster_index];
+
+	vec3 lighting = vec3(0.0f);
+
+	for (uint i = 0; i < light_count; i++)
+	{
+		LightData light = lightBuffer.lights[lightIndexBuffer.light_indices[cluster_index * MAX_LIGHTS_PER_CLUSTER + i]];
+
+		vec3 to_light = light.m_position_range.xyz - world_position;
+		float distance_squared = dot(to_light, to_light);
+		float range_squared = light.m_position_range.w * light.m_position_range.w;
+
+		if (distance_squared >= range_squared)
+		{
+			continue;
+		}
+
+		vec3 light_direction = to_light * inversesqrt(distance_squared);
+
+		// inverse square falloff, windowed so that it reaches 0 at the range
+		float distance_ratio = distance_squared / range_squared;
+		float window = clamp(1.0f - distance_ratio * distance_ratio, 0.0f, 1.0f);
+		float attenuation = window * window / max(distance_squared, 0.01f);
+
+		if (light.m_type == LIGHT_TYPE_SPOT)
+		{
+			attenuation *= smoothstep(light.m_spot_cos_outer, light.m_spot_cos_inner, dot(-light_direction, light.m_direction.xyz));
+		}
+
+		lighting += max(dot(normal, light_direction), 0.0f) * attenuation * light.m_color.rgb;
+	}
+
+	return lighting;
+}
@@ -1,6 +1,11 @@
 #version 450
 
+#extension GL_GOOGLE_include_directive : require
+
 layout (location = 0) in vec3 in_color;
+layout (location = 1) in vec3 in_normal;
+layout (location = 4) in vec3 in_world_position;
+
 layout (location = 0) out vec4 frag_color;
 
 layout (set = 0, binding = 1) uniform EnvironmentData
@@ -10,9 +15,22 @@ layout (set = 0, binding = 1) uniform EnvironmentData
 	vec4 m_ambient_color;
 	vec4 m_sunlight_direction;
 	vec4 m_sunlight_color;
+	vec4 m_light_cluster_params;
 } environment_data;
 
+#include "clustered_lighting.glsl"
+#include "shadows.glsl"
+
 void main() 
 {
-	frag_color = vec4(in_color + environment_data.m_ambient_color.xyz, 1.0f);
-}
\ No newline at end of file
+	vec3 normal = normalize(in_normal);
+
+	// sunlight_direction points from the sun towards the scene (set by the engine)
+	float diffuse = max(dot(normal, -normalize(environment_data.m_sunlight_direction.xyz)), 0.0f);
+	diffuse *= evaluate_sun_shadow(in_world_position, normal);
+
+	vec3 lighting = environment_data.m_ambient_color.xyz + diffuse * environment_data.m_sunlight_color.xyz;
+	lighting += evaluate_clustered_lights(in_world_position, normal, environment_data.m_light_cluster_params);
+
+	frag_color = vec4(in_color * lighting, 1.0f);
+}
@@ -5,8 +5,20 @@
 layout (location = 0) in vec3 in_position;
 layout (location = 1) in vec3 in_normal;
 layout (location = 2) in vec3 in_color;
+layout (location = 3) in vec2 in_uv;
 
 layout (location = 0) out vec3 frag_color;
+layout (location = 1) out vec3 frag_normal;
+layout (location = 2) out vec2 frag_uv;
+
+// bindless mode : index of the object's MaterialData (see bindless_lit.frag)
+layout (location = 3) flat out uint frag_material_index;
+
+// world space position, for clustered lighting
+layout (location = 4) out vec3 frag_world_position;
+
+// set by the engine from its VertexLayout : in_normal.xy is an octahedral encoded normal
+layout (constant_id = 0) const bool OCTAHEDRAL_NORMALS = true;
 
 layout (push_constant) uniform constants
 {
@@ -31,12 +43,39 @@ layout (std140, set = 1, binding = 0) readonly buffer  ObjectBuffer
 	ObjectData objects[];	
 } objectBuffer;
 
+layout (std430, set = 1, binding = 1) readonly buffer ObjectMaterialBuffer
+{
+	uint material_indices[];
+} objectMaterialBuffer;
+
+// note : must match depth_only.vert (depth pre pass), since the shading pass tests with eEqual.
+invariant gl_Position;
+
+vec3 decode_octahedral(vec2 encoded)
+{
+	vec3 normal = vec3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+
+	// unfold the lower hemisphere
+	float t = max(-normal.z, 0.0f);
+	normal.x += normal.x >= 0.0f ? -t : t;
+	normal.y += normal.y >= 0.0f ? -t : t;
+
+	return normalize(normal);
+}
+
 void main()
 {
 	mat4 model_mat = objectBuffer.objects[gl_BaseInstance].m_model_mat;
 	mat4 transform_mat = cameraBuffer.m_projection_view_mat * model_mat;
 
+	// note : same expression as depth_only.vert, the world position is computed separately
 	gl_Position = transform_mat * vec4(in_position, 1.0f);
+	frag_world_position = (model_mat * vec4(in_position, 1.0f)).xyz;
+
+	vec3 normal = OCTAHEDRAL_NORMALS ? decode_octahedral(in_normal.xy) : in_normal;
+	frag_normal = mat3(model_mat) * normal;
 
 	frag_color = in_color;
+	frag_uv = in_uv;
+	frag_material_index = objectMaterialBuffer.material_indices[gl_BaseInstance];
 }
\ No newline at end of file
@@ -0,0 +1,29 @@
+#version 460
+
+#extension GL_KHR_vulkan_glsl : enable
+
+// shadow cascades : depth only, position stream only. The cascade's matrix is pushed per cascade.
+
+layout (location = 0) in vec3 in_position;
+
+layout (push_constant) uniform constants
+{
+	mat4 m_light_mat;
+} pushConstants;
+
+struct ObjectData
+{
+	mat4 m_model_mat;
+};
+
+layout (std140, set = 1, binding = 0) readonly buffer  ObjectBuffer
+{
+	ObjectData objects[];	
+} objectBuffer;
+
+void main()
+{
+	mat4 model_mat = objectBuffer.objects[gl_BaseInstance].m_model_mat;
+
+	gl_Position = pushConstants.m_light_mat * model_mat * vec4(in_position, 1.0f);
+}
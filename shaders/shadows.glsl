@@ -0,0 +1,60 @@
+// cascaded shadow maps of the sun, included by the lit fragment shaders. Cascades are fitted to slices of the view frustum by the engine (see Engine::update_shadow_cascades).
+// note : the cascade limit must match MAX_SHADOW_CASCADES (types.h)
+
+const uint MAX_SHADOW_CASCADES = 4;
+
+layout (std140, set = 0, binding = 5) uniform ShadowData
+{
+	// world space to the cascade's clip space (xy in [-1, 1], z in [0, 1])
+	mat4 m_cascade_mats[MAX_SHADOW_CASCADES];
+
+	// view depth each cascade ends at
+	vec4 m_cascade_split_depths;
+
+	// world space size of a shadow map texel in each cascade
+	vec4 m_cascade_texel_sizes;
+
+	// x = cascade count, y = 1 / shadow map resolution
+	vec4 m_params;
+} shadowData;
+
+// one layer per cascade, sampled with depth compare (and bilinear filtering, so every tap already is a 2x2 PCF)
+layout (set = 0, binding = 6) uniform sampler2DArrayShadow shadow_map;
+
+// visibility of the sun at a world space position (1 = lit, 0 = in shadow)
+float evaluate_sun_shadow(vec3 world_position, vec3 normal)
+{
+	// clip space w is the view depth (see math::perpective)
+	float view_depth = 1.0f / gl_FragCoord.w;
+	uint cascade_count = uint(shadowData.m_params.x);
+
+	uint cascade = 0;
+	while (cascade < cascade_count && view_depth > shadowData.m_cascade_split_depths[cascade])
+	{
+		cascade++;
+	}
+
+	if (cascade == cascade_count)
+	{
+		return 1.0f;
+	}
+
+	// normal offset : moving the lookup off the surface by about a texel removes most of the acne the depth bias leaves on surfaces facing away from the sun
+	vec3 offset_position = world_position + normal * shadowData.m_cascade_texel_sizes[cascade] * 1.5f;
+	vec4 shadow_position = shadowData.m_cascade_mats[cascade] * vec4(offset_position, 1.0f);
+
+	vec2 uv = shadow_position.xy * 0.5f + 0.5f;
+	float texel = shadowData.m_params.y;
+
+	// 3x3 taps (positions outside of the cascade read the white border, so they are lit)
+	float visibility = 0.0f;
+	for (int y = -1; y <= 1; y++)
+	{
+		for (int x = -1; x <= 1; x++)
+		{
+			visibility += texture(shadow_map, vec4(uv + vec2(x, y) * texel, float(cascade), shadow_position.z));
+		}
+	}
+
+	return visibility / 9.0f;
+}
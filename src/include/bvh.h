@@ -0,0 +1,84 @@
+#pragma once
+
+#include "culling.h"
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace halo
+{
+	struct Ray
+	{
+		math::V3 m_origin;
+		math::V3 m_direction;
+	};
+
+	struct RayHit
+	{
+		uint32_t m_item;
+		float m_distance;
+	};
+
+	// bounding volume hierarchy over a set of items (each with a world AABB and bounding sphere), identified by their index in the arrays passed to build().
+	// Built top down with a binned surface area heuristic. Moving items are handled by refitting the nodes on their path to the root (update), which keeps the tree valid but
+	// slowly degrades its quality, so the owner is expected to rebuild when the set of items changes (or when many items moved far).
+	// Nodes are stored depth first, so the items of every subtree are a contiguous range : fully visible subtrees are emitted without testing their items.
+	class Bvh
+	{
+	public:
+		static constexpr uint32_t MAX_LEAF_SIZE = 8;
+
+		struct Node
+		{
+			AABB m_aabb;
+
+			// interior nodes : index of the left child (the right child is always m_left + 1). Leaves have no children.
+			uint32_t m_left;
+
+			// range of items (in leaf order) under this node
+			uint32_t m_item_begin;
+			uint32_t m_item_count;
+
+			bool m_is_leaf;
+		};
+
+		void build(const std::vector<AABB>& aabbs, const std::vector<math::V4>& spheres);
+
+		// incremental refit : updates the item's bounds and grows / shrinks the nodes above it (stops as soon as a node's box does not change).
+		void update(uint32_t item, const AABB& aabb, const math::V4& sphere);
+
+		// appends the items whose bounding sphere intersects the frustum.
+		void cull(const Frustum& frustum, std::vector<uint32_t>& visible_items) const;
+
+		// closest item whose AABB is hit by the ray (direction does not have to be normalized, distance is in units of direction's length).
+		[[nodiscard]]
+		std::optional<RayHit> raycast(const Ray& ray, float max_distance) const;
+
+		[[nodiscard]]
+		size_t get_item_count() const;
+
+		[[nodiscard]]
+		const std::vector<Node>& get_nodes() const;
+
+	private:
+		uint32_t build_node(uint32_t item_begin, uint32_t item_count, std::vector<math::V3>& centroids);
+
+		void refit_node(uint32_t node_index);
+
+		void append_items(const Node& node, std::vector<uint32_t>& visible_items) const;
+
+	private:
+		std::vector<Node> m_nodes;
+		std::vector<uint32_t> m_parents;
+
+		// item bounds, stored in leaf order so a leaf's spheres are contiguous (for the batched SIMD test)
+		std::vector<AABB> m_aabbs;
+		std::vector<math::V4> m_spheres;
+
+		// leaf order position -> item, and item -> leaf order position / leaf node
+		std::vector<uint32_t> m_items;
+		std::vector<uint32_t> m_item_positions;
+		std::vector<uint32_t> m_item_leaves;
+	};
+}
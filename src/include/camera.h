@@ -5,6 +5,11 @@
 namespace halo
 {
 	static constexpr float CAMERA_SPEED = 0.01f;
+
+	// projection parameters (vertical field of view in degrees)
+	static constexpr float CAMERA_FIELD_OF_VIEW = 45.0f;
+	static constexpr float CAMERA_NEAR_PLANE = 0.1f;
+	static constexpr float CAMERA_FAR_PLANE = 100.0f;
 		
 	// base camera class. Engine currently has only one viewport and one 'free' camera.
 	struct Camera
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "custom_math.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace halo
+{
+	// axis aligned bounding box
+	struct AABB
+	{
+		math::V3 m_min;
+		math::V3 m_max;
+	};
+
+	// view frustum as 6 planes (xyz = normalized normal pointing inside, w = distance). Order : left, right, bottom, top, near, far.
+	struct Frustum
+	{
+		math::V4 m_planes[6];
+	};
+
+	// bounding sphere stored as a V4 (xyz = center, w = radius), so 4 spheres can be loaded into SIMD registers with plain loads.
+
+	// AABB and bounding sphere of a set of points (positions are read with the given byte stride, so vertex arrays can be passed directly).
+	void compute_bounds(const float *first_position, size_t stride, size_t count, AABB& aabb, math::V4& sphere);
+
+	// world space bounds from local bounds and a world matrix (custom math convention).
+	[[nodiscard]]
+	AABB transform_aabb(const AABB& aabb, const math::M4& world_mat);
+
+	[[nodiscard]]
+	math::V4 transform_sphere(const math::V4& sphere, const math::M4& world_mat);
+
+	// point transform with w = 1 (the Matrix * Vector operator of the math lib is not a matrix vector product).
+	[[nodiscard]]
+	math::V3 transform_point(const math::M4& mat, const math::V3& point);
+
+	// extracts the frustum planes from projection * view (clip space z in [0, w], as in vulkan).
+	[[nodiscard]]
+	Frustum extract_frustum(const math::M4& projection_view_mat);
+
+	[[nodiscard]]
+	bool is_sphere_visible(const Frustum& frustum, const math::V4& sphere);
+
+	[[nodiscard]]
+	bool is_aabb_visible(const Frustum& frustum, const AABB& aabb);
+
+	// tests count spheres (read from first_sphere with the given byte stride) against the frustum 4 at a time using SSE, writing 1 (visible) or 0 into visibility.
+	void cull_spheres(const Frustum& frustum, const float *first_sphere, size_t stride, size_t count, uint8_t *visibility);
+}
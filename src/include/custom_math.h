@@ -555,6 +555,7 @@ namespace halo::math
 	using Mat3 = Matrix<3, 3>;
 	using Mat4 = Matrix<4, 4>;
 	
+	using V2 = Vector<2>;
 	using V3 = Vector<3>;
 	using V4 = Vector<4>;
 	
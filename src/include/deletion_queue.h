@@ -0,0 +1,86 @@
+#pragma once
+
+#include "types.h"
+
+#include <vector>
+
+namespace halo
+{
+	// typed record of a vulkan handle waiting for destruction (replaces heap allocated std::function closures).
+	// m_type is the vulkan object type of the handle, m_allocation is only set for VMA backed buffers / images.
+	struct DeletionRecord
+	{
+		uint64_t m_handle;
+		VmaAllocation m_allocation;
+
+		// the handle is destroyed once the GPU has completed this submission value (see Engine::get_completed_submission_value).
+		uint64_t m_retire_value;
+
+		vk::ObjectType m_type;
+	};
+
+	// used for vulkan cleanup. Has two lists :
+	// lifetime records are destroyed at shutdown in reverse order as what they are pushed in (latest pushed handle is destroyed first).
+	// deferred records are destroyed at runtime, as soon as the GPU has finished the last submission that used them, so unloading never needs a waitIdle.
+	class DeletionQueue
+	{
+	public:
+		void init(vk::Device device, VmaAllocator allocator);
+
+		// handles destroyed when the engine shuts down.
+		template <typename T>
+		void push(T handle)
+		{
+			m_lifetime_records.push_back(create_record(handle, nullptr, 0));
+		}
+
+		void push(const AllocatedBuffer& buffer);
+		void push(const AllocatedImage& image);
+
+		// handles destroyed once the submission with the given value has finished executing on the GPU.
+		// retire values pushed must be non decreasing (which is always true when using Engine::get_pending_submission_value).
+		template <typename T>
+		void defer(T handle, uint64_t retire_value)
+		{
+			m_deferred_records.push_back(create_record(handle, nullptr, retire_value));
+		}
+
+		void defer(const AllocatedBuffer& buffer, uint64_t retire_value);
+		void defer(const AllocatedImage& image, uint64_t retire_value);
+
+		// destroys all deferred handles whose retire value is <= completed_value. Called once per frame.
+		void flush(uint64_t completed_value);
+
+		// destroys everything (deferred records first, then lifetime records in reverse order). GPU must be idle.
+		void flush_all();
+
+		[[nodiscard]]
+		size_t get_pending_deferred_count() const;
+
+	private:
+		template <typename T>
+		[[nodiscard]]
+		static DeletionRecord create_record(T handle, VmaAllocation allocation, uint64_t retire_value)
+		{
+			DeletionRecord record = {};
+			record.m_handle = reinterpret_cast<uint64_t>(static_cast<typename T::CType>(handle));
+			record.m_allocation = allocation;
+			record.m_retire_value = retire_value;
+			record.m_type = T::objectType;
+
+			return record;
+		}
+
+		void destroy(const DeletionRecord& record);
+
+	private:
+		vk::Device m_device;
+		VmaAllocator m_vma_allocator{nullptr};
+
+		std::vector<DeletionRecord> m_lifetime_records;
+
+		// since retire values are non decreasing, retired records always form a prefix of the unretired range [m_deferred_head, size).
+		std::vector<DeletionRecord> m_deferred_records;
+		size_t m_deferred_head{0};
+	};
+}
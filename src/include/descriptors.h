@@ -0,0 +1,85 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <unordered_map>
+#include <vector>
+
+namespace halo
+{
+	// hands out descriptor sets from a chain of pools : when the current pool runs out, the next one is taken (a reset pool if there is one, a new one otherwise).
+	// Sets are never freed one by one. reset_pools recycles every pool at once, so per frame sets cost one vkResetDescriptorPool per pool and frame.
+	class DescriptorAllocator
+	{
+	public:
+		// sets_per_pool : maximum sets of each pool, descriptor counts of each type are proportional to it (see descriptors.cpp).
+		void init(vk::Device device, uint32_t sets_per_pool = 256);
+
+		// throws if a set cannot be allocated even from a fresh pool.
+		[[nodiscard]]
+		vk::DescriptorSet allocate(vk::DescriptorSetLayout layout);
+
+		// every set allocated so far becomes invalid. The GPU must be done with them (e.g. after waiting for the frame that used them).
+		void reset_pools();
+
+		void clean();
+
+	private:
+		[[nodiscard]]
+		vk::DescriptorPool grab_pool();
+
+	private:
+		vk::Device m_device;
+		uint32_t m_sets_per_pool{0};
+
+		vk::DescriptorPool m_current_pool;
+
+		// pools with sets allocated from them (including the current pool), and reset pools ready to be reused
+		std::vector<vk::DescriptorPool> m_used_pools;
+		std::vector<vk::DescriptorPool> m_free_pools;
+	};
+
+	// creates each distinct descriptor set layout once. Layouts are compared by create flags and bindings (sorted by binding number, with the per binding flags
+	// of a vk::DescriptorSetLayoutBindingFlagsCreateInfo in pNext). Layouts returned are owned by the cache.
+	// note : immutable samplers are not part of the key (no layout uses them).
+	class DescriptorLayoutCache
+	{
+	public:
+		void init(vk::Device device);
+
+		[[nodiscard]]
+		vk::DescriptorSetLayout create_descriptor_set_layout(const vk::DescriptorSetLayoutCreateInfo& create_info);
+
+		void clean();
+
+	private:
+		struct LayoutBinding
+		{
+			uint32_t m_binding;
+			vk::DescriptorType m_type;
+			uint32_t m_count;
+			vk::ShaderStageFlags m_stages;
+			vk::DescriptorBindingFlags m_flags;
+
+			bool operator==(const LayoutBinding&) const = default;
+		};
+
+		struct LayoutKey
+		{
+			vk::DescriptorSetLayoutCreateFlags m_flags;
+			std::vector<LayoutBinding> m_bindings;
+
+			bool operator==(const LayoutKey&) const = default;
+		};
+
+		struct LayoutKeyHash
+		{
+			size_t operator()(const LayoutKey& key) const;
+		};
+
+	private:
+		vk::Device m_device;
+
+		std::unordered_map<LayoutKey, vk::DescriptorSetLayout, LayoutKeyHash> m_layouts;
+	};
+}
@@ -0,0 +1,332 @@
+#pragma once
+
+#include "resource_pool.h"
+#include "job_system.h"
+
+#include <cstdint>
+#include <tuple>
+#include <vector>
+
+namespace halo
+{
+	struct EntityTag;
+
+	// entities are generational handles too : a destroyed entity's handle never aliases a newly created one.
+	using Entity = Handle<EntityTag>;
+
+	// sparse set storage for one component type.
+	// components are packed in a dense array (together with the owning entity and the version they were last changed in), and the sparse array maps entity index -> dense index.
+	// Every component type has its own pool, so the scene is effectively stored as a structure of arrays.
+	template <typename T>
+	class ComponentPool
+	{
+	public:
+		static constexpr uint32_t INVALID_INDEX = UINT32_MAX;
+
+		T& add(Entity entity, T&& component, uint32_t version)
+		{
+			if (entity.m_index >= m_sparse.size())
+			{
+				m_sparse.resize(static_cast<size_t>(entity.m_index) + 1, INVALID_INDEX);
+			}
+
+			if (has(entity))
+			{
+				const uint32_t dense_index = m_sparse[entity.m_index];
+				m_components[dense_index] = std::move(component);
+				m_versions[dense_index] = version;
+
+				return m_components[dense_index];
+			}
+
+			m_sparse[entity.m_index] = static_cast<uint32_t>(m_components.size());
+			m_layout_version++;
+
+			m_entities.push_back(entity);
+			m_components.push_back(std::move(component));
+			m_versions.push_back(version);
+
+			return m_components.back();
+		}
+
+		// swap removes the component. The component moved into the hole is marked as changed, since its dense index (and so any GPU side index derived from it) changed.
+		void remove(Entity entity, uint32_t version)
+		{
+			if (!has(entity))
+			{
+				return;
+			}
+
+			const uint32_t dense_index = m_sparse[entity.m_index];
+			const uint32_t last_dense_index = static_cast<uint32_t>(m_components.size() - 1);
+
+			if (dense_index != last_dense_index)
+			{
+				m_components[dense_index] = std::move(m_components[last_dense_index]);
+				m_entities[dense_index] = m_entities[last_dense_index];
+				m_versions[dense_index] = version;
+
+				m_sparse[m_entities[dense_index].m_index] = dense_index;
+			}
+
+			m_components.pop_back();
+			m_entities.pop_back();
+			m_versions.pop_back();
+
+			m_sparse[entity.m_index] = INVALID_INDEX;
+			m_layout_version++;
+		}
+
+		[[nodiscard]]
+		bool has(Entity entity) const
+		{
+			return entity.m_index < m_sparse.size() && m_sparse[entity.m_index] != INVALID_INDEX && m_entities[m_sparse[entity.m_index]] == entity;
+		}
+
+		[[nodiscard]]
+		T* get(Entity entity)
+		{
+			return has(entity) ? &m_components[m_sparse[entity.m_index]] : nullptr;
+		}
+
+		// index of the entity's component in the dense arrays (INVALID_INDEX if the entity does not have one).
+		[[nodiscard]]
+		uint32_t get_dense_index(Entity entity) const
+		{
+			return has(entity) ? m_sparse[entity.m_index] : INVALID_INDEX;
+		}
+
+		void mark_changed(uint32_t dense_index, uint32_t version)
+		{
+			m_versions[dense_index] = version;
+		}
+
+		[[nodiscard]]
+		size_t size() const
+		{
+			return m_components.size();
+		}
+
+		[[nodiscard]]
+		std::vector<T>& get_components()
+		{
+			return m_components;
+		}
+
+		[[nodiscard]]
+		const std::vector<Entity>& get_entities() const
+		{
+			return m_entities;
+		}
+
+		[[nodiscard]]
+		const std::vector<uint32_t>& get_versions() const
+		{
+			return m_versions;
+		}
+
+		// incremented whenever a component is added or removed (i.e. whenever dense indices may have changed), so structures indexed by dense index know when to rebuild.
+		[[nodiscard]]
+		uint64_t get_layout_version() const
+		{
+			return m_layout_version;
+		}
+
+	private:
+		std::vector<uint32_t> m_sparse;
+		uint64_t m_layout_version{0};
+
+		std::vector<Entity> m_entities;
+		std::vector<T> m_components;
+		std::vector<uint32_t> m_versions;
+	};
+
+	// entity component store over a fixed (compile time) list of component types. One ComponentPool per type, so there is no type erasure / virtual dispatch.
+	// change tracking : every add / patch records the registry's current version in the component's pool, and each_changed visits components changed since a given version.
+	template <typename... Components>
+	class Registry
+	{
+	public:
+		Entity create_entity()
+		{
+			uint32_t index;
+			if (!m_free_indices.empty())
+			{
+				index = m_free_indices.back();
+				m_free_indices.pop_back();
+			}
+			else
+			{
+				index = static_cast<uint32_t>(m_generations.size());
+				m_generations.push_back(0);
+			}
+
+			Entity entity{};
+			entity.m_index = index;
+			entity.m_generation = m_generations[index];
+
+			m_entity_count++;
+
+			return entity;
+		}
+
+		void destroy_entity(Entity entity)
+		{
+			if (!is_alive(entity))
+			{
+				return;
+			}
+
+			(get_pool<Components>().remove(entity, m_version), ...);
+
+			m_generations[entity.m_index]++;
+			m_free_indices.push_back(entity.m_index);
+
+			m_entity_count--;
+		}
+
+		[[nodiscard]]
+		bool is_alive(Entity entity) const
+		{
+			return entity.m_index < m_generations.size() && m_generations[entity.m_index] == entity.m_generation;
+		}
+
+		[[nodiscard]]
+		size_t get_entity_count() const
+		{
+			return m_entity_count;
+		}
+
+		template <typename T>
+		T& add(Entity entity, T component)
+		{
+			return get_pool<T>().add(entity, std::move(component), m_version);
+		}
+
+		template <typename T>
+		void remove(Entity entity)
+		{
+			get_pool<T>().remove(entity, m_version);
+		}
+
+		template <typename T>
+		[[nodiscard]]
+		bool has(Entity entity)
+		{
+			return get_pool<T>().has(entity);
+		}
+
+		// read access (does not count as a change)
+		template <typename T>
+		[[nodiscard]]
+		T* get(Entity entity)
+		{
+			return get_pool<T>().get(entity);
+		}
+
+		// write access : marks the component as changed in the current version. Entity must have the component.
+		template <typename T>
+		T& patch(Entity entity)
+		{
+			ComponentPool<T>& pool = get_pool<T>();
+			const uint32_t dense_index = pool.get_dense_index(entity);
+
+			pool.mark_changed(dense_index, m_version);
+
+			return pool.get_components()[dense_index];
+		}
+
+		template <typename T>
+		[[nodiscard]]
+		ComponentPool<T>& get_pool()
+		{
+			return std::get<ComponentPool<T>>(m_pools);
+		}
+
+		// calls function(entity, First&, Rest&...) for every entity having all the components.
+		// The dense array of First is streamed through, so First should be the rarest component of the query.
+		template <typename First, typename... Rest, typename Function>
+		void each(Function&& function)
+		{
+			each_in_range<First, Rest...>(0, get_pool<First>().size(), function);
+		}
+
+		// same as each, but the dense array of First is split into batches executed on the job system's threads.
+		// function is called concurrently : it may only write to the components it is given (or patch components of the entity it is given).
+		template <typename First, typename... Rest, typename Function>
+		void parallel_each(JobSystem& job_system, Function&& function, size_t batch_size = 1024)
+		{
+			job_system.parallel_for(get_pool<First>().size(), batch_size, [&](size_t begin, size_t end)
+			{
+				each_in_range<First, Rest...>(begin, end, function);
+			});
+		}
+
+		// calls function(entity, T&) for every component of type T added / patched after since_version.
+		template <typename T, typename Function>
+		void each_changed(uint32_t since_version, Function&& function)
+		{
+			ComponentPool<T>& pool = get_pool<T>();
+
+			const std::vector<uint32_t>& versions = pool.get_versions();
+			const std::vector<Entity>& entities = pool.get_entities();
+			std::vector<T>& components = pool.get_components();
+
+			for (size_t i = 0; i < components.size(); i++)
+			{
+				if (versions[i] > since_version)
+				{
+					function(entities[i], components[i]);
+				}
+			}
+		}
+
+		// versions start at 1, so everything added before the first advance_version counts as changed since version 0.
+		[[nodiscard]]
+		uint32_t get_version() const
+		{
+			return m_version;
+		}
+
+		void advance_version()
+		{
+			m_version++;
+		}
+
+	private:
+		template <typename First, typename... Rest, typename Function>
+		void each_in_range(size_t begin, size_t end, Function& function)
+		{
+			ComponentPool<First>& first_pool = get_pool<First>();
+
+			const std::vector<Entity>& entities = first_pool.get_entities();
+			std::vector<First>& components = first_pool.get_components();
+
+			for (size_t i = begin; i < end; i++)
+			{
+				const Entity entity = entities[i];
+
+				if constexpr (sizeof...(Rest) == 0)
+				{
+					function(entity, components[i]);
+				}
+				else
+				{
+					if ((get_pool<Rest>().has(entity) && ...))
+					{
+						function(entity, components[i], *get_pool<Rest>().get(entity)...);
+					}
+				}
+			}
+		}
+
+	private:
+		std::tuple<ComponentPool<Components>...> m_pools;
+
+		std::vector<uint32_t> m_generations;
+		std::vector<uint32_t> m_free_indices;
+		size_t m_entity_count{0};
+
+		uint32_t m_version{1};
+	};
+}
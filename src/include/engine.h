@@ -2,11 +2,24 @@
 
 #include "types.h"
 #include "mesh.h"
+#include "mesh_optimizer.h"
+#include "mesh_lod.h"
+#include "meshlet.h"
+#include "texture.h"
 #include "camera.h"
+#include "timeline.h"
+#include "deletion_queue.h"
+#include "string_id.h"
+#include "scene.h"
+#include "job_system.h"
+#include "bvh.h"
+#include "render_graph.h"
+#include "range_allocator.h"
 
 #include <vk_mem_alloc.h>
 
 #include <unordered_map>
+#include <functional>
 #include <iostream>
 
 struct SDL_Window;
@@ -14,13 +27,184 @@ struct SDL_Window;
 // frames in flight : decides single / double / triple buffering
 constexpr int MAX_FRAMES_IN_FLIGHT = 2;
 
+// capacity of the per frame ObjectData buffer (one entry per entity with a Transform component)
+constexpr int MAX_OBJECTS = 1 << 18;
+
+// cluster culling capacities : meshlets of all uploaded meshes, their vertex / triangle data (in uints), and the indices emitted per frame
+constexpr int MAX_MESHLETS = 1 << 18;
+constexpr int MAX_MESHLET_DATA = 1 << 23;
+constexpr int MAX_CLUSTER_INDICES = 1 << 22;
+
+// bindless mode : MaterialData entries of the material buffer, and the slots of the bindless set (clamped to the device's update after bind limits)
+constexpr int MAX_MATERIALS = 1 << 12;
+constexpr int MAX_BINDLESS_BUFFERS = 1 << 10;
+constexpr int MAX_BINDLESS_TEXTURES = 1 << 14;
+constexpr int MAX_BINDLESS_SAMPLERS = 64;
+
+// clustered lighting : lights uploaded per frame, the view space cluster grid (screen tiles x exponential depth slices) and the lights each cluster can hold.
+// note : the grid must match light_cull.comp and clustered_lighting.glsl
+constexpr int MAX_LIGHTS = 1 << 13;
+constexpr int LIGHT_CLUSTER_COUNT_X = 16;
+constexpr int LIGHT_CLUSTER_COUNT_Y = 9;
+constexpr int LIGHT_CLUSTER_COUNT_Z = 24;
+constexpr int LIGHT_CLUSTER_COUNT = LIGHT_CLUSTER_COUNT_X * LIGHT_CLUSTER_COUNT_Y * LIGHT_CLUSTER_COUNT_Z;
+constexpr int MAX_LIGHTS_PER_CLUSTER = 256;
+
 namespace halo
 {
+	// swapchain presentation modes. If the requested mode is not supported by the surface, the next one in its fallback chain is used (FIFO is always supported).
+	enum class PresentMode
+	{
+		Fifo,
+		FifoRelaxed,
+		Mailbox,
+		Immediate
+	};
+
+	// compute post processing chain run on the HDR scene color (see Engine::init_post_processing).
+	struct PostProcessSettings
+	{
+		float m_exposure{1.0f};
+
+		// bloom : the bright parts of the image (above m_bloom_threshold) are blurred through a half resolution mip chain and added back.
+		bool m_bloom{true};
+		float m_bloom_threshold{1.0f};
+		float m_bloom_intensity{0.05f};
+		uint32_t m_bloom_mip_count{6};
+
+		// distance fog of EnvironmentData (m_fog_color / m_fog_distance), applied to geometry only
+		bool m_fog{true};
+	};
+
+	// dynamic resolution : the scene is rendered at the window size * scale, the scale being adjusted from the measured GPU frame time so that it stays
+	// within m_target_gpu_time_ms. The post composite pass upscales to the window size (see Engine::update_render_scale).
+	struct DynamicResolutionSettings
+	{
+		bool m_enabled{false};
+		float m_target_gpu_time_ms{16.0f};
+
+		// the scale never goes above 1 (the render targets are allocated at the window size)
+		float m_min_scale{0.5f};
+	};
+
+	// GPU memory : budget / usage and allocation statistics are logged every m_log_interval seconds (0 disables the log), see Engine::get_memory_stats.
+	// Fragmentation is checked every m_defragmentation_interval seconds : if the fragmented bytes (see MemoryStats) exceed m_fragmentation_threshold of the
+	// blocks' size, mesh buffers and texture images are moved over the next frames, at most m_defragmentation_moves_per_frame per frame (each pass is copied
+	// by a frame's command buffer and committed once that frame has finished).
+	struct MemorySettings
+	{
+		float m_log_interval{0.0f};
+
+		bool m_defragmentation{false};
+		float m_defragmentation_interval{60.0f};
+		float m_fragmentation_threshold{0.25f};
+		uint32_t m_defragmentation_moves_per_frame{16};
+	};
+
+	// usage of a memory heap by this process, and the budget the driver gives it (from VK_EXT_memory_budget, estimated if it is not supported)
+	struct MemoryHeapStats
+	{
+		bool m_device_local{false};
+
+		vk::DeviceSize m_usage{0};
+		vk::DeviceSize m_budget{0};
+
+		// memory blocks allocated from the heap, and the part of them used by allocations
+		vk::DeviceSize m_block_bytes{0};
+		vk::DeviceSize m_allocation_bytes{0};
+	};
+
+	struct MemoryStats
+	{
+		std::vector<MemoryHeapStats> m_heaps;
+
+		// allocated bytes per category : mesh buffers, texture images, per frame buffers, render graph images (and the depth pyramid), and everything else
+		vk::DeviceSize m_mesh_bytes{0};
+		vk::DeviceSize m_texture_bytes{0};
+		vk::DeviceSize m_frame_bytes{0};
+		vk::DeviceSize m_attachment_bytes{0};
+		vk::DeviceSize m_other_bytes{0};
+
+		// fragmentation : free ranges left between the allocations of the blocks. Fragmented bytes are the free bytes outside of the largest free range of
+		// each memory type (which new allocations could not use if they are larger than the other ranges).
+		uint32_t m_block_count{0};
+		uint32_t m_allocation_count{0};
+		uint32_t m_unused_range_count{0};
+		vk::DeviceSize m_block_bytes{0};
+		vk::DeviceSize m_unused_bytes{0};
+		vk::DeviceSize m_fragmented_bytes{0};
+	};
+
 	struct Config
 	{
 		float m_window_width;
 		float m_window_height;
 		std::string m_window_name;
+
+		PresentMode m_present_mode{PresentMode::FifoRelaxed};
+
+		// low latency mode : the frame fence is waited on as late as possible, the CPU is kept at most one frame ahead of the GPU and input is sampled right before command recording.
+		bool m_low_latency_mode{false};
+
+		// use vulkan 1.2 timeline semaphores instead of per frame fences for frame synchronization (falls back to fences if the device does not support them).
+		bool m_use_timeline_semaphores{false};
+
+		// GPU two phase occlusion culling against a depth pyramid (hierarchical z). Needs the drawIndirectFirstInstance device feature, and is disabled if it is not supported.
+		bool m_occlusion_culling{false};
+
+		// depth only pre pass (position stream only) before the shading pass, which then tests with eEqual and does not write depth, so every pixel is shaded once.
+		bool m_depth_prepass{false};
+
+		// GPU vertex format of every uploaded mesh
+		VertexLayout m_vertex_layout;
+
+		// run the vertex cache / overdraw / vertex fetch optimizations on meshes when they are uploaded (prints ACMR / ATVR before and after).
+		bool m_optimize_meshes{false};
+
+		// simplify uploaded meshes into a LOD chain. Each draw uses the coarsest LOD whose error projects to at most m_lod_error_threshold pixels.
+		bool m_generate_mesh_lods{false};
+		float m_lod_error_threshold{1.0f};
+
+		// split meshes into meshlets and cull them on the GPU (frustum + normal cone) every frame, drawing the surviving triangles from a generated index buffer.
+		// Needs drawIndirectFirstInstance. Replaces occlusion culling if both are requested.
+		bool m_cluster_culling{false};
+
+		// bindless materials (VK_EXT_descriptor_indexing) : one update after bind set holds every storage buffer / texture / sampler, and materials are MaterialData
+		// entries indexed per object, so draws of different materials with the same mesh share one indirect draw. Falls back to per material sets if not supported.
+		bool m_bindless{false};
+
+		// point / spot lights scattered (and moving) around the scene by init_scene, to exercise clustered lighting.
+		uint32_t m_scene_light_count{0};
+
+		// cascaded shadow maps of the sun : cascades split the view frustum (clamped to [1, MAX_SHADOW_CASCADES]), each rendered into a layer of a
+		// m_shadow_map_resolution x m_shadow_map_resolution depth array (clamped to the largest image / framebuffer size the device supports).
+		uint32_t m_shadow_cascade_count{4};
+		uint32_t m_shadow_map_resolution{2048};
+
+		PostProcessSettings m_post_process;
+
+		// timestamp queries are required, dynamic resolution is disabled if the graphics queue does not support them.
+		DynamicResolutionSettings m_dynamic_resolution;
+
+		// MSAA samples per pixel of the scene pass (1 disables it), lowered to the highest count the device supports. The multisampled color is resolved
+		// into the HDR color by the scene pass itself, depth by a compute pass (see Engine::dispatch_depth_resolve).
+		uint32_t m_msaa_samples{1};
+
+		MemorySettings m_memory;
+
+		// settings of the textures referenced by loaded assets. Compression falls back to RGBA8 if the device does not support BC formats.
+		TextureSettings m_texture_settings;
+	};
+
+	// state of the keys the engine cares about, updated by poll_input
+	struct InputState
+	{
+		bool m_quit{false};
+
+		bool m_front{false};
+		bool m_back{false};
+		bool m_left{false};
+		bool m_right{false};
 	};
 
 	// base engine class. All things are brought together here
@@ -34,50 +218,255 @@ namespace halo
 		void run();
 		void clean();
 
+		// GPU memory usage, budgets and allocation statistics (see MemoryStats)
+		[[nodiscard]]
+		MemoryStats get_memory_stats();
+
+		// closest entity whose world bounds are hit by the ray through the given window position
+		[[nodiscard]]
+		std::optional<Entity> pick_entity(int32_t mouse_x, int32_t mouse_y);
+
 	private:
 		void render();
+
+		// pumps SDL events, updates the input state and moves the camera accordingly
+		void poll_input();
 		
 		void init_platform_backend();
 
 		void init_vulkan();
 
 		void init_swapchain();
-		void init_depth_buffer();
+
+		// returns the first present mode of the fallback chain of the configured mode that the surface supports.
+		[[nodiscard]]
+		vk::PresentModeKHR select_present_mode();
+
+		// frame graph : declares the depth buffer, HDR / post processing images and the passes of a frame (depending on the enabled culling and post
+		// processing modes), then compiles it.
+		void init_render_graph();
 
 		void init_command_objects();
 
 		void init_renderpass();
+
+		// scene render pass (depth pre pass subpass + main subpass if enabled). load_attachments keeps the color / depth written earlier in the frame instead of clearing them.
+		vk::RenderPass create_scene_render_pass(bool load_attachments);
 		void init_framebuffers();
 
 		void init_synchronization_objects();
 
 		void init_descriptors();
-		
+
+		// bindless set (storage buffers at binding 0, sampled images at 1, samplers at 2) and the material buffer, which takes buffer slot 0.
+		void init_bindless();
+
+		// writes the buffer into the next free storage buffer slot of the bindless set (slots are never given back).
+		uint32_t register_bindless_buffer(vk::Buffer buffer, vk::DeviceSize range);
+
+		// writes the texture's view into a free sampled image slot. The slot can be reused once the GPU is done with every frame submitted before release_bindless_texture.
+		uint32_t register_bindless_texture(const Texture& texture);
+		void release_bindless_texture(uint32_t slot);
+
+		// slot of the sampler with these settings, registered on first use.
+		[[nodiscard]]
+		uint32_t get_bindless_sampler_index(const SamplerSettings& settings);
+
 		void init_pipeline();
 
+		// layout of the scene's mesh pipelines : MeshPushConstants, the global and object sets, and the material's set (set 2) if there is one.
+		[[nodiscard]]
+		vk::PipelineLayout create_mesh_pipeline_layout(vk::DescriptorSetLayout material_set_layout = {});
+
+		// mesh pipeline of the scene pass's main subpass (configured vertex layout, dynamic viewport, MSAA sample count, depth state of the pre pass mode).
+		// The shader modules are destroyed at shutdown.
+		[[nodiscard]]
+		vk::Pipeline create_mesh_pipeline(vk::ShaderModule vertex_module, vk::ShaderModule fragment_module, vk::PipelineLayout pipeline_layout);
+
 		void load_shaders(const char *file_path, vk::ShaderModule& shader_module);
 		void load_meshes();
 
-		void upload_meshes(Mesh& mesh);
+		// packs the mesh's vertices with the configured vertex layout, uploads the position / attribute streams and registers the mesh under mesh_name.
+		MeshHandle upload_mesh(std::string_view mesh_name, Mesh&& mesh);
+
+		// host visible vertex / index buffer filled with data
+		BufferHandle create_mesh_buffer(const void *data, size_t size, vk::BufferUsageFlags usage);
+
+		// removes the mesh from the registry. Its vertex buffer is destroyed once the GPU is done with it, and game objects still using the handle are skipped.
+		// A running defragmentation is finished first (never call it while a frame is being recorded).
+		void unload_mesh(MeshHandle mesh_handle);
+
+		// loads a TGA texture and registers it under texture_name. Compressed textures come from (or are cooked into) the texture cache,
+		// uncompressed ones upload level 0 and generate the other mips on the GPU.
+		TextureHandle load_texture(std::string_view texture_name, const std::string& file_path, const TextureSettings& settings);
+
+		// copies every mip of texture_data through a staging buffer (no decoding). With generate_mips, only level 0 is copied and the chain is blitted on the GPU.
+		TextureHandle upload_texture(std::string_view texture_name, const TextureData& texture_data, bool generate_mips);
+
+		// image of a texture (shared by uploads and the copies made by defragmentation)
+		[[nodiscard]]
+		vk::ImageCreateInfo create_texture_image_info(vk::Format format, uint32_t width, uint32_t height, uint32_t mip_count) const;
+
+		// the image and view are destroyed once the GPU is done with them. Materials using the texture have to be removed first.
+		// A running defragmentation is finished first (never call it while a frame is being recorded).
+		void unload_texture(TextureHandle texture_handle);
+
+		// one sampler per distinct settings, shared by every texture using them (destroyed at shutdown).
+		[[nodiscard]]
+		vk::Sampler get_sampler(const SamplerSettings& settings);
+
+		// records commands into the upload command buffer, submits them and waits (used for loading, never inside a frame).
+		void immediate_submit(std::function<void(vk::CommandBuffer command_buffer)>&& record_commands);
 
 		void init_scene();
 
-		void create_material(const std::string& material_name, vk::Pipeline pipeline, vk::PipelineLayout pipeline_layout);
+		// per frame scene systems (run on the job system's threads)
+		void update_scene(float delta_time);
+
+		// rebuilds the BVH from the current world bounds (needed whenever Bounds components are added or removed)
+		void rebuild_bvh();
+
+		MaterialHandle create_material(std::string_view material_name, vk::Pipeline pipeline, vk::PipelineLayout pipeline_layout);
+
+		// material of the textured pipeline, sampling texture_handle with the given sampler settings (a bindless material in bindless mode).
+		MaterialHandle create_textured_material(std::string_view material_name, TextureHandle texture_handle, const SamplerSettings& sampler_settings = {});
+
+		// material of the bindless pipeline : material_data is written into the material buffer.
+		MaterialHandle create_bindless_material(std::string_view material_name, const MaterialData& material_data);
 
+		// lookups are keyed by hashed names (use "name"_sid for compile time ids), so no string is hashed or compared here.
 		[[nodiscard]]
-		Material* get_material(const std::string& material_name);
+		MaterialHandle get_material(StringId material_name);
 
 		[[nodiscard]]
-		Mesh* get_mesh(const std::string& mesh_name);
+		MeshHandle get_mesh(StringId mesh_name);
+
+		[[nodiscard]]
+		TextureHandle get_texture(StringId texture_name);
+
+		// uploads per frame data (camera, environment, dirty object matrices) and fills m_draw_list with the draws that pass frustum culling.
+		void prepare_draws();
+
+		// records m_draw_list. With a indirect buffer, draw i uses the command at indirect_offset + i (written by the occlusion or cluster cull shader).
+		void draw_objects(vk::CommandBuffer command_buffer, vk::Buffer indirect_buffer = {}, vk::DeviceSize indirect_offset = 0);
+
+		// appends a draw for every drawable entity in visible_bounds (Bounds dense indices), with the LOD selected from the camera.
+		void build_draw_list(const std::vector<uint32_t>& visible_bounds, float lod_projection_scale, std::vector<DrawRecord>& draw_list);
+
+		// index buffer the draws of a mesh use : the mesh's own, or the frame's cluster culling output.
+		[[nodiscard]]
+		vk::Buffer get_index_buffer(const Mesh& mesh);
+
+		// same draws as draw_objects, but with the depth only pipeline and the meshes' position buffers.
+		void draw_depth_prepass(vk::CommandBuffer command_buffer, vk::Buffer indirect_buffer = {}, vk::DeviceSize indirect_offset = 0);
+
+		// scene render pass of the early (clears) or late (loads, draws the late phase's commands) phase of a frame, into the current swapchain image.
+		void record_scene_pass(vk::CommandBuffer command_buffer, bool late_phase);
+
+		// records every subpass of the scene render pass (pre pass if enabled, then the shading pass).
+		void draw_scene(vk::CommandBuffer command_buffer, vk::Buffer indirect_buffer = {}, vk::DeviceSize indirect_offset = 0);
+
+		// occlusion culling : depth pyramid, cull pipelines and the render pass used after the pyramid is built (loads color / depth instead of clearing them).
+		void init_occlusion_culling();
 
-		void draw_objects(vk::CommandBuffer command_buffer, GameObject* game_object);
+		void dispatch_occlusion_cull(vk::CommandBuffer command_buffer, bool late_phase);
+		void build_depth_pyramid(vk::CommandBuffer command_buffer);
+
+		// cluster culling : global meshlet buffers, per frame output index buffers and the cull pipeline.
+		void init_cluster_culling();
+
+		// copies the mesh's meshlets into free ranges of the global meshlet buffers (offsets rebased), sets the mesh's GPU meshlet ranges.
+		void upload_meshlets(Mesh& mesh);
+
+		// gives the mesh's meshlet ranges back once the frames in flight are done with them.
+		void release_meshlets(const Mesh& mesh);
+
+		void dispatch_cluster_cull(vk::CommandBuffer command_buffer);
+
+		// clustered lighting : light cull pipeline and its per frame sets (the light / cluster buffers are part of the global set, see init_descriptors).
+		void init_light_culling();
+
+		// bins the frame's lights into the view space clusters read by the lit fragment shaders.
+		void dispatch_light_cull(vk::CommandBuffer command_buffer);
+
+		// shadow cascades : shadow render pass, per cascade framebuffers, depth only pipeline and the shadow data / shadow map of the global set.
+		void init_shadows();
+
+		// fits the cascades to slices of the view frustum, uploads ShadowData and fills the per cascade draw lists.
+		void update_shadow_cascades(const math::M4& projection_view_mat, float lod_projection_scale);
+
+		// one render pass per cascade, drawing its draw list into its layer of the shadow map.
+		void draw_shadow_cascades(vk::CommandBuffer command_buffer);
+
+		// post processing : bloom / composite (and MSAA depth resolve) pipelines and their sets (the images are transient images of the render graph).
+		void init_post_processing();
+
+		// bloom downsample chain (prefiltered from the HDR color), then upsample chain back to its first mip.
+		void dispatch_bloom(vk::CommandBuffer command_buffer);
+
+		// MSAA : resolves the multisampled depth buffer (farthest sample of each pixel) for the passes that sample depth.
+		void dispatch_depth_resolve(vk::CommandBuffer command_buffer);
+
+		// fused full screen pass : fog, bloom, exposure, tonemapping and output encoding, into the LDR image.
+		void dispatch_post_composite(vk::CommandBuffer command_buffer);
+
+		// copies the LDR image to the current swapchain image.
+		void blit_to_swapchain(vk::CommandBuffer command_buffer);
+
+		// dynamic resolution : per frame timestamp query pools (the first and last command of the frame).
+		void init_dynamic_resolution();
+
+		// reads the GPU time of the current frame's previous submission (the frame has just been waited for) and picks the render extent of the frame.
+		void update_render_scale();
+
+		// per frame memory bookkeeping : budget frame index, periodic statistics log, and the fragmentation check.
+		void update_memory();
+
+		void log_memory_stats();
+
+		// starts an incremental defragmentation of the mesh buffers and texture images (nothing happens if there is nothing to move).
+		void begin_defragmentation();
+
+		// called at the start of every frame while a defragmentation runs : commits the last pass once the submission that copied it has finished,
+		// then records the copies of the next one into the frame's command buffer.
+		void step_defragmentation(vk::CommandBuffer command_buffer);
+
+		// moves the next allocations : the moved buffers / images are recreated at their new place and copied by command_buffer, and their descriptors
+		// rewritten. Only passes moving textures wait (for the frames in flight, which use the descriptors). Ends the defragmentation if nothing is left.
+		void begin_defragmentation_pass(vk::CommandBuffer command_buffer, uint32_t max_moves);
+
+		// frees the places the last pass moved from, and ends the defragmentation once everything is moved (or last_pass is set).
+		void end_defragmentation_pass(bool last_pass);
+
+		// runs the remaining passes of the running defragmentation with immediate submissions (the allocations it plans to move can not be freed
+		// before it ends). Waits for the GPU to be idle.
+		void finish_defragmentation();
 
 		// Util function to get the current frame (from the m_frame_data array) that is being used
 		FrameData& get_current_frame_data();
 
+		// blocks until the GPU has finished the last submission that used frame_data (fence or timeline wait depending on the sync backend).
+		void wait_for_frame(FrameData& frame_data);
+
+		// submission values : every frame submission to the graphics queue is tagged with a monotonically increasing value.
+		// With timeline semaphores this is the timeline value, with fences it is emulated from the fences waited on so far.
+		// A resource last used by submission value v can be reused once get_completed_submission_value() >= v.
+		[[nodiscard]]
+		uint64_t get_pending_submission_value() const;
+
+		[[nodiscard]]
+		uint64_t get_completed_submission_value();
+
+		// queues a resource for destruction once the GPU has finished every submission made so far (used for runtime unloading, no waitIdle needed).
+		template <typename T>
+		void destroy_deferred(const T& resource)
+		{
+			m_deletion_queue.defer(resource, get_pending_submission_value());
+		}
+
 		// Utils for buffer creation
 		[[nodiscard]]
-		AllocatedBuffer create_buffer(size_t allocation_size, vk::BufferUsageFlagBits usage, VmaMemoryUsage memory_usage);
+		AllocatedBuffer create_buffer(size_t allocation_size, vk::BufferUsageFlags usage, VmaMemoryUsage memory_usage);
 
 		// Util function to pad size of alignment boundary, so that it the required alignment is based on device offset alignment
 		[[nodiscard]]
@@ -109,27 +498,182 @@ namespace halo
 		std::vector<vk::Image> m_swapchain_images;
 		std::vector<vk::ImageView> m_swapchain_image_views;
 
-		// related to depth buffer
+		// swapchain image acquired for the current frame
+		uint32_t m_swapchain_image_index{0};
+
+		// related to depth buffer (a transient image of the render graph)
 		vk::Format m_depth_image_format;
-		vk::Image m_depth_image;
 		vk::ImageView m_depth_image_view;
-		AllocatedImage m_depth_image_allocation;
+
+		// HDR color the scene is rendered into, before post processing (a transient image of the render graph)
+		vk::Format m_hdr_color_format;
+		vk::ImageView m_hdr_color_view;
+
+		// MSAA : the scene is rendered into multisampled color / depth, and color is resolved into the HDR color at the end of the scene pass
+		vk::SampleCountFlagBits m_msaa_samples{vk::SampleCountFlagBits::e1};
+		vk::ImageView m_msaa_color_view;
+
+		// single sampled depth read by the depth pyramid and post processing (the depth buffer itself, or its resolve with MSAA)
+		vk::ImageView m_sampled_depth_view;
+
+		// dynamic resolution : the scene passes render into the top left m_render_extent of the window sized targets, which post processing upscales.
+		// m_gpu_frame_time_ms is smoothed over frames, m_timestamp_period converts timestamp ticks to nanoseconds (of which the low m_timestamp_valid_bits are valid).
+		bool m_dynamic_resolution_enabled{false};
+		vk::Extent2D m_render_extent;
+		float m_render_scale{1.0f};
+		float m_gpu_frame_time_ms{0.0f};
+		float m_timestamp_period{1.0f};
+		uint32_t m_timestamp_valid_bits{0};
+
+		// barriers, layout transitions and transient images of a frame. The swapchain image is set every frame, the depth pyramid once it is created.
+		RenderGraph m_render_graph;
+		RenderGraphResource m_swapchain_graph_image;
+		RenderGraphResource m_depth_pyramid_graph_image;
+		RenderGraphResource m_shadow_map_graph_image;
+		RenderGraphResource m_bloom_graph_image;
+		RenderGraphResource m_ldr_color_graph_image;
 
 		// Queue's and index into queue (both presentation + graphics)
 		vk::Queue m_graphics_queue;
 		uint32_t m_graphics_queue_index;
 
-		// Frambuffer, render pass and (todo : depth buffer)
+		// timeline semaphore of the graphics queue (only valid if m_timeline_sync_enabled)
+		bool m_timeline_sync_enabled{false};
+		QueueTimeline m_graphics_timeline;
+
+		// fence based backend : highest submission value known to be finished by the GPU
+		uint64_t m_completed_submission_value{0};
+
+		// scene render pass and its framebuffer (HDR color + depth, so one framebuffer serves every swapchain image)
 		vk::RenderPass m_render_pass;
-		std::vector<vk::Framebuffer> m_framebuffers;
+		vk::Framebuffer m_framebuffer;
+
+		// subpass the shading pipelines are created for (1 if the depth pre pass is enabled)
+		uint32_t m_main_subpass{0};
+
+		vk::Pipeline m_depth_prepass_pipeline;
+		vk::PipelineLayout m_depth_prepass_pipeline_layout;
+
+		// occlusion culling : m_load_render_pass is compatible with m_render_pass (same framebuffers / pipelines) but keeps the early phase's color and depth.
+		bool m_occlusion_culling_enabled{false};
+		bool m_multi_draw_indirect_enabled{false};
+
+		vk::RenderPass m_load_render_pass;
+
+		AllocatedImage m_depth_pyramid_allocation;
+		vk::ImageView m_depth_pyramid_view;
+		std::vector<vk::ImageView> m_depth_pyramid_mip_views;
+		vk::Extent2D m_depth_pyramid_extent;
+		uint32_t m_depth_pyramid_mip_count{0};
+		vk::Sampler m_depth_pyramid_sampler;
+
+		// per object visibility of the last frame (indexed by object index), shared by all frames since frames execute in order on the graphics queue.
+		AllocatedBuffer m_object_visibility_buffer;
+
+		// visibility buffer is cleared by the first frame that uses it.
+		bool m_occlusion_resources_initialized{false};
+
+		vk::DescriptorSetLayout m_depth_reduce_descriptor_set_layout;
+		vk::DescriptorSetLayout m_occlusion_cull_descriptor_set_layout;
+		std::vector<vk::DescriptorSet> m_depth_reduce_descriptor_sets;
+
+		vk::Pipeline m_depth_reduce_pipeline;
+		vk::PipelineLayout m_depth_reduce_pipeline_layout;
+
+		vk::Pipeline m_occlusion_cull_pipeline;
+		vk::PipelineLayout m_occlusion_cull_pipeline_layout;
+
+		// cluster culling : meshlets of every mesh live in two global buffers. Each mesh gets a range of both, given back when the mesh is unloaded.
+		bool m_cluster_culling_enabled{false};
+
+		AllocatedBuffer m_meshlet_buffer;
+		AllocatedBuffer m_meshlet_data_buffer;
+		RangeAllocator m_meshlet_ranges;
+		RangeAllocator m_meshlet_data_ranges;
+
+		vk::DescriptorSetLayout m_cluster_cull_descriptor_set_layout;
+
+		vk::Pipeline m_cluster_cull_pipeline;
+		vk::PipelineLayout m_cluster_cull_pipeline_layout;
+
+		// clustered lighting : light count of every cluster, and the light indices of each cluster (MAX_LIGHTS_PER_CLUSTER slots per cluster), shared by all frames.
+		AllocatedBuffer m_light_cluster_buffer;
+		AllocatedBuffer m_light_index_buffer;
+
+		// lights of the current frame that survived frustum culling
+		uint32_t m_light_count{0};
+
+		vk::DescriptorSetLayout m_light_cull_descriptor_set_layout;
+
+		vk::Pipeline m_light_cull_pipeline;
+		vk::PipelineLayout m_light_cull_pipeline_layout;
+
+		// shadow cascades : layers of the shadow map (a transient image of the render graph), one view / framebuffer per layer to render it
+		uint32_t m_shadow_cascade_count{0};
+		uint32_t m_shadow_map_resolution{0};
+
+		vk::RenderPass m_shadow_render_pass;
+		std::vector<vk::ImageView> m_shadow_cascade_views;
+		std::vector<vk::Framebuffer> m_shadow_framebuffers;
+		vk::Sampler m_shadow_sampler;
+
+		vk::Pipeline m_shadow_pipeline;
+		vk::PipelineLayout m_shadow_pipeline_layout;
+
+		// world space to clip space of each cascade (custom math convention), and the draws that survived culling against it
+		math::M4 m_shadow_cascade_mats[MAX_SHADOW_CASCADES];
+		std::vector<DrawRecord> m_shadow_draw_lists[MAX_SHADOW_CASCADES];
+		std::vector<uint32_t> m_shadow_visible_bounds;
+
+		// post processing : the bloom image has one view per mip, with the sets of every downsample (mip i - 1 into mip i, the HDR color into mip 0)
+		// and upsample (mip i + 1 added into mip i) dispatch.
+		vk::Extent2D m_bloom_extent;
+		uint32_t m_bloom_mip_count{0};
+		std::vector<vk::ImageView> m_bloom_mip_views;
+
+		vk::Sampler m_post_sampler;
+
+		vk::DescriptorSetLayout m_bloom_descriptor_set_layout;
+		std::vector<vk::DescriptorSet> m_bloom_downsample_descriptor_sets;
+		std::vector<vk::DescriptorSet> m_bloom_upsample_descriptor_sets;
+
+		vk::Pipeline m_bloom_downsample_pipeline;
+		vk::Pipeline m_bloom_upsample_pipeline;
+		vk::PipelineLayout m_bloom_pipeline_layout;
+
+		vk::DescriptorSetLayout m_post_composite_descriptor_set_layout;
+		vk::DescriptorSet m_post_composite_descriptor_set;
+
+		vk::Pipeline m_post_composite_pipeline;
+		vk::PipelineLayout m_post_composite_pipeline_layout;
+
+		// MSAA depth resolve (only created with MSAA)
+		vk::DescriptorSetLayout m_depth_resolve_descriptor_set_layout;
+		vk::DescriptorSet m_depth_resolve_descriptor_set;
+
+		vk::Pipeline m_depth_resolve_pipeline;
+		vk::PipelineLayout m_depth_resolve_pipeline_layout;
+
+		// the composite pass sRGB encodes its output itself when the swapchain format does not
+		bool m_encode_srgb{false};
+
+		// draws of the current frame that survived frustum culling
+		std::vector<DrawRecord> m_draw_list;
+
+		// camera data of the current frame (as uploaded to the GPU)
+		CameraData m_camera_data;
+
+		// world space view frustum of the current frame
+		Frustum m_frustum;
 
 		FrameData m_frames[MAX_FRAMES_IN_FLIGHT];
 
 		EnvironmentData m_environment_data;
 		AllocatedBuffer m_environment_parameter_buffer;
 
-		// descriptor related handles
-		vk::DescriptorPool m_descriptor_pool;
+		// descriptor related handles : sets that live until shutdown come from a growable allocator, and every set layout goes through the cache
+		DescriptorAllocator m_descriptor_allocator;
+		DescriptorLayoutCache m_descriptor_layout_cache;
 		
 		vk::DescriptorSetLayout m_global_descriptor_set_layout;
 		vk::DescriptorSetLayout m_object_descriptor_set_layout;
@@ -141,21 +685,98 @@ namespace halo
 		vk::Pipeline m_default_mesh_pipeline;
 		vk::PipelineLayout m_default_mesh_layout;
 
-		Mesh m_triangle_mesh;
-		Mesh m_monkey_mesh;
-		
+		vk::DescriptorSetLayout m_texture_descriptor_set_layout;
+		vk::Pipeline m_textured_mesh_pipeline;
+		vk::PipelineLayout m_textured_mesh_layout;
+
+		// bindless mode (see Config::m_bindless)
+		bool m_bindless_enabled{false};
+
+		uint32_t m_bindless_buffer_capacity{0};
+		uint32_t m_bindless_texture_capacity{0};
+		uint32_t m_bindless_sampler_capacity{0};
+
+		vk::DescriptorPool m_bindless_descriptor_pool;
+		vk::DescriptorSetLayout m_bindless_descriptor_set_layout;
+		vk::DescriptorSet m_bindless_descriptor_set;
+
+		vk::Pipeline m_bindless_mesh_pipeline;
+		vk::PipelineLayout m_bindless_mesh_layout;
+
+		AllocatedBuffer m_material_buffer;
+		uint32_t m_material_count{0};
+
+		uint32_t m_bindless_buffer_count{0};
+		uint32_t m_bindless_texture_count{0};
+
+		// released texture slots : free ones, and ones that may still be used by frames in flight (with the submission value they retire at)
+		std::vector<uint32_t> m_free_bindless_texture_slots;
+		std::vector<std::pair<uint32_t, uint64_t>> m_retired_bindless_texture_slots;
+
+		std::unordered_map<SamplerSettings, uint32_t, SamplerSettingsHash> m_bindless_sampler_indices;
+
+		// textures
+		bool m_texture_compression_enabled{false};
+		bool m_sampler_anisotropy_enabled{false};
+		float m_max_sampler_anisotropy{1.0f};
+
+		std::unordered_map<SamplerSettings, vk::Sampler, SamplerSettingsHash> m_samplers;
+
+		// immediate submissions (uploads done outside of the frame loop)
+		vk::CommandPool m_upload_command_pool;
+		vk::CommandBuffer m_upload_command_buffer;
+		vk::Fence m_upload_fence;
+
 		// scene management objects
-		std::vector<GameObject> m_game_objects;
-		std::unordered_map<std::string, Material> m_materials;
-		std::unordered_map<std::string, Mesh> m_meshes;
+		Scene m_scene;
+		TransformHierarchy m_transform_hierarchy;
+		JobSystem m_job_system;
+
+		// spatial index over the world bounds of all entities (items are Bounds dense indices)
+		Bvh m_bvh;
+		uint64_t m_bvh_layout_version{0};
+
+		std::vector<uint8_t> m_bounds_changed;
+
+		// scene version of the last world bounds refresh (RenderMesh components changed after it get new bounds)
+		uint32_t m_render_mesh_version{0};
+		std::vector<uint32_t> m_visible_bounds;
+
+		// resource registries : resources live in dense pools and are referred to by generational handles. Hashed names are only used to look up handles.
+		ResourcePool<Mesh> m_meshes;
+		ResourcePool<Material> m_materials;
+		ResourcePool<AllocatedBuffer> m_buffers;
+		ResourcePool<AllocatedImage> m_images;
+		ResourcePool<Texture> m_textures;
+
+		std::unordered_map<StringId, MeshHandle> m_mesh_names;
+		std::unordered_map<StringId, MaterialHandle> m_material_names;
+		std::unordered_map<StringId, TextureHandle> m_texture_names;
 
 		// VMA allocator
 		VmaAllocator m_vma_allocator;
 
-		// for handling cleanup convineintly
-		DeletionList m_deletion_list;
+		// memory budget : VK_EXT_memory_budget gives the actual usage / budget of each heap (VMA estimates them otherwise)
+		bool m_memory_budget_enabled{false};
+
+		// ticks (ms) of the last statistics log and defragmentation check
+		uint32_t m_last_memory_log_ticks{0};
+		uint32_t m_last_defragmentation_ticks{0};
+
+		// running incremental defragmentation (nullptr if there is none)
+		VmaDefragmentationContext m_defragmentation_context{nullptr};
+		VmaDefragmentationStats m_defragmentation_stats{};
+
+		// pass whose copies were recorded but not committed yet, and the submission value after which its old places are no longer read
+		bool m_defragmentation_pass_pending{false};
+		uint64_t m_defragmentation_pass_value{0};
+
+		// for handling cleanup convineintly (both at shutdown and at runtime)
+		DeletionQueue m_deletion_queue;
 
 		Camera m_camera;
 		Timer m_timer;
+
+		InputState m_input;
 	};
 }
\ No newline at end of file
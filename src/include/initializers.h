@@ -38,7 +38,7 @@ namespace halo::init
 	vk::PipelineRasterizationStateCreateInfo create_rasterizer_state();
 	
 	[[nodiscard]]
-	vk::PipelineMultisampleStateCreateInfo create_multisampling_info();
+	vk::PipelineMultisampleStateCreateInfo create_multisampling_info(vk::SampleCountFlagBits samples = vk::SampleCountFlagBits::e1);
 	
 	[[nodiscard]]
 	vk::PipelineColorBlendAttachmentState create_color_blend_state();
@@ -52,7 +52,7 @@ namespace halo::init
 	
 	// image related helper functions
 	[[nodiscard]]
-	vk::ImageCreateInfo create_image_info(vk::Format format, vk::Extent3D extent, vk::ImageUsageFlagBits usage);
+	vk::ImageCreateInfo create_image_info(vk::Format format, vk::Extent3D extent, vk::ImageUsageFlags usage);
 
 	[[nodiscard]]
 	vk::ImageViewCreateInfo create_image_view_info(vk::Format format, vk::Image image, vk::ImageAspectFlagBits aspect_flags);
@@ -68,4 +68,11 @@ namespace halo::init
 	
 	[[nodiscard]]
 	vk::WriteDescriptorSet write_descriptor_buffer(vk::DescriptorType type, vk::DescriptorSet descriptor_set, vk::DescriptorBufferInfo *buffer_info, uint32_t binding);
+
+	[[nodiscard]]
+	vk::WriteDescriptorSet write_descriptor_image(vk::DescriptorType type, vk::DescriptorSet descriptor_set, vk::DescriptorImageInfo *image_info, uint32_t binding);
+
+	// sampler with the same filter / address mode on every axis, sampling every mip level
+	[[nodiscard]]
+	vk::SamplerCreateInfo create_sampler_info(vk::Filter filter, vk::SamplerAddressMode address_mode);
 }
\ No newline at end of file
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace halo
+{
+	// small pool of worker threads owned by the engine, used for data parallel work (scene queries, culling, etc).
+	// There is one job at a time : parallel_for blocks the calling thread (which also executes batches) until the job is complete.
+	class JobSystem
+	{
+	public:
+		// worker_count = 0 uses (number of hardware threads - 1) workers, since the calling thread works too.
+		explicit JobSystem(uint32_t worker_count = 0);
+		~JobSystem();
+
+		JobSystem(const JobSystem& other) = delete;
+		JobSystem& operator=(const JobSystem& other) = delete;
+
+		// splits [0, count) into batches of batch_size and calls function(begin, end) for each batch on the worker threads and the calling thread.
+		void parallel_for(size_t count, size_t batch_size, const std::function<void(size_t, size_t)>& function);
+
+		[[nodiscard]]
+		uint32_t get_thread_count() const;
+
+	private:
+		void worker_loop();
+
+		// runs batches of the current job until none are left.
+		void execute_batches(const std::function<void(size_t, size_t)>& function);
+
+	private:
+		std::vector<std::thread> m_workers;
+
+		std::mutex m_mutex;
+		std::condition_variable m_job_condition;
+		std::condition_variable m_done_condition;
+
+		bool m_quit{false};
+
+		// current job (protected by m_mutex, except the atomic counters)
+		const std::function<void(size_t, size_t)>* m_function{nullptr};
+		uint64_t m_job_id{0};
+		size_t m_count{0};
+		size_t m_batch_size{1};
+		size_t m_batch_count{0};
+
+		std::atomic<size_t> m_next_batch{0};
+		std::atomic<size_t> m_remaining_batches{0};
+
+		// workers currently looking at the job : parallel_for only returns when this is 0, so m_function never dangles.
+		uint32_t m_active_workers{0};
+	};
+}
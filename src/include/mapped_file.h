@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace halo
+{
+	// read only memory mapping of a whole file. The OS pages data in on access, so nothing is copied until it is read (e.g. by a memcpy into a staging buffer).
+	class MappedFile
+	{
+	public:
+		MappedFile() = default;
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		MappedFile(MappedFile&& other) noexcept;
+		MappedFile& operator=(MappedFile&& other) noexcept;
+
+		// returns false if the file does not exist or cannot be mapped (empty files cannot be mapped either).
+		bool open(const char *file_path);
+		void close();
+
+		[[nodiscard]]
+		bool is_open() const { return m_data != nullptr; }
+
+		[[nodiscard]]
+		const uint8_t *get_data() const { return m_data; }
+
+		[[nodiscard]]
+		size_t get_size() const { return m_size; }
+
+	private:
+		const uint8_t *m_data{nullptr};
+		size_t m_size{0};
+
+		// platform handles (file mapping object on windows, unused elsewhere)
+		void *m_mapping_handle{nullptr};
+	};
+}
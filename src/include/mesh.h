@@ -1,6 +1,7 @@
 #pragma once
 
 #include "types.h"
+#include "culling.h"
 
 namespace halo
 {
@@ -14,24 +15,121 @@ namespace halo
 		std::vector<vk::VertexInputAttributeDescription> m_attributes;
 	};
 
-	// Position, normal, color
+	enum class VertexPositionFormat
+	{
+		Float32,
+
+		// 4 x half (w is padding, 3 component 16 bit formats are rarely supported for vertex fetch). Only precise enough for meshes of small extent.
+		Float16
+	};
+
+	// how vertices are packed on the GPU. Positions are always a separate stream (binding 0) so depth only passes fetch nothing else, normal, color and uv are interleaved in binding 1.
+	struct VertexLayout
+	{
+		VertexPositionFormat m_position_format{VertexPositionFormat::Float32};
+
+		// normal as 2 x snorm16 (octahedral encoding) instead of 3 x float
+		bool m_octahedral_normals{true};
+
+		// color as 4 x unorm8 instead of 3 x float (values are clamped to [0, 1])
+		bool m_unorm8_colors{true};
+
+		// uv as 2 x half instead of 2 x float (enough for textures up to ~2048 texels wide that do not tile much)
+		bool m_half_uvs{true};
+
+		[[nodiscard]]
+		uint32_t get_position_stride() const;
+
+		[[nodiscard]]
+		uint32_t get_attribute_stride() const;
+	};
+
+	// Position, normal, color, uv (CPU side vertex, packed according to a VertexLayout when uploaded)
 	struct Vertex
 	{
 		math::V3 m_position;
 		math::V3 m_normal;
 		math::V3 m_color;
 
+		// top left origin (v is flipped from the OBJ convention when loading)
+		math::V2 m_uv;
+
+		// position stream (binding 0) and attribute stream (binding 1). Locations 0 to 3 are always vec3 position, normal, color and vec2 uv in the shader, an octahedral normal arrives as (x, y, 0).
+		[[nodiscard]]
+		static VertexInputLayoutDescription get_vertex_input_layout_description(const VertexLayout& vertex_layout);
+
+		// position stream only, for depth only passes.
 		[[nodiscard]]
-		static VertexInputLayoutDescription get_vertex_input_layout_description();
+		static VertexInputLayoutDescription get_position_input_layout_description(const VertexLayout& vertex_layout);
 	};
 
-	// GameObject's mesh : contains allocated buffer (vk::Buffer + allocation info) and set of vertices
+	// packs vertices into the position and attribute streams described by vertex_layout.
+	void pack_vertices(const std::vector<Vertex>& vertices, const VertexLayout& vertex_layout, std::vector<uint8_t>& position_stream, std::vector<uint8_t>& attribute_stream);
+
+	constexpr uint32_t MAX_MESH_LODS = 8;
+
+	// cluster of at most MESHLET_MAX_VERTICES vertices / MESHLET_MAX_TRIANGLES triangles, culled as a whole (std430, 48 bytes).
+	struct Meshlet
+	{
+		// object space bounding sphere (xyz center, w radius)
+		math::V4 m_sphere;
+
+		// normal cone : xyz axis, w cutoff. Back facing for a camera at p if dot(c - p, axis) >= cutoff * |c - p| + radius (c, radius : the sphere).
+		math::V4 m_cone;
+
+		// m_vertex_count vertex indices at m_vertex_offset, then m_triangle_count triangles (3 x 8 bit indices into the meshlet's vertices) at m_triangle_offset.
+		uint32_t m_vertex_offset;
+		uint32_t m_triangle_offset;
+		uint32_t m_vertex_count;
+		uint32_t m_triangle_count;
+	};
+
+	// range of Mesh::m_indices drawing one level of detail. m_error is the largest deviation from LOD 0, in object space units.
+	struct MeshLod
+	{
+		uint32_t m_first_index{0};
+		uint32_t m_index_count{0};
+		float m_error{0.0f};
+
+		// range of Mesh::m_meshlets (only built with cluster culling)
+		uint32_t m_first_meshlet{0};
+		uint32_t m_meshlet_count{0};
+	};
+
+	// GameObject's mesh : indexed triangle list, contains handles to the vertex / index buffers (owned by the engine's buffer pool), set of vertices and the local space bounds
 	struct Mesh
 	{
 		std::vector<Vertex> m_vertices;
-		AllocatedBuffer m_allocated_buffer;
+		std::vector<uint32_t> m_indices;
+
+		// LOD 0 first, then increasingly coarse ones (all index the same vertices). Has at least LOD 0 once the mesh is uploaded.
+		std::vector<MeshLod> m_lods;
+
+		// clusters of every LOD. Offsets index m_meshlet_data, which holds the meshlets' vertex indices and packed triangles.
+		std::vector<Meshlet> m_meshlets;
+		std::vector<uint32_t> m_meshlet_data;
+
+		// ranges of the engine's meshlet and meshlet data buffers holding m_meshlets and m_meshlet_data (empty until uploaded)
+		uint32_t m_first_gpu_meshlet{0};
+		uint32_t m_gpu_meshlet_count{0};
+		uint32_t m_first_gpu_meshlet_data{0};
+		uint32_t m_gpu_meshlet_data_size{0};
+
+		// GPU streams of m_vertices (see VertexLayout)
+		BufferHandle m_position_buffer;
+		BufferHandle m_attribute_buffer;
+		BufferHandle m_index_buffer;
+
+		AABB m_aabb;
+		math::V4 m_bounding_sphere;
+
+		// diffuse texture (map_Kd) of the first material of the OBJ, relative to the working directory. Empty if there is none.
+		std::string m_diffuse_texture_path;
 
 		[[maybe_unused]]
 		void load_obj_from_file(const char *file_path);
+
+		// recompute m_aabb and m_bounding_sphere from m_vertices (called by load_obj_from_file, has to be called manually for meshes built by hand)
+		void compute_bounds();
 	};
 }
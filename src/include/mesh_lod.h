@@ -0,0 +1,21 @@
+#pragma once
+
+#include "mesh.h"
+
+namespace halo
+{
+	// quadric error metric edge collapse. Vertices only move onto other existing vertices, so the result indexes the same vertex buffer.
+	// Vertices sharing a position (normal / color seams) are collapsed together. Stops at target_index_count, or before a collapse would exceed target_error (object space distance).
+	// out_error is the largest error of the collapses done.
+	[[nodiscard]]
+	std::vector<uint32_t> simplify(const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, size_t target_index_count, float target_error, float& out_error);
+
+	// appends up to max_lod_count - 1 LODs (each about half the triangles of the previous one) to the mesh's index buffer and fills m_lods.
+	// m_indices has to hold only LOD 0 (so run optimize_mesh before this, not after).
+	void generate_lods(Mesh& mesh, uint32_t max_lod_count = MAX_MESH_LODS);
+
+	// coarsest LOD whose error, projected to the screen, stays under error_threshold pixels.
+	// projection_scale is viewport height / (2 * tan(vertical fov / 2)), world_sphere the mesh's bounding sphere in world space.
+	[[nodiscard]]
+	const MeshLod& select_lod(const Mesh& mesh, const math::V4& world_sphere, const math::V3& camera_position, float projection_scale, float error_threshold);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "mesh.h"
+
+namespace halo
+{
+	// size of the FIFO post transform cache meshes are measured against (common on current hardware)
+	constexpr uint32_t VERTEX_CACHE_SIZE = 16;
+
+	struct VertexCacheStatistics
+	{
+		// average cache miss ratio : transformed vertices per triangle (3 is the worst, ~0.5 the best for large regular meshes)
+		float m_acmr{0.0f};
+
+		// average transform to vertex ratio : transformed vertices per referenced vertex (1 is the best)
+		float m_atvr{0.0f};
+	};
+
+	struct MeshOptimizationReport
+	{
+		VertexCacheStatistics m_before;
+		VertexCacheStatistics m_after;
+	};
+
+	[[nodiscard]]
+	VertexCacheStatistics analyze_vertex_cache(const std::vector<uint32_t>& indices, size_t vertex_count, uint32_t cache_size = VERTEX_CACHE_SIZE);
+
+	// reorders triangles for post transform cache locality (Tom Forsyth's linear speed vertex cache optimisation). Degenerate triangles are removed.
+	void optimize_vertex_cache(std::vector<uint32_t>& indices, size_t vertex_count);
+
+	// reorders clusters of triangles so outward facing clusters far from the mesh center are drawn first (and occlude the rest).
+	// Clusters are cut where the cache restarts anyway, and further split as long as their ACMR stays within threshold times the original one.
+	// Expects indices already optimized for the vertex cache.
+	void optimize_overdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, float threshold = 1.05f);
+
+	// reorders vertices in order of first use (unreferenced ones are dropped) and remaps the indices.
+	void optimize_vertex_fetch(std::vector<uint32_t>& indices, std::vector<Vertex>& vertices);
+
+	// vertex cache, overdraw and vertex fetch passes, then recomputes the mesh bounds.
+	// Does not touch the GPU, so it can run when cooking assets offline as well as at load time.
+	MeshOptimizationReport optimize_mesh(Mesh& mesh);
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "mesh.h"
+
+namespace halo
+{
+	constexpr uint32_t MESHLET_MAX_VERTICES = 64;
+	constexpr uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+	// splits every LOD of the mesh into meshlets, in index order (so it should run after the vertex cache optimization, which keeps neighbouring triangles together).
+	// Fills m_meshlets / m_meshlet_data and the meshlet range of every LOD.
+	void build_meshlets(Mesh& mesh);
+
+	// bounding sphere and normal cone of a meshlet, from its vertices and triangles in meshlet_data.
+	void compute_meshlet_bounds(Meshlet& meshlet, const std::vector<uint32_t>& meshlet_data, const std::vector<Vertex>& vertices);
+}
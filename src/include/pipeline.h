@@ -11,7 +11,7 @@ namespace halo
 	{
 	public:
 		[[nodiscard]]
-		vk::Pipeline create_pipeline(vk::Device device, vk::RenderPass renderpass);
+		vk::Pipeline create_pipeline(vk::Device device, vk::RenderPass renderpass, uint32_t subpass = 0);
 
 	public:
 
@@ -27,12 +27,18 @@ namespace halo
 		vk::Viewport m_viewport;
 		vk::Rect2D m_scissor;
 
+		// state set while recording instead (e.g. viewport / scissor of passes rendering at a changing resolution)
+		std::vector<vk::DynamicState> m_dynamic_states;
+
 		// configuration of fixed - function rasterizer stage
 		vk::PipelineRasterizationStateCreateInfo m_rasterizer_state_info;
 
 		// control how the pipeline goes about blending into some given attachment.
 		vk::PipelineColorBlendAttachmentState m_color_blend_state_attachment;
 
+		// has to match the subpass (0 for depth only passes).
+		uint32_t m_color_attachment_count{1};
+
 		// setup for depth and stencil buffer
 		vk::PipelineDepthStencilStateCreateInfo m_depth_stencil_state_info;
 
@@ -42,4 +48,8 @@ namespace halo
 		// additional vulkan struct : info of the shader inputs (push constants and descriptor sets) of a pipeline.
 		vk::PipelineLayout m_pipeline_layout;
 	};
+
+	// compute pipelines only need the shader stage and layout, so there is no builder for them.
+	[[nodiscard]]
+	vk::Pipeline create_compute_pipeline(vk::Device device, vk::ShaderModule shader_module, vk::PipelineLayout pipeline_layout);
 }
\ No newline at end of file
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace halo
+{
+	// hands out ranges of a fixed capacity array (in elements), first fit. Freed ranges are merged with their neighbours.
+	// released ranges are retired with a submission value, and only become free once the GPU is done with it (see Engine::get_completed_submission_value).
+	class RangeAllocator
+	{
+	public:
+		void init(uint32_t capacity);
+
+		// offset of the range, or nothing when no free range is large enough. Zero sized ranges are at offset 0.
+		[[nodiscard]]
+		std::optional<uint32_t> allocate(uint32_t size);
+
+		// the range can be handed out again once the submission value is completed (see reclaim).
+		void release(uint32_t offset, uint32_t size, uint64_t retire_value);
+
+		// frees the released ranges that retire at or before the completed submission value.
+		void reclaim(uint64_t completed_submission_value);
+
+		[[nodiscard]]
+		uint32_t get_capacity() const
+		{
+			return m_capacity;
+		}
+
+	private:
+		struct Range
+		{
+			uint32_t m_offset;
+			uint32_t m_size;
+		};
+
+		struct RetiredRange
+		{
+			Range m_range;
+			uint64_t m_retire_value;
+		};
+
+		void free(Range range);
+
+		uint32_t m_capacity{0};
+
+		// sorted by offset, never adjacent to each other (merged when freed)
+		std::vector<Range> m_free_ranges;
+		std::vector<RetiredRange> m_retired_ranges;
+	};
+}
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <vk_mem_alloc.h>
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace halo
+{
+	// how a pass uses a resource. Each usage maps to the stages / accesses / image layout the graph synchronizes (see get_usage_info in render_graph.cpp).
+	enum class RenderGraphUsage : uint32_t
+	{
+		// attachments are read and written (load / clear / blend and depth test / write)
+		ColorAttachment,
+		DepthAttachment,
+		DepthAttachmentRead,
+
+		ComputeSampledRead,
+		FragmentSampledRead,
+
+		ComputeStorageRead,
+		ComputeStorageWrite,
+		ComputeStorageReadWrite,
+		FragmentStorageRead,
+
+		// buffers only
+		IndirectRead,
+		IndexRead,
+
+		TransferRead,
+		TransferWrite
+	};
+
+	// resource of a render graph (index into its resource list)
+	struct RenderGraphResource
+	{
+		uint32_t m_index{0xffffffff};
+
+		[[nodiscard]]
+		bool is_valid() const { return m_index != 0xffffffff; }
+	};
+
+	struct RenderGraphAccess
+	{
+		RenderGraphResource m_resource;
+		RenderGraphUsage m_usage;
+	};
+
+	// image created by the graph. Its contents only live from its first to its last use in a frame, so images whose lifetimes do not overlap share memory.
+	// Usage flags are derived from the passes using it.
+	struct RenderGraphImageDesc
+	{
+		vk::Format m_format;
+		vk::Extent2D m_extent;
+		uint32_t m_mip_count{1};
+		vk::ImageAspectFlags m_aspect{vk::ImageAspectFlagBits::eColor};
+
+		// array images (e.g. shadow cascades) : the view created by the graph covers every layer
+		uint32_t m_layer_count{1};
+		vk::ImageViewType m_view_type{vk::ImageViewType::e2D};
+
+		vk::SampleCountFlagBits m_samples{vk::SampleCountFlagBits::e1};
+
+		// attachments whose contents never leave a render pass (e.g. multisampled color resolved in the pass) : transient attachment usage and lazily
+		// allocated memory, which tiled GPUs may never back. Such images get their own memory (they are not aliased).
+		bool m_lazily_allocated{false};
+	};
+
+	// image owned outside of the graph (set with RenderGraph::set_image)
+	struct RenderGraphImportedImage
+	{
+		vk::ImageAspectFlags m_aspect{vk::ImageAspectFlagBits::eColor};
+
+		// a different image every frame, handed over by a semaphore (swapchain images) : contents and previous accesses are not carried over.
+		// m_frame_start_stages is the semaphore's wait stage, m_final_layout the layout the image is left in (e.g. ePresentSrcKHR).
+		bool m_discard{false};
+		vk::PipelineStageFlags m_frame_start_stages;
+		vk::ImageLayout m_final_layout{vk::ImageLayout::eUndefined};
+
+		// read after the graph executes (presented, or read by the next frame) : passes writing it are never culled.
+		bool m_output{false};
+	};
+
+	// frame graph : passes declare the resources they use, and the graph culls the passes that contribute to no output, orders them, records the barriers
+	// and layout transitions between them, and aliases the memory of transient images.
+	// note : synchronization inside a pass (e.g. between the dispatches of a mip chain) is still up to the pass. Buffers are synchronized with global memory barriers.
+	class RenderGraph
+	{
+	public:
+		using RecordFunction = std::function<void(vk::CommandBuffer command_buffer)>;
+
+		void init(vk::Device device, VmaAllocator allocator);
+
+		RenderGraphResource create_image(std::string_view name, const RenderGraphImageDesc& desc);
+		RenderGraphResource import_image(std::string_view name, const RenderGraphImportedImage& imported_image);
+
+		// buffers are only tracked for synchronization, so they need no handle. Outputs are read after the graph executes (e.g. by the next frame).
+		RenderGraphResource import_buffer(std::string_view name, bool output);
+
+		// image of an imported resource (may change every frame)
+		void set_image(RenderGraphResource resource, vk::Image image);
+
+		// passes are declared in execution order : a read sees the writes of the passes declared before it. A resource can only appear once per pass.
+		void add_pass(std::string_view name, std::vector<RenderGraphAccess> accesses, RecordFunction&& record);
+
+		// culls and orders the passes, then creates the transient images used by the remaining ones. Called once, after every pass has been added.
+		void compile();
+
+		// records every pass with the barriers needed before it, then moves discarded imported images to their final layout.
+		void execute(vk::CommandBuffer command_buffer);
+
+		[[nodiscard]]
+		vk::Image get_image(RenderGraphResource resource) const;
+
+		// view of every mip and layer of a transient image
+		[[nodiscard]]
+		vk::ImageView get_image_view(RenderGraphResource resource) const;
+
+		// bytes allocated for the transient images (shared memory blocks counted once)
+		[[nodiscard]]
+		vk::DeviceSize get_memory_size() const;
+
+		// destroys the transient images and their memory. The GPU must be idle.
+		void clean();
+
+	private:
+		// accesses since the last write, tracked per resource (per memory block for transient images, since images sharing memory never overlap)
+		struct SyncState
+		{
+			vk::PipelineStageFlags m_write_stages;
+			vk::AccessFlags m_write_access;
+
+			// stages that read since the last write, and the accesses the last write has been made visible to
+			vk::PipelineStageFlags m_read_stages;
+			vk::AccessFlags m_visible_access;
+		};
+
+		enum class ResourceType
+		{
+			TransientImage,
+			ImportedImage,
+			ImportedBuffer
+		};
+
+		struct Resource
+		{
+			std::string m_name;
+			ResourceType m_type;
+
+			RenderGraphImageDesc m_desc;
+			RenderGraphImportedImage m_imported;
+			bool m_output{false};
+
+			vk::Image m_image;
+			vk::ImageView m_view;
+			vk::ImageLayout m_layout{vk::ImageLayout::eUndefined};
+
+			uint32_t m_sync_state{0};
+
+			// transient images : usage of every pass, and the first / last position in the pass order using it
+			vk::ImageUsageFlags m_usage;
+			uint32_t m_first_use{0xffffffff};
+			uint32_t m_last_use{0};
+		};
+
+		struct Pass
+		{
+			std::string m_name;
+			std::vector<RenderGraphAccess> m_accesses;
+			RecordFunction m_record;
+		};
+
+		// memory shared by transient images with disjoint lifetimes
+		struct MemoryBlock
+		{
+			VkMemoryRequirements m_requirements;
+			VmaAllocation m_allocation{nullptr};
+			std::vector<uint32_t> m_resources;
+			bool m_lazily_allocated{false};
+		};
+
+		[[nodiscard]]
+		std::vector<uint32_t> cull_passes() const;
+
+		[[nodiscard]]
+		std::vector<uint32_t> order_passes(const std::vector<uint32_t>& kept_passes) const;
+
+		void create_transient_images();
+
+	private:
+		vk::Device m_device;
+		VmaAllocator m_vma_allocator{nullptr};
+
+		std::vector<Resource> m_resources;
+		std::vector<SyncState> m_sync_states;
+
+		std::vector<Pass> m_passes;
+
+		// indices of the passes executed, in order
+		std::vector<uint32_t> m_pass_order;
+
+		std::vector<MemoryBlock> m_memory_blocks;
+	};
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace halo
+{
+	// generational handle into a ResourcePool<T>. Index selects the slot, and generation is used to detect handles to resources that have since been removed.
+	// The type parameter is only used to make handles of different resource types incompatible with each other.
+	template <typename T>
+	struct Handle
+	{
+		static constexpr uint32_t INVALID_INDEX = UINT32_MAX;
+
+		uint32_t m_index{INVALID_INDEX};
+		uint32_t m_generation{0};
+
+		[[nodiscard]]
+		bool is_valid() const
+		{
+			return m_index != INVALID_INDEX;
+		}
+
+		bool operator==(const Handle& other) const = default;
+	};
+
+	// slot map : resources are stored in a dense array (cache friendly iteration, no holes), and handles point to slots which store the resource's index in the dense array.
+	// insert, get and remove are all O(1). Removing bumps the slot's generation, so old handles to that slot resolve to nullptr instead of a different resource.
+	// note : pointers returned by get are invalidated by insert / remove, so keep handles (not pointers) around.
+	template <typename T>
+	class ResourcePool
+	{
+	public:
+		Handle<T> insert(T&& resource)
+		{
+			uint32_t slot_index;
+			if (!m_free_slots.empty())
+			{
+				slot_index = m_free_slots.back();
+				m_free_slots.pop_back();
+			}
+			else
+			{
+				slot_index = static_cast<uint32_t>(m_slots.size());
+				m_slots.push_back(Slot{});
+			}
+
+			m_slots[slot_index].m_dense_index = static_cast<uint32_t>(m_dense.size());
+
+			m_dense.push_back(std::move(resource));
+			m_dense_to_slot.push_back(slot_index);
+
+			Handle<T> handle{};
+			handle.m_index = slot_index;
+			handle.m_generation = m_slots[slot_index].m_generation;
+
+			return handle;
+		}
+
+		[[nodiscard]]
+		T* get(Handle<T> handle)
+		{
+			if (!is_alive(handle))
+			{
+				return nullptr;
+			}
+
+			return &m_dense[m_slots[handle.m_index].m_dense_index];
+		}
+
+		[[nodiscard]]
+		const T* get(Handle<T> handle) const
+		{
+			if (!is_alive(handle))
+			{
+				return nullptr;
+			}
+
+			return &m_dense[m_slots[handle.m_index].m_dense_index];
+		}
+
+		[[nodiscard]]
+		bool is_alive(Handle<T> handle) const
+		{
+			return handle.m_index < m_slots.size() && m_slots[handle.m_index].m_generation == handle.m_generation;
+		}
+
+		// removes the resource and returns it (so the caller can release whatever GPU memory it owns). Returns std::nullopt for stale handles.
+		std::optional<T> remove(Handle<T> handle)
+		{
+			if (!is_alive(handle))
+			{
+				return std::nullopt;
+			}
+
+			Slot& slot = m_slots[handle.m_index];
+			const uint32_t dense_index = slot.m_dense_index;
+			const uint32_t last_dense_index = static_cast<uint32_t>(m_dense.size() - 1);
+
+			std::optional<T> removed_resource = std::move(m_dense[dense_index]);
+
+			// move the last resource into the hole so the dense array stays packed
+			if (dense_index != last_dense_index)
+			{
+				m_dense[dense_index] = std::move(m_dense[last_dense_index]);
+				m_dense_to_slot[dense_index] = m_dense_to_slot[last_dense_index];
+				m_slots[m_dense_to_slot[dense_index]].m_dense_index = dense_index;
+			}
+
+			m_dense.pop_back();
+			m_dense_to_slot.pop_back();
+
+			slot.m_generation++;
+			m_free_slots.push_back(handle.m_index);
+
+			return removed_resource;
+		}
+
+		[[nodiscard]]
+		size_t size() const
+		{
+			return m_dense.size();
+		}
+
+		// dense iteration over all alive resources (order is not stable across removals).
+		[[nodiscard]]
+		std::vector<T>& get_dense()
+		{
+			return m_dense;
+		}
+
+		[[nodiscard]]
+		const std::vector<T>& get_dense() const
+		{
+			return m_dense;
+		}
+
+	private:
+		struct Slot
+		{
+			uint32_t m_dense_index{0};
+			uint32_t m_generation{0};
+		};
+
+		std::vector<Slot> m_slots;
+		std::vector<uint32_t> m_free_slots;
+
+		std::vector<T> m_dense;
+		std::vector<uint32_t> m_dense_to_slot;
+	};
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "types.h"
+#include "ecs.h"
+#include "transform_hierarchy.h"
+#include "culling.h"
+
+namespace halo
+{
+	// scene components : each type is stored in its own dense array (see ComponentPool).
+
+	// node of the entity in the engine's TransformHierarchy (which owns local / world matrices). The node's slot is the entity's index into the ObjectData buffer.
+	struct Transform
+	{
+		TransformNode m_node;
+	};
+
+	struct RenderMesh
+	{
+		MeshHandle m_mesh;
+	};
+
+	struct RenderMaterial
+	{
+		MaterialHandle m_material;
+	};
+
+	// world space bounds of the entity's mesh, updated when the transform or the RenderMesh (added / patched) changes. The sphere (xyz = center, w = radius) comes first so the frustum test can read it straight from the dense array.
+	struct Bounds
+	{
+		math::V4 m_world_sphere;
+		AABB m_world_aabb;
+	};
+
+	// linear velocity in units per millisecond, angular velocity (euler angles) in degrees per millisecond. Applied to the entity's local transform.
+	struct Velocity
+	{
+		math::V3 m_linear;
+		math::V3 m_angular;
+	};
+
+	// punctual light placed by the entity's Transform (spot lights point along its local +z axis). Color is scaled by intensity, angles are cone half angles in degrees.
+	struct Light
+	{
+		LightType m_type{LightType::Point};
+
+		math::V3 m_color{1.0f, 1.0f, 1.0f};
+		float m_intensity{1.0f};
+		float m_range{5.0f};
+
+		float m_spot_inner_angle{20.0f};
+		float m_spot_outer_angle{30.0f};
+	};
+
+	using Scene = Registry<Transform, RenderMesh, RenderMaterial, Bounds, Velocity, Light>;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <functional>
+
+namespace halo
+{
+	// 64 bit FNV-1a. constexpr, so ids of string literals are computed at compile time.
+	[[nodiscard]]
+	constexpr uint64_t hash_fnv1a(std::string_view str)
+	{
+		uint64_t hash = 14695981039346656037ull;
+
+		for (char c : str)
+		{
+			hash ^= static_cast<uint8_t>(c);
+			hash *= 1099511628211ull;
+		}
+
+		return hash;
+	}
+
+	// hashed name of an asset (mesh, material, ...). Comparing / hashing a StringId is a single integer operation, so registries keyed by it never touch the string.
+	// StringId is a structural type, so it can be used as a template argument : template <StringId ID>.
+	struct StringId
+	{
+		uint64_t m_hash{0};
+
+		constexpr StringId() = default;
+
+		constexpr explicit StringId(std::string_view str) : m_hash(hash_fnv1a(str))
+		{
+		}
+
+		constexpr bool operator==(const StringId& other) const = default;
+	};
+
+	// "monkey_mesh"_sid : guaranteed to be evaluated at compile time.
+	consteval StringId operator""_sid(const char* str, size_t length)
+	{
+		return StringId(std::string_view(str, length));
+	}
+
+	// creates a StringId from a runtime string. In debug builds the string is also stored in a reverse lookup table (used for error messages / debugging),
+	// and an exception is thrown if two different strings hash to the same id.
+	[[nodiscard]]
+	StringId make_string_id(std::string_view str);
+
+	// returns the original string in debug builds (if it was created through make_string_id), else the hash in hex.
+	[[nodiscard]]
+	std::string to_string(StringId string_id);
+}
+
+template <>
+struct std::hash<halo::StringId>
+{
+	// already a good hash, so it is used directly.
+	size_t operator()(halo::StringId string_id) const noexcept
+	{
+		return static_cast<size_t>(string_id.m_hash);
+	}
+};
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "mapped_file.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace halo
+{
+	// texel formats of texture data (values are stored in texture cache files)
+	enum class TextureFormat : uint32_t
+	{
+		Rgba8 = 0,
+
+		// 4 x 4 texel blocks : 8 bytes, RGB only
+		Bc1 = 1,
+
+		// 4 x 4 texel blocks : 16 bytes, BC1 color + 8 level alpha
+		Bc3 = 2
+	};
+
+	struct TextureSettings
+	{
+		// color data (albedo) : stored as sRGB, and mips are filtered in linear space. Off for data textures (normal maps, masks).
+		bool m_srgb{true};
+
+		bool m_generate_mips{true};
+
+		// BC1 (opaque) or BC3 (with alpha), cooked offline into a cache file next to the source. RGBA8 with mips generated on the GPU otherwise.
+		bool m_compress{true};
+	};
+
+	// RGBA8 pixels, rows top to bottom
+	struct Image
+	{
+		uint32_t m_width{0};
+		uint32_t m_height{0};
+		std::vector<uint8_t> m_pixels;
+	};
+
+	// one mip level inside TextureData's data (largest level first)
+	struct TextureMip
+	{
+		uint32_t m_width;
+		uint32_t m_height;
+		uint64_t m_offset;
+		uint64_t m_size;
+	};
+
+	// texture ready for upload : every mip, back to back in the texel format.
+	// The data either lives in a memory mapped cache file (uploaded without any decoding) or in m_storage.
+	struct TextureData
+	{
+		TextureFormat m_format{TextureFormat::Rgba8};
+		bool m_srgb{true};
+
+		uint32_t m_width{0};
+		uint32_t m_height{0};
+		std::vector<TextureMip> m_mips;
+
+		MappedFile m_file;
+		size_t m_file_data_offset{0};
+
+		std::vector<uint8_t> m_storage;
+
+		[[nodiscard]]
+		const uint8_t *get_data() const;
+
+		[[nodiscard]]
+		size_t get_data_size() const;
+	};
+
+	// full chain down to 1 x 1
+	[[nodiscard]]
+	uint32_t get_mip_count(uint32_t width, uint32_t height);
+
+	// bytes of one mip level
+	[[nodiscard]]
+	size_t get_texture_level_size(TextureFormat format, uint32_t width, uint32_t height);
+
+	// decodes an uncompressed or RLE truecolor / grayscale TGA (the only source format supported, so no image library is needed).
+	[[nodiscard]]
+	Image load_tga(const char *file_path);
+
+	// 2 x 2 box filter (odd sizes clamp to the edge). sRGB images are averaged in linear space, alpha always is.
+	[[nodiscard]]
+	Image downsample(const Image& image, bool srgb);
+
+	// BC1 / BC3 block compression (bounding box endpoints, inset, nearest palette entry per texel). Images that are not a multiple of 4 are padded by repeating edge texels.
+	void compress_image(const Image& image, TextureFormat format, std::vector<uint8_t>& out_blocks);
+
+	// mips (CPU filtered) and compression of a decoded image. BC3 is picked when any texel is not fully opaque.
+	[[nodiscard]]
+	TextureData cook_texture(const Image& image, const TextureSettings& settings);
+
+	// cache file : header, mip table, then the texel data of every mip. source_stamp identifies the version of the source it was cooked from.
+	void write_texture_cache(const char *cache_path, const TextureData& texture_data, uint64_t source_stamp);
+
+	// maps a cache file. Returns false if it is missing, from another container version, or was cooked from another source_stamp / with other settings.
+	bool read_texture_cache(const char *cache_path, uint64_t source_stamp, const TextureSettings& settings, TextureData& out_texture_data);
+
+	// size and modification time of the file, hashed
+	[[nodiscard]]
+	uint64_t get_source_stamp(const char *file_path);
+
+	// cooked texture of a TGA file, through the cache at file_path + ".htex" (cooked and written if missing or stale).
+	// Only used for compressed textures : uncompressed ones are decoded and get their mips on the GPU.
+	[[nodiscard]]
+	TextureData load_cooked_texture(const std::string& file_path, const TextureSettings& settings);
+}
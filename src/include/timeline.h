@@ -0,0 +1,37 @@
+#pragma once
+
+#include "types.h"
+
+namespace halo
+{
+	// wrapper over a vulkan 1.2 timeline semaphore. There is one timeline per queue, and each submission to that queue signals the next (monotonically increasing) value.
+	// CPU side code that reuses resources (upload ring, deletion queue, query readback) only needs to compare the value it recorded against the completed value, no fences or fence resets involved.
+	class QueueTimeline
+	{
+	public:
+		// the semaphore is owned by the caller (destroyed via the deletion queue).
+		void create(vk::Device device);
+
+		// reserves the value that the next submission to the queue will signal.
+		[[nodiscard]]
+		uint64_t next_signal_value();
+
+		// value of the last submission handed out by next_signal_value (might still be in flight).
+		[[nodiscard]]
+		uint64_t get_last_signal_value() const;
+
+		// queries the value the GPU has reached so far.
+		[[nodiscard]]
+		uint64_t get_completed_value() const;
+
+		// blocks the CPU until the timeline reaches value (or timeout, in nanoseconds, expires).
+		vk::Result wait(uint64_t value, uint64_t timeout) const;
+
+	public:
+		vk::Semaphore m_semaphore;
+
+	private:
+		vk::Device m_device;
+		uint64_t m_last_signal_value{0};
+	};
+}
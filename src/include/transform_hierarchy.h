@@ -0,0 +1,126 @@
+#pragma once
+
+#include "custom_math.h"
+#include "resource_pool.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace halo
+{
+	struct TransformNodeTag;
+
+	// stable handle to a node of the TransformHierarchy (its slot in the flat arrays changes when the hierarchy is re-sorted).
+	using TransformNode = Handle<TransformNodeTag>;
+
+	// local transform relative to the parent node : translation, rotation (euler angles in degrees, applied x -> y -> z) and scale.
+	struct LocalTransform
+	{
+		math::V3 m_translation{0.0f, 0.0f, 0.0f};
+		math::V3 m_rotation{0.0f, 0.0f, 0.0f};
+		math::V3 m_scale{1.0f, 1.0f, 1.0f};
+	};
+
+	// half open range of slots [m_begin, m_end)
+	struct SlotRange
+	{
+		uint32_t m_begin{0};
+		uint32_t m_end{0};
+
+		[[nodiscard]]
+		bool is_empty() const
+		{
+			return m_begin >= m_end;
+		}
+
+		void merge(const SlotRange& other)
+		{
+			if (other.is_empty())
+			{
+				return;
+			}
+
+			if (is_empty())
+			{
+				*this = other;
+				return;
+			}
+
+			m_begin = std::min(m_begin, other.m_begin);
+			m_end = std::max(m_end, other.m_end);
+		}
+	};
+
+	// parent / child transform hierarchy stored in flat arrays, sorted in depth first (pre) order :
+	// parents always come before their children, and every subtree is a contiguous range of slots.
+	// World matrices are cached and only recomputed for dirty subtrees, and update() reports the range of slots that changed (so only that range has to be uploaded).
+	// Creating root nodes appends to the arrays, while reparenting / creating child nodes / destroying nodes re-sorts everything on the next update().
+	class TransformHierarchy
+	{
+	public:
+		TransformNode create_node(const LocalTransform& local_transform, TransformNode parent = {});
+
+		// destroys the node and all of its descendants.
+		void destroy_node(TransformNode node);
+
+		// throws if parent is the node itself or one of its descendants.
+		void set_parent(TransformNode node, TransformNode parent);
+
+		// set_local does nothing and the getters return a default transform / the identity for destroyed or stale nodes.
+		void set_local(TransformNode node, const LocalTransform& local_transform);
+
+		[[nodiscard]]
+		const LocalTransform& get_local(TransformNode node) const;
+
+		// world matrix (custom math convention) as of the last update().
+		[[nodiscard]]
+		const math::M4& get_world(TransformNode node) const;
+
+		// index of the node in the flat arrays (valid until the next update()). Asserts the node is alive (INVALID_INDEX otherwise).
+		[[nodiscard]]
+		uint32_t get_slot(TransformNode node) const;
+
+		[[nodiscard]]
+		bool is_alive(TransformNode node) const;
+
+		// recomputes the world matrices of dirty subtrees. Returns the range of slots whose world matrix changed.
+		SlotRange update();
+
+		[[nodiscard]]
+		size_t size() const;
+
+		// world matrices indexed by slot.
+		[[nodiscard]]
+		const std::vector<math::M4>& get_world_matrices() const;
+
+	private:
+		// re-sorts the flat arrays in depth first order, compacting away destroyed nodes.
+		void rebuild_order();
+
+		void recompute_range(uint32_t begin, uint32_t end);
+
+	private:
+		static constexpr uint32_t INVALID_INDEX = UINT32_MAX;
+
+		// indexed by node index (stable)
+		std::vector<uint32_t> m_node_generations;
+		std::vector<uint32_t> m_node_to_slot;
+		std::vector<TransformNode> m_node_parents;
+		std::vector<uint32_t> m_free_nodes;
+
+		// destroyed nodes are only recycled after the next re-sort, since their slots are still in the arrays until then.
+		std::vector<uint32_t> m_pending_free_nodes;
+
+		// indexed by slot (depth first order)
+		std::vector<LocalTransform> m_local_transforms;
+		std::vector<math::M4> m_world_matrices;
+		std::vector<uint32_t> m_parent_slots;
+		std::vector<uint32_t> m_subtree_sizes;
+		std::vector<uint32_t> m_slot_to_node;
+
+		// slots whose local transform changed since the last update
+		std::vector<uint32_t> m_dirty_slots;
+		bool m_topology_dirty{false};
+	};
+}
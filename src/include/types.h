@@ -5,38 +5,26 @@
 #include <vk_mem_alloc.h>
 
 #include "custom_math.h"
+#include "resource_pool.h"
+#include "transform_hierarchy.h"
+#include "descriptors.h"
 
 #include <vector>
-#include <functional>
 
 namespace halo
 {
 	struct Mesh;
 	struct Material;
+	struct AllocatedBuffer;
+	struct AllocatedImage;
+	struct Texture;
 
-	// used for vulkan cleanup. Function calls are invoked in reverse order as what they are pushed in, resulting in the latest function to be pushed to be called first.
-	struct DeletionList
-	{
-		std::vector<std::function<void()>> deletors;
-
-		// significance of && here : lvalue is copied, while r value is moved.
-		// mostly (almost always) the capture will be by value. Reason for this is that the objects will go outofscope in that particular function block, and we want to preserve it.
-		// hence we do a copy by value.
-		void push_function(std::function<void()>&& function)
-		{
-			deletors.push_back(function);
-		}
-
-		void clear_deletor_list()
-		{
-			for (auto it = deletors.rbegin(); it != deletors.rend(); it++)
-			{
-				(*it)();
-			}
-
-			deletors.clear();
-		}
-	};
+	// handles to resources owned by the engine's resource pools
+	using MeshHandle = Handle<Mesh>;
+	using MaterialHandle = Handle<Material>;
+	using BufferHandle = Handle<AllocatedBuffer>;
+	using ImageHandle = Handle<AllocatedImage>;
+	using TextureHandle = Handle<Texture>;
 
 	// temporary struct, that holds transform matrix of each game object. Data sent to the shader via push constants.
 	struct MeshPushConstants
@@ -49,31 +37,86 @@ namespace halo
 	struct AllocatedBuffer
 	{
 		vk::Buffer m_buffer;
-		VmaAllocation m_allocation_data;
+		VmaAllocation m_allocation_data{nullptr};
+
+		// creation parameters, so that the buffer can be recreated when defragmentation moves its allocation
+		vk::DeviceSize m_size{0};
+		vk::BufferUsageFlags m_usage;
 	};
 
 	// struct for image allocated + some allocation details.
 	struct AllocatedImage
 	{
 		vk::Image m_image;
-		VmaAllocation m_allocation_data;
+		VmaAllocation m_allocation_data{nullptr};
 	};
 
-	// struct for game objects :  
+	// unused bindless slot (e.g. a material without a texture)
+	constexpr uint32_t BINDLESS_INVALID_INDEX = 0xffffffff;
+
+	// sampled image : the image lives in the engine's image pool, the view is owned by the texture.
+	struct Texture
+	{
+		ImageHandle m_image;
+		vk::ImageView m_view;
+
+		vk::Format m_format;
+		uint32_t m_width;
+		uint32_t m_height;
+		uint32_t m_mip_count;
+
+		// slot in the bindless sampled image array (bindless mode only)
+		uint32_t m_bindless_index{BINDLESS_INVALID_INDEX};
+	};
+
+	// samplers are deduplicated by these settings (see Engine::get_sampler)
+	struct SamplerSettings
+	{
+		vk::Filter m_filter{vk::Filter::eLinear};
+		vk::SamplerAddressMode m_address_mode{vk::SamplerAddressMode::eRepeat};
+
+		// clamped to the device limit. 1 (or no device support) disables anisotropic filtering.
+		float m_max_anisotropy{8.0f};
+
+		bool operator==(const SamplerSettings&) const = default;
+	};
+
+	struct SamplerSettingsHash
+	{
+		size_t operator()(const SamplerSettings& settings) const
+		{
+			size_t hash = static_cast<size_t>(settings.m_filter);
+			hash = hash * 31 + static_cast<size_t>(settings.m_address_mode);
+			hash = hash * 31 + static_cast<size_t>(settings.m_max_anisotropy * 16.0f);
+
+			return hash;
+		}
+	};
 
 	// Material : pipeline and pipeline layout 
 	struct Material
 	{
 		vk::Pipeline m_pipeline;
 		vk::PipelineLayout m_pipeline_layout;
+
+		// set 2 : diffuse texture and its sampler (textured materials only). The texture is kept so that the set can be rewritten when the texture's image moves.
+		vk::DescriptorSet m_texture_set;
+		TextureHandle m_diffuse_texture;
+		vk::Sampler m_texture_sampler;
+
+		// bindless mode : index of the material's MaterialData in the material buffer
+		uint32_t m_material_index{0};
 	};
 
-	// GameObject : contains a transform matrix (sent to shader via PUSH constants), mesh, and material
-	struct GameObject
+	// GPU side material of bindless mode (std430, 32 bytes). Resources are referred to by their slot in the bindless set.
+	struct MaterialData
 	{
-		Mesh *m_mesh;
-		Material *m_material;
-		math::M4 m_mesh_transform;
+		math::V4 m_base_color{1.0f, 1.0f, 1.0f, 1.0f};
+
+		// BINDLESS_INVALID_INDEX : untextured (vertex color * base color)
+		uint32_t m_diffuse_texture_index{BINDLESS_INVALID_INDEX};
+		uint32_t m_sampler_index{0};
+		uint32_t m_padding[2]{};
 	};
 
 	// Buffer for camera details (will be sent to GPU via descriptor sets)
@@ -99,14 +142,21 @@ namespace halo
 		vk::Semaphore m_presentation_semaphore;
 		vk::Semaphore m_render_semaphore;
 
+		// only created when the fence based sync backend is used.
 		vk::Fence m_render_fence;
 
+		// submission value (see Engine::get_pending_submission_value) signalled when this frame's commands finish executing.
+		uint64_t m_submission_value{0};
+
 		vk::CommandPool m_primary_command_pool;
 		vk::CommandBuffer m_command_buffer;
 
 		// each frame has its own allocated buffer so that there will be no issues in overlapping data (because of double buffering)
 		AllocatedBuffer m_camera_allocated_buffer;
 
+		// sets that only live for this frame (reset once the GPU is done with the frame)
+		DescriptorAllocator m_descriptor_allocator;
+
 		vk::DescriptorSet m_global_descriptor_set;
 
 		// descriptor set for per object 
@@ -114,9 +164,205 @@ namespace halo
 
 		// each frame has one buffer containing all objects data 
 		AllocatedBuffer m_objects_buffer;
+
+		// material index of every object (set 1, binding 1), written for the visible draws of the frame in bindless mode
+		AllocatedBuffer m_object_material_buffer;
+
+		// slots of the transform hierarchy whose world matrix changed since this frame's objects buffer was last written
+		SlotRange m_dirty_object_range;
+
+		// occlusion culling (only created when enabled) : inputs written by the CPU, and the indirect draw commands written by the cull shader (early commands, then late commands).
+		AllocatedBuffer m_cull_input_buffer;
+		AllocatedBuffer m_draw_command_buffer;
+		vk::DescriptorSet m_occlusion_cull_descriptor_set;
+
+		// cluster culling (only created when enabled) : per draw inputs, and the indices of the visible meshlets' triangles with the counter used to allocate them.
+		// Draw commands go to m_draw_command_buffer.
+		AllocatedBuffer m_cluster_cull_input_buffer;
+		AllocatedBuffer m_cluster_index_buffer;
+		AllocatedBuffer m_cluster_index_counter_buffer;
+		vk::DescriptorSet m_cluster_cull_descriptor_set;
+
+		// lights of the frame (LightData, written by the CPU), binned by the light cull shader
+		AllocatedBuffer m_light_buffer;
+		vk::DescriptorSet m_light_cull_descriptor_set;
+
+		// shadow cascades of the frame (ShadowData, written by the CPU)
+		AllocatedBuffer m_shadow_buffer;
+
+		// dynamic resolution (only created when enabled) : timestamps at the start / end of the frame's command buffer
+		vk::QueryPool m_timestamp_query_pool;
+	};
+
+	// draw that survived CPU side culling (resolved once per frame, recorded once per render pass that draws it)
+	struct DrawRecord
+	{
+		MaterialHandle m_material;
+		MeshHandle m_mesh;
+		uint32_t m_object_index;
+
+		// index range of the selected LOD
+		uint32_t m_first_index;
+		uint32_t m_index_count;
+
+		// meshlets of the selected LOD (in the global meshlet buffer)
+		uint32_t m_first_meshlet;
+		uint32_t m_meshlet_count;
+
+		math::V4 m_world_sphere;
+	};
+
+	// per draw input of the occlusion cull shader (std430, 32 bytes).
+	struct CullInput
+	{
+		math::V4 m_world_sphere;
+		uint32_t m_object_index;
+		uint32_t m_first_index;
+		uint32_t m_index_count;
+		uint32_t m_padding;
+	};
+
+	// per draw input of the cluster cull shader (std430, 16 bytes).
+	struct ClusterCullInput
+	{
+		uint32_t m_object_index;
+		uint32_t m_first_meshlet;
+		uint32_t m_meshlet_count;
+		uint32_t m_padding;
 	};
 
-	// struct having data of environment. Size : 4 * 4 * 5  = 80 bytes
+	// push constants of the cluster cull shader (120 bytes)
+	struct ClusterCullConstants
+	{
+		// world space frustum planes (see Frustum)
+		math::V4 m_frustum_planes[6];
+		math::V4 m_camera_position;
+
+		uint32_t m_draw_count;
+		uint32_t m_index_capacity;
+	};
+
+	// push constants of the occlusion cull shader
+	struct OcclusionCullConstants
+	{
+		// transposed, like CameraData::m_projection_view_mat
+		math::M4 m_projection_view_mat;
+
+		float m_pyramid_width;
+		float m_pyramid_height;
+
+		uint32_t m_draw_count;
+		uint32_t m_late_phase;
+		uint32_t m_command_offset;
+	};
+
+	// LightData::m_type
+	enum class LightType : uint32_t
+	{
+		Point,
+		Spot
+	};
+
+	// light of the frame as read by the light cull shader and the lit fragment shaders (std430, 64 bytes). Only lights inside the view frustum are uploaded.
+	struct LightData
+	{
+		// world space position, w = range (the light has no effect past it)
+		math::V4 m_position_range;
+
+		// color premultiplied by intensity (w unused)
+		math::V4 m_color;
+
+		// spot lights : world space direction the light points to (w unused)
+		math::V4 m_direction;
+
+		LightType m_type;
+
+		// spot lights : cosines of the cone half angles, the light fades out from inner to outer
+		float m_spot_cos_inner;
+		float m_spot_cos_outer;
+
+		uint32_t m_padding;
+	};
+
+	// push constants of the light cull shader (84 bytes)
+	struct LightCullConstants
+	{
+		// transposed, like CameraData::m_projection_view_mat
+		math::M4 m_view_mat;
+
+		// view space x / y to NDC at a depth of 1 (diagonal of the projection matrix)
+		float m_projection_scale_x;
+		float m_projection_scale_y;
+
+		float m_near_plane;
+		float m_far_plane;
+
+		uint32_t m_light_count;
+	};
+
+	// shadow cascades of the sun. note : must match shadows.glsl
+	constexpr uint32_t MAX_SHADOW_CASCADES = 4;
+
+	// cascades of the frame as read by the lit fragment shaders (std140, 304 bytes).
+	struct ShadowData
+	{
+		// world space to the cascade's clip space, transposed like CameraData::m_projection_view_mat
+		math::M4 m_cascade_mats[MAX_SHADOW_CASCADES];
+
+		// view depth each cascade ends at
+		math::V4 m_cascade_split_depths;
+
+		// world space size of a shadow map texel in each cascade (scales the normal offset)
+		math::V4 m_cascade_texel_sizes;
+
+		// x = cascade count, y = 1 / shadow map resolution
+		math::V4 m_params;
+	};
+
+	// push constants of the bloom downsample / upsample shaders (28 bytes)
+	struct BloomConstants
+	{
+		// texel size of the source mip (or of the HDR color for the first downsample)
+		float m_source_texel_size_x;
+		float m_source_texel_size_y;
+
+		// part of the source covered by the rendered area (render extent / window extent for the HDR color with dynamic resolution, 1 otherwise)
+		float m_source_uv_scale_x;
+		float m_source_uv_scale_y;
+
+		// first downsample only : colors are faded in from m_threshold - m_knee to m_threshold + m_knee
+		float m_threshold;
+		float m_knee;
+		uint32_t m_prefilter;
+	};
+
+	// PostCompositeConstants::m_flags. note : must match post_composite.comp
+	constexpr uint32_t POST_COMPOSITE_BLOOM = 1 << 0;
+	constexpr uint32_t POST_COMPOSITE_FOG = 1 << 1;
+	constexpr uint32_t POST_COMPOSITE_ENCODE_SRGB = 1 << 2;
+
+	// push constants of the post composite shader (60 bytes)
+	struct PostCompositeConstants
+	{
+		// EnvironmentData::m_fog_color / m_fog_distance
+		math::V4 m_fog_color;
+		math::V4 m_fog_distance;
+
+		float m_exposure;
+		float m_bloom_intensity;
+
+		// to get the view depth back from the depth buffer
+		float m_near_plane;
+		float m_far_plane;
+
+		// part of the HDR color / depth covered by the rendered area (render extent / window extent)
+		float m_render_uv_scale_x;
+		float m_render_uv_scale_y;
+
+		uint32_t m_flags;
+	};
+
+	// struct having data of environment. Size : 4 * 4 * 6  = 96 bytes
 	// Environment data will be used by dynamic descriptor sets, so we will have multiple descriptor sets point to this same buffer.
 	struct EnvironmentData
 	{
@@ -130,6 +376,9 @@ namespace halo
 		// w is used as power
 		math::V4 m_sunlight_direction;
 		math::V4 m_sunlight_color;
+
+		// clustered lighting : x / y = clusters per pixel horizontally / vertically, z / w = scale / bias of the depth slice (slice = log(view depth) * z + w)
+		math::V4 m_light_cluster_params;
 	};
 
 	// basic timer class, useful for delta time calculation
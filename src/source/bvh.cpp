@@ -0,0 +1,536 @@
+#include "../include/bvh.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <numeric>
+
+namespace halo
+{
+	static constexpr uint32_t INVALID_NODE = UINT32_MAX;
+	static constexpr uint32_t BIN_COUNT = 16;
+
+	static AABB empty_aabb()
+	{
+		return AABB{math::V3{FLT_MAX, FLT_MAX, FLT_MAX}, math::V3{-FLT_MAX, -FLT_MAX, -FLT_MAX}};
+	}
+
+	static void grow(AABB& aabb, const AABB& other)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			aabb.m_min[axis] = std::min(aabb.m_min[axis], other.m_min[axis]);
+			aabb.m_max[axis] = std::max(aabb.m_max[axis], other.m_max[axis]);
+		}
+	}
+
+	static void grow(AABB& aabb, const math::V3& point)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			aabb.m_min[axis] = std::min(aabb.m_min[axis], point[axis]);
+			aabb.m_max[axis] = std::max(aabb.m_max[axis], point[axis]);
+		}
+	}
+
+	// half of the surface area (the factor of 2 cancels out in the heuristic)
+	static float get_half_area(const AABB& aabb)
+	{
+		if (aabb.m_min.x > aabb.m_max.x)
+		{
+			return 0.0f;
+		}
+
+		const float dx = aabb.m_max.x - aabb.m_min.x;
+		const float dy = aabb.m_max.y - aabb.m_min.y;
+		const float dz = aabb.m_max.z - aabb.m_min.z;
+
+		return dx * dy + dy * dz + dz * dx;
+	}
+
+	static bool is_equal(const AABB& a, const AABB& b)
+	{
+		return a.m_min.x == b.m_min.x && a.m_min.y == b.m_min.y && a.m_min.z == b.m_min.z && a.m_max.x == b.m_max.x && a.m_max.y == b.m_max.y && a.m_max.z == b.m_max.z;
+	}
+
+	// slab test, returns the entry distance (or FLT_MAX if the box is missed)
+	static float intersect_ray_aabb(const Ray& ray, const math::V3& inverse_direction, const AABB& aabb, float max_distance)
+	{
+		float t_min = 0.0f;
+		float t_max = max_distance;
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float t0 = (aabb.m_min[axis] - ray.m_origin[axis]) * inverse_direction[axis];
+			float t1 = (aabb.m_max[axis] - ray.m_origin[axis]) * inverse_direction[axis];
+
+			if (t0 > t1)
+			{
+				std::swap(t0, t1);
+			}
+
+			t_min = std::max(t_min, t0);
+			t_max = std::min(t_max, t1);
+		}
+
+		return t_min <= t_max ? t_min : FLT_MAX;
+	}
+
+	void Bvh::build(const std::vector<AABB>& aabbs, const std::vector<math::V4>& spheres)
+	{
+		const uint32_t item_count = static_cast<uint32_t>(aabbs.size());
+
+		m_nodes.clear();
+		m_parents.clear();
+
+		m_items.resize(item_count);
+		std::iota(m_items.begin(), m_items.end(), 0);
+
+		// during the build m_aabbs is indexed by item, it is reordered into leaf order at the end
+		m_aabbs = aabbs;
+
+		std::vector<math::V3> centroids(item_count);
+		for (uint32_t i = 0; i < item_count; i++)
+		{
+			for (int axis = 0; axis < 3; axis++)
+			{
+				centroids[i][axis] = (aabbs[i].m_min[axis] + aabbs[i].m_max[axis]) * 0.5f;
+			}
+		}
+
+		// worst case node count for a binary tree with at least one item per leaf
+		m_nodes.reserve(std::max<size_t>(1, 2 * static_cast<size_t>(item_count)));
+		m_parents.reserve(m_nodes.capacity());
+
+		m_nodes.push_back(Node{empty_aabb(), 0, 0, item_count, true});
+		m_parents.push_back(INVALID_NODE);
+
+		// explicit stack, since unbalanced splits could get deep enough to overflow the call stack with millions of items
+		struct BuildTask
+		{
+			uint32_t m_node;
+			uint32_t m_item_begin;
+			uint32_t m_item_count;
+		};
+
+		std::vector<BuildTask> tasks;
+		if (item_count > 0)
+		{
+			tasks.push_back(BuildTask{0, 0, item_count});
+		}
+
+		while (!tasks.empty())
+		{
+			const BuildTask task = tasks.back();
+			tasks.pop_back();
+
+			const uint32_t split = build_node(task.m_item_begin, task.m_item_count, centroids);
+
+			Node& node = m_nodes[task.m_node];
+			node.m_aabb = empty_aabb();
+			node.m_item_begin = task.m_item_begin;
+			node.m_item_count = task.m_item_count;
+
+			for (uint32_t i = task.m_item_begin; i < task.m_item_begin + task.m_item_count; i++)
+			{
+				grow(node.m_aabb, m_aabbs[m_items[i]]);
+			}
+
+			if (split == 0)
+			{
+				node.m_is_leaf = true;
+				continue;
+			}
+
+			const uint32_t left = static_cast<uint32_t>(m_nodes.size());
+			node.m_is_leaf = false;
+			node.m_left = left;
+
+			m_nodes.push_back(Node{empty_aabb(), 0, 0, 0, true});
+			m_nodes.push_back(Node{empty_aabb(), 0, 0, 0, true});
+			m_parents.push_back(task.m_node);
+			m_parents.push_back(task.m_node);
+
+			tasks.push_back(BuildTask{left + 1, task.m_item_begin + split, task.m_item_count - split});
+			tasks.push_back(BuildTask{left, task.m_item_begin, split});
+		}
+
+		// reorder bounds into leaf order, and build the item -> position / leaf maps
+		std::vector<AABB> leaf_order_aabbs(item_count);
+		m_spheres.resize(item_count);
+		m_item_positions.resize(item_count);
+		m_item_leaves.resize(item_count);
+
+		for (uint32_t i = 0; i < item_count; i++)
+		{
+			leaf_order_aabbs[i] = aabbs[m_items[i]];
+			m_spheres[i] = spheres[m_items[i]];
+			m_item_positions[m_items[i]] = i;
+		}
+
+		m_aabbs = std::move(leaf_order_aabbs);
+
+		for (uint32_t node_index = 0; node_index < m_nodes.size(); node_index++)
+		{
+			const Node& node = m_nodes[node_index];
+			if (!node.m_is_leaf)
+			{
+				continue;
+			}
+
+			for (uint32_t i = node.m_item_begin; i < node.m_item_begin + node.m_item_count; i++)
+			{
+				m_item_leaves[m_items[i]] = node_index;
+			}
+		}
+	}
+
+	uint32_t Bvh::build_node(uint32_t item_begin, uint32_t item_count, std::vector<math::V3>& centroids)
+	{
+		// returns the number of items that go to the left child (items are partitioned in place), or 0 if the node should be a leaf
+		if (item_count <= 2)
+		{
+			return 0;
+		}
+
+		uint32_t *items = m_items.data() + item_begin;
+
+		AABB node_aabb = empty_aabb();
+		AABB centroid_aabb = empty_aabb();
+
+		for (uint32_t i = 0; i < item_count; i++)
+		{
+			grow(node_aabb, m_aabbs[items[i]]);
+			grow(centroid_aabb, centroids[items[i]]);
+		}
+
+		// binned SAH : items are put into BIN_COUNT buckets along each axis by centroid, and the split planes between bins are evaluated.
+		// cost of a split (relative to the cost of testing one item) = 1 (traversal) + (left count * left area + right count * right area) / node area
+		float best_cost = FLT_MAX;
+		int best_axis = -1;
+		uint32_t best_bin = 0;
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			const float extent = centroid_aabb.m_max[axis] - centroid_aabb.m_min[axis];
+			if (extent <= 0.0f)
+			{
+				continue;
+			}
+
+			const float bin_scale = BIN_COUNT / extent;
+
+			AABB bin_aabbs[BIN_COUNT];
+			uint32_t bin_counts[BIN_COUNT] = {};
+
+			for (AABB& bin_aabb : bin_aabbs)
+			{
+				bin_aabb = empty_aabb();
+			}
+
+			for (uint32_t i = 0; i < item_count; i++)
+			{
+				const uint32_t bin = std::min(BIN_COUNT - 1, static_cast<uint32_t>((centroids[items[i]][axis] - centroid_aabb.m_min[axis]) * bin_scale));
+
+				bin_counts[bin]++;
+				grow(bin_aabbs[bin], m_aabbs[items[i]]);
+			}
+
+			// sweep from the right to get the cost of everything right of each split plane, then from the left
+			float right_costs[BIN_COUNT];
+			AABB right_aabb = empty_aabb();
+			uint32_t right_count = 0;
+
+			for (uint32_t bin = BIN_COUNT - 1; bin > 0; bin--)
+			{
+				grow(right_aabb, bin_aabbs[bin]);
+				right_count += bin_counts[bin];
+				right_costs[bin] = right_count * get_half_area(right_aabb);
+			}
+
+			AABB left_aabb = empty_aabb();
+			uint32_t left_count = 0;
+
+			for (uint32_t bin = 0; bin < BIN_COUNT - 1; bin++)
+			{
+				grow(left_aabb, bin_aabbs[bin]);
+				left_count += bin_counts[bin];
+
+				if (left_count == 0 || left_count == item_count)
+				{
+					continue;
+				}
+
+				const float cost = left_count * get_half_area(left_aabb) + right_costs[bin + 1];
+				if (cost < best_cost)
+				{
+					best_cost = cost;
+					best_axis = axis;
+					best_bin = bin + 1;
+				}
+			}
+		}
+
+		const float node_area = get_half_area(node_aabb);
+		const float split_cost = node_area > 0.0f ? 1.0f + best_cost / node_area : FLT_MAX;
+
+		if (item_count <= MAX_LEAF_SIZE && (best_axis < 0 || split_cost >= static_cast<float>(item_count)))
+		{
+			return 0;
+		}
+
+		if (best_axis >= 0)
+		{
+			const float bin_scale = BIN_COUNT / (centroid_aabb.m_max[best_axis] - centroid_aabb.m_min[best_axis]);
+
+			uint32_t *middle = std::partition(items, items + item_count, [&](uint32_t item)
+			{
+				const uint32_t bin = std::min(BIN_COUNT - 1, static_cast<uint32_t>((centroids[item][best_axis] - centroid_aabb.m_min[best_axis]) * bin_scale));
+				return bin < best_bin;
+			});
+
+			const uint32_t left_count = static_cast<uint32_t>(middle - items);
+			if (left_count > 0 && left_count < item_count)
+			{
+				return left_count;
+			}
+		}
+
+		// no usable split plane (e.g. all centroids in the same spot) but too many items for a leaf : split at the median of the widest axis
+		int widest_axis = 0;
+		for (int axis = 1; axis < 3; axis++)
+		{
+			if (centroid_aabb.m_max[axis] - centroid_aabb.m_min[axis] > centroid_aabb.m_max[widest_axis] - centroid_aabb.m_min[widest_axis])
+			{
+				widest_axis = axis;
+			}
+		}
+
+		const uint32_t half_count = item_count / 2;
+		std::nth_element(items, items + half_count, items + item_count, [&](uint32_t a, uint32_t b)
+		{
+			return centroids[a][widest_axis] < centroids[b][widest_axis];
+		});
+
+		return half_count;
+	}
+
+	void Bvh::update(uint32_t item, const AABB& aabb, const math::V4& sphere)
+	{
+		const uint32_t position = m_item_positions[item];
+		m_aabbs[position] = aabb;
+		m_spheres[position] = sphere;
+
+		uint32_t node_index = m_item_leaves[item];
+		while (node_index != INVALID_NODE)
+		{
+			const AABB previous_aabb = m_nodes[node_index].m_aabb;
+			refit_node(node_index);
+
+			if (is_equal(previous_aabb, m_nodes[node_index].m_aabb))
+			{
+				break;
+			}
+
+			node_index = m_parents[node_index];
+		}
+	}
+
+	void Bvh::refit_node(uint32_t node_index)
+	{
+		Node& node = m_nodes[node_index];
+		node.m_aabb = empty_aabb();
+
+		if (node.m_is_leaf)
+		{
+			for (uint32_t i = node.m_item_begin; i < node.m_item_begin + node.m_item_count; i++)
+			{
+				grow(node.m_aabb, m_aabbs[i]);
+			}
+
+			return;
+		}
+
+		grow(node.m_aabb, m_nodes[node.m_left].m_aabb);
+		grow(node.m_aabb, m_nodes[node.m_left + 1].m_aabb);
+	}
+
+	void Bvh::append_items(const Node& node, std::vector<uint32_t>& visible_items) const
+	{
+		visible_items.insert(visible_items.end(), m_items.begin() + node.m_item_begin, m_items.begin() + node.m_item_begin + node.m_item_count);
+	}
+
+	void Bvh::cull(const Frustum& frustum, std::vector<uint32_t>& visible_items) const
+	{
+		if (m_items.empty())
+		{
+			return;
+		}
+
+		// plane mask : planes the node's box still intersects. Once a box is completely inside a plane, its children skip that plane.
+		struct CullTask
+		{
+			uint32_t m_node;
+			uint32_t m_plane_mask;
+		};
+
+		std::vector<CullTask> stack;
+		stack.reserve(64);
+		stack.push_back(CullTask{0, 0x3F});
+
+		while (!stack.empty())
+		{
+			CullTask task = stack.back();
+			stack.pop_back();
+
+			const Node& node = m_nodes[task.m_node];
+
+			bool is_outside = false;
+			for (uint32_t plane_index = 0; plane_index < 6 && !is_outside; plane_index++)
+			{
+				if ((task.m_plane_mask & (1u << plane_index)) == 0)
+				{
+					continue;
+				}
+
+				const math::V4& plane = frustum.m_planes[plane_index];
+
+				// farthest corner along the plane normal decides if the box is outside, the nearest one if it is fully inside
+				float far_distance = plane.w;
+				float near_distance = plane.w;
+				for (int axis = 0; axis < 3; axis++)
+				{
+					far_distance += plane[axis] * (plane[axis] >= 0.0f ? node.m_aabb.m_max[axis] : node.m_aabb.m_min[axis]);
+					near_distance += plane[axis] * (plane[axis] >= 0.0f ? node.m_aabb.m_min[axis] : node.m_aabb.m_max[axis]);
+				}
+
+				if (far_distance < 0.0f)
+				{
+					is_outside = true;
+				}
+				else if (near_distance >= 0.0f)
+				{
+					task.m_plane_mask &= ~(1u << plane_index);
+				}
+			}
+
+			if (is_outside)
+			{
+				continue;
+			}
+
+			if (task.m_plane_mask == 0)
+			{
+				append_items(node, visible_items);
+				continue;
+			}
+
+			if (node.m_is_leaf)
+			{
+				// leaf spheres are contiguous, so they go through the batched SIMD test
+				uint8_t visibility[MAX_LEAF_SIZE];
+				cull_spheres(frustum, &m_spheres[node.m_item_begin].x, sizeof(math::V4), node.m_item_count, visibility);
+
+				for (uint32_t i = 0; i < node.m_item_count; i++)
+				{
+					if (visibility[i] != 0)
+					{
+						visible_items.push_back(m_items[node.m_item_begin + i]);
+					}
+				}
+
+				continue;
+			}
+
+			stack.push_back(CullTask{node.m_left, task.m_plane_mask});
+			stack.push_back(CullTask{node.m_left + 1, task.m_plane_mask});
+		}
+	}
+
+	std::optional<RayHit> Bvh::raycast(const Ray& ray, float max_distance) const
+	{
+		if (m_items.empty())
+		{
+			return std::nullopt;
+		}
+
+		const math::V3 inverse_direction = {1.0f / ray.m_direction.x, 1.0f / ray.m_direction.y, 1.0f / ray.m_direction.z};
+
+		std::optional<RayHit> closest_hit;
+		float closest_distance = max_distance;
+
+		struct RayTask
+		{
+			uint32_t m_node;
+			float m_distance;
+		};
+
+		std::vector<RayTask> stack;
+		stack.reserve(64);
+
+		const float root_distance = intersect_ray_aabb(ray, inverse_direction, m_nodes[0].m_aabb, closest_distance);
+		if (root_distance != FLT_MAX)
+		{
+			stack.push_back(RayTask{0, root_distance});
+		}
+
+		while (!stack.empty())
+		{
+			const RayTask task = stack.back();
+			stack.pop_back();
+
+			// a closer hit was found after this node was pushed
+			if (task.m_distance > closest_distance)
+			{
+				continue;
+			}
+
+			const Node& node = m_nodes[task.m_node];
+
+			if (node.m_is_leaf)
+			{
+				for (uint32_t i = node.m_item_begin; i < node.m_item_begin + node.m_item_count; i++)
+				{
+					const float distance = intersect_ray_aabb(ray, inverse_direction, m_aabbs[i], closest_distance);
+					if (distance != FLT_MAX && (!closest_hit.has_value() || distance < closest_distance))
+					{
+						closest_distance = distance;
+						closest_hit = RayHit{m_items[i], distance};
+					}
+				}
+
+				continue;
+			}
+
+			// visit the nearer child first (pushed last)
+			RayTask left = RayTask{node.m_left, intersect_ray_aabb(ray, inverse_direction, m_nodes[node.m_left].m_aabb, closest_distance)};
+			RayTask right = RayTask{node.m_left + 1, intersect_ray_aabb(ray, inverse_direction, m_nodes[node.m_left + 1].m_aabb, closest_distance)};
+
+			if (left.m_distance < right.m_distance)
+			{
+				std::swap(left, right);
+			}
+
+			if (left.m_distance != FLT_MAX)
+			{
+				stack.push_back(left);
+			}
+
+			if (right.m_distance != FLT_MAX)
+			{
+				stack.push_back(right);
+			}
+		}
+
+		return closest_hit;
+	}
+
+	size_t Bvh::get_item_count() const
+	{
+		return m_items.size();
+	}
+
+	const std::vector<Bvh::Node>& Bvh::get_nodes() const
+	{
+		return m_nodes;
+	}
+}
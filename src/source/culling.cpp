@@ -0,0 +1,213 @@
+#include "../include/culling.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define HALO_CULLING_SSE 1
+#include <xmmintrin.h>
+#endif
+
+namespace halo
+{
+	static const math::V3& get_position(const float *first_position, size_t stride, size_t index)
+	{
+		return *reinterpret_cast<const math::V3*>(reinterpret_cast<const uint8_t*>(first_position) + stride * index);
+	}
+
+	void compute_bounds(const float *first_position, size_t stride, size_t count, AABB& aabb, math::V4& sphere)
+	{
+		aabb.m_min = {FLT_MAX, FLT_MAX, FLT_MAX};
+		aabb.m_max = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+
+		if (count == 0)
+		{
+			aabb.m_min = {0.0f, 0.0f, 0.0f};
+			aabb.m_max = {0.0f, 0.0f, 0.0f};
+			sphere = {0.0f, 0.0f, 0.0f, 0.0f};
+			return;
+		}
+
+		for (size_t i = 0; i < count; i++)
+		{
+			const math::V3& position = get_position(first_position, stride, i);
+			for (int axis = 0; axis < 3; axis++)
+			{
+				aabb.m_min[axis] = std::min(aabb.m_min[axis], position[axis]);
+				aabb.m_max[axis] = std::max(aabb.m_max[axis], position[axis]);
+			}
+		}
+
+		// sphere centered on the box, radius is the farthest point (tighter than half of the box diagonal).
+		math::V3 center = {(aabb.m_min.x + aabb.m_max.x) * 0.5f, (aabb.m_min.y + aabb.m_max.y) * 0.5f, (aabb.m_min.z + aabb.m_max.z) * 0.5f};
+
+		float radius_squared = 0.0f;
+		for (size_t i = 0; i < count; i++)
+		{
+			const math::V3 offset = get_position(first_position, stride, i) - center;
+			radius_squared = std::max(radius_squared, offset.x * offset.x + offset.y * offset.y + offset.z * offset.z);
+		}
+
+		sphere = {center.x, center.y, center.z, sqrtf(radius_squared)};
+	}
+
+	math::V3 transform_point(const math::M4& mat, const math::V3& point)
+	{
+		math::V3 res{};
+		for (int i = 0; i < 3; i++)
+		{
+			res[i] = mat.data_rc[i][0] * point.x + mat.data_rc[i][1] * point.y + mat.data_rc[i][2] * point.z + mat.data_rc[i][3];
+		}
+
+		return res;
+	}
+
+	AABB transform_aabb(const AABB& aabb, const math::M4& world_mat)
+	{
+		// transform the center, and get the new extent from the absolute values of the rotation / scale part (Arvo's method).
+		const math::V3 center = {(aabb.m_min.x + aabb.m_max.x) * 0.5f, (aabb.m_min.y + aabb.m_max.y) * 0.5f, (aabb.m_min.z + aabb.m_max.z) * 0.5f};
+		const math::V3 extent = {(aabb.m_max.x - aabb.m_min.x) * 0.5f, (aabb.m_max.y - aabb.m_min.y) * 0.5f, (aabb.m_max.z - aabb.m_min.z) * 0.5f};
+
+		const math::V3 world_center = transform_point(world_mat, center);
+
+		AABB res{};
+		for (int i = 0; i < 3; i++)
+		{
+			const float world_extent = fabsf(world_mat.data_rc[i][0]) * extent.x + fabsf(world_mat.data_rc[i][1]) * extent.y + fabsf(world_mat.data_rc[i][2]) * extent.z;
+
+			res.m_min[i] = world_center[i] - world_extent;
+			res.m_max[i] = world_center[i] + world_extent;
+		}
+
+		return res;
+	}
+
+	math::V4 transform_sphere(const math::V4& sphere, const math::M4& world_mat)
+	{
+		const math::V3 world_center = transform_point(world_mat, math::V3{sphere.x, sphere.y, sphere.z});
+
+		// radius is scaled by the largest scale along any axis (length of the basis columns)
+		float max_scale_squared = 0.0f;
+		for (int j = 0; j < 3; j++)
+		{
+			const float column_length_squared = world_mat.data_rc[0][j] * world_mat.data_rc[0][j] + world_mat.data_rc[1][j] * world_mat.data_rc[1][j] + world_mat.data_rc[2][j] * world_mat.data_rc[2][j];
+			max_scale_squared = std::max(max_scale_squared, column_length_squared);
+		}
+
+		return math::V4{world_center.x, world_center.y, world_center.z, sphere.w * sqrtf(max_scale_squared)};
+	}
+
+	Frustum extract_frustum(const math::M4& projection_view_mat)
+	{
+		// Gribb / Hartmann : planes are sums / differences of the rows of the matrix. Near plane is row 2 alone, since clip z is in [0, w].
+		const auto& m = projection_view_mat.data_rc;
+
+		Frustum frustum{};
+		for (int i = 0; i < 4; i++)
+		{
+			frustum.m_planes[0][i] = m[3][i] + m[0][i];
+			frustum.m_planes[1][i] = m[3][i] - m[0][i];
+			frustum.m_planes[2][i] = m[3][i] + m[1][i];
+			frustum.m_planes[3][i] = m[3][i] - m[1][i];
+			frustum.m_planes[4][i] = m[2][i];
+			frustum.m_planes[5][i] = m[3][i] - m[2][i];
+		}
+
+		// normalize, so that plane distances are in world units (needed for the sphere radius comparison)
+		for (math::V4& plane : frustum.m_planes)
+		{
+			const float length = sqrtf(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+			for (int i = 0; i < 4; i++)
+			{
+				plane[i] /= length;
+			}
+		}
+
+		return frustum;
+	}
+
+	bool is_sphere_visible(const Frustum& frustum, const math::V4& sphere)
+	{
+		for (const math::V4& plane : frustum.m_planes)
+		{
+			if (plane.x * sphere.x + plane.y * sphere.y + plane.z * sphere.z + plane.w < -sphere.w)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	bool is_aabb_visible(const Frustum& frustum, const AABB& aabb)
+	{
+		// test the corner of the box that is farthest along the plane normal
+		for (const math::V4& plane : frustum.m_planes)
+		{
+			const float x = plane.x >= 0.0f ? aabb.m_max.x : aabb.m_min.x;
+			const float y = plane.y >= 0.0f ? aabb.m_max.y : aabb.m_min.y;
+			const float z = plane.z >= 0.0f ? aabb.m_max.z : aabb.m_min.z;
+
+			if (plane.x * x + plane.y * y + plane.z * z + plane.w < 0.0f)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	void cull_spheres(const Frustum& frustum, const float *first_sphere, size_t stride, size_t count, uint8_t *visibility)
+	{
+		const uint8_t *sphere_bytes = reinterpret_cast<const uint8_t*>(first_sphere);
+		size_t i = 0;
+
+#ifdef HALO_CULLING_SSE
+		// plane coefficients broadcasted once
+		__m128 plane_x[6], plane_y[6], plane_z[6], plane_w[6];
+		for (int p = 0; p < 6; p++)
+		{
+			plane_x[p] = _mm_set1_ps(frustum.m_planes[p].x);
+			plane_y[p] = _mm_set1_ps(frustum.m_planes[p].y);
+			plane_z[p] = _mm_set1_ps(frustum.m_planes[p].z);
+			plane_w[p] = _mm_set1_ps(frustum.m_planes[p].w);
+		}
+
+		for (; i + 4 <= count; i += 4)
+		{
+			// load 4 spheres (x, y, z, r) and transpose them into x x x x, y y y y, ...
+			__m128 x = _mm_loadu_ps(reinterpret_cast<const float*>(sphere_bytes + stride * (i + 0)));
+			__m128 y = _mm_loadu_ps(reinterpret_cast<const float*>(sphere_bytes + stride * (i + 1)));
+			__m128 z = _mm_loadu_ps(reinterpret_cast<const float*>(sphere_bytes + stride * (i + 2)));
+			__m128 r = _mm_loadu_ps(reinterpret_cast<const float*>(sphere_bytes + stride * (i + 3)));
+			_MM_TRANSPOSE4_PS(x, y, z, r);
+
+			const __m128 negative_r = _mm_sub_ps(_mm_setzero_ps(), r);
+			__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+			for (int p = 0; p < 6; p++)
+			{
+				__m128 distance = _mm_add_ps(_mm_mul_ps(plane_x[p], x), plane_w[p]);
+				distance = _mm_add_ps(distance, _mm_mul_ps(plane_y[p], y));
+				distance = _mm_add_ps(distance, _mm_mul_ps(plane_z[p], z));
+
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negative_r));
+			}
+
+			const int mask = _mm_movemask_ps(inside);
+			visibility[i + 0] = (mask >> 0) & 1;
+			visibility[i + 1] = (mask >> 1) & 1;
+			visibility[i + 2] = (mask >> 2) & 1;
+			visibility[i + 3] = (mask >> 3) & 1;
+		}
+#endif
+
+		// remainder (or everything, without SSE)
+		for (; i < count; i++)
+		{
+			const math::V4& sphere = *reinterpret_cast<const math::V4*>(sphere_bytes + stride * i);
+			visibility[i] = is_sphere_visible(frustum, sphere) ? 1 : 0;
+		}
+	}
+}
@@ -0,0 +1,159 @@
+#include "../include/deletion_queue.h"
+
+#include <iostream>
+
+namespace halo
+{
+	// converts the stored 64 bit value back to a vulkan.hpp handle
+	template <typename T>
+	static T to_handle(uint64_t handle)
+	{
+		return T(reinterpret_cast<typename T::CType>(handle));
+	}
+
+	void DeletionQueue::init(vk::Device device, VmaAllocator allocator)
+	{
+		m_device = device;
+		m_vma_allocator = allocator;
+
+		// most of the startup handles fit here, so no reallocations happen while initializing
+		m_lifetime_records.reserve(256);
+	}
+
+	void DeletionQueue::push(const AllocatedBuffer& buffer)
+	{
+		m_lifetime_records.push_back(create_record(buffer.m_buffer, buffer.m_allocation_data, 0));
+	}
+
+	void DeletionQueue::push(const AllocatedImage& image)
+	{
+		m_lifetime_records.push_back(create_record(image.m_image, image.m_allocation_data, 0));
+	}
+
+	void DeletionQueue::defer(const AllocatedBuffer& buffer, uint64_t retire_value)
+	{
+		m_deferred_records.push_back(create_record(buffer.m_buffer, buffer.m_allocation_data, retire_value));
+	}
+
+	void DeletionQueue::defer(const AllocatedImage& image, uint64_t retire_value)
+	{
+		m_deferred_records.push_back(create_record(image.m_image, image.m_allocation_data, retire_value));
+	}
+
+	void DeletionQueue::flush(uint64_t completed_value)
+	{
+		while (m_deferred_head < m_deferred_records.size() && m_deferred_records[m_deferred_head].m_retire_value <= completed_value)
+		{
+			destroy(m_deferred_records[m_deferred_head]);
+			m_deferred_head++;
+		}
+
+		// once everything is retired the storage is reused from the start, so the vector does not keep growing.
+		if (m_deferred_head == m_deferred_records.size())
+		{
+			m_deferred_records.clear();
+			m_deferred_head = 0;
+		}
+	}
+
+	void DeletionQueue::flush_all()
+	{
+		flush(UINT64_MAX);
+
+		for (auto it = m_lifetime_records.rbegin(); it != m_lifetime_records.rend(); it++)
+		{
+			destroy(*it);
+		}
+
+		m_lifetime_records.clear();
+	}
+
+	size_t DeletionQueue::get_pending_deferred_count() const
+	{
+		return m_deferred_records.size() - m_deferred_head;
+	}
+
+	void DeletionQueue::destroy(const DeletionRecord& record)
+	{
+		switch (record.m_type)
+		{
+			case vk::ObjectType::eBuffer:
+				if (record.m_allocation != nullptr)
+				{
+					vmaDestroyBuffer(m_vma_allocator, reinterpret_cast<VkBuffer>(record.m_handle), record.m_allocation);
+				}
+				else
+				{
+					m_device.destroyBuffer(to_handle<vk::Buffer>(record.m_handle));
+				}
+				break;
+
+			case vk::ObjectType::eImage:
+				if (record.m_allocation != nullptr)
+				{
+					vmaDestroyImage(m_vma_allocator, reinterpret_cast<VkImage>(record.m_handle), record.m_allocation);
+				}
+				else
+				{
+					m_device.destroyImage(to_handle<vk::Image>(record.m_handle));
+				}
+				break;
+
+			case vk::ObjectType::eImageView:
+				m_device.destroyImageView(to_handle<vk::ImageView>(record.m_handle));
+				break;
+
+			case vk::ObjectType::eSampler:
+				m_device.destroySampler(to_handle<vk::Sampler>(record.m_handle));
+				break;
+
+			case vk::ObjectType::eFramebuffer:
+				m_device.destroyFramebuffer(to_handle<vk::Framebuffer>(record.m_handle));
+				break;
+
+			case vk::ObjectType::eRenderPass:
+				m_device.destroyRenderPass(to_handle<vk::RenderPass>(record.m_handle));
+				break;
+
+			case vk::ObjectType::ePipeline:
+				m_device.destroyPipeline(to_handle<vk::Pipeline>(record.m_handle));
+				break;
+
+			case vk::ObjectType::ePipelineLayout:
+				m_device.destroyPipelineLayout(to_handle<vk::PipelineLayout>(record.m_handle));
+				break;
+
+			case vk::ObjectType::eShaderModule:
+				m_device.destroyShaderModule(to_handle<vk::ShaderModule>(record.m_handle));
+				break;
+
+			case vk::ObjectType::eDescriptorPool:
+				m_device.destroyDescriptorPool(to_handle<vk::DescriptorPool>(record.m_handle));
+				break;
+
+			case vk::ObjectType::eDescriptorSetLayout:
+				m_device.destroyDescriptorSetLayout(to_handle<vk::DescriptorSetLayout>(record.m_handle));
+				break;
+
+			case vk::ObjectType::eCommandPool:
+				m_device.destroyCommandPool(to_handle<vk::CommandPool>(record.m_handle));
+				break;
+
+			case vk::ObjectType::eFence:
+				m_device.destroyFence(to_handle<vk::Fence>(record.m_handle));
+				break;
+
+			case vk::ObjectType::eSemaphore:
+				m_device.destroySemaphore(to_handle<vk::Semaphore>(record.m_handle));
+				break;
+
+			case vk::ObjectType::eQueryPool:
+				m_device.destroyQueryPool(to_handle<vk::QueryPool>(record.m_handle));
+				break;
+
+			default:
+				std::cerr << "DeletionQueue : unhandled object type " << vk::to_string(record.m_type) << '\n';
+				break;
+		}
+	}
+}
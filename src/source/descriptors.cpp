@@ -0,0 +1,190 @@
+#include "../include/descriptors.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace halo
+{
+	namespace
+	{
+		// descriptors of each type per set in a pool (the sets of the engine mostly hold buffers)
+		constexpr std::pair<vk::DescriptorType, float> POOL_DESCRIPTOR_RATIOS[] =
+		{
+			{vk::DescriptorType::eSampler, 0.5f},
+			{vk::DescriptorType::eCombinedImageSampler, 2.0f},
+			{vk::DescriptorType::eSampledImage, 2.0f},
+			{vk::DescriptorType::eStorageImage, 1.0f},
+			{vk::DescriptorType::eUniformBuffer, 1.0f},
+			{vk::DescriptorType::eUniformBufferDynamic, 1.0f},
+			{vk::DescriptorType::eStorageBuffer, 4.0f},
+			{vk::DescriptorType::eStorageBufferDynamic, 0.5f},
+			{vk::DescriptorType::eInputAttachment, 0.5f}
+		};
+	}
+
+	void DescriptorAllocator::init(vk::Device device, uint32_t sets_per_pool)
+	{
+		m_device = device;
+		m_sets_per_pool = sets_per_pool;
+	}
+
+	vk::DescriptorSet DescriptorAllocator::allocate(vk::DescriptorSetLayout layout)
+	{
+		if (!m_current_pool)
+		{
+			m_current_pool = grab_pool();
+		}
+
+		vk::DescriptorSetAllocateInfo allocate_info{};
+		allocate_info.descriptorPool = m_current_pool;
+		allocate_info.descriptorSetCount = 1;
+		allocate_info.pSetLayouts = &layout;
+
+		// the result overload is used, since running out of pool memory is expected here
+		vk::DescriptorSet descriptor_set;
+		vk::Result result = m_device.allocateDescriptorSets(&allocate_info, &descriptor_set);
+
+		if (result == vk::Result::eErrorOutOfPoolMemory || result == vk::Result::eErrorFragmentedPool)
+		{
+			m_current_pool = grab_pool();
+			allocate_info.descriptorPool = m_current_pool;
+
+			result = m_device.allocateDescriptorSets(&allocate_info, &descriptor_set);
+		}
+
+		if (result != vk::Result::eSuccess)
+		{
+			throw std::runtime_error("Failed to allocate descriptor set : " + vk::to_string(result));
+		}
+
+		return descriptor_set;
+	}
+
+	void DescriptorAllocator::reset_pools()
+	{
+		for (vk::DescriptorPool pool : m_used_pools)
+		{
+			m_device.resetDescriptorPool(pool);
+			m_free_pools.push_back(pool);
+		}
+
+		m_used_pools.clear();
+		m_current_pool = nullptr;
+	}
+
+	void DescriptorAllocator::clean()
+	{
+		for (vk::DescriptorPool pool : m_used_pools)
+		{
+			m_device.destroyDescriptorPool(pool);
+		}
+
+		for (vk::DescriptorPool pool : m_free_pools)
+		{
+			m_device.destroyDescriptorPool(pool);
+		}
+
+		m_used_pools.clear();
+		m_free_pools.clear();
+		m_current_pool = nullptr;
+	}
+
+	vk::DescriptorPool DescriptorAllocator::grab_pool()
+	{
+		vk::DescriptorPool pool;
+
+		if (!m_free_pools.empty())
+		{
+			pool = m_free_pools.back();
+			m_free_pools.pop_back();
+		}
+		else
+		{
+			std::vector<vk::DescriptorPoolSize> pool_sizes;
+			for (const auto& [type, ratio] : POOL_DESCRIPTOR_RATIOS)
+			{
+				pool_sizes.emplace_back(type, std::max(1u, static_cast<uint32_t>(ratio * m_sets_per_pool)));
+			}
+
+			vk::DescriptorPoolCreateInfo pool_create_info{};
+			pool_create_info.maxSets = m_sets_per_pool;
+			pool_create_info.poolSizeCount = static_cast<uint32_t>(pool_sizes.size());
+			pool_create_info.pPoolSizes = pool_sizes.data();
+
+			pool = m_device.createDescriptorPool(pool_create_info);
+		}
+
+		m_used_pools.push_back(pool);
+		return pool;
+	}
+
+	void DescriptorLayoutCache::init(vk::Device device)
+	{
+		m_device = device;
+	}
+
+	vk::DescriptorSetLayout DescriptorLayoutCache::create_descriptor_set_layout(const vk::DescriptorSetLayoutCreateInfo& create_info)
+	{
+		// per binding flags, if the create info has any
+		const vk::DescriptorBindingFlags *binding_flags = nullptr;
+		for (const vk::BaseInStructure *next = static_cast<const vk::BaseInStructure*>(create_info.pNext); next != nullptr; next = next->pNext)
+		{
+			if (next->sType == vk::StructureType::eDescriptorSetLayoutBindingFlagsCreateInfo)
+			{
+				binding_flags = reinterpret_cast<const vk::DescriptorSetLayoutBindingFlagsCreateInfo*>(next)->pBindingFlags;
+			}
+		}
+
+		LayoutKey key{};
+		key.m_flags = create_info.flags;
+		key.m_bindings.reserve(create_info.bindingCount);
+
+		for (uint32_t i = 0; i < create_info.bindingCount; i++)
+		{
+			const vk::DescriptorSetLayoutBinding& binding = create_info.pBindings[i];
+			key.m_bindings.push_back(LayoutBinding{binding.binding, binding.descriptorType, binding.descriptorCount, binding.stageFlags, binding_flags != nullptr ? binding_flags[i] : vk::DescriptorBindingFlags{}});
+		}
+
+		std::sort(key.m_bindings.begin(), key.m_bindings.end(), [](const LayoutBinding& a, const LayoutBinding& b) { return a.m_binding < b.m_binding; });
+
+		auto it = m_layouts.find(key);
+		if (it != m_layouts.end())
+		{
+			return it->second;
+		}
+
+		vk::DescriptorSetLayout layout = m_device.createDescriptorSetLayout(create_info);
+		m_layouts.emplace(std::move(key), layout);
+
+		return layout;
+	}
+
+	void DescriptorLayoutCache::clean()
+	{
+		for (const auto& [key, layout] : m_layouts)
+		{
+			m_device.destroyDescriptorSetLayout(layout);
+		}
+
+		m_layouts.clear();
+	}
+
+	size_t DescriptorLayoutCache::LayoutKeyHash::operator()(const LayoutKey& key) const
+	{
+		size_t hash = std::hash<uint32_t>{}(static_cast<uint32_t>(key.m_flags));
+
+		for (const LayoutBinding& binding : key.m_bindings)
+		{
+			// binding number, type, count, stages and flags mixed into one word (overlapping bits only weaken the hash)
+			const uint64_t packed = static_cast<uint64_t>(binding.m_binding)
+				| static_cast<uint64_t>(binding.m_type) << 8
+				| static_cast<uint64_t>(binding.m_count) << 16
+				| static_cast<uint64_t>(static_cast<uint32_t>(binding.m_stages)) << 40
+				| static_cast<uint64_t>(static_cast<uint32_t>(binding.m_flags)) << 56;
+
+			hash ^= std::hash<uint64_t>{}(packed) + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+		}
+
+		return hash;
+	}
+}
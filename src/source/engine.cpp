@@ -15,6 +15,8 @@
 #include <iostream>
 #include <algorithm>
 #include <fstream>
+#include <filesystem>
+#include <random>
 
 #define ONE_SECOND 1000000000
 
@@ -29,9 +31,6 @@ do																	   \
 }																	   \
 while(0)															   \
 
-// macro for making push back's to deletion queue a bit more readable
-#define CREATE_LAMBDA_FUNCTION(function) ([=](){function;})
-
 namespace halo
 {
 	Engine::Engine(const Config& config): m_config(config)
@@ -55,7 +54,7 @@ namespace halo
 		init_vulkan();
 
 		init_swapchain();
-		init_depth_buffer();
+		init_render_graph();
 
 		init_command_objects();
 
@@ -65,9 +64,17 @@ namespace halo
 		init_synchronization_objects();
 
 		init_descriptors();
+		init_bindless();
 
 		init_pipeline();
 
+		init_occlusion_culling();
+		init_cluster_culling();
+		init_light_culling();
+		init_shadows();
+		init_post_processing();
+		init_dynamic_resolution();
+
 		load_meshes();
 
 		init_scene();
@@ -77,89 +84,82 @@ namespace halo
 
 	void Engine::run()
 	{
-		SDL_Event event;
-		bool quit = false;
-
-		bool front = false;
-		bool right = false;
-		bool back = false;
-		bool left=  false;
-
-
-		while (!quit)
+		while (!m_input.m_quit)
 		{
 			m_timer.m_prev_frame = SDL_GetTicks();
 
-			while (SDL_PollEvent(&event) != 0)
+			// in low latency mode input is sampled inside render, after all the blocking calls.
+			if (!m_config.m_low_latency_mode)
 			{
-				if (event.type == SDL_QUIT)
-				{
-					quit = true;
-				}
-
-				const Uint8 *keyboard_state = SDL_GetKeyboardState(nullptr);
+				poll_input();
+			}
 
-				if (keyboard_state[SDL_SCANCODE_ESCAPE])
-				{
-					quit = true;
-				}
-				else 
+			update_scene((float)m_timer.m_delta_time);
 
-				if (keyboard_state[SDL_SCANCODE_W])
-				{
-					front = true;
-				}
-				else
-				{
-					front = false;
-				}
+			render();
 
-				if (keyboard_state[SDL_SCANCODE_S])
-				{
-					back = true;
-				}
-				else
-				{
-					back = false;
-				}
+			m_timer.m_current_frame = SDL_GetTicks();
+			m_timer.m_delta_time = m_timer.m_current_frame - m_timer.m_prev_frame;
+		}
+	}
 
-				if (keyboard_state[SDL_SCANCODE_A])
-				{
-					left = true;
-				}
-				else
-				{
-					left = false;
-				}
+	void Engine::poll_input()
+	{
+		SDL_Event event;
 
-				if (keyboard_state[SDL_SCANCODE_D])
-				{
-					right = true;
-				}
-				else
-				{
-					right = false;
-				}
+		while (SDL_PollEvent(&event) != 0)
+		{
+			if (event.type == SDL_QUIT)
+			{
+				m_input.m_quit = true;
 			}
-			
-			m_camera.update_position(front, back, left, right, (float)m_timer.m_delta_time);
+		}
 
-			render();
+		const Uint8 *keyboard_state = SDL_GetKeyboardState(nullptr);
 
-			m_timer.m_current_frame = SDL_GetTicks();
-			m_timer.m_delta_time = m_timer.m_current_frame - m_timer.m_prev_frame;
+		if (keyboard_state[SDL_SCANCODE_ESCAPE])
+		{
+			m_input.m_quit = true;
 		}
+
+		m_input.m_front = keyboard_state[SDL_SCANCODE_W] != 0;
+		m_input.m_back = keyboard_state[SDL_SCANCODE_S] != 0;
+		m_input.m_left = keyboard_state[SDL_SCANCODE_A] != 0;
+		m_input.m_right = keyboard_state[SDL_SCANCODE_D] != 0;
+
+		m_camera.update_position(m_input.m_front, m_input.m_back, m_input.m_left, m_input.m_right, (float)m_timer.m_delta_time);
 	}
 
 	void Engine::render()
 	{
-		// wait until GPU has rendered the last frame
-		VK_CHECK(m_device.waitForFences(get_current_frame_data().m_render_fence, true, ONE_SECOND));
-		m_device.resetFences(get_current_frame_data().m_render_fence);
+		// wait until GPU has rendered the last frame that used this frame's resources
+		wait_for_frame(get_current_frame_data());
+
+		// resources retired by earlier frames that the GPU is done with can now be destroyed
+		m_deletion_queue.flush(get_completed_submission_value());
+
+		// this frame's previous sets are no longer in use : all of them are recycled with one reset per pool
+		get_current_frame_data().m_descriptor_allocator.reset_pools();
+
+		// the frame's previous timestamps are available now, so the render resolution of this frame can be picked
+		update_render_scale();
+
+		// budget / statistics, and the periodic fragmentation check
+		update_memory();
 
 		// presentation semaphore will be signalled when swapchain image is acquired.
 		vk::ResultValue<uint32_t> swapchain_image_index = m_device.acquireNextImageKHR(m_swapchain, ONE_SECOND, get_current_frame_data().m_presentation_semaphore, nullptr);
 
+		// low latency mode : after acquire (which may block on vsync), also wait for the previously submitted frame so that the CPU is never more than one frame ahead.
+		// input is sampled only after that, so the recorded frame uses the freshest input possible.
+		if (m_config.m_low_latency_mode)
+		{
+			FrameData& previous_frame_data = m_frames[(m_frame_number + MAX_FRAMES_IN_FLIGHT - 1) % MAX_FRAMES_IN_FLIGHT];
+			wait_for_frame(previous_frame_data);
+
+			poll_input();
+		}
+
 		// begin rendering commands
 		get_current_frame_data().m_command_buffer.reset();
 		
@@ -171,29 +171,31 @@ namespace halo
 		command_buffer_begin_info.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
 		
 		command_buffer.begin(command_buffer_begin_info);
-	
-		vk::ClearColorValue clear_color;
-		clear_color.setFloat32({0.0f, 0.0f, (float)abs(sin(SDL_GetTicks() / 360.0f))});
 
-		vk::ClearDepthStencilValue depth_clear;
-		depth_clear.setDepth(1.0f);
+		// running defragmentation : commits the last pass once the GPU is done with it, and records the copies of the next one
+		if (m_defragmentation_context != nullptr)
+		{
+			step_defragmentation(command_buffer);
+		}
 
-		vk::ClearValue clear_values[2] = {clear_color, depth_clear};
+		if (m_dynamic_resolution_enabled)
+		{
+			command_buffer.resetQueryPool(get_current_frame_data().m_timestamp_query_pool, 0, 2);
+			command_buffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, get_current_frame_data().m_timestamp_query_pool, 0);
+		}
 
-		// begin renderpass
-		vk::RenderPassBeginInfo render_pass_begin_info = {};
-		render_pass_begin_info.renderPass = m_render_pass;
-		render_pass_begin_info.renderArea.extent = m_window_extent;
-		render_pass_begin_info.renderArea.offset = vk::Offset2D{0, 0};
-		render_pass_begin_info.clearValueCount = 2;
-		render_pass_begin_info.pClearValues = clear_values;
-		render_pass_begin_info.framebuffer = m_framebuffers[swapchain_image_index.value];
+		prepare_draws();
 
-		command_buffer.beginRenderPass(render_pass_begin_info, vk::SubpassContents::eInline);
-		
-		draw_objects(command_buffer, m_game_objects.data());
+		// every pass of the frame, with the barriers between them (see init_render_graph)
+		m_swapchain_image_index = swapchain_image_index.value;
+		m_render_graph.set_image(m_swapchain_graph_image, m_swapchain_images[m_swapchain_image_index]);
 
-		command_buffer.endRenderPass();
+		m_render_graph.execute(command_buffer);
+
+		if (m_dynamic_resolution_enabled)
+		{
+			command_buffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, get_current_frame_data().m_timestamp_query_pool, 1);
+		}
 
 		command_buffer.end();
 
@@ -212,11 +214,41 @@ namespace halo
 		submit_info.commandBufferCount = 1;
 		submit_info.pCommandBuffers = &command_buffer;
 
-		vk::PipelineStageFlags dst_wait_stage_mask = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+		// the swapchain image is first written by the blit at the end of the frame
+		vk::PipelineStageFlags dst_wait_stage_mask = vk::PipelineStageFlagBits::eTransfer;
 		submit_info.pWaitDstStageMask = &dst_wait_stage_mask;
 
-		// once all command buffers have completed thier execution, m_render_fence is signalled.
-		m_graphics_queue.submit(submit_info, get_current_frame_data().m_render_fence);
+		if (m_timeline_sync_enabled)
+		{
+			// the graphics timeline is signalled along with the binary render semaphore (which presentation needs). Values of binary semaphores are ignored.
+			get_current_frame_data().m_submission_value = m_graphics_timeline.next_signal_value();
+
+			vk::Semaphore signal_semaphores[] = {get_current_frame_data().m_render_semaphore, m_graphics_timeline.m_semaphore};
+			uint64_t wait_values[] = {0};
+			uint64_t signal_values[] = {0, get_current_frame_data().m_submission_value};
+
+			vk::TimelineSemaphoreSubmitInfo timeline_submit_info = {};
+			timeline_submit_info.waitSemaphoreValueCount = 1;
+			timeline_submit_info.pWaitSemaphoreValues = wait_values;
+			timeline_submit_info.signalSemaphoreValueCount = 2;
+			timeline_submit_info.pSignalSemaphoreValues = signal_values;
+
+			submit_info.pNext = &timeline_submit_info;
+			submit_info.signalSemaphoreCount = 2;
+			submit_info.pSignalSemaphores = signal_semaphores;
+
+			m_graphics_queue.submit(submit_info, nullptr);
+		}
+		else
+		{
+			get_current_frame_data().m_submission_value = get_pending_submission_value();
+
+			// fence is reset as late as possible (right before the submission that signals it again).
+			m_device.resetFences(get_current_frame_data().m_render_fence);
+
+			// once all command buffers have completed thier execution, m_render_fence is signalled.
+			m_graphics_queue.submit(submit_info, get_current_frame_data().m_render_fence);
+		}
 
 		// wait on render semaphore before presentation
 		// m_render_fence is not needed to be explicity set here since presentation waits on m_render_semaphore, and so does m_render_fence.
@@ -227,7 +259,7 @@ namespace halo
 		present_info.pWaitSemaphores = &get_current_frame_data().m_render_semaphore;
 		present_info.waitSemaphoreCount = 1;
 
-		present_info.pImageIndices = &swapchain_image_index.value;
+		present_info.pImageIndices = &m_swapchain_image_index;
 
 		VK_CHECK(m_graphics_queue.presentKHR(present_info));
 
@@ -260,9 +292,13 @@ namespace halo
 	{
 		vkb::InstanceBuilder instance_builder;
 
+		// timeline semaphores are core in vulkan 1.2, so it is desired (not required) when they are requested.
+		const uint32_t desired_minor_version = m_config.m_use_timeline_semaphores ? 2 : 1;
+
 		auto instance = instance_builder.set_app_name("Halogen")
 			.request_validation_layers(true)
 			.require_api_version(1, 1, 0)
+			.desire_api_version(1, desired_minor_version, 0)
 			.use_default_debug_messenger()
 			.build();
 
@@ -279,6 +315,16 @@ namespace halo
 		// physical device is selected after surface since we want to be able to render to that surface.
 		// by default vkbootstrap will apparently try to choose the dedicated GPU, which is preferable.
 		vkb::PhysicalDeviceSelector physical_device_selector {vkb_instance};
+
+		// enabled if the selected device has it (its features are checked below)
+		if (m_config.m_bindless)
+		{
+			physical_device_selector.add_desired_extension(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+		}
+
+		// per heap usage / budget reported by the driver (see get_memory_stats)
+		physical_device_selector.add_desired_extension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
 		vkb::PhysicalDevice vkb_physical_device = physical_device_selector.set_minimum_version(1, 1)
 			.set_surface(m_surface)
 			.select()
@@ -286,6 +332,116 @@ namespace halo
 
 		vkb::DeviceBuilder device_builder {vkb_physical_device};
 
+		// optional device features are queried here and enabled via the pNext chain of the device create info.
+		vk::PhysicalDevice selected_physical_device = vkb_physical_device.physical_device;
+
+		vk::PhysicalDeviceTimelineSemaphoreFeatures timeline_semaphore_features = {};
+		if (m_config.m_use_timeline_semaphores)
+		{
+			const bool api_supports_timeline = vk::enumerateInstanceVersion() >= VK_API_VERSION_1_2 && selected_physical_device.getProperties().apiVersion >= VK_API_VERSION_1_2;
+
+			if (api_supports_timeline)
+			{
+				auto features = selected_physical_device.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceTimelineSemaphoreFeatures>();
+				m_timeline_sync_enabled = features.get<vk::PhysicalDeviceTimelineSemaphoreFeatures>().timelineSemaphore;
+			}
+
+			if (m_timeline_sync_enabled)
+			{
+				timeline_semaphore_features.timelineSemaphore = true;
+				device_builder.add_pNext(&timeline_semaphore_features);
+			}
+			else
+			{
+				std::cout << "Timeline semaphores are not supported, falling back to fences\n";
+			}
+		}
+
+		// occlusion and cluster culling write the object index into the firstInstance of indirect draws. multiDrawIndirect is optional (draws with the same mesh / material are then batched).
+		// note : both write their draw commands into the same per frame buffer, so cluster culling (when requested) takes over.
+		bool occlusion_culling_requested = m_config.m_occlusion_culling;
+		if (m_config.m_cluster_culling && occlusion_culling_requested)
+		{
+			std::cout << "Cluster culling replaces occlusion culling, occlusion culling is disabled\n";
+			occlusion_culling_requested = false;
+		}
+
+		const vk::PhysicalDeviceFeatures supported_features = selected_physical_device.getFeatures();
+
+		vk::PhysicalDeviceFeatures2 device_features = {};
+		if (occlusion_culling_requested || m_config.m_cluster_culling)
+		{
+			bool indirect_first_instance_supported = supported_features.drawIndirectFirstInstance;
+
+			m_occlusion_culling_enabled = occlusion_culling_requested && indirect_first_instance_supported;
+			m_cluster_culling_enabled = m_config.m_cluster_culling && indirect_first_instance_supported;
+
+			if (indirect_first_instance_supported)
+			{
+				m_multi_draw_indirect_enabled = supported_features.multiDrawIndirect;
+
+				device_features.features.drawIndirectFirstInstance = true;
+				device_features.features.multiDrawIndirect = m_multi_draw_indirect_enabled;
+			}
+			else
+			{
+				std::cout << "drawIndirectFirstInstance is not supported, GPU culling is disabled\n";
+			}
+		}
+
+		// textures : BC formats (desktop GPUs) and anisotropic filtering are used whenever they are supported
+		m_texture_compression_enabled = supported_features.textureCompressionBC;
+		m_sampler_anisotropy_enabled = supported_features.samplerAnisotropy;
+		m_max_sampler_anisotropy = m_sampler_anisotropy_enabled ? selected_physical_device.getProperties().limits.maxSamplerAnisotropy : 1.0f;
+
+		device_features.features.textureCompressionBC = m_texture_compression_enabled;
+		device_features.features.samplerAnisotropy = m_sampler_anisotropy_enabled;
+
+		if (!m_texture_compression_enabled)
+		{
+			std::cout << "BC texture compression is not supported, textures are uploaded uncompressed\n";
+		}
+
+		device_builder.add_pNext(&device_features);
+
+		// bindless : runtime sized arrays, indexed with non uniform indices (draws of one multi draw use different materials), written after the set is bound.
+		vk::PhysicalDeviceDescriptorIndexingFeatures descriptor_indexing_features = {};
+		if (m_config.m_bindless)
+		{
+			const std::vector<vk::ExtensionProperties> extensions = selected_physical_device.enumerateDeviceExtensionProperties();
+			const bool extension_supported = std::any_of(extensions.begin(), extensions.end(), [](const vk::ExtensionProperties& extension)
+			{
+				return strcmp(extension.extensionName, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) == 0;
+			});
+
+			if (extension_supported)
+			{
+				auto features = selected_physical_device.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceDescriptorIndexingFeatures>();
+				const vk::PhysicalDeviceDescriptorIndexingFeatures& supported_indexing_features = features.get<vk::PhysicalDeviceDescriptorIndexingFeatures>();
+
+				m_bindless_enabled = supported_indexing_features.runtimeDescriptorArray
+					&& supported_indexing_features.descriptorBindingPartiallyBound
+					&& supported_indexing_features.descriptorBindingStorageBufferUpdateAfterBind
+					&& supported_indexing_features.descriptorBindingSampledImageUpdateAfterBind
+					&& supported_indexing_features.shaderSampledImageArrayNonUniformIndexing;
+			}
+
+			if (m_bindless_enabled)
+			{
+				descriptor_indexing_features.runtimeDescriptorArray = true;
+				descriptor_indexing_features.descriptorBindingPartiallyBound = true;
+				descriptor_indexing_features.descriptorBindingStorageBufferUpdateAfterBind = true;
+				descriptor_indexing_features.descriptorBindingSampledImageUpdateAfterBind = true;
+				descriptor_indexing_features.shaderSampledImageArrayNonUniformIndexing = true;
+
+				device_builder.add_pNext(&descriptor_indexing_features);
+			}
+			else
+			{
+				std::cout << "Descriptor indexing is not supported, materials use per material descriptor sets\n";
+			}
+		}
+
 		vkb::Device vkb_device = device_builder.build().value();
 
 		m_device = vkb_device.device;
@@ -297,13 +453,34 @@ namespace halo
 		std::cout << "Device chosen : "  << device_properties.deviceName<< '\n';
 		std::cout << "Minimum uniform buffer offset alignment : " << device_properties.limits.minUniformBufferOffsetAlignment << '\n';
 		
-		// create the vma allocator
+		// memory budget : the extension was enabled by the device builder if the device has it
+		const std::vector<vk::ExtensionProperties> device_extensions = m_physical_device.enumerateDeviceExtensionProperties();
+		m_memory_budget_enabled = std::any_of(device_extensions.begin(), device_extensions.end(), [](const vk::ExtensionProperties& extension)
+		{
+			return strcmp(extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0;
+		});
+
+		if (!m_memory_budget_enabled)
+		{
+			std::cout << "VK_EXT_memory_budget is not supported, memory budgets are estimated from the heap sizes\n";
+		}
+
+		// create the vma allocator (vulkan 1.1 is required, so memory properties 2 used by the budget query are core)
 		VmaAllocatorCreateInfo vma_allocator_create_info = {};
 		vma_allocator_create_info.device = m_device;
 		vma_allocator_create_info.instance = m_instance;
 		vma_allocator_create_info.physicalDevice = m_physical_device;
+		vma_allocator_create_info.vulkanApiVersion = VK_API_VERSION_1_1;
+
+		if (m_memory_budget_enabled)
+		{
+			vma_allocator_create_info.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+		}
+
 		VK_CHECK(vmaCreateAllocator(&vma_allocator_create_info, &m_vma_allocator));
 
+		m_deletion_queue.init(m_device, m_vma_allocator);
+
 		// acquire queue and its index
 		m_graphics_queue = vkb_device.get_queue(vkb::QueueType::graphics).value();
 		m_graphics_queue_index = vkb_device.get_queue_index(vkb::QueueType::graphics).value();
@@ -314,9 +491,13 @@ namespace halo
 	{
 		vkb::SwapchainBuilder swapchain_builder{m_physical_device, m_device, m_surface};
 
+		// frames reach the swapchain through a blit from the post processing output. A UNORM format is preferred, so that the composite pass
+		// can do the sRGB encoding at full precision (see init_post_processing).
 		vkb::Swapchain vkb_swapchain = swapchain_builder
 			.use_default_format_selection()
-			.set_desired_present_mode(VK_PRESENT_MODE_FIFO_RELAXED_KHR)
+			.set_desired_format(VkSurfaceFormatKHR{VK_FORMAT_B8G8R8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR})
+			.add_image_usage_flags(VK_IMAGE_USAGE_TRANSFER_DST_BIT)
+			.set_desired_present_mode(static_cast<VkPresentModeKHR>(select_present_mode()))
 			.set_desired_extent(m_window_extent.width, m_window_extent.height)
 			.build()
 			.value();
@@ -329,36 +510,251 @@ namespace halo
 		m_swapchain_image_format = vk::Format(vkb_swapchain.image_format);
 	}
 
-	void Engine::init_depth_buffer()
+	vk::PresentModeKHR Engine::select_present_mode()
+	{
+		// fallback chains : modes that tear (immediate) are never picked unless immediate was requested.
+		std::vector<vk::PresentModeKHR> fallback_chain;
+		switch (m_config.m_present_mode)
+		{
+			case PresentMode::Immediate:
+				fallback_chain = {vk::PresentModeKHR::eImmediate, vk::PresentModeKHR::eMailbox, vk::PresentModeKHR::eFifoRelaxed, vk::PresentModeKHR::eFifo};
+				break;
+
+			case PresentMode::Mailbox:
+				fallback_chain = {vk::PresentModeKHR::eMailbox, vk::PresentModeKHR::eFifo};
+				break;
+
+			case PresentMode::FifoRelaxed:
+				fallback_chain = {vk::PresentModeKHR::eFifoRelaxed, vk::PresentModeKHR::eFifo};
+				break;
+
+			case PresentMode::Fifo:
+				fallback_chain = {vk::PresentModeKHR::eFifo};
+				break;
+		}
+
+		std::vector<vk::PresentModeKHR> supported_present_modes = m_physical_device.getSurfacePresentModesKHR(m_surface);
+
+		for (vk::PresentModeKHR present_mode : fallback_chain)
+		{
+			if (std::find(supported_present_modes.begin(), supported_present_modes.end(), present_mode) != supported_present_modes.end())
+			{
+				std::cout << "Present mode chosen : " << vk::to_string(present_mode) << '\n';
+				return present_mode;
+			}
+		}
+
+		// FIFO support is required by the spec.
+		return vk::PresentModeKHR::eFifo;
+	}
+
+	void Engine::init_render_graph()
 	{
+		m_render_graph.init(m_device, m_vma_allocator);
+
 		m_depth_image_format = vk::Format::eD32Sfloat;
-		
-		vk::Extent3D extent = {};
-		extent.setWidth(m_window_extent.width);
-		extent.setHeight(m_window_extent.height);
-		extent.setDepth(1);
 
-		vk::ImageCreateInfo depth_image_create_info = init::create_image_info(m_depth_image_format, extent, vk::ImageUsageFlagBits::eDepthStencilAttachment);
+		m_hdr_color_format = vk::Format::eR16G16B16A16Sfloat;
 
-		VmaAllocationCreateInfo depth_image_allocation_create_info = {};
-		depth_image_allocation_create_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
-		depth_image_allocation_create_info.requiredFlags = static_cast<VkMemoryPropertyFlags>(vk::MemoryPropertyFlagBits::eDeviceLocal);
+		// swapchain image : a new image every frame, which the submission waits for at the transfer stage (blit_to_swapchain), presented after the graph.
+		RenderGraphImportedImage swapchain_image{};
+		swapchain_image.m_discard = true;
+		swapchain_image.m_frame_start_stages = vk::PipelineStageFlagBits::eTransfer;
+		swapchain_image.m_final_layout = vk::ImageLayout::ePresentSrcKHR;
+		swapchain_image.m_output = true;
 
-		auto image = static_cast<VkImage>(m_depth_image_allocation.m_image);
-		auto image_create_info = static_cast<VkImageCreateInfo>(depth_image_create_info);
+		m_swapchain_graph_image = m_render_graph.import_image("swapchain", swapchain_image);
 
-		VK_CHECK(vmaCreateImage(m_vma_allocator, &image_create_info, &depth_image_allocation_create_info, &image, &m_depth_image_allocation.m_allocation_data, nullptr));
+		// MSAA : the highest sample count up to the configured one that color / depth attachments and sampled depth (for the depth resolve) support
+		const vk::PhysicalDeviceLimits limits = m_physical_device.getProperties().limits;
+		const vk::SampleCountFlags supported_sample_counts = limits.framebufferColorSampleCounts & limits.framebufferDepthSampleCounts & limits.sampledImageDepthSampleCounts;
 
-		// m_depth_image is merely a reference (well, logically but the c++ way) to the vk::Image in the m_depth_image_allocation member.
-		m_depth_image = image;
-		m_depth_image_allocation.m_image = image;
+		m_msaa_samples = vk::SampleCountFlagBits::e1;
+		for (uint32_t samples = 64; samples > 1; samples /= 2)
+		{
+			if (samples <= m_config.m_msaa_samples && (supported_sample_counts & static_cast<vk::SampleCountFlagBits>(samples)))
+			{
+				m_msaa_samples = static_cast<vk::SampleCountFlagBits>(samples);
+				break;
+			}
+		}
 
-		vk::ImageViewCreateInfo depth_image_view_create_info = init::create_image_view_info(m_depth_image_format, m_depth_image, vk::ImageAspectFlagBits::eDepth);
-		m_depth_image_view = m_device.createImageView(depth_image_view_create_info);
-		
-		m_deletion_list.push_function(CREATE_LAMBDA_FUNCTION(m_device.destroyImageView(m_depth_image_view)));
-		m_deletion_list.push_function(CREATE_LAMBDA_FUNCTION(vmaDestroyImage(m_vma_allocator, static_cast<VkImage>(m_depth_image_allocation.m_image), m_depth_image_allocation.m_allocation_data)));
+		const bool msaa_enabled = m_msaa_samples != vk::SampleCountFlagBits::e1;
+		std::cout << "MSAA samples : " << static_cast<uint32_t>(m_msaa_samples) << '\n';
+
+		// the depth buffer only lives during a frame (it is sampled by the depth pyramid pass if occlusion culling is enabled)
+		RenderGraphImageDesc depth_desc{m_depth_image_format, m_window_extent, 1, vk::ImageAspectFlagBits::eDepth};
+		depth_desc.m_samples = m_msaa_samples;
+
+		const RenderGraphResource depth_image = m_render_graph.create_image("depth", depth_desc);
+
+		// MSAA : multisampled color is resolved into the HDR color within the scene pass, so it only needs memory if the late phase loads it again.
+		// Depth is resolved into a color image by a compute pass (depth formats cannot be storage images).
+		RenderGraphImageDesc msaa_color_desc{m_hdr_color_format, m_window_extent};
+		msaa_color_desc.m_samples = m_msaa_samples;
+		msaa_color_desc.m_lazily_allocated = !m_occlusion_culling_enabled;
+
+		const RenderGraphResource msaa_color_image = m_render_graph.create_image("msaa_color", msaa_color_desc);
+		const RenderGraphResource resolved_depth_image = m_render_graph.create_image("resolved_depth", RenderGraphImageDesc{vk::Format::eR32Sfloat, m_window_extent});
+
+		// depth as read by the depth pyramid and post processing
+		const RenderGraphResource sampled_depth_image = msaa_enabled ? resolved_depth_image : depth_image;
+
+		// post processing : the scene is rendered into HDR color, and the composite pass writes the LDR image copied to the swapchain.
+		// Bloom works at half resolution (mip count clamped so that the last mip is at least 1 pixel wide).
+		const RenderGraphResource hdr_color_image = m_render_graph.create_image("hdr_color", RenderGraphImageDesc{m_hdr_color_format, m_window_extent});
+
+		m_bloom_extent = vk::Extent2D{std::max(1u, m_window_extent.width / 2), std::max(1u, m_window_extent.height / 2)};
+		m_bloom_mip_count = std::clamp(m_config.m_post_process.m_bloom_mip_count, 1u, static_cast<uint32_t>(std::log2(std::min(m_bloom_extent.width, m_bloom_extent.height))) + 1);
+
+		m_bloom_graph_image = m_render_graph.create_image("bloom", RenderGraphImageDesc{vk::Format::eR16G16B16A16Sfloat, m_bloom_extent, m_bloom_mip_count});
+		m_ldr_color_graph_image = m_render_graph.create_image("ldr_color", RenderGraphImageDesc{vk::Format::eR8G8B8A8Unorm, m_window_extent});
+
+		// shadow cascades : one layer per cascade, rendered every frame before being sampled by the lit shaders.
+		// The resolution is clamped to the largest image / framebuffer the device supports.
+		m_shadow_cascade_count = std::clamp(m_config.m_shadow_cascade_count, 1u, MAX_SHADOW_CASCADES);
+
+		const uint32_t max_shadow_map_resolution = std::min({limits.maxImageDimension2D, limits.maxFramebufferWidth, limits.maxFramebufferHeight});
+		m_shadow_map_resolution = std::clamp(m_config.m_shadow_map_resolution, 1u, max_shadow_map_resolution);
+
+		RenderGraphImageDesc shadow_map_desc{m_depth_image_format, vk::Extent2D{m_shadow_map_resolution, m_shadow_map_resolution}, 1, vk::ImageAspectFlagBits::eDepth};
+		shadow_map_desc.m_layer_count = m_shadow_cascade_count;
+		shadow_map_desc.m_view_type = vk::ImageViewType::e2DArray;
+
+		m_shadow_map_graph_image = m_render_graph.create_image("shadow_map", shadow_map_desc);
+
+		// note : per frame buffers are tracked as one resource. Frames execute in order on the graphics queue, so this only adds dependencies between frames.
+		const RenderGraphResource draw_commands = m_render_graph.import_buffer("draw_commands", false);
+		const RenderGraphResource cluster_indices = m_render_graph.import_buffer("cluster_indices", false);
+
+		// light counts and indices of the clusters (both written by the light cull pass)
+		const RenderGraphResource light_clusters = m_render_graph.import_buffer("light_clusters", false);
+
+		// visibility and the depth pyramid are kept for the next frame (the pyramid is created, and set, by init_occlusion_culling)
+		const RenderGraphResource object_visibility = m_render_graph.import_buffer("object_visibility", true);
+		m_depth_pyramid_graph_image = m_render_graph.import_image("depth_pyramid", RenderGraphImportedImage{});
+
+		// early phase of occlusion culling : objects visible last frame are drawn first, and their depth is used to test everything else.
+		if (m_occlusion_culling_enabled)
+		{
+			m_render_graph.add_pass("occlusion_cull_early",
+				{{object_visibility, RenderGraphUsage::ComputeStorageReadWrite}, {draw_commands, RenderGraphUsage::ComputeStorageWrite}},
+				[this](vk::CommandBuffer command_buffer) { dispatch_occlusion_cull(command_buffer, false); });
+		}
+
+		// cluster culling : the visible meshlets' triangles are written to this frame's index buffer, drawn with one indirect command per draw.
+		if (m_cluster_culling_enabled)
+		{
+			m_render_graph.add_pass("cluster_cull",
+				{{draw_commands, RenderGraphUsage::ComputeStorageWrite}, {cluster_indices, RenderGraphUsage::ComputeStorageWrite}},
+				[this](vk::CommandBuffer command_buffer) { dispatch_cluster_cull(command_buffer); });
+		}
+
+		m_render_graph.add_pass("light_cull", {{light_clusters, RenderGraphUsage::ComputeStorageWrite}}, [this](vk::CommandBuffer command_buffer) { dispatch_light_cull(command_buffer); });
+
+		m_render_graph.add_pass("shadows", {{m_shadow_map_graph_image, RenderGraphUsage::DepthAttachment}}, [this](vk::CommandBuffer command_buffer) { draw_shadow_cascades(command_buffer); });
+
+		std::vector<RenderGraphAccess> scene_accesses =
+		{
+			{hdr_color_image, RenderGraphUsage::ColorAttachment},
+			{depth_image, RenderGraphUsage::DepthAttachment},
+			{light_clusters, RenderGraphUsage::FragmentStorageRead},
+			{m_shadow_map_graph_image, RenderGraphUsage::FragmentSampledRead}
+		};
+
+		if (msaa_enabled)
+		{
+			scene_accesses.push_back({msaa_color_image, RenderGraphUsage::ColorAttachment});
+		}
+
+		if (m_occlusion_culling_enabled || m_cluster_culling_enabled)
+		{
+			scene_accesses.push_back({draw_commands, RenderGraphUsage::IndirectRead});
+		}
+
+		if (m_cluster_culling_enabled)
+		{
+			scene_accesses.push_back({cluster_indices, RenderGraphUsage::IndexRead});
+		}
+
+		// the late phase needs its own copy of the accesses (draw commands from the late cull, no cluster indices)
+		std::vector<RenderGraphAccess> scene_late_accesses =
+		{
+			{hdr_color_image, RenderGraphUsage::ColorAttachment},
+			{depth_image, RenderGraphUsage::DepthAttachment},
+			{draw_commands, RenderGraphUsage::IndirectRead},
+			{light_clusters, RenderGraphUsage::FragmentStorageRead},
+			{m_shadow_map_graph_image, RenderGraphUsage::FragmentSampledRead}
+		};
+
+		if (msaa_enabled)
+		{
+			scene_late_accesses.push_back({msaa_color_image, RenderGraphUsage::ColorAttachment});
+		}
+
+		m_render_graph.add_pass("scene", std::move(scene_accesses), [this](vk::CommandBuffer command_buffer) { record_scene_pass(command_buffer, false); });
+
+		const auto add_depth_resolve_pass = [&](std::string_view name)
+		{
+			if (msaa_enabled)
+			{
+				m_render_graph.add_pass(name, {{depth_image, RenderGraphUsage::ComputeSampledRead}, {resolved_depth_image, RenderGraphUsage::ComputeStorageWrite}},
+					[this](vk::CommandBuffer command_buffer) { dispatch_depth_resolve(command_buffer); });
+			}
+		};
+
+		add_depth_resolve_pass("depth_resolve");
+
+		// late phase : build the depth pyramid, test every draw against it and draw the newly visible ones on top.
+		if (m_occlusion_culling_enabled)
+		{
+			m_render_graph.add_pass("depth_pyramid",
+				{{sampled_depth_image, RenderGraphUsage::ComputeSampledRead}, {m_depth_pyramid_graph_image, RenderGraphUsage::ComputeStorageWrite}},
+				[this](vk::CommandBuffer command_buffer) { build_depth_pyramid(command_buffer); });
+
+			// note : the pyramid is sampled in general layout (the layout its levels are written in), hence a storage read
+			m_render_graph.add_pass("occlusion_cull_late",
+				{{m_depth_pyramid_graph_image, RenderGraphUsage::ComputeStorageRead}, {object_visibility, RenderGraphUsage::ComputeStorageReadWrite}, {draw_commands, RenderGraphUsage::ComputeStorageWrite}},
+				[this](vk::CommandBuffer command_buffer) { dispatch_occlusion_cull(command_buffer, true); });
+
+			m_render_graph.add_pass("scene_late", std::move(scene_late_accesses), [this](vk::CommandBuffer command_buffer) { record_scene_pass(command_buffer, true); });
+
+			add_depth_resolve_pass("depth_resolve_late");
+		}
+
+		// post processing chain : bloom (one pass, synchronizing its own mips), then everything else fused into one full screen pass, then the copy to the swapchain
+		std::vector<RenderGraphAccess> composite_accesses =
+		{
+			{hdr_color_image, RenderGraphUsage::ComputeSampledRead},
+			{sampled_depth_image, RenderGraphUsage::ComputeSampledRead},
+			{m_ldr_color_graph_image, RenderGraphUsage::ComputeStorageWrite}
+		};
+
+		if (m_config.m_post_process.m_bloom)
+		{
+			m_render_graph.add_pass("bloom",
+				{{hdr_color_image, RenderGraphUsage::ComputeSampledRead}, {m_bloom_graph_image, RenderGraphUsage::ComputeStorageReadWrite}},
+				[this](vk::CommandBuffer command_buffer) { dispatch_bloom(command_buffer); });
+
+			composite_accesses.push_back({m_bloom_graph_image, RenderGraphUsage::ComputeSampledRead});
+		}
+
+		m_render_graph.add_pass("post_composite", std::move(composite_accesses), [this](vk::CommandBuffer command_buffer) { dispatch_post_composite(command_buffer); });
+
+		m_render_graph.add_pass("present_blit",
+			{{m_ldr_color_graph_image, RenderGraphUsage::TransferRead}, {m_swapchain_graph_image, RenderGraphUsage::TransferWrite}},
+			[this](vk::CommandBuffer command_buffer) { blit_to_swapchain(command_buffer); });
+
+		m_render_graph.compile();
 
+		m_depth_image_view = m_render_graph.get_image_view(depth_image);
+		m_hdr_color_view = m_render_graph.get_image_view(hdr_color_image);
+		m_sampled_depth_view = m_render_graph.get_image_view(sampled_depth_image);
+
+		if (msaa_enabled)
+		{
+			m_msaa_color_view = m_render_graph.get_image_view(msaa_color_image);
+		}
 	}
 
 	void Engine::init_command_objects()
@@ -367,28 +763,48 @@ namespace halo
 		{
 			vk::CommandPoolCreateInfo command_pool_create_info = init::create_command_pool(m_graphics_queue_index);
 			m_frames[i].m_primary_command_pool = m_device.createCommandPool(command_pool_create_info);
-			m_deletion_list.push_function(CREATE_LAMBDA_FUNCTION(m_device.destroyCommandPool(m_frames[i].m_primary_command_pool)));
+			m_deletion_queue.push(m_frames[i].m_primary_command_pool);
 
 			vk::CommandBufferAllocateInfo command_buffer_allocate_info = init::create_command_buffer_allocate(m_frames[i].m_primary_command_pool);
 	 		m_frames[i].m_command_buffer = m_device.allocateCommandBuffers(command_buffer_allocate_info)[0];
 		}
+
+		// upload context : separate pool, so uploads never touch the frames' command buffers
+		m_upload_command_pool = m_device.createCommandPool(init::create_command_pool(m_graphics_queue_index));
+		m_deletion_queue.push(m_upload_command_pool);
+
+		m_upload_command_buffer = m_device.allocateCommandBuffers(init::create_command_buffer_allocate(m_upload_command_pool))[0];
+
+		m_upload_fence = m_device.createFence(init::create_fence(vk::FenceCreateFlags{}));
+		m_deletion_queue.push(m_upload_fence);
 	}
 
 	// renderpass stores the state of images rendering into, and the state needed to setup the target framebuffer for rendering.
 	void Engine::init_renderpass()
 	{
-		// create the color attachment
+		// with the depth pre pass, subpass 0 only writes depth and the shading pipelines run in subpass 1.
+		m_main_subpass = m_config.m_depth_prepass ? 1 : 0;
+
+		m_render_pass = create_scene_render_pass(false);
+		m_deletion_queue.push(m_render_pass);
+	}
+
+	vk::RenderPass Engine::create_scene_render_pass(bool load_attachments)
+	{
+		const bool msaa_enabled = m_msaa_samples != vk::SampleCountFlagBits::e1;
+
+		// create the color attachment (multisampled with MSAA : it is only kept for the late phase, which loads it again)
 		vk::AttachmentDescription color_attachment_desc = {};
-		color_attachment_desc.format = m_swapchain_image_format;
-		color_attachment_desc.samples = vk::SampleCountFlagBits::e1;
-		color_attachment_desc.loadOp = vk::AttachmentLoadOp::eClear;
-		color_attachment_desc.storeOp = vk::AttachmentStoreOp::eStore;
+		color_attachment_desc.format = m_hdr_color_format;
+		color_attachment_desc.samples = m_msaa_samples;
+		color_attachment_desc.loadOp = load_attachments ? vk::AttachmentLoadOp::eLoad : vk::AttachmentLoadOp::eClear;
+		color_attachment_desc.storeOp = !msaa_enabled || m_occlusion_culling_enabled ? vk::AttachmentStoreOp::eStore : vk::AttachmentStoreOp::eDontCare;
 		color_attachment_desc.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
 		color_attachment_desc.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
-		color_attachment_desc.initialLayout = vk::ImageLayout::eUndefined;
 
-		// image should be ready for presentation
-		color_attachment_desc.finalLayout = vk::ImageLayout::ePresentSrcKHR;
+		// attachments stay in their attachment layout : the render graph transitions them before / after the pass (e.g. for the post processing passes)
+		color_attachment_desc.initialLayout = load_attachments ? vk::ImageLayout::eColorAttachmentOptimal : vk::ImageLayout::eUndefined;
+		color_attachment_desc.finalLayout = vk::ImageLayout::eColorAttachmentOptimal;
 
 		// reference to color attachment
 		vk::AttachmentReference color_attachment_ref = {};
@@ -398,14 +814,14 @@ namespace halo
 		// create the depth attachment
 		vk::AttachmentDescription depth_attachment_desc = {};
 		depth_attachment_desc.format = m_depth_image_format;
-		depth_attachment_desc.samples = vk::SampleCountFlagBits::e1;
-		depth_attachment_desc.loadOp = vk::AttachmentLoadOp::eClear;
+		depth_attachment_desc.samples = m_msaa_samples;
+		depth_attachment_desc.loadOp = load_attachments ? vk::AttachmentLoadOp::eLoad : vk::AttachmentLoadOp::eClear;
 		depth_attachment_desc.storeOp = vk::AttachmentStoreOp::eStore;
 
 		depth_attachment_desc.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
 		depth_attachment_desc.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
 
-		depth_attachment_desc.initialLayout = vk::ImageLayout::eUndefined;
+		depth_attachment_desc.initialLayout = load_attachments ? vk::ImageLayout::eDepthStencilAttachmentOptimal : vk::ImageLayout::eUndefined;
 		depth_attachment_desc.finalLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
 
 		// reference to depth attachment
@@ -413,85 +829,135 @@ namespace halo
 		depth_attachment_ref.attachment = 1;
 		depth_attachment_ref.layout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
 
-		// Description for only subpass of renderpass
+		// MSAA : the main subpass resolves color into the HDR image (fully overwritten, so its previous contents are never loaded)
+		vk::AttachmentDescription resolve_attachment_desc = {};
+		resolve_attachment_desc.format = m_hdr_color_format;
+		resolve_attachment_desc.samples = vk::SampleCountFlagBits::e1;
+		resolve_attachment_desc.loadOp = vk::AttachmentLoadOp::eDontCare;
+		resolve_attachment_desc.storeOp = vk::AttachmentStoreOp::eStore;
+		resolve_attachment_desc.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
+		resolve_attachment_desc.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
+		resolve_attachment_desc.initialLayout = vk::ImageLayout::eUndefined;
+		resolve_attachment_desc.finalLayout = vk::ImageLayout::eColorAttachmentOptimal;
+
+		vk::AttachmentReference resolve_attachment_ref = {};
+		resolve_attachment_ref.attachment = 2;
+		resolve_attachment_ref.layout = vk::ImageLayout::eColorAttachmentOptimal;
+
+		// depth pre pass subpass : depth only
+		vk::SubpassDescription depth_prepass_subpass_desc = {};
+		depth_prepass_subpass_desc.pipelineBindPoint = vk::PipelineBindPoint::eGraphics;
+		depth_prepass_subpass_desc.colorAttachmentCount = 0;
+		depth_prepass_subpass_desc.pDepthStencilAttachment = &depth_attachment_ref;
+
+		// Description for the main subpass of renderpass
 		vk::SubpassDescription subpass_desc = {};
 		subpass_desc.pipelineBindPoint = vk::PipelineBindPoint::eGraphics;
 		subpass_desc.colorAttachmentCount = 1;
 		subpass_desc.pColorAttachments = &color_attachment_ref;
+		subpass_desc.pResolveAttachments = msaa_enabled ? &resolve_attachment_ref : nullptr;
 
 		subpass_desc.pDepthStencilAttachment = &depth_attachment_ref;
 
-		vk::AttachmentDescription attachments[] = {color_attachment_desc, depth_attachment_desc};
+		vk::SubpassDescription subpass_descs[] = {depth_prepass_subpass_desc, subpass_desc};
+
+		// main subpass depth tests read what the pre pass wrote
+		vk::SubpassDependency depth_dependency = {};
+		depth_dependency.srcSubpass = 0;
+		depth_dependency.dstSubpass = 1;
+		depth_dependency.srcStageMask = vk::PipelineStageFlagBits::eLateFragmentTests;
+		depth_dependency.dstStageMask = vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests;
+		depth_dependency.srcAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+		depth_dependency.dstAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentRead;
+		depth_dependency.dependencyFlags = vk::DependencyFlagBits::eByRegion;
+
+		vk::AttachmentDescription attachments[] = {color_attachment_desc, depth_attachment_desc, resolve_attachment_desc};
 
 		vk::RenderPassCreateInfo render_pass_create_info = {};
-		render_pass_create_info.attachmentCount = 2;
+		render_pass_create_info.attachmentCount = msaa_enabled ? 3 : 2;
 		render_pass_create_info.pAttachments = &attachments[0];
-		render_pass_create_info.subpassCount = 1;
-		render_pass_create_info.pSubpasses = &subpass_desc;
+
+		if (m_config.m_depth_prepass)
+		{
+			render_pass_create_info.subpassCount = 2;
+			render_pass_create_info.pSubpasses = subpass_descs;
+			render_pass_create_info.dependencyCount = 1;
+			render_pass_create_info.pDependencies = &depth_dependency;
+		}
+		else
+		{
+			render_pass_create_info.subpassCount = 1;
+			render_pass_create_info.pSubpasses = &subpass_desc;
+		}
 		
-		m_render_pass = m_device.createRenderPass(render_pass_create_info);
-		m_deletion_list.push_function(CREATE_LAMBDA_FUNCTION(m_device.destroyRenderPass(m_render_pass)));
+		return m_device.createRenderPass(render_pass_create_info);
 	}
 	
 	// acts as a link between the attachments of the renderpassand the real images that they should render to.
 	// contains color, depth, stencil and other buffers.
 	void Engine::init_framebuffers()
 	{
-		// since most properties will be shared, all fb create info structs will be made by modifying this template
 		vk::FramebufferCreateInfo framebuffer_create_info = {};
 		framebuffer_create_info.renderPass = m_render_pass;
 		framebuffer_create_info.width = m_window_extent.width;
 		framebuffer_create_info.height = m_window_extent.height;
 		framebuffer_create_info.layers = 1;
 
-		const size_t swapchain_image_count = m_swapchain_images.size();
-		m_framebuffers = std::vector<vk::Framebuffer>(swapchain_image_count);
+		// the scene renders into HDR color, so one framebuffer serves every swapchain image. With MSAA, HDR color is the resolve attachment.
+		const bool msaa_enabled = m_msaa_samples != vk::SampleCountFlagBits::e1;
 
-		for (size_t i = 0; i < m_swapchain_image_views.size(); i++)
-		{
-			vk::ImageView attachments[] = {m_swapchain_image_views[i], m_depth_image_view};
+		vk::ImageView attachments[] = {msaa_enabled ? m_msaa_color_view : m_hdr_color_view, m_depth_image_view, m_hdr_color_view};
+
+		framebuffer_create_info.attachmentCount = msaa_enabled ? 3 : 2;
+		framebuffer_create_info.pAttachments = attachments;
 
-			framebuffer_create_info.attachmentCount = 2;
-			framebuffer_create_info.pAttachments = attachments;
+		m_framebuffer = m_device.createFramebuffer(framebuffer_create_info);
+		m_deletion_queue.push(m_framebuffer);
 
-			m_framebuffers[i] = m_device.createFramebuffer(framebuffer_create_info);
-			m_deletion_list.push_function(CREATE_LAMBDA_FUNCTION(m_device.destroyFramebuffer(m_framebuffers[i])));
-			m_deletion_list.push_function(CREATE_LAMBDA_FUNCTION(m_device.destroyImageView(m_swapchain_image_views[i])));
+		for (vk::ImageView swapchain_image_view : m_swapchain_image_views)
+		{
+			m_deletion_queue.push(swapchain_image_view);
 		}
 	}
 
 	// sync objects : fence (GPU to CPU), semaphore (GPU to GPU)
 	void Engine::init_synchronization_objects()
 	{
-		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		// with timeline semaphores, one timeline for the graphics queue replaces all the per frame fences.
+		if (m_timeline_sync_enabled)
 		{
-			vk::FenceCreateInfo fence_create_info = init::create_fence();
-			m_frames[i].m_render_fence = m_device.createFence(fence_create_info);
-			m_deletion_list.push_function(CREATE_LAMBDA_FUNCTION(m_device.destroyFence(m_frames[i].m_render_fence)));
+			m_graphics_timeline.create(m_device);
+			m_deletion_queue.push(m_graphics_timeline.m_semaphore);
+		}
 
-			vk::SemaphoreCreateInfo semaphore_create_info = init::create_semaphore();
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		{
+			if (!m_timeline_sync_enabled)
+			{
+				vk::FenceCreateInfo fence_create_info = init::create_fence();
+				m_frames[i].m_render_fence = m_device.createFence(fence_create_info);
+				m_deletion_queue.push(m_frames[i].m_render_fence);
+			}
+
+			vk::SemaphoreCreateInfo semaphore_create_info = init::create_semaphore();
 			m_frames[i].m_render_semaphore = m_device.createSemaphore(semaphore_create_info);
 			m_frames[i].m_presentation_semaphore = m_device.createSemaphore(semaphore_create_info);
 
-			m_deletion_list.push_function(CREATE_LAMBDA_FUNCTION(m_device.destroySemaphore(m_frames[i].m_render_semaphore)));
-			m_deletion_list.push_function(CREATE_LAMBDA_FUNCTION(m_device.destroySemaphore(m_frames[i].m_presentation_semaphore)));
+			m_deletion_queue.push(m_frames[i].m_render_semaphore);
+			m_deletion_queue.push(m_frames[i].m_presentation_semaphore);
 		}
 	}
 
 	void Engine::init_descriptors()
 	{
-		// create descriptor pool, that can hold pointers to 10 uniform buffers
-		std::vector<vk::DescriptorPoolSize> descriptor_pool_size =
-		{
-			{vk::DescriptorType::eUniformBuffer, 10},
-			{vk::DescriptorType::eUniformBufferDynamic, 10},
-			{vk::DescriptorType::eStorageBuffer, 10}
-		};
-
-		vk::DescriptorPoolCreateInfo descriptor_pool_create_info = init::create_descriptor_pool(descriptor_pool_size, 10);
+		// descriptor sets come from chains of pools that grow as sets are allocated (see DescriptorAllocator), so there is no fixed set budget.
+		m_descriptor_allocator.init(m_device);
+		m_descriptor_layout_cache.init(m_device);
 
-		m_descriptor_pool = m_device.createDescriptorPool(descriptor_pool_create_info);
-		m_deletion_list.push_function(CREATE_LAMBDA_FUNCTION(m_device.destroyDescriptorPool(m_descriptor_pool)));
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		{
+			m_frames[i].m_descriptor_allocator.init(m_device, 64);
+		}
 
 		// note : uniform buffer is a type of buffer that is small in memory, but very fast for the GPU to read from.
 		// information about binding for camera buffer (bound at binding 0)
@@ -501,33 +967,57 @@ namespace halo
 		const vk::ShaderStageFlags VF = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment;
 
 		vk::DescriptorSetLayoutBinding environment_buffer_binding = init::create_descriptor_set_layout_binding(vk::DescriptorType::eUniformBufferDynamic, VF, 1);
+
+		// clustered lighting : lights of the frame, light count and light indices of each cluster (bindings 2 - 4, read by the lit fragment shaders)
+		vk::DescriptorSetLayoutBinding light_buffer_binding = init::create_descriptor_set_layout_binding(vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eFragment, 2);
+		vk::DescriptorSetLayoutBinding light_cluster_buffer_binding = init::create_descriptor_set_layout_binding(vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eFragment, 3);
+		vk::DescriptorSetLayoutBinding light_index_buffer_binding = init::create_descriptor_set_layout_binding(vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eFragment, 4);
+
+		// shadow cascades : shadow data and the shadow map (bindings 5 - 6, written by init_shadows)
+		vk::DescriptorSetLayoutBinding shadow_buffer_binding = init::create_descriptor_set_layout_binding(vk::DescriptorType::eUniformBuffer, vk::ShaderStageFlagBits::eFragment, 5);
+		vk::DescriptorSetLayoutBinding shadow_map_binding = init::create_descriptor_set_layout_binding(vk::DescriptorType::eCombinedImageSampler, vk::ShaderStageFlagBits::eFragment, 6);
 		
-		vk::DescriptorSetLayoutBinding bindings[] = {camera_buffer_binding, environment_buffer_binding};
+		vk::DescriptorSetLayoutBinding bindings[] = {camera_buffer_binding, environment_buffer_binding, light_buffer_binding, light_cluster_buffer_binding, light_index_buffer_binding,
+			shadow_buffer_binding, shadow_map_binding};
 
 		// Create the descriptor set layout (it is the shape of descriptor : what all its binding to and how much of it)
 		vk::DescriptorSetLayoutCreateInfo global_layout_create_info{};
-		global_layout_create_info.bindingCount = 2;
+		global_layout_create_info.bindingCount = 7;
 		global_layout_create_info.pBindings = bindings;
 
-		m_global_descriptor_set_layout = m_device.createDescriptorSetLayout(global_layout_create_info);
-		m_deletion_list.push_function(CREATE_LAMBDA_FUNCTION(m_device.destroyDescriptorSetLayout(m_global_descriptor_set_layout)));
+		m_global_descriptor_set_layout = m_descriptor_layout_cache.create_descriptor_set_layout(global_layout_create_info);
 
 		// descriptor set layout creation for object descriptor set 
 		vk::DescriptorSetLayoutBinding object_buffer_binding = init::create_descriptor_set_layout_binding(vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eVertex, 0);
 
+		// material index of each object (only read by the bindless pipeline)
+		vk::DescriptorSetLayoutBinding object_material_buffer_binding = init::create_descriptor_set_layout_binding(vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eVertex, 1);
+
+		vk::DescriptorSetLayoutBinding object_bindings[] = {object_buffer_binding, object_material_buffer_binding};
+
 		vk::DescriptorSetLayoutCreateInfo object_layout_create_info{};
-		object_layout_create_info.bindingCount = 1;
-		object_layout_create_info.pBindings = &object_buffer_binding;
+		object_layout_create_info.bindingCount = 2;
+		object_layout_create_info.pBindings = object_bindings;
+
+		m_object_descriptor_set_layout = m_descriptor_layout_cache.create_descriptor_set_layout(object_layout_create_info);
+
+		// texture set of textured materials : diffuse texture at binding 0
+		vk::DescriptorSetLayoutBinding diffuse_texture_binding = init::create_descriptor_set_layout_binding(vk::DescriptorType::eCombinedImageSampler, vk::ShaderStageFlagBits::eFragment, 0);
+
+		vk::DescriptorSetLayoutCreateInfo texture_layout_create_info{};
+		texture_layout_create_info.bindingCount = 1;
+		texture_layout_create_info.pBindings = &diffuse_texture_binding;
 
-		m_object_descriptor_set_layout = m_device.createDescriptorSetLayout(object_layout_create_info);
-		m_deletion_list.push_function(CREATE_LAMBDA_FUNCTION(m_device.destroyDescriptorSetLayout(m_object_descriptor_set_layout)));
+		m_texture_descriptor_set_layout = m_descriptor_layout_cache.create_descriptor_set_layout(texture_layout_create_info);
 
 		// for dynamic descriptor sets
 		// allocate buffer by padding it properly so tha we can fit 2 padded EnvironmentData structs
 		const size_t environment_buffer_size = MAX_FRAMES_IN_FLIGHT * pad_uniform_buffer(sizeof(EnvironmentData));
 		m_environment_parameter_buffer = create_buffer(environment_buffer_size, vk::BufferUsageFlagBits::eUniformBuffer, VMA_MEMORY_USAGE_CPU_TO_GPU);
 
-		constexpr int MAX_OBJECTS = 10000;
+		// cluster buffers are rewritten every frame by the light cull pass, so all frames share them
+		m_light_cluster_buffer = create_buffer(sizeof(uint32_t) * LIGHT_CLUSTER_COUNT, vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_GPU_ONLY);
+		m_light_index_buffer = create_buffer(sizeof(uint32_t) * LIGHT_CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER, vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_GPU_ONLY);
 
 		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
 		{
@@ -536,23 +1026,12 @@ namespace halo
 			
 			// create buffer for all objects' data
 			m_frames[i].m_objects_buffer = create_buffer(sizeof(ObjectData) * MAX_OBJECTS, vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_CPU_TO_GPU);
+			m_frames[i].m_object_material_buffer = create_buffer(sizeof(uint32_t) * MAX_OBJECTS, vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_CPU_TO_GPU);
+			m_frames[i].m_light_buffer = create_buffer(sizeof(LightData) * MAX_LIGHTS, vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_CPU_TO_GPU);
 
-			// allocation one descriptor set for each frame
-			vk::DescriptorSetAllocateInfo global_descriptor_set_allocate_info{};
-
-			global_descriptor_set_allocate_info.descriptorPool = m_descriptor_pool;
-			global_descriptor_set_allocate_info.descriptorSetCount = 1;
-			global_descriptor_set_allocate_info.pSetLayouts = &m_global_descriptor_set_layout;
-
-			m_frames[i].m_global_descriptor_set = m_device.allocateDescriptorSets(global_descriptor_set_allocate_info)[0];
-
-			// object descriptor set alloc 
-			vk::DescriptorSetAllocateInfo object_descriptor_set_allocate_info{};
-			object_descriptor_set_allocate_info.descriptorPool = m_descriptor_pool;
-			object_descriptor_set_allocate_info.descriptorSetCount = 1;
-			object_descriptor_set_allocate_info.pSetLayouts = &m_object_descriptor_set_layout;
-
-			m_frames[i].m_object_descriptor_set = m_device.allocateDescriptorSets(object_descriptor_set_allocate_info)[0];
+			// allocation one descriptor set for each frame (global and object sets)
+			m_frames[i].m_global_descriptor_set = m_descriptor_allocator.allocate(m_global_descriptor_set_layout);
+			m_frames[i].m_object_descriptor_set = m_descriptor_allocator.allocate(m_object_descriptor_set_layout);
 
 			// point descriptor set to buffer
 			
@@ -574,42 +1053,216 @@ namespace halo
 			object_buffer_info.offset = 0;
 			object_buffer_info.range = sizeof(ObjectData) * MAX_OBJECTS;
 
+			vk::DescriptorBufferInfo object_material_buffer_info{};
+			object_material_buffer_info.buffer = m_frames[i].m_object_material_buffer.m_buffer;
+			object_material_buffer_info.offset = 0;
+			object_material_buffer_info.range = sizeof(uint32_t) * MAX_OBJECTS;
+
 			//each resource has a vk::WriteDescriptorSet which contains which buffer the individual set points to
 			// vk::WriteDescriptorSet : Structure specifying the parameters of a descriptor set write operation
 			vk::WriteDescriptorSet camera_descriptor_set_write = init::write_descriptor_buffer(vk::DescriptorType::eUniformBuffer, m_frames[i].m_global_descriptor_set, &camera_buffer_info, 0);
 			vk::WriteDescriptorSet environment_descritor_set_write = init::write_descriptor_buffer(vk::DescriptorType::eUniformBufferDynamic, m_frames[i].m_global_descriptor_set, &environment_buffer_info, 1);
 
+			vk::DescriptorBufferInfo light_buffer_info{m_frames[i].m_light_buffer.m_buffer, 0, sizeof(LightData) * MAX_LIGHTS};
+			vk::DescriptorBufferInfo light_cluster_buffer_info{m_light_cluster_buffer.m_buffer, 0, sizeof(uint32_t) * LIGHT_CLUSTER_COUNT};
+			vk::DescriptorBufferInfo light_index_buffer_info{m_light_index_buffer.m_buffer, 0, sizeof(uint32_t) * LIGHT_CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER};
+
+			vk::WriteDescriptorSet light_descriptor_set_write = init::write_descriptor_buffer(vk::DescriptorType::eStorageBuffer, m_frames[i].m_global_descriptor_set, &light_buffer_info, 2);
+			vk::WriteDescriptorSet light_cluster_descriptor_set_write = init::write_descriptor_buffer(vk::DescriptorType::eStorageBuffer, m_frames[i].m_global_descriptor_set, &light_cluster_buffer_info, 3);
+			vk::WriteDescriptorSet light_index_descriptor_set_write = init::write_descriptor_buffer(vk::DescriptorType::eStorageBuffer, m_frames[i].m_global_descriptor_set, &light_index_buffer_info, 4);
+
 			vk::WriteDescriptorSet object_descriptor_set_write = init::write_descriptor_buffer(vk::DescriptorType::eStorageBuffer, m_frames[i].m_object_descriptor_set, &object_buffer_info, 0);
+			vk::WriteDescriptorSet object_material_descriptor_set_write = init::write_descriptor_buffer(vk::DescriptorType::eStorageBuffer, m_frames[i].m_object_descriptor_set, &object_material_buffer_info, 1);
 	
-			vk::WriteDescriptorSet write_descriptor_sets[] = {camera_descriptor_set_write, environment_descritor_set_write, object_descriptor_set_write};
+			vk::WriteDescriptorSet write_descriptor_sets[] = {camera_descriptor_set_write, environment_descritor_set_write, light_descriptor_set_write, light_cluster_descriptor_set_write, light_index_descriptor_set_write,
+				object_descriptor_set_write, object_material_descriptor_set_write};
 
 			// make the descriptor sets' point to some buffer / memory
-			m_device.updateDescriptorSets(3, write_descriptor_sets, 0, nullptr);
+			m_device.updateDescriptorSets(7, write_descriptor_sets, 0, nullptr);
 		}
 			
 	}
 
-	void Engine::init_pipeline()
+	void Engine::init_bindless()
 	{
-		// for triangle's
+		if (!m_bindless_enabled)
 		{
-			// create shader modules
-			vk::ShaderModule default_vert_module;
-			load_shaders("../shaders/default_mesh.vert.spv", default_vert_module);
+			return;
+		}
 
-			vk::ShaderModule triangle_test_frag;
-			load_shaders("../shaders/default_lit.frag.spv", triangle_test_frag);
+		auto properties = m_physical_device.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceDescriptorIndexingProperties>();
+		const vk::PhysicalDeviceDescriptorIndexingProperties& limits = properties.get<vk::PhysicalDeviceDescriptorIndexingProperties>();
+
+		m_bindless_buffer_capacity = std::min({static_cast<uint32_t>(MAX_BINDLESS_BUFFERS), limits.maxDescriptorSetUpdateAfterBindStorageBuffers, limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers});
+		m_bindless_texture_capacity = std::min({static_cast<uint32_t>(MAX_BINDLESS_TEXTURES), limits.maxDescriptorSetUpdateAfterBindSampledImages, limits.maxPerStageDescriptorUpdateAfterBindSampledImages});
+		m_bindless_sampler_capacity = std::min({static_cast<uint32_t>(MAX_BINDLESS_SAMPLERS), limits.maxDescriptorSetUpdateAfterBindSamplers, limits.maxPerStageDescriptorUpdateAfterBindSamplers});
+
+		const vk::ShaderStageFlags VF = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment;
+
+		vk::DescriptorSetLayoutBinding bindings[] =
+		{
+			init::create_descriptor_set_layout_binding(vk::DescriptorType::eStorageBuffer, VF, 0),
+			init::create_descriptor_set_layout_binding(vk::DescriptorType::eSampledImage, vk::ShaderStageFlagBits::eFragment, 1),
+			init::create_descriptor_set_layout_binding(vk::DescriptorType::eSampler, vk::ShaderStageFlagBits::eFragment, 2)
+		};
+
+		bindings[0].descriptorCount = m_bindless_buffer_capacity;
+		bindings[1].descriptorCount = m_bindless_texture_capacity;
+		bindings[2].descriptorCount = m_bindless_sampler_capacity;
+
+		// slots are filled as resources are loaded (partially bound), while frames using the set may still be in flight (update after bind).
+		const vk::DescriptorBindingFlags binding_flag = vk::DescriptorBindingFlagBits::ePartiallyBound | vk::DescriptorBindingFlagBits::eUpdateAfterBind;
+		vk::DescriptorBindingFlags binding_flags[] = {binding_flag, binding_flag, binding_flag};
+
+		vk::DescriptorSetLayoutBindingFlagsCreateInfo binding_flags_create_info{};
+		binding_flags_create_info.bindingCount = 3;
+		binding_flags_create_info.pBindingFlags = binding_flags;
+
+		vk::DescriptorSetLayoutCreateInfo layout_create_info{};
+		layout_create_info.flags = vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool;
+		layout_create_info.bindingCount = 3;
+		layout_create_info.pBindings = bindings;
+		layout_create_info.pNext = &binding_flags_create_info;
+
+		m_bindless_descriptor_set_layout = m_descriptor_layout_cache.create_descriptor_set_layout(layout_create_info);
+
+		std::vector<vk::DescriptorPoolSize> descriptor_pool_size =
+		{
+			{vk::DescriptorType::eStorageBuffer, m_bindless_buffer_capacity},
+			{vk::DescriptorType::eSampledImage, m_bindless_texture_capacity},
+			{vk::DescriptorType::eSampler, m_bindless_sampler_capacity}
+		};
+
+		vk::DescriptorPoolCreateInfo descriptor_pool_create_info = init::create_descriptor_pool(descriptor_pool_size, 1);
+		descriptor_pool_create_info.flags = vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind;
+
+		m_bindless_descriptor_pool = m_device.createDescriptorPool(descriptor_pool_create_info);
+		m_deletion_queue.push(m_bindless_descriptor_pool);
+
+		vk::DescriptorSetAllocateInfo allocate_info{};
+		allocate_info.descriptorPool = m_bindless_descriptor_pool;
+		allocate_info.descriptorSetCount = 1;
+		allocate_info.pSetLayouts = &m_bindless_descriptor_set_layout;
+
+		m_bindless_descriptor_set = m_device.allocateDescriptorSets(allocate_info)[0];
+
+		// materials are written once when created, so a single buffer is shared by every frame.
+		m_material_buffer = create_buffer(sizeof(MaterialData) * MAX_MATERIALS, vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_CPU_TO_GPU);
+		register_bindless_buffer(m_material_buffer.m_buffer, sizeof(MaterialData) * MAX_MATERIALS);
+	}
+
+	uint32_t Engine::register_bindless_buffer(vk::Buffer buffer, vk::DeviceSize range)
+	{
+		if (m_bindless_buffer_count >= m_bindless_buffer_capacity)
+		{
+			throw std::runtime_error("Bindless storage buffer slots are full");
+		}
+
+		const uint32_t slot = m_bindless_buffer_count++;
+
+		vk::DescriptorBufferInfo buffer_info{};
+		buffer_info.buffer = buffer;
+		buffer_info.offset = 0;
+		buffer_info.range = range;
+
+		vk::WriteDescriptorSet buffer_write = init::write_descriptor_buffer(vk::DescriptorType::eStorageBuffer, m_bindless_descriptor_set, &buffer_info, 0);
+		buffer_write.dstArrayElement = slot;
+
+		m_device.updateDescriptorSets(1, &buffer_write, 0, nullptr);
+
+		return slot;
+	}
+
+	uint32_t Engine::register_bindless_texture(const Texture& texture)
+	{
+		// slots released by textures that no frame in flight can still sample become free again
+		const uint64_t completed_submission_value = get_completed_submission_value();
+
+		std::erase_if(m_retired_bindless_texture_slots, [&](const std::pair<uint32_t, uint64_t>& retired_slot)
+		{
+			if (retired_slot.second > completed_submission_value)
+			{
+				return false;
+			}
+
+			m_free_bindless_texture_slots.push_back(retired_slot.first);
+			return true;
+		});
+
+		uint32_t slot;
+		if (!m_free_bindless_texture_slots.empty())
+		{
+			slot = m_free_bindless_texture_slots.back();
+			m_free_bindless_texture_slots.pop_back();
+		}
+		else if (m_bindless_texture_count < m_bindless_texture_capacity)
+		{
+			slot = m_bindless_texture_count++;
+		}
+		else
+		{
+			throw std::runtime_error("Bindless texture slots are full");
+		}
+
+		vk::DescriptorImageInfo image_info{};
+		image_info.imageView = texture.m_view;
+		image_info.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+
+		vk::WriteDescriptorSet image_write = init::write_descriptor_image(vk::DescriptorType::eSampledImage, m_bindless_descriptor_set, &image_info, 1);
+		image_write.dstArrayElement = slot;
+
+		m_device.updateDescriptorSets(1, &image_write, 0, nullptr);
+
+		return slot;
+	}
+
+	void Engine::release_bindless_texture(uint32_t slot)
+	{
+		m_retired_bindless_texture_slots.emplace_back(slot, get_pending_submission_value());
+	}
+
+	uint32_t Engine::get_bindless_sampler_index(const SamplerSettings& settings)
+	{
+		auto it = m_bindless_sampler_indices.find(settings);
+		if (it != m_bindless_sampler_indices.end())
+		{
+			return it->second;
+		}
+
+		const uint32_t slot = static_cast<uint32_t>(m_bindless_sampler_indices.size());
+		if (slot >= m_bindless_sampler_capacity)
+		{
+			throw std::runtime_error("Bindless sampler slots are full");
+		}
+
+		vk::DescriptorImageInfo sampler_info{};
+		sampler_info.sampler = get_sampler(settings);
+
+		vk::WriteDescriptorSet sampler_write = init::write_descriptor_image(vk::DescriptorType::eSampler, m_bindless_descriptor_set, &sampler_info, 2);
+		sampler_write.dstArrayElement = slot;
+
+		m_device.updateDescriptorSets(1, &sampler_write, 0, nullptr);
+
+		m_bindless_sampler_indices.emplace(settings, slot);
+		return slot;
+	}
+
+	void Engine::init_pipeline()
+	{
+		// depth pre pass : position stream only and no fragment shader.
+		if (m_config.m_depth_prepass)
+		{
+			vk::ShaderModule depth_only_vert_module;
+			load_shaders("../shaders/depth_only.vert.spv", depth_only_vert_module);
 
 			PipelineBuilder pipeline_builder = {};
-			pipeline_builder.m_shader_stages.push_back(init::create_shader_stage(vk::ShaderStageFlagBits::eVertex, default_vert_module));
-			pipeline_builder.m_shader_stages.push_back(init::create_shader_stage(vk::ShaderStageFlagBits::eFragment, triangle_test_frag));
+			pipeline_builder.m_shader_stages.push_back(init::create_shader_stage(vk::ShaderStageFlagBits::eVertex, depth_only_vert_module));
 
-			m_deletion_list.push_function(CREATE_LAMBDA_FUNCTION(m_device.destroyShaderModule(default_vert_module)));
-			m_deletion_list.push_function(CREATE_LAMBDA_FUNCTION(m_device.destroyShaderModule(triangle_test_frag)));
+			m_deletion_queue.push(depth_only_vert_module);
 
 			pipeline_builder.m_vertex_input_info = init::create_vertex_input_state();
 
-			VertexInputLayoutDescription vertex_input_layout_description = Vertex::get_vertex_input_layout_description();
+			VertexInputLayoutDescription vertex_input_layout_description = Vertex::get_position_input_layout_description(m_config.m_vertex_layout);
 
 			pipeline_builder.m_vertex_input_info.vertexBindingDescriptionCount = static_cast<uint32_t>(vertex_input_layout_description.m_bindings.size());
 			pipeline_builder.m_vertex_input_info.pVertexBindingDescriptions = vertex_input_layout_description.m_bindings.data();
@@ -629,106 +1282,172 @@ namespace halo
 			pipeline_builder.m_scissor.offset = vk::Offset2D{0, 0};
 			pipeline_builder.m_scissor.extent = m_window_extent;
 
+			// the scene passes render at the dynamic resolution's extent (see record_scene_pass)
+			pipeline_builder.m_dynamic_states = {vk::DynamicState::eViewport, vk::DynamicState::eScissor};
+
 			pipeline_builder.m_rasterizer_state_info = init::create_rasterizer_state();
-			pipeline_builder.m_multisample_state_info = init::create_multisampling_info();
+			pipeline_builder.m_multisample_state_info = init::create_multisampling_info(m_msaa_samples);
 			pipeline_builder.m_color_blend_state_attachment = init::create_color_blend_state();
+			pipeline_builder.m_color_attachment_count = 0;
 			pipeline_builder.m_depth_stencil_state_info = init::create_depth_stencil_state();
-			
-			// create push constant (configure so that it can hold a view projection matrix)
-			vk::PushConstantRange push_constant_range = {};
-			push_constant_range.size = sizeof(MeshPushConstants);
-			push_constant_range.offset = 0;
-			push_constant_range.stageFlags = vk::ShaderStageFlagBits::eVertex;
 
-			// bind push_constants and descriptor sets to the pipeline
 			vk::PipelineLayoutCreateInfo pipeline_layout_create_info = {};
-			pipeline_layout_create_info.pushConstantRangeCount = 1;
-			pipeline_layout_create_info.pPushConstantRanges = &push_constant_range;
 
 			vk::DescriptorSetLayout set_layouts[] = {m_global_descriptor_set_layout, m_object_descriptor_set_layout};
 
 			pipeline_layout_create_info.pSetLayouts = set_layouts;
 			pipeline_layout_create_info.setLayoutCount = 2;
 
-			m_triangle_pipeline_layout = m_device.createPipelineLayout(pipeline_layout_create_info);
-			m_deletion_list.push_function(CREATE_LAMBDA_FUNCTION(m_device.destroyPipelineLayout(m_triangle_pipeline_layout)));
+			m_depth_prepass_pipeline_layout = m_device.createPipelineLayout(pipeline_layout_create_info);
+			m_deletion_queue.push(m_depth_prepass_pipeline_layout);
+
+			pipeline_builder.m_pipeline_layout = m_depth_prepass_pipeline_layout;
+
+			m_depth_prepass_pipeline = pipeline_builder.create_pipeline(m_device, m_render_pass, 0);
+			m_deletion_queue.push(m_depth_prepass_pipeline);
+		}
+
+		// for triangle's
+		{
+			vk::ShaderModule default_vert_module;
+			load_shaders("../shaders/default_mesh.vert.spv", default_vert_module);
 
-			pipeline_builder.m_pipeline_layout = m_triangle_pipeline_layout;
+			vk::ShaderModule triangle_test_frag;
+			load_shaders("../shaders/default_lit.frag.spv", triangle_test_frag);
 
-			m_triangle_pipeline = pipeline_builder.create_pipeline(m_device, m_render_pass);
-			m_deletion_list.push_function(CREATE_LAMBDA_FUNCTION(m_device.destroyPipeline(m_triangle_pipeline)));
+			m_triangle_pipeline_layout = create_mesh_pipeline_layout();
+			m_triangle_pipeline = create_mesh_pipeline(default_vert_module, triangle_test_frag, m_triangle_pipeline_layout);
 
 			create_material("triangle_material", m_triangle_pipeline, m_triangle_pipeline_layout);
 		}
 
 		// creation for mesh pipeline and layout (with vertex buffer and push constants)
 		{
-			// create shader modules
 			vk::ShaderModule mesh_vert_module;
 			load_shaders("../shaders/default_mesh.vert.spv", mesh_vert_module);
 
 			vk::ShaderModule mesh_frag_module;
 			load_shaders("../shaders/default_mesh.frag.spv", mesh_frag_module);
 
-			PipelineBuilder pipeline_builder = {};
-			pipeline_builder.m_shader_stages.push_back(init::create_shader_stage(vk::ShaderStageFlagBits::eVertex, mesh_vert_module));
-			pipeline_builder.m_shader_stages.push_back(init::create_shader_stage(vk::ShaderStageFlagBits::eFragment, mesh_frag_module));
+			m_default_mesh_layout = create_mesh_pipeline_layout();
+			m_default_mesh_pipeline = create_mesh_pipeline(mesh_vert_module, mesh_frag_module, m_default_mesh_layout);
 
-			m_deletion_list.push_function(CREATE_LAMBDA_FUNCTION(m_device.destroyShaderModule(mesh_vert_module)));
-			m_deletion_list.push_function(CREATE_LAMBDA_FUNCTION(m_device.destroyShaderModule(mesh_frag_module)));
+			// bindless mode : the default material is a MaterialData entry of the bindless pipeline instead (created below)
+			if (!m_bindless_enabled)
+			{
+				create_material("default_material", m_default_mesh_pipeline, m_default_mesh_layout);
+			}
+		}
 
-			pipeline_builder.m_vertex_input_info = init::create_vertex_input_state();
+		// textured mesh pipeline : same vertex stage, diffuse texture in set 2
+		{
+			vk::ShaderModule mesh_vert_module;
+			load_shaders("../shaders/default_mesh.vert.spv", mesh_vert_module);
 
-			VertexInputLayoutDescription vertex_input_layout_description = Vertex::get_vertex_input_layout_description();
+			vk::ShaderModule textured_frag_module;
+			load_shaders("../shaders/textured_lit.frag.spv", textured_frag_module);
 
-			pipeline_builder.m_vertex_input_info.vertexBindingDescriptionCount = static_cast<uint32_t>(vertex_input_layout_description.m_bindings.size());
-			pipeline_builder.m_vertex_input_info.pVertexBindingDescriptions = vertex_input_layout_description.m_bindings.data();
+			m_textured_mesh_layout = create_mesh_pipeline_layout(m_texture_descriptor_set_layout);
+			m_textured_mesh_pipeline = create_mesh_pipeline(mesh_vert_module, textured_frag_module, m_textured_mesh_layout);
+		}
 
-			pipeline_builder.m_vertex_input_info.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertex_input_layout_description.m_attributes.size());
-			pipeline_builder.m_vertex_input_info.pVertexAttributeDescriptions = vertex_input_layout_description.m_attributes.data();
+		// bindless mesh pipeline : one pipeline for every bindless material, resources in the bindless set (set 2)
+		if (m_bindless_enabled)
+		{
+			vk::ShaderModule mesh_vert_module;
+			load_shaders("../shaders/default_mesh.vert.spv", mesh_vert_module);
 
-			pipeline_builder.m_input_assembler = init::create_input_assembler();
+			vk::ShaderModule bindless_frag_module;
+			load_shaders("../shaders/bindless_lit.frag.spv", bindless_frag_module);
 
-			pipeline_builder.m_viewport.x = 0.0f;
-			pipeline_builder.m_viewport.y = 0.0f;
-			pipeline_builder.m_viewport.width = static_cast<float>(m_window_extent.width);
-			pipeline_builder.m_viewport.height = static_cast<float>(m_window_extent.height);
-			pipeline_builder.m_viewport.minDepth = 0.0f;
-			pipeline_builder.m_viewport.maxDepth = 1.0f;
+			m_bindless_mesh_layout = create_mesh_pipeline_layout(m_bindless_descriptor_set_layout);
+			m_bindless_mesh_pipeline = create_mesh_pipeline(mesh_vert_module, bindless_frag_module, m_bindless_mesh_layout);
 
-			pipeline_builder.m_scissor.offset = vk::Offset2D{ 0, 0 };
-			pipeline_builder.m_scissor.extent = m_window_extent;
+			// untextured, white : same output as default_mesh.frag
+			create_bindless_material("default_material", MaterialData{});
+		}
+	}
 
-			pipeline_builder.m_rasterizer_state_info = init::create_rasterizer_state();
-			pipeline_builder.m_multisample_state_info = init::create_multisampling_info();
-			pipeline_builder.m_color_blend_state_attachment = init::create_color_blend_state();
-			pipeline_builder.m_depth_stencil_state_info = init::create_depth_stencil_state();
+	vk::PipelineLayout Engine::create_mesh_pipeline_layout(vk::DescriptorSetLayout material_set_layout)
+	{
+		// push constant (configured so that it can hold a view projection matrix)
+		vk::PushConstantRange push_constant_range = {};
+		push_constant_range.size = sizeof(MeshPushConstants);
+		push_constant_range.offset = 0;
+		push_constant_range.stageFlags = vk::ShaderStageFlagBits::eVertex;
 
-			// create push constant (configure so that it can hold a view projection matrix)
-			vk::PushConstantRange push_constant_range = {};
-			push_constant_range.size = sizeof(MeshPushConstants);
-			push_constant_range.offset = 0;
-			push_constant_range.stageFlags = vk::ShaderStageFlagBits::eVertex;
+		vk::PipelineLayoutCreateInfo pipeline_layout_create_info = {};
+		pipeline_layout_create_info.pushConstantRangeCount = 1;
+		pipeline_layout_create_info.pPushConstantRanges = &push_constant_range;
 
-			// bind push_constants and descriptor sets to the pipeline
-			vk::PipelineLayoutCreateInfo pipeline_layout_create_info = {};
-			pipeline_layout_create_info.pushConstantRangeCount = 1;
-			pipeline_layout_create_info.pPushConstantRanges = &push_constant_range;
+		vk::DescriptorSetLayout set_layouts[] = {m_global_descriptor_set_layout, m_object_descriptor_set_layout, material_set_layout};
 
-			vk::DescriptorSetLayout set_layouts[] = { m_global_descriptor_set_layout, m_object_descriptor_set_layout };
+		pipeline_layout_create_info.pSetLayouts = set_layouts;
+		pipeline_layout_create_info.setLayoutCount = material_set_layout ? 3 : 2;
 
-			pipeline_layout_create_info.pSetLayouts = set_layouts;
-			pipeline_layout_create_info.setLayoutCount = 2;
+		vk::PipelineLayout pipeline_layout = m_device.createPipelineLayout(pipeline_layout_create_info);
+		m_deletion_queue.push(pipeline_layout);
+
+		return pipeline_layout;
+	}
+
+	vk::Pipeline Engine::create_mesh_pipeline(vk::ShaderModule vertex_module, vk::ShaderModule fragment_module, vk::PipelineLayout pipeline_layout)
+	{
+		PipelineBuilder pipeline_builder = {};
+		pipeline_builder.m_shader_stages.push_back(init::create_shader_stage(vk::ShaderStageFlagBits::eVertex, vertex_module));
 
-			m_default_mesh_layout = m_device.createPipelineLayout(pipeline_layout_create_info);
-			m_deletion_list.push_function(CREATE_LAMBDA_FUNCTION(m_device.destroyPipelineLayout(m_default_mesh_layout)));
+		// constant_id 0 : normals are octahedral encoded
+		vk::Bool32 octahedral_normals = m_config.m_vertex_layout.m_octahedral_normals;
+		vk::SpecializationMapEntry octahedral_normals_entry{0, 0, sizeof(vk::Bool32)};
+		vk::SpecializationInfo vertex_specialization_info{1, &octahedral_normals_entry, sizeof(vk::Bool32), &octahedral_normals};
+		pipeline_builder.m_shader_stages.back().pSpecializationInfo = &vertex_specialization_info;
 
-			pipeline_builder.m_pipeline_layout = m_default_mesh_layout;
+		pipeline_builder.m_shader_stages.push_back(init::create_shader_stage(vk::ShaderStageFlagBits::eFragment, fragment_module));
 
-			m_default_mesh_pipeline = pipeline_builder.create_pipeline(m_device, m_render_pass);
-			m_deletion_list.push_function(CREATE_LAMBDA_FUNCTION(m_device.destroyPipeline(m_default_mesh_pipeline)));
-			create_material("default_material", m_default_mesh_pipeline, m_default_mesh_layout);
+		m_deletion_queue.push(vertex_module);
+		m_deletion_queue.push(fragment_module);
+
+		pipeline_builder.m_vertex_input_info = init::create_vertex_input_state();
+
+		VertexInputLayoutDescription vertex_input_layout_description = Vertex::get_vertex_input_layout_description(m_config.m_vertex_layout);
+
+		pipeline_builder.m_vertex_input_info.vertexBindingDescriptionCount = static_cast<uint32_t>(vertex_input_layout_description.m_bindings.size());
+		pipeline_builder.m_vertex_input_info.pVertexBindingDescriptions = vertex_input_layout_description.m_bindings.data();
+
+		pipeline_builder.m_vertex_input_info.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertex_input_layout_description.m_attributes.size());
+		pipeline_builder.m_vertex_input_info.pVertexAttributeDescriptions = vertex_input_layout_description.m_attributes.data();
+
+		pipeline_builder.m_input_assembler = init::create_input_assembler();
+
+		pipeline_builder.m_viewport.x = 0.0f;
+		pipeline_builder.m_viewport.y = 0.0f;
+		pipeline_builder.m_viewport.width = static_cast<float>(m_window_extent.width);
+		pipeline_builder.m_viewport.height = static_cast<float>(m_window_extent.height);
+		pipeline_builder.m_viewport.minDepth = 0.0f;
+		pipeline_builder.m_viewport.maxDepth = 1.0f;
+
+		pipeline_builder.m_scissor.offset = vk::Offset2D{0, 0};
+		pipeline_builder.m_scissor.extent = m_window_extent;
+		pipeline_builder.m_dynamic_states = {vk::DynamicState::eViewport, vk::DynamicState::eScissor};
+
+		pipeline_builder.m_rasterizer_state_info = init::create_rasterizer_state();
+		pipeline_builder.m_multisample_state_info = init::create_multisampling_info(m_msaa_samples);
+		pipeline_builder.m_color_blend_state_attachment = init::create_color_blend_state();
+		pipeline_builder.m_depth_stencil_state_info = init::create_depth_stencil_state();
+
+		// depth is already resolved by the pre pass : only the visible fragment of each pixel passes, and nothing is written.
+		if (m_config.m_depth_prepass)
+		{
+			pipeline_builder.m_depth_stencil_state_info.depthWriteEnable = false;
+			pipeline_builder.m_depth_stencil_state_info.depthCompareOp = vk::CompareOp::eEqual;
 		}
+
+		pipeline_builder.m_pipeline_layout = pipeline_layout;
+
+		vk::Pipeline pipeline = pipeline_builder.create_pipeline(m_device, m_render_pass, m_main_subpass);
+		m_deletion_queue.push(pipeline);
+
+		return pipeline;
 	}
 
 	void Engine::load_shaders(const char* file_path, vk::ShaderModule& shader_module)
@@ -761,31 +1480,94 @@ namespace halo
 
 	void Engine::load_meshes()
 	{
-		m_triangle_mesh.m_vertices.resize(3);
-		m_triangle_mesh.m_vertices[0].m_position = {-0.5f, -0.5f, 0.0f};
-		m_triangle_mesh.m_vertices[0].m_color = {1.0f, 0.0f, 0.0f};
+		Mesh triangle_mesh;
+		triangle_mesh.m_vertices.resize(3);
+		triangle_mesh.m_vertices[0].m_position = {-0.5f, -0.5f, 0.0f};
+		triangle_mesh.m_vertices[0].m_color = {1.0f, 0.0f, 0.0f};
+
+		triangle_mesh.m_vertices[1].m_position = {0.5f, -0.5f, 0.0f};
+		triangle_mesh.m_vertices[1].m_color = {0.0f, 1.0f, 0.0f};
+
+		triangle_mesh.m_vertices[2].m_position = {0.0f, 0.5f, 0.0f};
+		triangle_mesh.m_vertices[2].m_color = {0.0f, 0.0f, 1.0f};
+
+		// lit by default_lit.frag
+		for (Vertex& vertex : triangle_mesh.m_vertices)
+		{
+			vertex.m_normal = {0.0f, 0.0f, 1.0f};
+		}
+
+		triangle_mesh.m_indices = {0, 1, 2};
+
+		triangle_mesh.compute_bounds();
+
+		Mesh monkey_mesh;
+		monkey_mesh.load_obj_from_file("../assets/monkey_flat.obj");
+
+		// the OBJ's material texture gets its own material (init_scene falls back to the default material without it)
+		if (!monkey_mesh.m_diffuse_texture_path.empty())
+		{
+			if (std::filesystem::exists(monkey_mesh.m_diffuse_texture_path))
+			{
+				TextureHandle monkey_texture = load_texture("monkey_diffuse", monkey_mesh.m_diffuse_texture_path, m_config.m_texture_settings);
+				create_textured_material("monkey_material", monkey_texture);
+			}
+			else
+			{
+				std::cout << "Failed to find texture : " << monkey_mesh.m_diffuse_texture_path << '\n';
+			}
+		}
+
+		// meshes are moved into the registry, not copied
+		upload_mesh("triangle_mesh", std::move(triangle_mesh));
+		upload_mesh("monkey_mesh", std::move(monkey_mesh));
+	}
+
+	MeshHandle Engine::upload_mesh(std::string_view mesh_name, Mesh&& mesh)
+	{
+		if (m_config.m_optimize_meshes)
+		{
+			MeshOptimizationReport report = optimize_mesh(mesh);
+
+			std::cout << "Mesh optimization (" << mesh_name << ") : ACMR " << report.m_before.m_acmr << " -> " << report.m_after.m_acmr << ", ATVR " << report.m_before.m_atvr << " -> " << report.m_after.m_atvr << '\n';
+		}
+
+		// LODs are appended to the index buffer after LOD 0. Meshes without LODs draw their whole index buffer.
+		if (m_config.m_generate_mesh_lods)
+		{
+			generate_lods(mesh);
+		}
+		else if (mesh.m_lods.empty())
+		{
+			mesh.m_lods.push_back(MeshLod{0, static_cast<uint32_t>(mesh.m_indices.size()), 0.0f});
+		}
 
-		m_triangle_mesh.m_vertices[1].m_position = {0.5f, -0.5f, 0.0f};
-		m_triangle_mesh.m_vertices[1].m_color = {0.0f, 1.0f, 0.0f};
+		if (m_cluster_culling_enabled)
+		{
+			build_meshlets(mesh);
+			upload_meshlets(mesh);
+		}
 
-		m_triangle_mesh.m_vertices[2].m_position = {0.0f, 0.5f, 0.0f};
-		m_triangle_mesh.m_vertices[2].m_color = {0.0f, 0.0f, 1.0f};
+		std::vector<uint8_t> position_stream;
+		std::vector<uint8_t> attribute_stream;
+		pack_vertices(mesh.m_vertices, m_config.m_vertex_layout, position_stream, attribute_stream);
 
-		m_monkey_mesh.load_obj_from_file("../assets/monkey_flat.obj");
+		mesh.m_position_buffer = create_mesh_buffer(position_stream.data(), position_stream.size(), vk::BufferUsageFlagBits::eVertexBuffer);
+		mesh.m_attribute_buffer = create_mesh_buffer(attribute_stream.data(), attribute_stream.size(), vk::BufferUsageFlagBits::eVertexBuffer);
+		mesh.m_index_buffer = create_mesh_buffer(mesh.m_indices.data(), mesh.m_indices.size() * sizeof(uint32_t), vk::BufferUsageFlagBits::eIndexBuffer);
 
-		upload_meshes(m_triangle_mesh);
-		upload_meshes(m_monkey_mesh);
+		MeshHandle mesh_handle = m_meshes.insert(std::move(mesh));
+		m_mesh_names[make_string_id(mesh_name)] = mesh_handle;
 
-		m_meshes["monkey_mesh"] = m_monkey_mesh;
-		m_meshes["triangle_mesh"] = m_triangle_mesh;
+		return mesh_handle;
 	}
 
-	void Engine::upload_meshes(Mesh& mesh)
+	BufferHandle Engine::create_mesh_buffer(const void *data, size_t size, vk::BufferUsageFlags usage)
 	{
-		// allocate vertex buffer
+		// allocate vertex / index buffer (transfer usage : defragmentation copies it when its allocation moves)
 		vk::BufferCreateInfo buffer_create_info = {};
-		buffer_create_info.size = mesh.m_vertices.size() * sizeof(Vertex);
-		buffer_create_info.usage = vk::BufferUsageFlagBits::eVertexBuffer;
+		buffer_create_info.size = size;
+		buffer_create_info.usage = usage | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst;
 
 		// use VMA to specify that this data is written nto by CPU and accessed by GPU
 		VmaAllocationCreateInfo vma_allocation_create_info = {};
@@ -795,162 +1577,2777 @@ namespace halo
 		VkBufferCreateInfo vertex_buffer_create_info = static_cast<VkBufferCreateInfo>(buffer_create_info);
 		VkBuffer vertex_buffer;
 
-		vk::Result result = vk::Result(vmaCreateBuffer(m_vma_allocator, &vertex_buffer_create_info, &vma_allocation_create_info, &vertex_buffer, &mesh.m_allocated_buffer.m_allocation_data, nullptr));
+		AllocatedBuffer allocated_buffer;
+
+		vk::Result result = vk::Result(vmaCreateBuffer(m_vma_allocator, &vertex_buffer_create_info, &vma_allocation_create_info, &vertex_buffer, &allocated_buffer.m_allocation_data, nullptr));
 		VK_CHECK(result);
 
-		mesh.m_allocated_buffer.m_buffer = vertex_buffer;
-		
-		m_deletion_list.push_function(CREATE_LAMBDA_FUNCTION(vmaDestroyBuffer(m_vma_allocator, static_cast<VkBuffer>(mesh.m_allocated_buffer.m_buffer), mesh.m_allocated_buffer.m_allocation_data)));
+		allocated_buffer.m_buffer = vertex_buffer;
+		allocated_buffer.m_size = buffer_create_info.size;
+		allocated_buffer.m_usage = buffer_create_info.usage;
 
-		// now that we have memory spot for vertex data, copy vertices into this GPU readable location
-		void *data;
-		vmaMapMemory(m_vma_allocator, mesh.m_allocated_buffer.m_allocation_data, &data);
+		// now that we have memory spot for the data, copy it into this GPU readable location
+		void *mapped_data;
+		vmaMapMemory(m_vma_allocator, allocated_buffer.m_allocation_data, &mapped_data);
 
-		memcpy(data, mesh.m_vertices.data(), mesh.m_vertices.size() * sizeof(Vertex));
+		memcpy(mapped_data, data, size);
 
-		vmaUnmapMemory(m_vma_allocator, mesh.m_allocated_buffer.m_allocation_data);
+		vmaUnmapMemory(m_vma_allocator, allocated_buffer.m_allocation_data);
+
+		return m_buffers.insert(std::move(allocated_buffer));
 	}
 
-	void Engine::init_scene()
+	void Engine::unload_mesh(MeshHandle mesh_handle)
 	{
-		GameObject monkey;
-		monkey.m_material = get_material("default_material");
-		monkey.m_mesh = get_mesh("monkey_mesh");
-		monkey.m_mesh_transform = math::M4(1.0f);
+		// the mesh's buffers may be part of the running defragmentation
+		finish_defragmentation();
 
-		m_game_objects.push_back(monkey);
+		std::optional<Mesh> mesh = m_meshes.remove(mesh_handle);
+		if (!mesh.has_value())
+		{
+			return;
+		}
 
-		GameObject triangle;
-		triangle.m_material = get_material("triangle_material");
-		triangle.m_mesh = get_mesh("triangle_mesh");
-		triangle.m_mesh_transform = math::transpose(math::translate(math::V3{0.0f, 1.0f, -1.3f}));
-	
-		m_game_objects.push_back(triangle);
-	}
+		if (m_cluster_culling_enabled)
+		{
+			release_meshlets(*mesh);
+		}
 
-	void Engine::create_material(const std::string& material_name, vk::Pipeline pipeline, vk::PipelineLayout pipeline_layout)
-	{
-		Material material;
-		material.m_pipeline = pipeline;
-		material.m_pipeline_layout = pipeline_layout;
+		for (BufferHandle buffer_handle : {mesh->m_position_buffer, mesh->m_attribute_buffer, mesh->m_index_buffer})
+		{
+			std::optional<AllocatedBuffer> mesh_buffer = m_buffers.remove(buffer_handle);
+			if (mesh_buffer.has_value())
+			{
+				destroy_deferred(*mesh_buffer);
+			}
+		}
 
-		m_materials[material_name] = material;
+		std::erase_if(m_mesh_names, [&](const auto& entry) { return entry.second == mesh_handle; });
 	}
 
-	Material* Engine::get_material(const std::string& material_name)
+	TextureHandle Engine::load_texture(std::string_view texture_name, const std::string& file_path, const TextureSettings& settings)
 	{
-		auto it = m_materials.find(material_name);
-		if (it != m_materials.end())
+		TextureSettings texture_settings = settings;
+		texture_settings.m_compress = settings.m_compress && m_texture_compression_enabled;
+
+		if (texture_settings.m_compress)
 		{
-			return &m_materials[material_name];
+			TextureData texture_data = load_cooked_texture(file_path, texture_settings);
+			return upload_texture(texture_name, texture_data, false);
 		}
 
-		throw std::runtime_error("Failed to find material with name : " + material_name);
+		// uncompressed : mips are blitted on the GPU, unless linear blits from the format are not supported (they are then filtered on the CPU).
+		const vk::Format format = texture_settings.m_srgb ? vk::Format::eR8G8B8A8Srgb : vk::Format::eR8G8B8A8Unorm;
+		const bool supports_linear_blit = static_cast<bool>(m_physical_device.getFormatProperties(format).optimalTilingFeatures & vk::FormatFeatureFlagBits::eSampledImageFilterLinear);
+
+		const bool generate_mips_on_gpu = texture_settings.m_generate_mips && supports_linear_blit;
+		texture_settings.m_generate_mips = texture_settings.m_generate_mips && !generate_mips_on_gpu;
 
-		return nullptr;
+		TextureData texture_data = cook_texture(load_tga(file_path.c_str()), texture_settings);
+		return upload_texture(texture_name, texture_data, generate_mips_on_gpu);
 	}
 
-	Mesh* Engine::get_mesh(const std::string& mesh_name)
+	vk::ImageCreateInfo Engine::create_texture_image_info(vk::Format format, uint32_t width, uint32_t height, uint32_t mip_count) const
 	{
-		auto it = m_meshes.find(mesh_name);
-		if (it != m_meshes.end())
-		{
-			return &m_meshes[mesh_name];
-		}
+		const vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled;
 
-		throw std::runtime_error("Failed to find mesh with name : " + mesh_name);
+		vk::ImageCreateInfo image_create_info = init::create_image_info(format, vk::Extent3D{width, height, 1}, usage);
+		image_create_info.mipLevels = mip_count;
 
-		return nullptr;
+		return image_create_info;
 	}
 
-	void Engine::draw_objects(vk::CommandBuffer command_buffer, GameObject* game_object)
-	{		
-		math::V3 camera_position{m_camera.m_position};
-		camera_position.w = 0;
+	TextureHandle Engine::upload_texture(std::string_view texture_name, const TextureData& texture_data, bool generate_mips)
+	{
+		vk::Format format = vk::Format::eR8G8B8A8Srgb;
+		switch (texture_data.m_format)
+		{
+			case TextureFormat::Bc1:
+				format = texture_data.m_srgb ? vk::Format::eBc1RgbSrgbBlock : vk::Format::eBc1RgbUnormBlock;
+				break;
 
-		math::M4 view_mat = m_camera.get_look_at();
-		
-		math::M4 projection_mat = math::perpective(radians(45.0f), static_cast<float>(m_window_extent.width) / m_window_extent.height, 0.1f, 100.0f);
-		
-		Mesh *last_mesh = nullptr;
-		Material *last_material = nullptr;
+			case TextureFormat::Bc3:
+				format = texture_data.m_srgb ? vk::Format::eBc3SrgbBlock : vk::Format::eBc3UnormBlock;
+				break;
 
-		// Camera data struct : that will pass data to shader's via descriptor sets.
-		CameraData camera_data{};
-		camera_data.m_projection_mat = projection_mat;
-		camera_data.m_view_mat = view_mat;
+			default:
+				format = texture_data.m_srgb ? vk::Format::eR8G8B8A8Srgb : vk::Format::eR8G8B8A8Unorm;
+				break;
+		}
 
-		// transposing here because glsl expects column major order while the custom math lib uses row major order.
-		camera_data.m_projection_view_mat = transpose(projection_mat * view_mat);
+		const uint32_t mip_count = generate_mips ? get_mip_count(texture_data.m_width, texture_data.m_height) : static_cast<uint32_t>(texture_data.m_mips.size());
 
-		// copy data to buffer (GPU side)
-		void *data;
-		vmaMapMemory(m_vma_allocator, get_current_frame_data().m_camera_allocated_buffer.m_allocation_data, &data);
-		memcpy(data, &camera_data, sizeof(CameraData));
-		vmaUnmapMemory(m_vma_allocator, get_current_frame_data().m_camera_allocated_buffer.m_allocation_data);
+		// image (device local). Transfer source : GPU mips are blitted from the previous level, and defragmentation copies the image when its allocation moves.
+		vk::ImageCreateInfo image_create_info = create_texture_image_info(format, texture_data.m_width, texture_data.m_height, mip_count);
 
-		// for environment data
-		float frame_num = m_frame_number / 120.0f;
-		m_environment_data.m_ambient_color = {sin(frame_num), 0, cos(frame_num), 1};
+		VmaAllocationCreateInfo image_allocation_create_info = {};
+		image_allocation_create_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
 
-		char *environment_data;
-		vmaMapMemory(m_vma_allocator, m_environment_parameter_buffer.m_allocation_data, (void**)&environment_data);
+		VkImage image;
+		AllocatedImage allocated_image;
+		VkImageCreateInfo vk_image_create_info = static_cast<VkImageCreateInfo>(image_create_info);
+		VK_CHECK(vmaCreateImage(m_vma_allocator, &vk_image_create_info, &image_allocation_create_info, &image, &allocated_image.m_allocation_data, nullptr));
 
-		int frame_index = m_frame_number % MAX_FRAMES_IN_FLIGHT;
+		allocated_image.m_image = image;
 
-		environment_data += pad_uniform_buffer(sizeof(EnvironmentData)) * frame_index;
-		memcpy(environment_data, &m_environment_data, sizeof(EnvironmentData));
+		// staging buffer : the mips are copied as they are (from the mapped cache file for cooked textures)
+		vk::BufferCreateInfo staging_buffer_create_info = {};
+		staging_buffer_create_info.size = texture_data.get_data_size();
+		staging_buffer_create_info.usage = vk::BufferUsageFlagBits::eTransferSrc;
 
-		vmaUnmapMemory(m_vma_allocator, m_environment_parameter_buffer.m_allocation_data);
+		VmaAllocationCreateInfo staging_allocation_create_info = {};
+		staging_allocation_create_info.usage = VMA_MEMORY_USAGE_CPU_ONLY;
 
-		// write into shader storage buffer
-		void *object_data;
-		vmaMapMemory(m_vma_allocator, get_current_frame_data().m_objects_buffer.m_allocation_data, &object_data);
+		VkBuffer staging_buffer;
+		VmaAllocation staging_allocation;
+		VkBufferCreateInfo vk_staging_buffer_create_info = static_cast<VkBufferCreateInfo>(staging_buffer_create_info);
+		VK_CHECK(vmaCreateBuffer(m_vma_allocator, &vk_staging_buffer_create_info, &staging_allocation_create_info, &staging_buffer, &staging_allocation, nullptr));
 
-		ObjectData *ssbo = (ObjectData*)object_data;
+		void *staging_data;
+		vmaMapMemory(m_vma_allocator, staging_allocation, &staging_data);
+		memcpy(staging_data, texture_data.get_data(), texture_data.get_data_size());
+		vmaUnmapMemory(m_vma_allocator, staging_allocation);
 
-		for (int i = 0; i < m_game_objects.size(); i++)
+		std::vector<vk::BufferImageCopy> copy_regions;
+		for (uint32_t mip = 0; mip < (generate_mips ? 1 : mip_count); mip++)
 		{
-			GameObject& object = m_game_objects[i];
-			math::M4 transform = math::rotate_x((float)SDL_GetTicks());
-			ssbo[i].model_mat = transform * object.m_mesh_transform;
-		}
+			const TextureMip& texture_mip = texture_data.m_mips[mip];
 
-		vmaUnmapMemory(m_vma_allocator, get_current_frame_data().m_objects_buffer.m_allocation_data);
+			vk::BufferImageCopy copy_region = {};
+			copy_region.bufferOffset = texture_mip.m_offset;
+			copy_region.imageSubresource = vk::ImageSubresourceLayers{vk::ImageAspectFlagBits::eColor, mip, 0, 1};
+			copy_region.imageExtent = vk::Extent3D{texture_mip.m_width, texture_mip.m_height, 1};
+
+			copy_regions.push_back(copy_region);
+		}
 
-		for (int i = 0; i < m_game_objects.size(); i++)
+		immediate_submit([&](vk::CommandBuffer command_buffer)
 		{
-			const auto& game_object = m_game_objects[i];
+			vk::ImageMemoryBarrier barrier = {};
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = allocated_image.m_image;
 
-			if (game_object.m_material != last_material)
+			// every level : undefined -> transfer destination
+			barrier.oldLayout = vk::ImageLayout::eUndefined;
+			barrier.newLayout = vk::ImageLayout::eTransferDstOptimal;
+			barrier.subresourceRange = vk::ImageSubresourceRange{vk::ImageAspectFlagBits::eColor, 0, mip_count, 0, 1};
+			barrier.srcAccessMask = {};
+			barrier.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
+
+			command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer, {}, nullptr, nullptr, barrier);
+
+			command_buffer.copyBufferToImage(staging_buffer, allocated_image.m_image, vk::ImageLayout::eTransferDstOptimal, copy_regions);
+
+			// each level is blitted from the previous one, which is then done and moves to shader read
+			uint32_t level_width = texture_data.m_width;
+			uint32_t level_height = texture_data.m_height;
+
+			for (uint32_t level = 1; level < (generate_mips ? mip_count : 1); level++)
+			{
+				barrier.subresourceRange = vk::ImageSubresourceRange{vk::ImageAspectFlagBits::eColor, level - 1, 1, 0, 1};
+				barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+				barrier.newLayout = vk::ImageLayout::eTransferSrcOptimal;
+				barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+				barrier.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+
+				command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer, {}, nullptr, nullptr, barrier);
+
+				const uint32_t next_width = std::max(1u, level_width / 2);
+				const uint32_t next_height = std::max(1u, level_height / 2);
+
+				vk::ImageBlit blit = {};
+				blit.srcSubresource = vk::ImageSubresourceLayers{vk::ImageAspectFlagBits::eColor, level - 1, 0, 1};
+				blit.srcOffsets[1] = vk::Offset3D{static_cast<int32_t>(level_width), static_cast<int32_t>(level_height), 1};
+				blit.dstSubresource = vk::ImageSubresourceLayers{vk::ImageAspectFlagBits::eColor, level, 0, 1};
+				blit.dstOffsets[1] = vk::Offset3D{static_cast<int32_t>(next_width), static_cast<int32_t>(next_height), 1};
+
+				command_buffer.blitImage(allocated_image.m_image, vk::ImageLayout::eTransferSrcOptimal, allocated_image.m_image, vk::ImageLayout::eTransferDstOptimal, blit, vk::Filter::eLinear);
+
+				barrier.oldLayout = vk::ImageLayout::eTransferSrcOptimal;
+				barrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+				barrier.srcAccessMask = vk::AccessFlagBits::eTransferRead;
+				barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+
+				command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader, {}, nullptr, nullptr, barrier);
+
+				level_width = next_width;
+				level_height = next_height;
+			}
+
+			// remaining levels (all of them without GPU mips, the last one otherwise) : transfer destination -> shader read
+			const uint32_t first_remaining_level = generate_mips ? mip_count - 1 : 0;
+
+			barrier.subresourceRange = vk::ImageSubresourceRange{vk::ImageAspectFlagBits::eColor, first_remaining_level, mip_count - first_remaining_level, 0, 1};
+			barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+			barrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+			barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+			barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+
+			command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader, {}, nullptr, nullptr, barrier);
+		});
+
+		// immediate_submit waited for the copy
+		vmaDestroyBuffer(m_vma_allocator, staging_buffer, staging_allocation);
+
+		vk::ImageViewCreateInfo view_create_info = init::create_image_view_info(format, allocated_image.m_image, vk::ImageAspectFlagBits::eColor);
+		view_create_info.subresourceRange.levelCount = mip_count;
+
+		Texture texture;
+		texture.m_view = m_device.createImageView(view_create_info);
+		texture.m_image = m_images.insert(std::move(allocated_image));
+		texture.m_format = format;
+		texture.m_width = texture_data.m_width;
+		texture.m_height = texture_data.m_height;
+		texture.m_mip_count = mip_count;
+
+		if (m_bindless_enabled)
+		{
+			texture.m_bindless_index = register_bindless_texture(texture);
+		}
+
+		TextureHandle texture_handle = m_textures.insert(std::move(texture));
+		m_texture_names[make_string_id(texture_name)] = texture_handle;
+
+		return texture_handle;
+	}
+
+	void Engine::unload_texture(TextureHandle texture_handle)
+	{
+		// the texture's image may be part of the running defragmentation
+		finish_defragmentation();
+
+		std::optional<Texture> texture = m_textures.remove(texture_handle);
+		if (!texture.has_value())
+		{
+			return;
+		}
+
+		destroy_deferred(texture->m_view);
+
+		if (texture->m_bindless_index != BINDLESS_INVALID_INDEX)
+		{
+			release_bindless_texture(texture->m_bindless_index);
+		}
+
+		std::optional<AllocatedImage> image = m_images.remove(texture->m_image);
+		if (image.has_value())
+		{
+			destroy_deferred(*image);
+		}
+
+		std::erase_if(m_texture_names, [&](const auto& entry) { return entry.second == texture_handle; });
+	}
+
+	vk::Sampler Engine::get_sampler(const SamplerSettings& settings)
+	{
+		auto it = m_samplers.find(settings);
+		if (it != m_samplers.end())
+		{
+			return it->second;
+		}
+
+		vk::SamplerCreateInfo sampler_create_info = init::create_sampler_info(settings.m_filter, settings.m_address_mode);
+
+		const float max_anisotropy = std::min(settings.m_max_anisotropy, m_max_sampler_anisotropy);
+		if (m_sampler_anisotropy_enabled && max_anisotropy > 1.0f)
+		{
+			sampler_create_info.anisotropyEnable = true;
+			sampler_create_info.maxAnisotropy = max_anisotropy;
+		}
+
+		vk::Sampler sampler = m_device.createSampler(sampler_create_info);
+		m_deletion_queue.push(sampler);
+
+		m_samplers.emplace(settings, sampler);
+		return sampler;
+	}
+
+	void Engine::immediate_submit(std::function<void(vk::CommandBuffer command_buffer)>&& record_commands)
+	{
+		vk::CommandBufferBeginInfo command_buffer_begin_info = {};
+		command_buffer_begin_info.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+
+		m_upload_command_buffer.begin(command_buffer_begin_info);
+		record_commands(m_upload_command_buffer);
+		m_upload_command_buffer.end();
+
+		vk::SubmitInfo submit_info = {};
+		submit_info.commandBufferCount = 1;
+		submit_info.pCommandBuffers = &m_upload_command_buffer;
+
+		m_graphics_queue.submit(submit_info, m_upload_fence);
+
+		VK_CHECK(m_device.waitForFences(m_upload_fence, true, ONE_SECOND * 10));
+		m_device.resetFences(m_upload_fence);
+
+		m_device.resetCommandPool(m_upload_command_pool);
+	}
+
+	void Engine::init_scene()
+	{
+		Entity monkey = m_scene.create_entity();
+		m_scene.add(monkey, Transform{m_transform_hierarchy.create_node(LocalTransform{})});
+		m_scene.add(monkey, RenderMesh{get_mesh("monkey_mesh"_sid)});
+		m_scene.add(monkey, RenderMaterial{get_material(m_material_names.contains("monkey_material"_sid) ? "monkey_material"_sid : "default_material"_sid)});
+		m_scene.add(monkey, Bounds{});
+		m_scene.add(monkey, Velocity{math::V3{0.0f, 0.0f, 0.0f}, math::V3{1.0f, 0.0f, 0.0f}});
+
+		// the triangle is a child of the monkey, so it follows the monkey's rotation
+		LocalTransform triangle_local_transform{};
+		triangle_local_transform.m_translation = {0.0f, 1.0f, -1.3f};
+
+		Entity triangle = m_scene.create_entity();
+		m_scene.add(triangle, Transform{m_transform_hierarchy.create_node(triangle_local_transform, m_scene.get<Transform>(monkey)->m_node)});
+		m_scene.add(triangle, RenderMesh{get_mesh("triangle_mesh"_sid)});
+		m_scene.add(triangle, RenderMaterial{get_material("triangle_material"_sid)});
+		m_scene.add(triangle, Bounds{});
+
+		// lights are children of a spinning pivot, so all of them move every frame. One in four is a spot light with a random orientation.
+		if (m_config.m_scene_light_count > 0)
+		{
+			Entity light_pivot = m_scene.create_entity();
+			m_scene.add(light_pivot, Transform{m_transform_hierarchy.create_node(LocalTransform{})});
+			m_scene.add(light_pivot, Velocity{math::V3{0.0f, 0.0f, 0.0f}, math::V3{0.0f, 0.02f, 0.0f}});
+
+			std::mt19937 random_engine{1337};
+			std::uniform_real_distribution<float> position_distribution{-20.0f, 20.0f};
+			std::uniform_real_distribution<float> unit_distribution{0.0f, 1.0f};
+
+			for (uint32_t i = 0; i < m_config.m_scene_light_count; i++)
+			{
+				LocalTransform light_local_transform{};
+				light_local_transform.m_translation = {position_distribution(random_engine), position_distribution(random_engine) * 0.25f, position_distribution(random_engine)};
+				light_local_transform.m_rotation = {unit_distribution(random_engine) * 360.0f, unit_distribution(random_engine) * 360.0f, 0.0f};
+
+				Light light{};
+				light.m_type = i % 4 == 3 ? LightType::Spot : LightType::Point;
+				light.m_color = {unit_distribution(random_engine), unit_distribution(random_engine), unit_distribution(random_engine)};
+				light.m_intensity = 4.0f;
+				light.m_range = 2.0f + unit_distribution(random_engine) * 4.0f;
+
+				Entity light_entity = m_scene.create_entity();
+				m_scene.add(light_entity, Transform{m_transform_hierarchy.create_node(light_local_transform, m_scene.get<Transform>(light_pivot)->m_node)});
+				m_scene.add(light_entity, light);
+			}
+		}
+	}
+
+	void Engine::update_scene(float delta_time)
+	{
+		// RenderMesh components added / patched since the last update also need their world bounds recomputed
+		const uint32_t render_mesh_since_version = m_render_mesh_version;
+		m_render_mesh_version = m_scene.get_version();
+
+		m_scene.advance_version();
+
+		// integrate velocities into local transforms (sequential, since marking transforms dirty is not thread safe)
+		m_scene.each<Velocity, Transform>([&](Entity entity, const Velocity& velocity, const Transform& transform)
+		{
+			LocalTransform local_transform = m_transform_hierarchy.get_local(transform.m_node);
+
+			for (int i = 0; i < 3; i++)
+			{
+				local_transform.m_translation[i] += velocity.m_linear[i] * delta_time;
+				local_transform.m_rotation[i] = fmodf(local_transform.m_rotation[i] + velocity.m_angular[i] * delta_time, 360.0f);
+			}
+
+			m_transform_hierarchy.set_local(transform.m_node, local_transform);
+			m_scene.patch<Transform>(entity);
+		});
+
+		// only dirty subtrees are recomputed, and each frame's objects buffer only receives the slots that changed
+		SlotRange changed_range = m_transform_hierarchy.update();
+
+		for (FrameData& frame_data : m_frames)
+		{
+			frame_data.m_dirty_object_range.merge(changed_range);
+		}
+
+		// world bounds only have to be recomputed for entities whose world matrix or mesh changed
+		ComponentPool<Bounds>& bounds_pool = m_scene.get_pool<Bounds>();
+
+		ComponentPool<RenderMesh>& render_mesh_pool = m_scene.get_pool<RenderMesh>();
+		const std::vector<uint32_t>& render_mesh_versions = render_mesh_pool.get_versions();
+
+		const bool render_mesh_changed = std::any_of(render_mesh_versions.begin(), render_mesh_versions.end(), [&](uint32_t version) { return version > render_mesh_since_version; });
+		const bool bounds_dirty = !changed_range.is_empty() || render_mesh_changed;
+
+		if (bounds_dirty)
+		{
+			const std::vector<math::M4>& world_matrices = m_transform_hierarchy.get_world_matrices();
+			m_bounds_changed.assign(bounds_pool.size(), 0);
+
+			m_scene.parallel_each<Bounds, Transform, RenderMesh>(m_job_system, [&](Entity entity, Bounds& bounds, const Transform& transform, const RenderMesh& render_mesh)
+			{
+				const uint32_t slot = m_transform_hierarchy.get_slot(transform.m_node);
+
+				const bool transform_changed = slot >= changed_range.m_begin && slot < changed_range.m_end;
+				const bool mesh_changed = render_mesh_versions[render_mesh_pool.get_dense_index(entity)] > render_mesh_since_version;
+
+				if (!transform_changed && !mesh_changed)
+				{
+					return;
+				}
+
+				const Mesh *mesh = m_meshes.get(render_mesh.m_mesh);
+				if (mesh == nullptr)
+				{
+					return;
+				}
+
+				bounds.m_world_sphere = transform_sphere(mesh->m_bounding_sphere, world_matrices[slot]);
+				bounds.m_world_aabb = transform_aabb(mesh->m_aabb, world_matrices[slot]);
+
+				m_bounds_changed[bounds_pool.get_dense_index(entity)] = 1;
+			});
+		}
+
+		// BVH items are Bounds dense indices : rebuild when components were added / removed, refit the moved ones otherwise.
+		if (bounds_pool.get_layout_version() != m_bvh_layout_version)
+		{
+			rebuild_bvh();
+		}
+		else if (bounds_dirty)
+		{
+			const std::vector<Bounds>& bounds = bounds_pool.get_components();
+			for (uint32_t i = 0; i < static_cast<uint32_t>(bounds.size()); i++)
+			{
+				if (m_bounds_changed[i] != 0)
+				{
+					m_bvh.update(i, bounds[i].m_world_aabb, bounds[i].m_world_sphere);
+				}
+			}
+		}
+	}
+
+	void Engine::rebuild_bvh()
+	{
+		ComponentPool<Bounds>& bounds_pool = m_scene.get_pool<Bounds>();
+		const std::vector<Bounds>& bounds = bounds_pool.get_components();
+
+		std::vector<AABB> aabbs(bounds.size());
+		std::vector<math::V4> spheres(bounds.size());
+
+		for (size_t i = 0; i < bounds.size(); i++)
+		{
+			aabbs[i] = bounds[i].m_world_aabb;
+			spheres[i] = bounds[i].m_world_sphere;
+		}
+
+		m_bvh.build(aabbs, spheres);
+		m_bvh_layout_version = bounds_pool.get_layout_version();
+	}
+
+	std::optional<Entity> Engine::pick_entity(int32_t mouse_x, int32_t mouse_y)
+	{
+		// ray through the pixel, built from the camera basis (window y goes down, camera up goes up)
+		const float aspect_ratio = static_cast<float>(m_window_extent.width) / m_window_extent.height;
+		const float tan_half_fov = tanf(radians(CAMERA_FIELD_OF_VIEW) * 0.5f);
+
+		const float ndc_x = (2.0f * (mouse_x + 0.5f) / m_window_extent.width - 1.0f) * tan_half_fov * aspect_ratio;
+		const float ndc_y = (1.0f - 2.0f * (mouse_y + 0.5f) / m_window_extent.height) * tan_half_fov;
+
+		Ray ray{};
+		ray.m_origin = m_camera.m_position;
+
+		float length_squared = 0.0f;
+		for (int i = 0; i < 3; i++)
+		{
+			ray.m_direction[i] = m_camera.m_front[i] + m_camera.m_right[i] * ndc_x + m_camera.m_up[i] * ndc_y;
+			length_squared += ray.m_direction[i] * ray.m_direction[i];
+		}
+
+		for (int i = 0; i < 3; i++)
+		{
+			ray.m_direction[i] /= sqrtf(length_squared);
+		}
+
+		std::optional<RayHit> hit = m_bvh.raycast(ray, CAMERA_FAR_PLANE);
+		if (!hit.has_value())
+		{
+			return std::nullopt;
+		}
+
+		return m_scene.get_pool<Bounds>().get_entities()[hit->m_item];
+	}
+
+	MaterialHandle Engine::create_material(std::string_view material_name, vk::Pipeline pipeline, vk::PipelineLayout pipeline_layout)
+	{
+		Material material;
+		material.m_pipeline = pipeline;
+		material.m_pipeline_layout = pipeline_layout;
+
+		MaterialHandle material_handle = m_materials.insert(std::move(material));
+		m_material_names[make_string_id(material_name)] = material_handle;
+
+		return material_handle;
+	}
+
+	MaterialHandle Engine::create_textured_material(std::string_view material_name, TextureHandle texture_handle, const SamplerSettings& sampler_settings)
+	{
+		const Texture *texture = m_textures.get(texture_handle);
+		if (texture == nullptr)
+		{
+			throw std::runtime_error("Failed to create textured material (texture not loaded) : " + std::string(material_name));
+		}
+
+		if (m_bindless_enabled)
+		{
+			MaterialData material_data{};
+			material_data.m_diffuse_texture_index = texture->m_bindless_index;
+			material_data.m_sampler_index = get_bindless_sampler_index(sampler_settings);
+
+			return create_bindless_material(material_name, material_data);
+		}
+
+		vk::DescriptorSet texture_set = m_descriptor_allocator.allocate(m_texture_descriptor_set_layout);
+
+		vk::DescriptorImageInfo image_info{};
+		image_info.sampler = get_sampler(sampler_settings);
+		image_info.imageView = texture->m_view;
+		image_info.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+
+		vk::WriteDescriptorSet texture_write = init::write_descriptor_image(vk::DescriptorType::eCombinedImageSampler, texture_set, &image_info, 0);
+		m_device.updateDescriptorSets(1, &texture_write, 0, nullptr);
+
+		MaterialHandle material_handle = create_material(material_name, m_textured_mesh_pipeline, m_textured_mesh_layout);
+
+		Material *material = m_materials.get(material_handle);
+		material->m_texture_set = texture_set;
+		material->m_diffuse_texture = texture_handle;
+		material->m_texture_sampler = image_info.sampler;
+
+		return material_handle;
+	}
+
+	MaterialHandle Engine::create_bindless_material(std::string_view material_name, const MaterialData& material_data)
+	{
+		if (m_material_count >= MAX_MATERIALS)
+		{
+			throw std::runtime_error("Failed to create bindless material (material buffer is full) : " + std::string(material_name));
+		}
+
+		const uint32_t material_index = m_material_count++;
+
+		// frames in flight only read entries of existing materials, so the new entry can be written right away
+		void *material_buffer_data;
+		vmaMapMemory(m_vma_allocator, m_material_buffer.m_allocation_data, &material_buffer_data);
+		memcpy(static_cast<MaterialData*>(material_buffer_data) + material_index, &material_data, sizeof(MaterialData));
+		vmaUnmapMemory(m_vma_allocator, m_material_buffer.m_allocation_data);
+
+		MaterialHandle material_handle = create_material(material_name, m_bindless_mesh_pipeline, m_bindless_mesh_layout);
+		m_materials.get(material_handle)->m_material_index = material_index;
+
+		return material_handle;
+	}
+
+	MaterialHandle Engine::get_material(StringId material_name)
+	{
+		auto it = m_material_names.find(material_name);
+		if (it != m_material_names.end())
+		{
+			return it->second;
+		}
+
+		throw std::runtime_error("Failed to find material with name : " + to_string(material_name));
+	}
+
+	MeshHandle Engine::get_mesh(StringId mesh_name)
+	{
+		auto it = m_mesh_names.find(mesh_name);
+		if (it != m_mesh_names.end())
+		{
+			return it->second;
+		}
+
+		throw std::runtime_error("Failed to find mesh with name : " + to_string(mesh_name));
+	}
+
+	TextureHandle Engine::get_texture(StringId texture_name)
+	{
+		auto it = m_texture_names.find(texture_name);
+		if (it != m_texture_names.end())
+		{
+			return it->second;
+		}
+
+		throw std::runtime_error("Failed to find texture with name : " + to_string(texture_name));
+	}
+
+	void Engine::prepare_draws()
+	{
+		math::M4 view_mat = m_camera.get_look_at();
+		
+		math::M4 projection_mat = math::perpective(radians(CAMERA_FIELD_OF_VIEW), static_cast<float>(m_window_extent.width) / m_window_extent.height, CAMERA_NEAR_PLANE, CAMERA_FAR_PLANE);
+
+		// Camera data struct : that will pass data to shader's via descriptor sets.
+		m_camera_data.m_projection_mat = projection_mat;
+		m_camera_data.m_view_mat = view_mat;
+
+		// transposing here because glsl expects column major order while the custom math lib uses row major order.
+		m_camera_data.m_projection_view_mat = transpose(projection_mat * view_mat);
+
+		// copy data to buffer (GPU side)
+		void *data;
+		vmaMapMemory(m_vma_allocator, get_current_frame_data().m_camera_allocated_buffer.m_allocation_data, &data);
+		memcpy(data, &m_camera_data, sizeof(CameraData));
+		vmaUnmapMemory(m_vma_allocator, get_current_frame_data().m_camera_allocated_buffer.m_allocation_data);
+
+		// for environment data
+		float frame_num = m_frame_number / 120.0f;
+		m_environment_data.m_ambient_color = {sin(frame_num), 0, cos(frame_num), 1};
+
+		// fixed sun (direction points from the sun towards the scene)
+		m_environment_data.m_sunlight_direction = {-0.3f, -1.0f, -0.4f, 0.0f};
+		m_environment_data.m_sunlight_color = {1.0f, 1.0f, 1.0f, 1.0f};
+
+		// distance fog, applied by the post composite pass (fog amount = ((view depth - x) / (y - x)) ^ w, clamped to [0, 1])
+		m_environment_data.m_fog_color = {0.55f, 0.6f, 0.7f, 1.5f};
+		m_environment_data.m_fog_distance = {20.0f, CAMERA_FAR_PLANE, 0.0f, 0.0f};
+
+		// depth slices are exponential : slice k starts at near * (far / near) ^ (k / slice count)
+		const float depth_slice_scale = LIGHT_CLUSTER_COUNT_Z / std::log(CAMERA_FAR_PLANE / CAMERA_NEAR_PLANE);
+
+		m_environment_data.m_light_cluster_params =
+		{
+			static_cast<float>(LIGHT_CLUSTER_COUNT_X) / m_render_extent.width,
+			static_cast<float>(LIGHT_CLUSTER_COUNT_Y) / m_render_extent.height,
+			depth_slice_scale,
+			-std::log(CAMERA_NEAR_PLANE) * depth_slice_scale
+		};
+
+		char *environment_data;
+		vmaMapMemory(m_vma_allocator, m_environment_parameter_buffer.m_allocation_data, (void**)&environment_data);
+
+		int frame_index = m_frame_number % MAX_FRAMES_IN_FLIGHT;
+
+		environment_data += pad_uniform_buffer(sizeof(EnvironmentData)) * frame_index;
+		memcpy(environment_data, &m_environment_data, sizeof(EnvironmentData));
+
+		vmaUnmapMemory(m_vma_allocator, m_environment_parameter_buffer.m_allocation_data);
+
+		// write into shader storage buffer
+		void *object_data;
+		vmaMapMemory(m_vma_allocator, get_current_frame_data().m_objects_buffer.m_allocation_data, &object_data);
+
+		ObjectData *ssbo = (ObjectData*)object_data;
+
+		// ObjectData index of an entity == slot of its transform node. Only the range that changed since this frame's buffer was last written is copied.
+		SlotRange& dirty_object_range = get_current_frame_data().m_dirty_object_range;
+		const uint32_t upload_end = std::min<uint32_t>(dirty_object_range.m_end, MAX_OBJECTS);
+
+		const std::vector<math::M4>& world_matrices = m_transform_hierarchy.get_world_matrices();
+
+		if (dirty_object_range.m_begin < upload_end)
+		{
+			m_job_system.parallel_for(upload_end - dirty_object_range.m_begin, 4096, [&](size_t begin, size_t end)
+			{
+				for (size_t i = dirty_object_range.m_begin + begin; i < dirty_object_range.m_begin + end; i++)
+				{
+					ssbo[i].model_mat = math::transpose(world_matrices[i]);
+				}
+			});
+		}
+
+		dirty_object_range = SlotRange{};
+
+		vmaUnmapMemory(m_vma_allocator, get_current_frame_data().m_objects_buffer.m_allocation_data);
+
+		// frustum cull through the BVH (fully visible subtrees are accepted without testing their objects), sorted back into dense order so draws stay grouped as before.
+		// note : only entities with a Bounds component can be drawn.
+		m_frustum = extract_frustum(projection_mat * view_mat);
+
+		// a LOD's object space error is projected to pixels as error / distance * lod_projection_scale
+		const float lod_projection_scale = static_cast<float>(m_render_extent.height) * 0.5f / std::tan(radians(CAMERA_FIELD_OF_VIEW) * 0.5f);
+
+		// lights outside of the frustum cannot reach a visible pixel (their sphere is the range around the light)
+		{
+			LightData *lights;
+			vmaMapMemory(m_vma_allocator, get_current_frame_data().m_light_buffer.m_allocation_data, (void**)&lights);
+
+			const std::vector<math::M4>& light_world_matrices = m_transform_hierarchy.get_world_matrices();
+			m_light_count = 0;
+
+			m_scene.each<Light, Transform>([&](Entity, const Light& light, const Transform& transform)
+			{
+				const math::M4& world_mat = light_world_matrices[m_transform_hierarchy.get_slot(transform.m_node)];
+				const math::V3 position = transform_point(world_mat, math::V3{0.0f, 0.0f, 0.0f});
+
+				if (m_light_count == MAX_LIGHTS || !is_sphere_visible(m_frustum, math::V4{position.x, position.y, position.z, light.m_range}))
+				{
+					return;
+				}
+
+				LightData& light_data = lights[m_light_count++];
+				light_data.m_position_range = math::V4{position.x, position.y, position.z, light.m_range};
+				light_data.m_color = math::V4{light.m_color.x * light.m_intensity, light.m_color.y * light.m_intensity, light.m_color.z * light.m_intensity, 0.0f};
+				light_data.m_type = light.m_type;
+
+				// local +z axis of the world matrix
+				const math::V3 direction = math::V3{world_mat.data_rc[0][2], world_mat.data_rc[1][2], world_mat.data_rc[2][2]}.normalize();
+				light_data.m_direction = math::V4{direction.x, direction.y, direction.z, 0.0f};
+
+				light_data.m_spot_cos_inner = std::cos(radians(light.m_spot_inner_angle));
+				light_data.m_spot_cos_outer = std::cos(radians(light.m_spot_outer_angle));
+			});
+
+			vmaUnmapMemory(m_vma_allocator, get_current_frame_data().m_light_buffer.m_allocation_data);
+		}
+
+		m_visible_bounds.clear();
+		m_bvh.cull(m_frustum, m_visible_bounds);
+		std::sort(m_visible_bounds.begin(), m_visible_bounds.end());
+
+		m_draw_list.clear();
+		build_draw_list(m_visible_bounds, lod_projection_scale, m_draw_list);
+
+		update_shadow_cascades(projection_mat * view_mat, lod_projection_scale);
+
+		// bindless : the material of each visible object is looked up by the vertex shader through its object index
+		if (m_bindless_enabled)
+		{
+			void *object_material_data;
+			vmaMapMemory(m_vma_allocator, get_current_frame_data().m_object_material_buffer.m_allocation_data, &object_material_data);
+
+			uint32_t *object_material_indices = (uint32_t*)object_material_data;
+
+			for (const DrawRecord& draw_record : m_draw_list)
+			{
+				object_material_indices[draw_record.m_object_index] = m_materials.get(draw_record.m_material)->m_material_index;
+			}
+
+			vmaUnmapMemory(m_vma_allocator, get_current_frame_data().m_object_material_buffer.m_allocation_data);
+		}
+
+		// the occlusion cull shader gets one input per draw (object indices are unique, so the list never exceeds MAX_OBJECTS)
+		if (m_occlusion_culling_enabled)
+		{
+			void *cull_input_data;
+			vmaMapMemory(m_vma_allocator, get_current_frame_data().m_cull_input_buffer.m_allocation_data, &cull_input_data);
+
+			CullInput *cull_inputs = (CullInput*)cull_input_data;
+
+			for (size_t i = 0; i < m_draw_list.size(); i++)
+			{
+				cull_inputs[i].m_world_sphere = m_draw_list[i].m_world_sphere;
+				cull_inputs[i].m_object_index = m_draw_list[i].m_object_index;
+				cull_inputs[i].m_first_index = m_draw_list[i].m_first_index;
+				cull_inputs[i].m_index_count = m_draw_list[i].m_index_count;
+			}
+
+			vmaUnmapMemory(m_vma_allocator, get_current_frame_data().m_cull_input_buffer.m_allocation_data);
+		}
+
+		// the cluster cull shader gets one input per draw as well (one workgroup each)
+		if (m_cluster_culling_enabled)
+		{
+			void *cull_input_data;
+			vmaMapMemory(m_vma_allocator, get_current_frame_data().m_cluster_cull_input_buffer.m_allocation_data, &cull_input_data);
+
+			ClusterCullInput *cull_inputs = (ClusterCullInput*)cull_input_data;
+
+			for (size_t i = 0; i < m_draw_list.size(); i++)
+			{
+				cull_inputs[i].m_object_index = m_draw_list[i].m_object_index;
+				cull_inputs[i].m_first_meshlet = m_draw_list[i].m_first_meshlet;
+				cull_inputs[i].m_meshlet_count = m_draw_list[i].m_meshlet_count;
+			}
+
+			vmaUnmapMemory(m_vma_allocator, get_current_frame_data().m_cluster_cull_input_buffer.m_allocation_data);
+		}
+	}
+
+	void Engine::build_draw_list(const std::vector<uint32_t>& visible_bounds, float lod_projection_scale, std::vector<DrawRecord>& draw_list)
+	{
+		ComponentPool<Bounds>& bounds_pool = m_scene.get_pool<Bounds>();
+
+		for (uint32_t bounds_index : visible_bounds)
+		{
+			const Entity entity = bounds_pool.get_entities()[bounds_index];
+
+			const RenderMesh *render_mesh = m_scene.get<RenderMesh>(entity);
+			const RenderMaterial *render_material = m_scene.get<RenderMaterial>(entity);
+			const Transform *transform = m_scene.get<Transform>(entity);
+
+			if (render_mesh == nullptr || render_material == nullptr || transform == nullptr)
+			{
+				continue;
+			}
+
+			const uint32_t object_index = m_transform_hierarchy.get_slot(transform->m_node);
+			if (object_index >= MAX_OBJECTS)
+			{
+				continue;
+			}
+
+			// handles resolve to nullptr if the mesh / material has been unloaded.
+			const Mesh *mesh = m_meshes.get(render_mesh->m_mesh);
+			if (mesh == nullptr || m_materials.get(render_material->m_material) == nullptr)
+			{
+				continue;
+			}
+
+			DrawRecord draw_record{};
+			draw_record.m_material = render_material->m_material;
+			draw_record.m_mesh = render_mesh->m_mesh;
+			draw_record.m_object_index = object_index;
+			draw_record.m_world_sphere = bounds_pool.get_components()[bounds_index].m_world_sphere;
+
+			const MeshLod& lod = select_lod(*mesh, draw_record.m_world_sphere, m_camera.m_position, lod_projection_scale, m_config.m_lod_error_threshold);
+			draw_record.m_first_index = lod.m_first_index;
+			draw_record.m_index_count = lod.m_index_count;
+			draw_record.m_first_meshlet = mesh->m_first_gpu_meshlet + lod.m_first_meshlet;
+			draw_record.m_meshlet_count = lod.m_meshlet_count;
+
+			draw_list.push_back(draw_record);
+		}
+	}
+
+	void Engine::draw_objects(vk::CommandBuffer command_buffer, vk::Buffer indirect_buffer, vk::DeviceSize indirect_offset)
+	{
+		MeshHandle last_mesh_handle{};
+		MaterialHandle last_material_handle{};
+		Material *last_material = nullptr;
+		vk::Pipeline last_pipeline{};
+		vk::PipelineLayout last_pipeline_layout{};
+
+		int frame_index = m_frame_number % MAX_FRAMES_IN_FLIGHT;
+
+		for (size_t i = 0; i < m_draw_list.size(); i++)
+		{
+			const DrawRecord& draw_record = m_draw_list[i];
+
+			Material *material = m_materials.get(draw_record.m_material);
+			Mesh *mesh = m_meshes.get(draw_record.m_mesh);
+
+			// bindless materials share pipeline, layout and sets, so switching between them binds nothing
+			if (draw_record.m_material != last_material_handle)
+			{
+				if (material->m_pipeline != last_pipeline)
+				{
+					command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, material->m_pipeline);
+					last_pipeline = material->m_pipeline;
+				}
+
+				if (material->m_pipeline_layout != last_pipeline_layout)
+				{
+					// offset for environment buffer (set in render loop now, since its dynamic)
+					uint32_t environment_buffer_offset = pad_uniform_buffer(sizeof(EnvironmentData)) * frame_index;
+
+					command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, material->m_pipeline_layout, 0, 1, &get_current_frame_data().m_global_descriptor_set, 1, &environment_buffer_offset);
+
+					// bind object descriptor
+					command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, material->m_pipeline_layout, 1, 1, &get_current_frame_data().m_object_descriptor_set, 0, nullptr);
+
+					if (material->m_pipeline_layout == m_bindless_mesh_layout)
+					{
+						command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, material->m_pipeline_layout, 2, 1, &m_bindless_descriptor_set, 0, nullptr);
+					}
+
+					last_pipeline_layout = material->m_pipeline_layout;
+				}
+
+				if (material->m_texture_set)
+				{
+					command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, material->m_pipeline_layout, 2, 1, &material->m_texture_set, 0, nullptr);
+				}
+
+				last_material_handle = draw_record.m_material;
+				last_material = material;
+			}
+
+			math::M4 model_mat = math::rotate_y((float)m_frame_number) * math::rotate_x(((float)m_frame_number));
+		
+			MeshPushConstants push_constants{};
+			push_constants.m_transform_mat = model_mat;
+			command_buffer.pushConstants(last_material->m_pipeline_layout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(MeshPushConstants), &push_constants);
+
+			if (draw_record.m_mesh != last_mesh_handle)
+			{
+				// binding 0 : positions, binding 1 : normal + color
+				vk::Buffer vertex_buffers[] = {m_buffers.get(mesh->m_position_buffer)->m_buffer, m_buffers.get(mesh->m_attribute_buffer)->m_buffer};
+				vk::DeviceSize offsets[] = {0, 0};
+				command_buffer.bindVertexBuffers(0, 2, vertex_buffers, offsets);
+				command_buffer.bindIndexBuffer(get_index_buffer(*mesh), 0, vk::IndexType::eUint32);
+
+				last_mesh_handle = draw_record.m_mesh;
+			}
+
+			if (!indirect_buffer)
+			{
+				command_buffer.drawIndexed(draw_record.m_index_count, 1, draw_record.m_first_index, 0, draw_record.m_object_index);
+				continue;
+			}
+
+			// indirect : instance count is 0 or 1, decided by the occlusion cull shader. With multiDrawIndirect, a run of draws sharing the mesh and the bound state is one call
+			// (any bindless materials, since each draw reads its material through its object index).
+			uint32_t draw_count = 1;
+			if (m_multi_draw_indirect_enabled)
+			{
+				while (i + draw_count < m_draw_list.size() && m_draw_list[i + draw_count].m_mesh == draw_record.m_mesh)
+				{
+					const DrawRecord& next_draw_record = m_draw_list[i + draw_count];
+					if (next_draw_record.m_material != draw_record.m_material)
+					{
+						const Material *next_material = m_materials.get(next_draw_record.m_material);
+						if (next_material->m_pipeline != material->m_pipeline || next_material->m_texture_set != material->m_texture_set)
+						{
+							break;
+						}
+					}
+
+					draw_count++;
+				}
+			}
+
+			command_buffer.drawIndexedIndirect(indirect_buffer, indirect_offset + sizeof(vk::DrawIndexedIndirectCommand) * i, draw_count, sizeof(vk::DrawIndexedIndirectCommand));
+			i += draw_count - 1;
+		}
+	}
+
+	vk::Buffer Engine::get_index_buffer(const Mesh& mesh)
+	{
+		// with cluster culling, every draw indexes the frame's generated index buffer (indices are still relative to the mesh's own vertices)
+		if (m_cluster_culling_enabled)
+		{
+			return get_current_frame_data().m_cluster_index_buffer.m_buffer;
+		}
+
+		return m_buffers.get(mesh.m_index_buffer)->m_buffer;
+	}
+
+	void Engine::draw_depth_prepass(vk::CommandBuffer command_buffer, vk::Buffer indirect_buffer, vk::DeviceSize indirect_offset)
+	{
+		MeshHandle last_mesh_handle{};
+
+		int frame_index = m_frame_number % MAX_FRAMES_IN_FLIGHT;
+
+		// one pipeline for every material, so state is only bound once
+		command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_depth_prepass_pipeline);
+
+		uint32_t environment_buffer_offset = pad_uniform_buffer(sizeof(EnvironmentData)) * frame_index;
+		command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_depth_prepass_pipeline_layout, 0, 1, &get_current_frame_data().m_global_descriptor_set, 1, &environment_buffer_offset);
+		command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_depth_prepass_pipeline_layout, 1, 1, &get_current_frame_data().m_object_descriptor_set, 0, nullptr);
+
+		for (size_t i = 0; i < m_draw_list.size(); i++)
+		{
+			const DrawRecord& draw_record = m_draw_list[i];
+
+			if (draw_record.m_mesh != last_mesh_handle)
+			{
+				Mesh *mesh = m_meshes.get(draw_record.m_mesh);
+				const AllocatedBuffer *position_buffer = m_buffers.get(mesh->m_position_buffer);
+
+				vk::DeviceSize offset{0};
+				command_buffer.bindVertexBuffers(0, position_buffer->m_buffer, offset);
+				command_buffer.bindIndexBuffer(get_index_buffer(*mesh), 0, vk::IndexType::eUint32);
+
+				last_mesh_handle = draw_record.m_mesh;
+			}
+
+			if (!indirect_buffer)
+			{
+				command_buffer.drawIndexed(draw_record.m_index_count, 1, draw_record.m_first_index, 0, draw_record.m_object_index);
+				continue;
+			}
+
+			// material does not matter here, so runs only need to share the mesh
+			uint32_t draw_count = 1;
+			if (m_multi_draw_indirect_enabled)
+			{
+				while (i + draw_count < m_draw_list.size() && m_draw_list[i + draw_count].m_mesh == draw_record.m_mesh)
+				{
+					draw_count++;
+				}
+			}
+
+			command_buffer.drawIndexedIndirect(indirect_buffer, indirect_offset + sizeof(vk::DrawIndexedIndirectCommand) * i, draw_count, sizeof(vk::DrawIndexedIndirectCommand));
+			i += draw_count - 1;
+		}
+	}
+
+	void Engine::record_scene_pass(vk::CommandBuffer command_buffer, bool late_phase)
+	{
+		vk::ClearColorValue clear_color;
+		clear_color.setFloat32({0.0f, 0.0f, (float)abs(sin(SDL_GetTicks() / 360.0f))});
+
+		vk::ClearDepthStencilValue depth_clear;
+		depth_clear.setDepth(1.0f);
+
+		vk::ClearValue clear_values[2] = {clear_color, depth_clear};
+
+		// begin renderpass (the late phase loads what the early phase drew)
+		vk::RenderPassBeginInfo render_pass_begin_info = {};
+		render_pass_begin_info.renderPass = late_phase ? m_load_render_pass : m_render_pass;
+		render_pass_begin_info.renderArea.extent = m_render_extent;
+		render_pass_begin_info.renderArea.offset = vk::Offset2D{0, 0};
+		render_pass_begin_info.clearValueCount = late_phase ? 0 : 2;
+		render_pass_begin_info.pClearValues = late_phase ? nullptr : clear_values;
+		render_pass_begin_info.framebuffer = m_framebuffer;
+
+		command_buffer.beginRenderPass(render_pass_begin_info, vk::SubpassContents::eInline);
+
+		// the scene covers the top left m_render_extent of the targets (dynamic resolution)
+		const vk::Viewport viewport{0.0f, 0.0f, static_cast<float>(m_render_extent.width), static_cast<float>(m_render_extent.height), 0.0f, 1.0f};
+		command_buffer.setViewport(0, viewport);
+		command_buffer.setScissor(0, vk::Rect2D{vk::Offset2D{0, 0}, m_render_extent});
+
+		if (late_phase)
+		{
+			draw_scene(command_buffer, get_current_frame_data().m_draw_command_buffer.m_buffer, sizeof(vk::DrawIndexedIndirectCommand) * MAX_OBJECTS);
+		}
+		else if (m_occlusion_culling_enabled || m_cluster_culling_enabled)
+		{
+			draw_scene(command_buffer, get_current_frame_data().m_draw_command_buffer.m_buffer, 0);
+		}
+		else
+		{
+			draw_scene(command_buffer);
+		}
+
+		command_buffer.endRenderPass();
+	}
+
+	void Engine::draw_scene(vk::CommandBuffer command_buffer, vk::Buffer indirect_buffer, vk::DeviceSize indirect_offset)
+	{
+		if (m_config.m_depth_prepass)
+		{
+			draw_depth_prepass(command_buffer, indirect_buffer, indirect_offset);
+			command_buffer.nextSubpass(vk::SubpassContents::eInline);
+		}
+
+		draw_objects(command_buffer, indirect_buffer, indirect_offset);
+	}
+
+	void Engine::init_occlusion_culling()
+	{
+		if (!m_occlusion_culling_enabled)
+		{
+			return;
+		}
+
+		// render pass of the late phase : compatible with m_render_pass (so the framebuffers and pipelines are shared), but color and depth are loaded.
+		m_load_render_pass = create_scene_render_pass(true);
+		m_deletion_queue.push(m_load_render_pass);
+
+		// depth pyramid : level 0 is the depth buffer size rounded down to a power of two, so every following level is exactly half the size of the previous one.
+		auto previous_power_of_two = [](uint32_t value)
+		{
+			uint32_t result = 1;
+			while (result * 2 <= value)
+			{
+				result *= 2;
+			}
+
+			return result;
+		};
+
+		m_depth_pyramid_extent = vk::Extent2D{previous_power_of_two(m_window_extent.width), previous_power_of_two(m_window_extent.height)};
+
+		m_depth_pyramid_mip_count = 1;
+		while ((std::max(m_depth_pyramid_extent.width, m_depth_pyramid_extent.height) >> m_depth_pyramid_mip_count) > 0)
+		{
+			m_depth_pyramid_mip_count++;
+		}
+
+		{
+			vk::ImageCreateInfo image_create_info = init::create_image_info(vk::Format::eR32Sfloat, vk::Extent3D{m_depth_pyramid_extent.width, m_depth_pyramid_extent.height, 1}, vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled);
+			image_create_info.mipLevels = m_depth_pyramid_mip_count;
+
+			VmaAllocationCreateInfo image_allocation_create_info = {};
+			image_allocation_create_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+			VkImage image;
+			VkImageCreateInfo vk_image_create_info = static_cast<VkImageCreateInfo>(image_create_info);
+			VK_CHECK(vmaCreateImage(m_vma_allocator, &vk_image_create_info, &image_allocation_create_info, &image, &m_depth_pyramid_allocation.m_allocation_data, nullptr));
+
+			m_depth_pyramid_allocation.m_image = image;
+			m_deletion_queue.push(m_depth_pyramid_allocation);
+
+			m_render_graph.set_image(m_depth_pyramid_graph_image, m_depth_pyramid_allocation.m_image);
+
+			vk::ImageViewCreateInfo view_create_info = init::create_image_view_info(vk::Format::eR32Sfloat, m_depth_pyramid_allocation.m_image, vk::ImageAspectFlagBits::eColor);
+			view_create_info.subresourceRange.levelCount = m_depth_pyramid_mip_count;
+
+			m_depth_pyramid_view = m_device.createImageView(view_create_info);
+			m_deletion_queue.push(m_depth_pyramid_view);
+
+			// one view per level : levels are written as storage images and read as the input of the next level
+			for (uint32_t level = 0; level < m_depth_pyramid_mip_count; level++)
+			{
+				view_create_info.subresourceRange.baseMipLevel = level;
+				view_create_info.subresourceRange.levelCount = 1;
+
+				m_depth_pyramid_mip_views.push_back(m_device.createImageView(view_create_info));
+				m_deletion_queue.push(m_depth_pyramid_mip_views.back());
+			}
+
+			// only texelFetch is used, so filtering does not matter
+			vk::SamplerCreateInfo sampler_create_info = {};
+			sampler_create_info.magFilter = vk::Filter::eNearest;
+			sampler_create_info.minFilter = vk::Filter::eNearest;
+			sampler_create_info.mipmapMode = vk::SamplerMipmapMode::eNearest;
+			sampler_create_info.addressModeU = vk::SamplerAddressMode::eClampToEdge;
+			sampler_create_info.addressModeV = vk::SamplerAddressMode::eClampToEdge;
+			sampler_create_info.addressModeW = vk::SamplerAddressMode::eClampToEdge;
+			sampler_create_info.maxLod = static_cast<float>(m_depth_pyramid_mip_count);
+
+			m_depth_pyramid_sampler = m_device.createSampler(sampler_create_info);
+			m_deletion_queue.push(m_depth_pyramid_sampler);
+		}
+
+		// buffers : visibility is shared by all frames, cull inputs and draw commands (early phase commands, then late phase commands) are per frame.
+		m_object_visibility_buffer = create_buffer(sizeof(uint32_t) * MAX_OBJECTS, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, VMA_MEMORY_USAGE_GPU_ONLY);
+
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		{
+			m_frames[i].m_cull_input_buffer = create_buffer(sizeof(CullInput) * MAX_OBJECTS, vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_CPU_TO_GPU);
+			m_frames[i].m_draw_command_buffer = create_buffer(sizeof(vk::DrawIndexedIndirectCommand) * MAX_OBJECTS * 2, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer, VMA_MEMORY_USAGE_GPU_ONLY);
+		}
+
+		// descriptors
+		{
+			vk::DescriptorSetLayoutBinding bindings[] =
+			{
+				init::create_descriptor_set_layout_binding(vk::DescriptorType::eCombinedImageSampler, vk::ShaderStageFlagBits::eCompute, 0),
+				init::create_descriptor_set_layout_binding(vk::DescriptorType::eStorageImage, vk::ShaderStageFlagBits::eCompute, 1)
+			};
+
+			vk::DescriptorSetLayoutCreateInfo layout_create_info{};
+			layout_create_info.bindingCount = 2;
+			layout_create_info.pBindings = bindings;
+
+			m_depth_reduce_descriptor_set_layout = m_descriptor_layout_cache.create_descriptor_set_layout(layout_create_info);
+		}
+
+		{
+			vk::DescriptorSetLayoutBinding bindings[] =
+			{
+				init::create_descriptor_set_layout_binding(vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute, 0),
+				init::create_descriptor_set_layout_binding(vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute, 1),
+				init::create_descriptor_set_layout_binding(vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute, 2),
+				init::create_descriptor_set_layout_binding(vk::DescriptorType::eCombinedImageSampler, vk::ShaderStageFlagBits::eCompute, 3)
+			};
+
+			vk::DescriptorSetLayoutCreateInfo layout_create_info{};
+			layout_create_info.bindingCount = 4;
+			layout_create_info.pBindings = bindings;
+
+			m_occlusion_cull_descriptor_set_layout = m_descriptor_layout_cache.create_descriptor_set_layout(layout_create_info);
+		}
+
+		// one reduce set per pyramid level : input is the (resolved) depth buffer for level 0, the previous level otherwise.
+		for (uint32_t level = 0; level < m_depth_pyramid_mip_count; level++)
+		{
+			m_depth_reduce_descriptor_sets.push_back(m_descriptor_allocator.allocate(m_depth_reduce_descriptor_set_layout));
+
+			vk::DescriptorImageInfo input_image_info{};
+			input_image_info.sampler = m_depth_pyramid_sampler;
+			input_image_info.imageView = level == 0 ? m_sampled_depth_view : m_depth_pyramid_mip_views[level - 1];
+			input_image_info.imageLayout = level == 0 ? vk::ImageLayout::eShaderReadOnlyOptimal : vk::ImageLayout::eGeneral;
+
+			vk::DescriptorImageInfo output_image_info{};
+			output_image_info.imageView = m_depth_pyramid_mip_views[level];
+			output_image_info.imageLayout = vk::ImageLayout::eGeneral;
+
+			vk::WriteDescriptorSet writes[2] = {};
+			writes[0].dstSet = m_depth_reduce_descriptor_sets.back();
+			writes[0].dstBinding = 0;
+			writes[0].descriptorCount = 1;
+			writes[0].descriptorType = vk::DescriptorType::eCombinedImageSampler;
+			writes[0].pImageInfo = &input_image_info;
+
+			writes[1].dstSet = m_depth_reduce_descriptor_sets.back();
+			writes[1].dstBinding = 1;
+			writes[1].descriptorCount = 1;
+			writes[1].descriptorType = vk::DescriptorType::eStorageImage;
+			writes[1].pImageInfo = &output_image_info;
+
+			m_device.updateDescriptorSets(2, writes, 0, nullptr);
+		}
+
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		{
+			m_frames[i].m_occlusion_cull_descriptor_set = m_descriptor_allocator.allocate(m_occlusion_cull_descriptor_set_layout);
+
+			vk::DescriptorBufferInfo cull_input_buffer_info{m_frames[i].m_cull_input_buffer.m_buffer, 0, sizeof(CullInput) * MAX_OBJECTS};
+			vk::DescriptorBufferInfo draw_command_buffer_info{m_frames[i].m_draw_command_buffer.m_buffer, 0, sizeof(vk::DrawIndexedIndirectCommand) * MAX_OBJECTS * 2};
+			vk::DescriptorBufferInfo visibility_buffer_info{m_object_visibility_buffer.m_buffer, 0, sizeof(uint32_t) * MAX_OBJECTS};
+
+			vk::DescriptorImageInfo depth_pyramid_info{};
+			depth_pyramid_info.sampler = m_depth_pyramid_sampler;
+			depth_pyramid_info.imageView = m_depth_pyramid_view;
+			depth_pyramid_info.imageLayout = vk::ImageLayout::eGeneral;
+
+			vk::WriteDescriptorSet pyramid_write = {};
+			pyramid_write.dstSet = m_frames[i].m_occlusion_cull_descriptor_set;
+			pyramid_write.dstBinding = 3;
+			pyramid_write.descriptorCount = 1;
+			pyramid_write.descriptorType = vk::DescriptorType::eCombinedImageSampler;
+			pyramid_write.pImageInfo = &depth_pyramid_info;
+
+			vk::WriteDescriptorSet writes[] =
+			{
+				init::write_descriptor_buffer(vk::DescriptorType::eStorageBuffer, m_frames[i].m_occlusion_cull_descriptor_set, &cull_input_buffer_info, 0),
+				init::write_descriptor_buffer(vk::DescriptorType::eStorageBuffer, m_frames[i].m_occlusion_cull_descriptor_set, &draw_command_buffer_info, 1),
+				init::write_descriptor_buffer(vk::DescriptorType::eStorageBuffer, m_frames[i].m_occlusion_cull_descriptor_set, &visibility_buffer_info, 2),
+				pyramid_write
+			};
+
+			m_device.updateDescriptorSets(4, writes, 0, nullptr);
+		}
+
+		// pipelines
+		{
+			vk::ShaderModule depth_reduce_module;
+			load_shaders("../shaders/depth_reduce.comp.spv", depth_reduce_module);
+			m_deletion_queue.push(depth_reduce_module);
+
+			// size of the input level (see depth_reduce.comp)
+			vk::PushConstantRange push_constant_range = {};
+			push_constant_range.size = sizeof(uint32_t) * 2;
+			push_constant_range.offset = 0;
+			push_constant_range.stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+			vk::PipelineLayoutCreateInfo pipeline_layout_create_info = {};
+			pipeline_layout_create_info.setLayoutCount = 1;
+			pipeline_layout_create_info.pSetLayouts = &m_depth_reduce_descriptor_set_layout;
+			pipeline_layout_create_info.pushConstantRangeCount = 1;
+			pipeline_layout_create_info.pPushConstantRanges = &push_constant_range;
+
+			m_depth_reduce_pipeline_layout = m_device.createPipelineLayout(pipeline_layout_create_info);
+			m_deletion_queue.push(m_depth_reduce_pipeline_layout);
+
+			m_depth_reduce_pipeline = create_compute_pipeline(m_device, depth_reduce_module, m_depth_reduce_pipeline_layout);
+			m_deletion_queue.push(m_depth_reduce_pipeline);
+		}
+
+		{
+			vk::ShaderModule occlusion_cull_module;
+			load_shaders("../shaders/occlusion_cull.comp.spv", occlusion_cull_module);
+			m_deletion_queue.push(occlusion_cull_module);
+
+			vk::PushConstantRange push_constant_range = {};
+			push_constant_range.size = sizeof(OcclusionCullConstants);
+			push_constant_range.offset = 0;
+			push_constant_range.stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+			vk::PipelineLayoutCreateInfo pipeline_layout_create_info = {};
+			pipeline_layout_create_info.setLayoutCount = 1;
+			pipeline_layout_create_info.pSetLayouts = &m_occlusion_cull_descriptor_set_layout;
+			pipeline_layout_create_info.pushConstantRangeCount = 1;
+			pipeline_layout_create_info.pPushConstantRanges = &push_constant_range;
+
+			m_occlusion_cull_pipeline_layout = m_device.createPipelineLayout(pipeline_layout_create_info);
+			m_deletion_queue.push(m_occlusion_cull_pipeline_layout);
+
+			m_occlusion_cull_pipeline = create_compute_pipeline(m_device, occlusion_cull_module, m_occlusion_cull_pipeline_layout);
+			m_deletion_queue.push(m_occlusion_cull_pipeline);
+		}
+	}
+
+	void Engine::dispatch_occlusion_cull(vk::CommandBuffer command_buffer, bool late_phase)
+	{
+		// first use : visibility starts cleared (so everything is tested in the late phase). Other barriers of the cull passes come from the render graph.
+		if (!late_phase && !m_occlusion_resources_initialized)
+		{
+			command_buffer.fillBuffer(m_object_visibility_buffer.m_buffer, 0, VK_WHOLE_SIZE, 0);
+
+			vk::MemoryBarrier clear_barrier = {};
+			clear_barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+			clear_barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+
+			command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader, {}, clear_barrier, nullptr, nullptr);
+
+			m_occlusion_resources_initialized = true;
+		}
+
+		command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_occlusion_cull_pipeline);
+		command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_occlusion_cull_pipeline_layout, 0, 1, &get_current_frame_data().m_occlusion_cull_descriptor_set, 0, nullptr);
+
+		OcclusionCullConstants cull_constants{};
+		cull_constants.m_projection_view_mat = m_camera_data.m_projection_view_mat;
+		cull_constants.m_pyramid_width = static_cast<float>(m_depth_pyramid_extent.width);
+		cull_constants.m_pyramid_height = static_cast<float>(m_depth_pyramid_extent.height);
+		cull_constants.m_draw_count = static_cast<uint32_t>(m_draw_list.size());
+		cull_constants.m_late_phase = late_phase ? 1 : 0;
+		cull_constants.m_command_offset = late_phase ? MAX_OBJECTS : 0;
+
+		command_buffer.pushConstants(m_occlusion_cull_pipeline_layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(OcclusionCullConstants), &cull_constants);
+		command_buffer.dispatch((cull_constants.m_draw_count + 63) / 64, 1, 1);
+	}
+
+	void Engine::init_cluster_culling()
+	{
+		if (!m_cluster_culling_enabled)
+		{
+			return;
+		}
+
+		// buffers : meshlets are shared by all frames, cull inputs, draw commands, generated indices and their counter are per frame.
+		m_meshlet_buffer = create_buffer(sizeof(Meshlet) * MAX_MESHLETS, vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_CPU_TO_GPU);
+		m_meshlet_data_buffer = create_buffer(sizeof(uint32_t) * MAX_MESHLET_DATA, vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_CPU_TO_GPU);
+
+		m_meshlet_ranges.init(MAX_MESHLETS);
+		m_meshlet_data_ranges.init(MAX_MESHLET_DATA);
+
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		{
+			m_frames[i].m_cluster_cull_input_buffer = create_buffer(sizeof(ClusterCullInput) * MAX_OBJECTS, vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_CPU_TO_GPU);
+			m_frames[i].m_cluster_index_buffer = create_buffer(sizeof(uint32_t) * MAX_CLUSTER_INDICES, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndexBuffer, VMA_MEMORY_USAGE_GPU_ONLY);
+			m_frames[i].m_cluster_index_counter_buffer = create_buffer(sizeof(uint32_t), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, VMA_MEMORY_USAGE_GPU_ONLY);
+
+			// note : occlusion culling is disabled along with cluster culling, so the command buffer is never created twice
+			m_frames[i].m_draw_command_buffer = create_buffer(sizeof(vk::DrawIndexedIndirectCommand) * MAX_OBJECTS, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer, VMA_MEMORY_USAGE_GPU_ONLY);
+		}
+
+		// descriptors
+		constexpr uint32_t CLUSTER_CULL_BINDING_COUNT = 7;
+
+		{
+			vk::DescriptorSetLayoutBinding bindings[CLUSTER_CULL_BINDING_COUNT];
+			for (uint32_t binding = 0; binding < CLUSTER_CULL_BINDING_COUNT; binding++)
+			{
+				bindings[binding] = init::create_descriptor_set_layout_binding(vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute, binding);
+			}
+
+			vk::DescriptorSetLayoutCreateInfo layout_create_info{};
+			layout_create_info.bindingCount = CLUSTER_CULL_BINDING_COUNT;
+			layout_create_info.pBindings = bindings;
+
+			m_cluster_cull_descriptor_set_layout = m_descriptor_layout_cache.create_descriptor_set_layout(layout_create_info);
+		}
+
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		{
+			m_frames[i].m_cluster_cull_descriptor_set = m_descriptor_allocator.allocate(m_cluster_cull_descriptor_set_layout);
+
+			vk::DescriptorBufferInfo buffer_infos[CLUSTER_CULL_BINDING_COUNT] =
+			{
+				{m_frames[i].m_cluster_cull_input_buffer.m_buffer, 0, sizeof(ClusterCullInput) * MAX_OBJECTS},
+				{m_meshlet_buffer.m_buffer, 0, sizeof(Meshlet) * MAX_MESHLETS},
+				{m_meshlet_data_buffer.m_buffer, 0, sizeof(uint32_t) * MAX_MESHLET_DATA},
+				{m_frames[i].m_objects_buffer.m_buffer, 0, sizeof(ObjectData) * MAX_OBJECTS},
+				{m_frames[i].m_cluster_index_buffer.m_buffer, 0, sizeof(uint32_t) * MAX_CLUSTER_INDICES},
+				{m_frames[i].m_draw_command_buffer.m_buffer, 0, sizeof(vk::DrawIndexedIndirectCommand) * MAX_OBJECTS},
+				{m_frames[i].m_cluster_index_counter_buffer.m_buffer, 0, sizeof(uint32_t)}
+			};
+
+			vk::WriteDescriptorSet writes[CLUSTER_CULL_BINDING_COUNT];
+			for (uint32_t binding = 0; binding < CLUSTER_CULL_BINDING_COUNT; binding++)
+			{
+				writes[binding] = init::write_descriptor_buffer(vk::DescriptorType::eStorageBuffer, m_frames[i].m_cluster_cull_descriptor_set, &buffer_infos[binding], binding);
+			}
+
+			m_device.updateDescriptorSets(CLUSTER_CULL_BINDING_COUNT, writes, 0, nullptr);
+		}
+
+		// pipeline
+		vk::ShaderModule cluster_cull_module;
+		load_shaders("../shaders/cluster_cull.comp.spv", cluster_cull_module);
+		m_deletion_queue.push(cluster_cull_module);
+
+		vk::PushConstantRange push_constant_range = {};
+		push_constant_range.size = sizeof(ClusterCullConstants);
+		push_constant_range.offset = 0;
+		push_constant_range.stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+		vk::PipelineLayoutCreateInfo pipeline_layout_create_info = {};
+		pipeline_layout_create_info.setLayoutCount = 1;
+		pipeline_layout_create_info.pSetLayouts = &m_cluster_cull_descriptor_set_layout;
+		pipeline_layout_create_info.pushConstantRangeCount = 1;
+		pipeline_layout_create_info.pPushConstantRanges = &push_constant_range;
+
+		m_cluster_cull_pipeline_layout = m_device.createPipelineLayout(pipeline_layout_create_info);
+		m_deletion_queue.push(m_cluster_cull_pipeline_layout);
+
+		m_cluster_cull_pipeline = create_compute_pipeline(m_device, cluster_cull_module, m_cluster_cull_pipeline_layout);
+		m_deletion_queue.push(m_cluster_cull_pipeline);
+	}
+
+	void Engine::upload_meshlets(Mesh& mesh)
+	{
+		// ranges released by meshes that no frame in flight can still cull become free again
+		const uint64_t completed_submission_value = get_completed_submission_value();
+
+		m_meshlet_ranges.reclaim(completed_submission_value);
+		m_meshlet_data_ranges.reclaim(completed_submission_value);
+
+		const uint32_t meshlet_count = static_cast<uint32_t>(mesh.m_meshlets.size());
+		const uint32_t meshlet_data_size = static_cast<uint32_t>(mesh.m_meshlet_data.size());
+
+		std::optional<uint32_t> first_meshlet = m_meshlet_ranges.allocate(meshlet_count);
+		std::optional<uint32_t> first_meshlet_data = m_meshlet_data_ranges.allocate(meshlet_data_size);
+
+		if (!first_meshlet.has_value() || !first_meshlet_data.has_value())
+		{
+			// note : the ranges are not used by any frame yet, so they can be freed right away
+			if (first_meshlet.has_value())
+			{
+				m_meshlet_ranges.release(*first_meshlet, meshlet_count, 0);
+			}
+
+			if (first_meshlet_data.has_value())
+			{
+				m_meshlet_data_ranges.release(*first_meshlet_data, meshlet_data_size, 0);
+			}
+
+			throw std::runtime_error("Meshlet buffers are full");
+		}
+
+		mesh.m_first_gpu_meshlet = *first_meshlet;
+		mesh.m_gpu_meshlet_count = meshlet_count;
+		mesh.m_first_gpu_meshlet_data = *first_meshlet_data;
+		mesh.m_gpu_meshlet_data_size = meshlet_data_size;
+
+		// meshlet offsets index the mesh's own data, which lands at the start of its data range
+		Meshlet *meshlets;
+		vmaMapMemory(m_vma_allocator, m_meshlet_buffer.m_allocation_data, (void**)&meshlets);
+
+		for (size_t i = 0; i < mesh.m_meshlets.size(); i++)
+		{
+			Meshlet meshlet = mesh.m_meshlets[i];
+			meshlet.m_vertex_offset += mesh.m_first_gpu_meshlet_data;
+			meshlet.m_triangle_offset += mesh.m_first_gpu_meshlet_data;
+
+			meshlets[mesh.m_first_gpu_meshlet + i] = meshlet;
+		}
+
+		vmaUnmapMemory(m_vma_allocator, m_meshlet_buffer.m_allocation_data);
+
+		uint32_t *meshlet_data;
+		vmaMapMemory(m_vma_allocator, m_meshlet_data_buffer.m_allocation_data, (void**)&meshlet_data);
+		memcpy(meshlet_data + mesh.m_first_gpu_meshlet_data, mesh.m_meshlet_data.data(), mesh.m_meshlet_data.size() * sizeof(uint32_t));
+		vmaUnmapMemory(m_vma_allocator, m_meshlet_data_buffer.m_allocation_data);
+	}
+
+	void Engine::release_meshlets(const Mesh& mesh)
+	{
+		// frames in flight may still cull the mesh's meshlets, so the ranges are only reused once they are done
+		const uint64_t retire_value = get_pending_submission_value();
+
+		m_meshlet_ranges.release(mesh.m_first_gpu_meshlet, mesh.m_gpu_meshlet_count, retire_value);
+		m_meshlet_data_ranges.release(mesh.m_first_gpu_meshlet_data, mesh.m_gpu_meshlet_data_size, retire_value);
+	}
+
+	void Engine::dispatch_cluster_cull(vk::CommandBuffer command_buffer)
+	{
+		FrameData& frame_data = get_current_frame_data();
+
+		// the counter is cleared every frame (it is private to this pass, so it is not tracked by the render graph)
+		command_buffer.fillBuffer(frame_data.m_cluster_index_counter_buffer.m_buffer, 0, sizeof(uint32_t), 0);
+
+		vk::MemoryBarrier clear_barrier = {};
+		clear_barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+		clear_barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+
+		command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader, {}, clear_barrier, nullptr, nullptr);
+
+		command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_cluster_cull_pipeline);
+		command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_cluster_cull_pipeline_layout, 0, 1, &frame_data.m_cluster_cull_descriptor_set, 0, nullptr);
+
+		ClusterCullConstants cull_constants{};
+		std::copy(std::begin(m_frustum.m_planes), std::end(m_frustum.m_planes), std::begin(cull_constants.m_frustum_planes));
+		cull_constants.m_camera_position = math::V4{m_camera.m_position.x, m_camera.m_position.y, m_camera.m_position.z, 1.0f};
+		cull_constants.m_draw_count = static_cast<uint32_t>(m_draw_list.size());
+		cull_constants.m_index_capacity = MAX_CLUSTER_INDICES;
+
+		command_buffer.pushConstants(m_cluster_cull_pipeline_layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(ClusterCullConstants), &cull_constants);
+
+		// one workgroup per draw, spread over y past the dispatch limit of one dimension
+		constexpr uint32_t MAX_GROUP_COUNT_X = 65535;
+
+		const uint32_t group_count_x = std::min(cull_constants.m_draw_count, MAX_GROUP_COUNT_X);
+		const uint32_t group_count_y = (cull_constants.m_draw_count + MAX_GROUP_COUNT_X - 1) / MAX_GROUP_COUNT_X;
+
+		if (group_count_x > 0)
+		{
+			command_buffer.dispatch(group_count_x, group_count_y, 1);
+		}
+	}
+
+	void Engine::init_light_culling()
+	{
+		// lights of the frame, light counts and light indices of the clusters
+		{
+			vk::DescriptorSetLayoutBinding bindings[] =
+			{
+				init::create_descriptor_set_layout_binding(vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute, 0),
+				init::create_descriptor_set_layout_binding(vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute, 1),
+				init::create_descriptor_set_layout_binding(vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute, 2)
+			};
+
+			vk::DescriptorSetLayoutCreateInfo layout_create_info{};
+			layout_create_info.bindingCount = 3;
+			layout_create_info.pBindings = bindings;
+
+			m_light_cull_descriptor_set_layout = m_descriptor_layout_cache.create_descriptor_set_layout(layout_create_info);
+		}
+
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		{
+			m_frames[i].m_light_cull_descriptor_set = m_descriptor_allocator.allocate(m_light_cull_descriptor_set_layout);
+
+			vk::DescriptorBufferInfo light_buffer_info{m_frames[i].m_light_buffer.m_buffer, 0, sizeof(LightData) * MAX_LIGHTS};
+			vk::DescriptorBufferInfo light_cluster_buffer_info{m_light_cluster_buffer.m_buffer, 0, sizeof(uint32_t) * LIGHT_CLUSTER_COUNT};
+			vk::DescriptorBufferInfo light_index_buffer_info{m_light_index_buffer.m_buffer, 0, sizeof(uint32_t) * LIGHT_CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER};
+
+			vk::WriteDescriptorSet writes[] =
+			{
+				init::write_descriptor_buffer(vk::DescriptorType::eStorageBuffer, m_frames[i].m_light_cull_descriptor_set, &light_buffer_info, 0),
+				init::write_descriptor_buffer(vk::DescriptorType::eStorageBuffer, m_frames[i].m_light_cull_descriptor_set, &light_cluster_buffer_info, 1),
+				init::write_descriptor_buffer(vk::DescriptorType::eStorageBuffer, m_frames[i].m_light_cull_descriptor_set, &light_index_buffer_info, 2)
+			};
+
+			m_device.updateDescriptorSets(3, writes, 0, nullptr);
+		}
+
+		// pipeline
+		vk::ShaderModule light_cull_module;
+		load_shaders("../shaders/light_cull.comp.spv", light_cull_module);
+		m_deletion_queue.push(light_cull_module);
+
+		vk::PushConstantRange push_constant_range = {};
+		push_constant_range.size = sizeof(LightCullConstants);
+		push_constant_range.offset = 0;
+		push_constant_range.stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+		vk::PipelineLayoutCreateInfo pipeline_layout_create_info = {};
+		pipeline_layout_create_info.setLayoutCount = 1;
+		pipeline_layout_create_info.pSetLayouts = &m_light_cull_descriptor_set_layout;
+		pipeline_layout_create_info.pushConstantRangeCount = 1;
+		pipeline_layout_create_info.pPushConstantRanges = &push_constant_range;
+
+		m_light_cull_pipeline_layout = m_device.createPipelineLayout(pipeline_layout_create_info);
+		m_deletion_queue.push(m_light_cull_pipeline_layout);
+
+		m_light_cull_pipeline = create_compute_pipeline(m_device, light_cull_module, m_light_cull_pipeline_layout);
+		m_deletion_queue.push(m_light_cull_pipeline);
+	}
+
+	void Engine::dispatch_light_cull(vk::CommandBuffer command_buffer)
+	{
+		command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_light_cull_pipeline);
+		command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_light_cull_pipeline_layout, 0, 1, &get_current_frame_data().m_light_cull_descriptor_set, 0, nullptr);
+
+		LightCullConstants cull_constants{};
+		cull_constants.m_view_mat = math::transpose(m_camera_data.m_view_mat);
+		cull_constants.m_projection_scale_x = m_camera_data.m_projection_mat.data_rc[0][0];
+		cull_constants.m_projection_scale_y = m_camera_data.m_projection_mat.data_rc[1][1];
+		cull_constants.m_near_plane = CAMERA_NEAR_PLANE;
+		cull_constants.m_far_plane = CAMERA_FAR_PLANE;
+		cull_constants.m_light_count = m_light_count;
+
+		command_buffer.pushConstants(m_light_cull_pipeline_layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(LightCullConstants), &cull_constants);
+
+		// one invocation per cluster (every cluster is written, even without lights)
+		command_buffer.dispatch((LIGHT_CLUSTER_COUNT + 127) / 128, 1, 1);
+	}
+
+	void Engine::init_shadows()
+	{
+		const vk::Extent2D shadow_map_extent{m_shadow_map_resolution, m_shadow_map_resolution};
+
+		// depth only render pass, cleared per cascade. The render graph moves the shadow map to attachment layout before the pass, and to a sampled layout after it.
+		{
+			vk::AttachmentDescription depth_attachment_desc = {};
+			depth_attachment_desc.format = m_depth_image_format;
+			depth_attachment_desc.samples = vk::SampleCountFlagBits::e1;
+			depth_attachment_desc.loadOp = vk::AttachmentLoadOp::eClear;
+			depth_attachment_desc.storeOp = vk::AttachmentStoreOp::eStore;
+			depth_attachment_desc.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
+			depth_attachment_desc.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
+			depth_attachment_desc.initialLayout = vk::ImageLayout::eUndefined;
+			depth_attachment_desc.finalLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
+
+			vk::AttachmentReference depth_attachment_ref = {};
+			depth_attachment_ref.attachment = 0;
+			depth_attachment_ref.layout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
+
+			vk::SubpassDescription subpass_desc = {};
+			subpass_desc.pipelineBindPoint = vk::PipelineBindPoint::eGraphics;
+			subpass_desc.colorAttachmentCount = 0;
+			subpass_desc.pDepthStencilAttachment = &depth_attachment_ref;
+
+			vk::RenderPassCreateInfo render_pass_create_info = {};
+			render_pass_create_info.attachmentCount = 1;
+			render_pass_create_info.pAttachments = &depth_attachment_desc;
+			render_pass_create_info.subpassCount = 1;
+			render_pass_create_info.pSubpasses = &subpass_desc;
+
+			m_shadow_render_pass = m_device.createRenderPass(render_pass_create_info);
+			m_deletion_queue.push(m_shadow_render_pass);
+		}
+
+		// one view (and framebuffer) per cascade layer
+		const vk::Image shadow_map = m_render_graph.get_image(m_shadow_map_graph_image);
+
+		for (uint32_t cascade = 0; cascade < m_shadow_cascade_count; cascade++)
+		{
+			vk::ImageViewCreateInfo view_create_info = init::create_image_view_info(m_depth_image_format, shadow_map, vk::ImageAspectFlagBits::eDepth);
+			view_create_info.subresourceRange.baseArrayLayer = cascade;
+			view_create_info.subresourceRange.layerCount = 1;
+
+			m_shadow_cascade_views.push_back(m_device.createImageView(view_create_info));
+			m_deletion_queue.push(m_shadow_cascade_views.back());
+
+			vk::FramebufferCreateInfo framebuffer_create_info = {};
+			framebuffer_create_info.renderPass = m_shadow_render_pass;
+			framebuffer_create_info.attachmentCount = 1;
+			framebuffer_create_info.pAttachments = &m_shadow_cascade_views.back();
+			framebuffer_create_info.width = m_shadow_map_resolution;
+			framebuffer_create_info.height = m_shadow_map_resolution;
+			framebuffer_create_info.layers = 1;
+
+			m_shadow_framebuffers.push_back(m_device.createFramebuffer(framebuffer_create_info));
+			m_deletion_queue.push(m_shadow_framebuffers.back());
+		}
+
+		// depth compare sampler : linear filtering makes every tap a 2x2 PCF. Outside of a cascade the white border is read, which compares as lit.
+		{
+			vk::SamplerCreateInfo sampler_create_info = {};
+			sampler_create_info.magFilter = vk::Filter::eLinear;
+			sampler_create_info.minFilter = vk::Filter::eLinear;
+			sampler_create_info.mipmapMode = vk::SamplerMipmapMode::eNearest;
+			sampler_create_info.addressModeU = vk::SamplerAddressMode::eClampToBorder;
+			sampler_create_info.addressModeV = vk::SamplerAddressMode::eClampToBorder;
+			sampler_create_info.addressModeW = vk::SamplerAddressMode::eClampToBorder;
+			sampler_create_info.borderColor = vk::BorderColor::eFloatOpaqueWhite;
+			sampler_create_info.compareEnable = true;
+			sampler_create_info.compareOp = vk::CompareOp::eLessOrEqual;
+
+			m_shadow_sampler = m_device.createSampler(sampler_create_info);
+			m_deletion_queue.push(m_shadow_sampler);
+		}
+
+		// shadow data and shadow map of the global set (bindings 5 - 6)
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		{
+			m_frames[i].m_shadow_buffer = create_buffer(sizeof(ShadowData), vk::BufferUsageFlagBits::eUniformBuffer, VMA_MEMORY_USAGE_CPU_TO_GPU);
+
+			vk::DescriptorBufferInfo shadow_buffer_info{m_frames[i].m_shadow_buffer.m_buffer, 0, sizeof(ShadowData)};
+			vk::DescriptorImageInfo shadow_map_info{m_shadow_sampler, m_render_graph.get_image_view(m_shadow_map_graph_image), vk::ImageLayout::eShaderReadOnlyOptimal};
+
+			vk::WriteDescriptorSet writes[] =
+			{
+				init::write_descriptor_buffer(vk::DescriptorType::eUniformBuffer, m_frames[i].m_global_descriptor_set, &shadow_buffer_info, 5),
+				init::write_descriptor_image(vk::DescriptorType::eCombinedImageSampler, m_frames[i].m_global_descriptor_set, &shadow_map_info, 6)
+			};
+
+			m_device.updateDescriptorSets(2, writes, 0, nullptr);
+		}
+
+		// depth only pipeline : position stream only, no fragment shader. Slope scaled depth bias keeps surfaces from shadowing themselves.
+		vk::ShaderModule shadow_vert_module;
+		load_shaders("../shaders/shadow.vert.spv", shadow_vert_module);
+		m_deletion_queue.push(shadow_vert_module);
+
+		PipelineBuilder pipeline_builder = {};
+		pipeline_builder.m_shader_stages.push_back(init::create_shader_stage(vk::ShaderStageFlagBits::eVertex, shadow_vert_module));
+
+		pipeline_builder.m_vertex_input_info = init::create_vertex_input_state();
+
+		VertexInputLayoutDescription vertex_input_layout_description = Vertex::get_position_input_layout_description(m_config.m_vertex_layout);
+
+		pipeline_builder.m_vertex_input_info.vertexBindingDescriptionCount = static_cast<uint32_t>(vertex_input_layout_description.m_bindings.size());
+		pipeline_builder.m_vertex_input_info.pVertexBindingDescriptions = vertex_input_layout_description.m_bindings.data();
+
+		pipeline_builder.m_vertex_input_info.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertex_input_layout_description.m_attributes.size());
+		pipeline_builder.m_vertex_input_info.pVertexAttributeDescriptions = vertex_input_layout_description.m_attributes.data();
+
+		pipeline_builder.m_input_assembler = init::create_input_assembler();
+
+		pipeline_builder.m_viewport.x = 0.0f;
+		pipeline_builder.m_viewport.y = 0.0f;
+		pipeline_builder.m_viewport.width = static_cast<float>(m_shadow_map_resolution);
+		pipeline_builder.m_viewport.height = static_cast<float>(m_shadow_map_resolution);
+		pipeline_builder.m_viewport.minDepth = 0.0f;
+		pipeline_builder.m_viewport.maxDepth = 1.0f;
+
+		pipeline_builder.m_scissor.offset = vk::Offset2D{0, 0};
+		pipeline_builder.m_scissor.extent = shadow_map_extent;
+
+		pipeline_builder.m_rasterizer_state_info = init::create_rasterizer_state();
+		pipeline_builder.m_rasterizer_state_info.depthBiasEnable = true;
+		pipeline_builder.m_rasterizer_state_info.depthBiasConstantFactor = 1.25f;
+		pipeline_builder.m_rasterizer_state_info.depthBiasSlopeFactor = 1.75f;
+
+		pipeline_builder.m_multisample_state_info = init::create_multisampling_info();
+		pipeline_builder.m_color_blend_state_attachment = init::create_color_blend_state();
+		pipeline_builder.m_color_attachment_count = 0;
+		pipeline_builder.m_depth_stencil_state_info = init::create_depth_stencil_state();
+
+		// the cascade's matrix is pushed per cascade
+		vk::PushConstantRange push_constant_range = {};
+		push_constant_range.size = sizeof(MeshPushConstants);
+		push_constant_range.offset = 0;
+		push_constant_range.stageFlags = vk::ShaderStageFlagBits::eVertex;
+
+		vk::DescriptorSetLayout set_layouts[] = {m_global_descriptor_set_layout, m_object_descriptor_set_layout};
+
+		vk::PipelineLayoutCreateInfo pipeline_layout_create_info = {};
+		pipeline_layout_create_info.setLayoutCount = 2;
+		pipeline_layout_create_info.pSetLayouts = set_layouts;
+		pipeline_layout_create_info.pushConstantRangeCount = 1;
+		pipeline_layout_create_info.pPushConstantRanges = &push_constant_range;
+
+		m_shadow_pipeline_layout = m_device.createPipelineLayout(pipeline_layout_create_info);
+		m_deletion_queue.push(m_shadow_pipeline_layout);
+
+		pipeline_builder.m_pipeline_layout = m_shadow_pipeline_layout;
+
+		m_shadow_pipeline = pipeline_builder.create_pipeline(m_device, m_shadow_render_pass, 0);
+		m_deletion_queue.push(m_shadow_pipeline);
+	}
+
+	void Engine::update_shadow_cascades(const math::M4& projection_view_mat, float lod_projection_scale)
+	{
+		// weight of the logarithmic split scheme against the uniform one, and how far behind a cascade (towards the sun) casters are still rendered
+		constexpr float CASCADE_SPLIT_LAMBDA = 0.75f;
+		constexpr float SHADOW_CASTER_DISTANCE = 50.0f;
+
+		// light basis (forward points from the sun towards the scene)
+		const math::V4& sun_direction = m_environment_data.m_sunlight_direction;
+		const float sun_direction_length = std::sqrt(sun_direction.x * sun_direction.x + sun_direction.y * sun_direction.y + sun_direction.z * sun_direction.z);
+
+		const math::V3 light_forward{sun_direction.x / sun_direction_length, sun_direction.y / sun_direction_length, sun_direction.z / sun_direction_length};
+		const math::V3 up_reference = std::abs(light_forward.y) > 0.99f ? math::V3{0.0f, 0.0f, 1.0f} : math::V3{0.0f, 1.0f, 0.0f};
+
+		const math::V3 right_direction = math::cross(up_reference, light_forward);
+		const float right_length = right_direction.length();
+
+		const math::V3 light_right{right_direction.x / right_length, right_direction.y / right_length, right_direction.z / right_length};
+		const math::V3 light_up = math::cross(light_forward, light_right);
+
+		// corners of a slice of the view frustum : where two side planes meet the plane of a view depth (clip w is the view depth, so that plane is row 3 of projection * view)
+		const Frustum frustum = extract_frustum(projection_view_mat);
+		const auto& m = projection_view_mat.data_rc;
+
+		const auto get_corner = [&](const math::V4& a, const math::V4& b, float view_depth)
+		{
+			const math::V3 normal_a{a.x, a.y, a.z};
+			const math::V3 normal_b{b.x, b.y, b.z};
+			const math::V3 normal_c{m[3][0], m[3][1], m[3][2]};
+			const float distance_c = m[3][3] - view_depth;
+
+			const math::V3 bc = math::cross(normal_b, normal_c);
+			const math::V3 ca = math::cross(normal_c, normal_a);
+			const math::V3 ab = math::cross(normal_a, normal_b);
+
+			const float scale = -1.0f / dot(normal_a, bc);
+
+			return math::V3
+			{
+				(bc.x * a.w + ca.x * b.w + ab.x * distance_c) * scale,
+				(bc.y * a.w + ca.y * b.w + ab.y * distance_c) * scale,
+				(bc.z * a.w + ca.z * b.w + ab.z * distance_c) * scale
+			};
+		};
+
+		ShadowData shadow_data{};
+		shadow_data.m_params = math::V4{static_cast<float>(m_shadow_cascade_count), 1.0f / m_shadow_map_resolution, 0.0f, 0.0f};
+
+		float split_near = CAMERA_NEAR_PLANE;
+
+		for (uint32_t cascade = 0; cascade < m_shadow_cascade_count; cascade++)
+		{
+			// practical split scheme : logarithmic splits (constant texel density in depth) blended with uniform ones, so close cascades do not get too thin
+			const float split_ratio = static_cast<float>(cascade + 1) / m_shadow_cascade_count;
+			const float logarithmic_split = CAMERA_NEAR_PLANE * std::pow(CAMERA_FAR_PLANE / CAMERA_NEAR_PLANE, split_ratio);
+			const float uniform_split = CAMERA_NEAR_PLANE + (CAMERA_FAR_PLANE - CAMERA_NEAR_PLANE) * split_ratio;
+			const float split_far = CASCADE_SPLIT_LAMBDA * logarithmic_split + (1.0f - CASCADE_SPLIT_LAMBDA) * uniform_split;
+
+			math::V3 corners[8];
+			for (int i = 0; i < 4; i++)
+			{
+				corners[i] = get_corner(frustum.m_planes[i / 2], frustum.m_planes[2 + i % 2], split_near);
+				corners[i + 4] = get_corner(frustum.m_planes[i / 2], frustum.m_planes[2 + i % 2], split_far);
+			}
+
+			// fitted with a bounding sphere rather than a box : its size does not change as the camera turns, so neither does the texel size (rounded up, so that
+			// float noise in the corners cannot change it either)
+			math::V3 center{0.0f, 0.0f, 0.0f};
+			for (const math::V3& corner : corners)
+			{
+				center += corner;
+			}
+
+			center = math::V3{center.x / 8.0f, center.y / 8.0f, center.z / 8.0f};
+
+			float radius = 0.0f;
+			for (const math::V3& corner : corners)
+			{
+				radius = std::max(radius, (corner - center).length());
+			}
+
+			radius = std::ceil(radius * 16.0f) / 16.0f;
+
+			const float texel_size = 2.0f * radius / m_shadow_map_resolution;
+
+			// snapping the light space center to whole texels moves the cascade by whole texels, so shadow edges do not shimmer as the camera moves
+			const float center_x = std::floor(dot(light_right, center) / texel_size) * texel_size;
+			const float center_y = std::floor(dot(light_up, center) / texel_size) * texel_size;
+			const float center_z = dot(light_forward, center);
+
+			const float z_min = center_z - radius - SHADOW_CASTER_DISTANCE;
+			const float z_max = center_z + radius;
+			const float depth_range = z_max - z_min;
+
+			// orthographic projection in the light basis : x / y in [-1, 1] over the sphere, z in [0, 1] from z_min to z_max
+			const math::M4 cascade_mat
+			{
+				light_right.x / radius, light_right.y / radius, light_right.z / radius, -center_x / radius,
+				light_up.x / radius, light_up.y / radius, light_up.z / radius, -center_y / radius,
+				light_forward.x / depth_range, light_forward.y / depth_range, light_forward.z / depth_range, -z_min / depth_range,
+				0.0f, 0.0f, 0.0f, 1.0f
+			};
+
+			m_shadow_cascade_mats[cascade] = cascade_mat;
+
+			shadow_data.m_cascade_mats[cascade] = math::transpose(cascade_mat);
+			shadow_data.m_cascade_split_depths[cascade] = split_far;
+			shadow_data.m_cascade_texel_sizes[cascade] = texel_size;
+
+			// casters of the cascade : the BVH is culled against the cascade's box, which includes casters outside of the view frustum
+			m_shadow_visible_bounds.clear();
+			m_bvh.cull(extract_frustum(cascade_mat), m_shadow_visible_bounds);
+			std::sort(m_shadow_visible_bounds.begin(), m_shadow_visible_bounds.end());
+
+			m_shadow_draw_lists[cascade].clear();
+			build_draw_list(m_shadow_visible_bounds, lod_projection_scale, m_shadow_draw_lists[cascade]);
+
+			split_near = split_far;
+		}
+
+		void *data;
+		vmaMapMemory(m_vma_allocator, get_current_frame_data().m_shadow_buffer.m_allocation_data, &data);
+		memcpy(data, &shadow_data, sizeof(ShadowData));
+		vmaUnmapMemory(m_vma_allocator, get_current_frame_data().m_shadow_buffer.m_allocation_data);
+	}
+
+	void Engine::draw_shadow_cascades(vk::CommandBuffer command_buffer)
+	{
+		vk::ClearDepthStencilValue depth_clear;
+		depth_clear.setDepth(1.0f);
+
+		vk::ClearValue clear_value = depth_clear;
+
+		for (uint32_t cascade = 0; cascade < m_shadow_cascade_count; cascade++)
+		{
+			vk::RenderPassBeginInfo render_pass_begin_info = {};
+			render_pass_begin_info.renderPass = m_shadow_render_pass;
+			render_pass_begin_info.renderArea.extent = vk::Extent2D{m_shadow_map_resolution, m_shadow_map_resolution};
+			render_pass_begin_info.renderArea.offset = vk::Offset2D{0, 0};
+			render_pass_begin_info.clearValueCount = 1;
+			render_pass_begin_info.pClearValues = &clear_value;
+			render_pass_begin_info.framebuffer = m_shadow_framebuffers[cascade];
+
+			command_buffer.beginRenderPass(render_pass_begin_info, vk::SubpassContents::eInline);
+
+			// only the object set is read (the global set is part of the layout so that set numbers match the other pipelines)
+			command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_shadow_pipeline);
+			command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_shadow_pipeline_layout, 1, 1, &get_current_frame_data().m_object_descriptor_set, 0, nullptr);
+
+			MeshPushConstants push_constants{};
+			push_constants.m_transform_mat = math::transpose(m_shadow_cascade_mats[cascade]);
+			command_buffer.pushConstants(m_shadow_pipeline_layout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(MeshPushConstants), &push_constants);
+
+			MeshHandle last_mesh_handle{};
+
+			for (const DrawRecord& draw_record : m_shadow_draw_lists[cascade])
+			{
+				if (draw_record.m_mesh != last_mesh_handle)
+				{
+					Mesh *mesh = m_meshes.get(draw_record.m_mesh);
+					const AllocatedBuffer *position_buffer = m_buffers.get(mesh->m_position_buffer);
+
+					// the mesh's own indices : the cluster culling output only holds the triangles visible from the camera
+					vk::DeviceSize offset{0};
+					command_buffer.bindVertexBuffers(0, position_buffer->m_buffer, offset);
+					command_buffer.bindIndexBuffer(m_buffers.get(mesh->m_index_buffer)->m_buffer, 0, vk::IndexType::eUint32);
+
+					last_mesh_handle = draw_record.m_mesh;
+				}
+
+				command_buffer.drawIndexed(draw_record.m_index_count, 1, draw_record.m_first_index, 0, draw_record.m_object_index);
+			}
+
+			command_buffer.endRenderPass();
+		}
+	}
+
+	void Engine::init_post_processing()
+	{
+		// the composite pass writes linear values when the swapchain format encodes them itself (sRGB formats)
+		switch (m_swapchain_image_format)
+		{
+			case vk::Format::eB8G8R8A8Srgb:
+			case vk::Format::eR8G8B8A8Srgb:
+			case vk::Format::eA8B8G8R8SrgbPack32:
+				m_encode_srgb = false;
+				break;
+
+			default:
+				m_encode_srgb = true;
+				break;
+		}
+
+		// bilinear, clamped (bloom reads mips through single mip views, so no mip filtering)
+		{
+			vk::SamplerCreateInfo sampler_create_info = {};
+			sampler_create_info.magFilter = vk::Filter::eLinear;
+			sampler_create_info.minFilter = vk::Filter::eLinear;
+			sampler_create_info.mipmapMode = vk::SamplerMipmapMode::eNearest;
+			sampler_create_info.addressModeU = vk::SamplerAddressMode::eClampToEdge;
+			sampler_create_info.addressModeV = vk::SamplerAddressMode::eClampToEdge;
+			sampler_create_info.addressModeW = vk::SamplerAddressMode::eClampToEdge;
+
+			m_post_sampler = m_device.createSampler(sampler_create_info);
+			m_deletion_queue.push(m_post_sampler);
+		}
+
+		// bloom : source (sampled) and destination (storage) of each dispatch. The bloom image stays in general layout for the whole bloom pass.
+		if (m_config.m_post_process.m_bloom)
+		{
+			vk::DescriptorSetLayoutBinding bindings[] =
+			{
+				init::create_descriptor_set_layout_binding(vk::DescriptorType::eCombinedImageSampler, vk::ShaderStageFlagBits::eCompute, 0),
+				init::create_descriptor_set_layout_binding(vk::DescriptorType::eStorageImage, vk::ShaderStageFlagBits::eCompute, 1)
+			};
+
+			vk::DescriptorSetLayoutCreateInfo layout_create_info{};
+			layout_create_info.bindingCount = 2;
+			layout_create_info.pBindings = bindings;
+
+			m_bloom_descriptor_set_layout = m_descriptor_layout_cache.create_descriptor_set_layout(layout_create_info);
+
+			const vk::Image bloom_image = m_render_graph.get_image(m_bloom_graph_image);
+
+			for (uint32_t mip = 0; mip < m_bloom_mip_count; mip++)
+			{
+				vk::ImageViewCreateInfo view_create_info = init::create_image_view_info(vk::Format::eR16G16B16A16Sfloat, bloom_image, vk::ImageAspectFlagBits::eColor);
+				view_create_info.subresourceRange.baseMipLevel = mip;
+				view_create_info.subresourceRange.levelCount = 1;
+
+				m_bloom_mip_views.push_back(m_device.createImageView(view_create_info));
+				m_deletion_queue.push(m_bloom_mip_views.back());
+			}
+
+			const auto write_bloom_set = [&](vk::ImageView source_view, vk::ImageLayout source_layout, vk::ImageView destination_view)
+			{
+				const vk::DescriptorSet descriptor_set = m_descriptor_allocator.allocate(m_bloom_descriptor_set_layout);
+
+				vk::DescriptorImageInfo source_info{m_post_sampler, source_view, source_layout};
+				vk::DescriptorImageInfo destination_info{{}, destination_view, vk::ImageLayout::eGeneral};
+
+				vk::WriteDescriptorSet writes[] =
+				{
+					init::write_descriptor_image(vk::DescriptorType::eCombinedImageSampler, descriptor_set, &source_info, 0),
+					init::write_descriptor_image(vk::DescriptorType::eStorageImage, descriptor_set, &destination_info, 1)
+				};
+
+				m_device.updateDescriptorSets(2, writes, 0, nullptr);
+
+				return descriptor_set;
+			};
+
+			for (uint32_t mip = 0; mip < m_bloom_mip_count; mip++)
+			{
+				if (mip == 0)
+				{
+					m_bloom_downsample_descriptor_sets.push_back(write_bloom_set(m_hdr_color_view, vk::ImageLayout::eShaderReadOnlyOptimal, m_bloom_mip_views[0]));
+				}
+				else
+				{
+					m_bloom_downsample_descriptor_sets.push_back(write_bloom_set(m_bloom_mip_views[mip - 1], vk::ImageLayout::eGeneral, m_bloom_mip_views[mip]));
+				}
+
+				if (mip + 1 < m_bloom_mip_count)
+				{
+					m_bloom_upsample_descriptor_sets.push_back(write_bloom_set(m_bloom_mip_views[mip + 1], vk::ImageLayout::eGeneral, m_bloom_mip_views[mip]));
+				}
+			}
+
+			vk::PushConstantRange push_constant_range = {};
+			push_constant_range.size = sizeof(BloomConstants);
+			push_constant_range.offset = 0;
+			push_constant_range.stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+			vk::PipelineLayoutCreateInfo pipeline_layout_create_info = {};
+			pipeline_layout_create_info.setLayoutCount = 1;
+			pipeline_layout_create_info.pSetLayouts = &m_bloom_descriptor_set_layout;
+			pipeline_layout_create_info.pushConstantRangeCount = 1;
+			pipeline_layout_create_info.pPushConstantRanges = &push_constant_range;
+
+			m_bloom_pipeline_layout = m_device.createPipelineLayout(pipeline_layout_create_info);
+			m_deletion_queue.push(m_bloom_pipeline_layout);
+
+			vk::ShaderModule bloom_downsample_module;
+			load_shaders("../shaders/bloom_downsample.comp.spv", bloom_downsample_module);
+			m_deletion_queue.push(bloom_downsample_module);
+
+			vk::ShaderModule bloom_upsample_module;
+			load_shaders("../shaders/bloom_upsample.comp.spv", bloom_upsample_module);
+			m_deletion_queue.push(bloom_upsample_module);
+
+			m_bloom_downsample_pipeline = create_compute_pipeline(m_device, bloom_downsample_module, m_bloom_pipeline_layout);
+			m_deletion_queue.push(m_bloom_downsample_pipeline);
+
+			m_bloom_upsample_pipeline = create_compute_pipeline(m_device, bloom_upsample_module, m_bloom_pipeline_layout);
+			m_deletion_queue.push(m_bloom_upsample_pipeline);
+		}
+
+		// composite : HDR color, depth and bloom (texelFetch / bilinear), LDR output
+		{
+			vk::DescriptorSetLayoutBinding bindings[] =
+			{
+				init::create_descriptor_set_layout_binding(vk::DescriptorType::eCombinedImageSampler, vk::ShaderStageFlagBits::eCompute, 0),
+				init::create_descriptor_set_layout_binding(vk::DescriptorType::eCombinedImageSampler, vk::ShaderStageFlagBits::eCompute, 1),
+				init::create_descriptor_set_layout_binding(vk::DescriptorType::eCombinedImageSampler, vk::ShaderStageFlagBits::eCompute, 2),
+				init::create_descriptor_set_layout_binding(vk::DescriptorType::eStorageImage, vk::ShaderStageFlagBits::eCompute, 3)
+			};
+
+			vk::DescriptorSetLayoutCreateInfo layout_create_info{};
+			layout_create_info.bindingCount = 4;
+			layout_create_info.pBindings = bindings;
+
+			m_post_composite_descriptor_set_layout = m_descriptor_layout_cache.create_descriptor_set_layout(layout_create_info);
+			m_post_composite_descriptor_set = m_descriptor_allocator.allocate(m_post_composite_descriptor_set_layout);
+
+			// without bloom, the binding is never read (but must stay valid) : the HDR color stands in for it
+			const vk::ImageView bloom_view = m_config.m_post_process.m_bloom ? m_bloom_mip_views[0] : m_hdr_color_view;
+
+			vk::DescriptorImageInfo hdr_color_info{m_post_sampler, m_hdr_color_view, vk::ImageLayout::eShaderReadOnlyOptimal};
+			vk::DescriptorImageInfo depth_info{m_post_sampler, m_sampled_depth_view, vk::ImageLayout::eShaderReadOnlyOptimal};
+			vk::DescriptorImageInfo bloom_info{m_post_sampler, bloom_view, vk::ImageLayout::eShaderReadOnlyOptimal};
+			vk::DescriptorImageInfo ldr_color_info{{}, m_render_graph.get_image_view(m_ldr_color_graph_image), vk::ImageLayout::eGeneral};
+
+			vk::WriteDescriptorSet writes[] =
+			{
+				init::write_descriptor_image(vk::DescriptorType::eCombinedImageSampler, m_post_composite_descriptor_set, &hdr_color_info, 0),
+				init::write_descriptor_image(vk::DescriptorType::eCombinedImageSampler, m_post_composite_descriptor_set, &depth_info, 1),
+				init::write_descriptor_image(vk::DescriptorType::eCombinedImageSampler, m_post_composite_descriptor_set, &bloom_info, 2),
+				init::write_descriptor_image(vk::DescriptorType::eStorageImage, m_post_composite_descriptor_set, &ldr_color_info, 3)
+			};
+
+			m_device.updateDescriptorSets(4, writes, 0, nullptr);
+
+			vk::PushConstantRange push_constant_range = {};
+			push_constant_range.size = sizeof(PostCompositeConstants);
+			push_constant_range.offset = 0;
+			push_constant_range.stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+			vk::PipelineLayoutCreateInfo pipeline_layout_create_info = {};
+			pipeline_layout_create_info.setLayoutCount = 1;
+			pipeline_layout_create_info.pSetLayouts = &m_post_composite_descriptor_set_layout;
+			pipeline_layout_create_info.pushConstantRangeCount = 1;
+			pipeline_layout_create_info.pPushConstantRanges = &push_constant_range;
+
+			m_post_composite_pipeline_layout = m_device.createPipelineLayout(pipeline_layout_create_info);
+			m_deletion_queue.push(m_post_composite_pipeline_layout);
+
+			vk::ShaderModule post_composite_module;
+			load_shaders("../shaders/post_composite.comp.spv", post_composite_module);
+			m_deletion_queue.push(post_composite_module);
+
+			m_post_composite_pipeline = create_compute_pipeline(m_device, post_composite_module, m_post_composite_pipeline_layout);
+			m_deletion_queue.push(m_post_composite_pipeline);
+		}
+
+		// MSAA depth resolve : multisampled depth (texelFetch per sample), single sampled R32 output
+		if (m_msaa_samples != vk::SampleCountFlagBits::e1)
+		{
+			vk::DescriptorSetLayoutBinding bindings[] =
+			{
+				init::create_descriptor_set_layout_binding(vk::DescriptorType::eCombinedImageSampler, vk::ShaderStageFlagBits::eCompute, 0),
+				init::create_descriptor_set_layout_binding(vk::DescriptorType::eStorageImage, vk::ShaderStageFlagBits::eCompute, 1)
+			};
+
+			vk::DescriptorSetLayoutCreateInfo layout_create_info{};
+			layout_create_info.bindingCount = 2;
+			layout_create_info.pBindings = bindings;
+
+			m_depth_resolve_descriptor_set_layout = m_descriptor_layout_cache.create_descriptor_set_layout(layout_create_info);
+			m_depth_resolve_descriptor_set = m_descriptor_allocator.allocate(m_depth_resolve_descriptor_set_layout);
+
+			vk::DescriptorImageInfo depth_info{m_post_sampler, m_depth_image_view, vk::ImageLayout::eShaderReadOnlyOptimal};
+			vk::DescriptorImageInfo resolved_depth_info{{}, m_sampled_depth_view, vk::ImageLayout::eGeneral};
+
+			vk::WriteDescriptorSet writes[] =
+			{
+				init::write_descriptor_image(vk::DescriptorType::eCombinedImageSampler, m_depth_resolve_descriptor_set, &depth_info, 0),
+				init::write_descriptor_image(vk::DescriptorType::eStorageImage, m_depth_resolve_descriptor_set, &resolved_depth_info, 1)
+			};
+
+			m_device.updateDescriptorSets(2, writes, 0, nullptr);
+
+			vk::PipelineLayoutCreateInfo pipeline_layout_create_info = {};
+			pipeline_layout_create_info.setLayoutCount = 1;
+			pipeline_layout_create_info.pSetLayouts = &m_depth_resolve_descriptor_set_layout;
+
+			m_depth_resolve_pipeline_layout = m_device.createPipelineLayout(pipeline_layout_create_info);
+			m_deletion_queue.push(m_depth_resolve_pipeline_layout);
+
+			vk::ShaderModule depth_resolve_module;
+			load_shaders("../shaders/depth_resolve.comp.spv", depth_resolve_module);
+			m_deletion_queue.push(depth_resolve_module);
+
+			m_depth_resolve_pipeline = create_compute_pipeline(m_device, depth_resolve_module, m_depth_resolve_pipeline_layout);
+			m_deletion_queue.push(m_depth_resolve_pipeline);
+		}
+	}
+
+	void Engine::dispatch_depth_resolve(vk::CommandBuffer command_buffer)
+	{
+		command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_depth_resolve_pipeline);
+		command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_depth_resolve_pipeline_layout, 0, 1, &m_depth_resolve_descriptor_set, 0, nullptr);
+		command_buffer.dispatch((m_render_extent.width + 7) / 8, (m_render_extent.height + 7) / 8, 1);
+	}
+
+	void Engine::dispatch_bloom(vk::CommandBuffer command_buffer)
+	{
+		// note : the render graph synchronizes the bloom image with the other passes, only the mips are synchronized here (upsamples read and write them)
+		vk::MemoryBarrier mip_barrier = {};
+		mip_barrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+		mip_barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+
+		const auto get_mip_extent = [&](uint32_t mip)
+		{
+			return vk::Extent2D{std::max(1u, m_bloom_extent.width >> mip), std::max(1u, m_bloom_extent.height >> mip)};
+		};
+
+		BloomConstants bloom_constants{};
+		bloom_constants.m_threshold = m_config.m_post_process.m_bloom_threshold;
+		bloom_constants.m_knee = m_config.m_post_process.m_bloom_threshold * 0.5f;
+
+		// downsample : the HDR color into mip 0 (prefiltered), then each mip into the next one
+		command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_bloom_downsample_pipeline);
+
+		for (uint32_t mip = 0; mip < m_bloom_mip_count; mip++)
+		{
+			const vk::Extent2D source_extent = mip == 0 ? m_window_extent : get_mip_extent(mip - 1);
+			const vk::Extent2D mip_extent = get_mip_extent(mip);
+
+			bloom_constants.m_source_texel_size_x = 1.0f / source_extent.width;
+			bloom_constants.m_source_texel_size_y = 1.0f / source_extent.height;
+			bloom_constants.m_source_uv_scale_x = mip == 0 ? static_cast<float>(m_render_extent.width) / m_window_extent.width : 1.0f;
+			bloom_constants.m_source_uv_scale_y = mip == 0 ? static_cast<float>(m_render_extent.height) / m_window_extent.height : 1.0f;
+			bloom_constants.m_prefilter = mip == 0 ? 1 : 0;
+
+			command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_bloom_pipeline_layout, 0, 1, &m_bloom_downsample_descriptor_sets[mip], 0, nullptr);
+			command_buffer.pushConstants(m_bloom_pipeline_layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(BloomConstants), &bloom_constants);
+			command_buffer.dispatch((mip_extent.width + 7) / 8, (mip_extent.height + 7) / 8, 1);
+
+			command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, {}, mip_barrier, nullptr, nullptr);
+		}
+
+		// upsample : from the smallest mip up, each mip adds the filtered mip below it
+		command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_bloom_upsample_pipeline);
+
+		for (uint32_t mip = m_bloom_mip_count - 1; mip-- > 0;)
+		{
+			const vk::Extent2D source_extent = get_mip_extent(mip + 1);
+			const vk::Extent2D mip_extent = get_mip_extent(mip);
+
+			bloom_constants.m_source_texel_size_x = 1.0f / source_extent.width;
+			bloom_constants.m_source_texel_size_y = 1.0f / source_extent.height;
+			bloom_constants.m_source_uv_scale_x = 1.0f;
+			bloom_constants.m_source_uv_scale_y = 1.0f;
+			bloom_constants.m_prefilter = 0;
+
+			command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_bloom_pipeline_layout, 0, 1, &m_bloom_upsample_descriptor_sets[mip], 0, nullptr);
+			command_buffer.pushConstants(m_bloom_pipeline_layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(BloomConstants), &bloom_constants);
+			command_buffer.dispatch((mip_extent.width + 7) / 8, (mip_extent.height + 7) / 8, 1);
+
+			if (mip > 0)
+			{
+				command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, {}, mip_barrier, nullptr, nullptr);
+			}
+		}
+	}
+
+	void Engine::dispatch_post_composite(vk::CommandBuffer command_buffer)
+	{
+		command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_post_composite_pipeline);
+		command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_post_composite_pipeline_layout, 0, 1, &m_post_composite_descriptor_set, 0, nullptr);
+
+		PostCompositeConstants composite_constants{};
+		composite_constants.m_fog_color = m_environment_data.m_fog_color;
+		composite_constants.m_fog_distance = m_environment_data.m_fog_distance;
+		composite_constants.m_exposure = m_config.m_post_process.m_exposure;
+		composite_constants.m_bloom_intensity = m_config.m_post_process.m_bloom_intensity;
+		composite_constants.m_near_plane = CAMERA_NEAR_PLANE;
+		composite_constants.m_far_plane = CAMERA_FAR_PLANE;
+		composite_constants.m_render_uv_scale_x = static_cast<float>(m_render_extent.width) / m_window_extent.width;
+		composite_constants.m_render_uv_scale_y = static_cast<float>(m_render_extent.height) / m_window_extent.height;
+
+		composite_constants.m_flags |= m_config.m_post_process.m_bloom ? POST_COMPOSITE_BLOOM : 0;
+		composite_constants.m_flags |= m_config.m_post_process.m_fog ? POST_COMPOSITE_FOG : 0;
+		composite_constants.m_flags |= m_encode_srgb ? POST_COMPOSITE_ENCODE_SRGB : 0;
+
+		command_buffer.pushConstants(m_post_composite_pipeline_layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(PostCompositeConstants), &composite_constants);
+		command_buffer.dispatch((m_window_extent.width + 7) / 8, (m_window_extent.height + 7) / 8, 1);
+	}
+
+	void Engine::blit_to_swapchain(vk::CommandBuffer command_buffer)
+	{
+		// same size, so the blit only converts the format (RGBA8 to the swapchain's)
+		const vk::Offset3D extent{static_cast<int32_t>(m_window_extent.width), static_cast<int32_t>(m_window_extent.height), 1};
+
+		vk::ImageBlit blit_region = {};
+		blit_region.srcSubresource = vk::ImageSubresourceLayers{vk::ImageAspectFlagBits::eColor, 0, 0, 1};
+		blit_region.srcOffsets[1] = extent;
+		blit_region.dstSubresource = vk::ImageSubresourceLayers{vk::ImageAspectFlagBits::eColor, 0, 0, 1};
+		blit_region.dstOffsets[1] = extent;
+
+		command_buffer.blitImage(m_render_graph.get_image(m_ldr_color_graph_image), vk::ImageLayout::eTransferSrcOptimal, m_swapchain_images[m_swapchain_image_index], vk::ImageLayout::eTransferDstOptimal,
+			blit_region, vk::Filter::eNearest);
+	}
+
+	void Engine::init_dynamic_resolution()
+	{
+		m_render_extent = m_window_extent;
+
+		if (!m_config.m_dynamic_resolution.m_enabled)
+		{
+			return;
+		}
+
+		const std::vector<vk::QueueFamilyProperties> queue_families = m_physical_device.getQueueFamilyProperties();
+		m_timestamp_valid_bits = queue_families[m_graphics_queue_index].timestampValidBits;
+		m_dynamic_resolution_enabled = m_timestamp_valid_bits > 0;
+
+		if (!m_dynamic_resolution_enabled)
+		{
+			std::cout << "Timestamp queries are not supported by the graphics queue, dynamic resolution is disabled\n";
+			return;
+		}
+
+		m_timestamp_period = m_physical_device.getProperties().limits.timestampPeriod;
+
+		vk::QueryPoolCreateInfo query_pool_create_info = {};
+		query_pool_create_info.queryType = vk::QueryType::eTimestamp;
+		query_pool_create_info.queryCount = 2;
+
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		{
+			m_frames[i].m_timestamp_query_pool = m_device.createQueryPool(query_pool_create_info);
+			m_deletion_queue.push(m_frames[i].m_timestamp_query_pool);
+		}
+	}
+
+	void Engine::update_render_scale()
+	{
+		// note : the pools are reset by the frame's command buffer, so they can only be read once every frame has been submitted once
+		if (!m_dynamic_resolution_enabled || m_frame_number < MAX_FRAMES_IN_FLIGHT)
+		{
+			return;
+		}
+
+		uint64_t timestamps[2] = {};
+		const vk::Result result = m_device.getQueryPoolResults(get_current_frame_data().m_timestamp_query_pool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+
+		if (result != vk::Result::eSuccess)
+		{
+			return;
+		}
+
+		// only the low timestampValidBits bits are meaningful : the difference is taken modulo that range, so that a counter wrapping in between
+		// still gives the elapsed ticks
+		const uint64_t valid_mask = m_timestamp_valid_bits >= 64 ? ~0ull : (1ull << m_timestamp_valid_bits) - 1;
+		const uint64_t elapsed_ticks = ((timestamps[1] & valid_mask) - (timestamps[0] & valid_mask)) & valid_mask;
+
+		const float gpu_time_ms = static_cast<float>(elapsed_ticks) * m_timestamp_period * 1e-6f;
+
+		// smoothed, so that a single slow frame does not change the resolution
+		m_gpu_frame_time_ms = m_gpu_frame_time_ms == 0.0f ? gpu_time_ms : m_gpu_frame_time_ms + (gpu_time_ms - m_gpu_frame_time_ms) * 0.1f;
+
+		// the resolution only changes when the frame time leaves [85%, 100%] of the budget. The scene's cost is roughly proportional to its pixel count
+		// (scale squared), so the scale moves a quarter of the way towards the one that would land in the middle of the band.
+		const DynamicResolutionSettings& settings = m_config.m_dynamic_resolution;
+
+		if (m_gpu_frame_time_ms > settings.m_target_gpu_time_ms || m_gpu_frame_time_ms < settings.m_target_gpu_time_ms * 0.85f)
+		{
+			const float target_scale = m_render_scale * std::sqrt(settings.m_target_gpu_time_ms * 0.925f / std::max(m_gpu_frame_time_ms, 0.01f));
+			m_render_scale = std::clamp(m_render_scale + (target_scale - m_render_scale) * 0.25f, std::min(settings.m_min_scale, 1.0f), 1.0f);
+		}
+
+		m_render_extent.width = std::max(1u, static_cast<uint32_t>(m_window_extent.width * m_render_scale));
+		m_render_extent.height = std::max(1u, static_cast<uint32_t>(m_window_extent.height * m_render_scale));
+	}
+
+	void Engine::update_memory()
+	{
+		// VMA fetches the budget of the heaps again once the frame index changes
+		vmaSetCurrentFrameIndex(m_vma_allocator, static_cast<uint32_t>(m_frame_number));
+
+		const MemorySettings& settings = m_config.m_memory;
+		const uint32_t ticks = SDL_GetTicks();
+
+		if (settings.m_log_interval > 0.0f && ticks - m_last_memory_log_ticks >= static_cast<uint32_t>(settings.m_log_interval * 1000.0f))
+		{
+			m_last_memory_log_ticks = ticks;
+			log_memory_stats();
+		}
+
+		if (!settings.m_defragmentation)
+		{
+			return;
+		}
+
+		// a running defragmentation is stepped by the frames themselves (see step_defragmentation)
+		if (m_defragmentation_context == nullptr && ticks - m_last_defragmentation_ticks >= static_cast<uint32_t>(settings.m_defragmentation_interval * 1000.0f))
+		{
+			m_last_defragmentation_ticks = ticks;
+
+			// note : the statistics walk every block, so fragmentation is only measured at the check interval
+			const MemoryStats stats = get_memory_stats();
+			if (stats.m_fragmented_bytes > static_cast<vk::DeviceSize>(static_cast<double>(stats.m_block_bytes) * settings.m_fragmentation_threshold))
 			{
-				command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, game_object.m_material->m_pipeline);
-				last_material = game_object.m_material;
+				std::cout << "Defragmentation : " << stats.m_fragmented_bytes / 1024 << " KB fragmented, " << settings.m_defragmentation_moves_per_frame << " moves per frame\n";
+
+				begin_defragmentation();
+			}
+		}
+	}
+
+	MemoryStats Engine::get_memory_stats()
+	{
+		MemoryStats stats;
+
+		const VkPhysicalDeviceMemoryProperties *memory_properties = nullptr;
+		vmaGetMemoryProperties(m_vma_allocator, &memory_properties);
 
-				// offset for environment buffer (set in render loop now, since its dynamic)
-				uint32_t environment_buffer_offset = pad_uniform_buffer(sizeof(EnvironmentData)) * frame_index;
+		VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+		vmaGetBudget(m_vma_allocator, budgets);
+
+		for (uint32_t heap = 0; heap < memory_properties->memoryHeapCount; heap++)
+		{
+			MemoryHeapStats heap_stats;
+			heap_stats.m_device_local = (memory_properties->memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+			heap_stats.m_usage = budgets[heap].usage;
+			heap_stats.m_budget = budgets[heap].budget;
+			heap_stats.m_block_bytes = budgets[heap].blockBytes;
+			heap_stats.m_allocation_bytes = budgets[heap].allocationBytes;
+
+			stats.m_heaps.push_back(heap_stats);
+		}
 
-				command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, game_object.m_material->m_pipeline_layout, 0, 1, &get_current_frame_data().m_global_descriptor_set, 1, &environment_buffer_offset);
-				
-				// bind object descriptor
-				command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, game_object.m_material->m_pipeline_layout, 1, 1, &get_current_frame_data().m_object_descriptor_set, 0, nullptr);
+		// categories : the allocations owned by the resource registries, the frames and the render graph
+		auto get_allocation_size = [&](VmaAllocation allocation) -> vk::DeviceSize
+		{
+			if (allocation == nullptr)
+			{
+				return 0;
 			}
 
-			math::M4 model_mat = math::rotate_y((float)m_frame_number) * math::rotate_x(((float)m_frame_number));
-		
-			MeshPushConstants push_constants{};
-			push_constants.m_transform_mat = model_mat;
-			command_buffer.pushConstants(last_material->m_pipeline_layout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(MeshPushConstants), &push_constants);
+			VmaAllocationInfo allocation_info;
+			vmaGetAllocationInfo(m_vma_allocator, allocation, &allocation_info);
 
-			if (game_object.m_mesh != last_mesh)
+			return allocation_info.size;
+		};
+
+		for (const AllocatedBuffer& buffer : m_buffers.get_dense())
+		{
+			stats.m_mesh_bytes += get_allocation_size(buffer.m_allocation_data);
+		}
+
+		for (const AllocatedImage& image : m_images.get_dense())
+		{
+			stats.m_texture_bytes += get_allocation_size(image.m_allocation_data);
+		}
+
+		for (const FrameData& frame_data : m_frames)
+		{
+			for (const AllocatedBuffer *buffer : {&frame_data.m_camera_allocated_buffer, &frame_data.m_objects_buffer, &frame_data.m_object_material_buffer,
+				&frame_data.m_cull_input_buffer, &frame_data.m_draw_command_buffer, &frame_data.m_cluster_cull_input_buffer, &frame_data.m_cluster_index_buffer,
+				&frame_data.m_cluster_index_counter_buffer, &frame_data.m_light_buffer, &frame_data.m_shadow_buffer})
 			{
-				vk::DeviceSize offset{0};
-				command_buffer.bindVertexBuffers(0, game_object.m_mesh->m_allocated_buffer.m_buffer, offset);
+				stats.m_frame_bytes += get_allocation_size(buffer->m_allocation_data);
+			}
+		}
+
+		stats.m_attachment_bytes = m_render_graph.get_memory_size() + get_allocation_size(m_depth_pyramid_allocation.m_allocation_data);
+
+		VmaStats vma_stats;
+		vmaCalculateStats(m_vma_allocator, &vma_stats);
+
+		for (uint32_t memory_type = 0; memory_type < memory_properties->memoryTypeCount; memory_type++)
+		{
+			const VmaStatInfo& type_stats = vma_stats.memoryType[memory_type];
+			if (type_stats.unusedRangeCount > 0)
+			{
+				stats.m_fragmented_bytes += type_stats.unusedBytes - type_stats.unusedRangeSizeMax;
+			}
+		}
+
+		const VmaStatInfo& total = vma_stats.total;
+		stats.m_block_count = total.blockCount;
+		stats.m_allocation_count = total.allocationCount;
+		stats.m_unused_range_count = total.unusedRangeCount;
+		stats.m_block_bytes = total.usedBytes + total.unusedBytes;
+		stats.m_unused_bytes = total.unusedBytes;
+
+		const vk::DeviceSize categorized_bytes = stats.m_mesh_bytes + stats.m_texture_bytes + stats.m_frame_bytes + stats.m_attachment_bytes;
+		stats.m_other_bytes = total.usedBytes > categorized_bytes ? total.usedBytes - categorized_bytes : 0;
+
+		return stats;
+	}
+
+	void Engine::log_memory_stats()
+	{
+		const MemoryStats stats = get_memory_stats();
+
+		std::cout << "GPU memory" << (m_memory_budget_enabled ? "" : " (estimated budget)") << " :\n";
+
+		for (size_t heap = 0; heap < stats.m_heaps.size(); heap++)
+		{
+			const MemoryHeapStats& heap_stats = stats.m_heaps[heap];
+
+			std::cout << "  heap " << heap << (heap_stats.m_device_local ? " (device local)" : "") << " : " << heap_stats.m_usage / 1024 << " / " << heap_stats.m_budget / 1024
+				<< " KB used, " << heap_stats.m_allocation_bytes / 1024 << " KB allocated in " << heap_stats.m_block_bytes / 1024 << " KB of blocks\n";
+		}
+
+		std::cout << "  meshes " << stats.m_mesh_bytes / 1024 << " KB, textures " << stats.m_texture_bytes / 1024 << " KB, per frame " << stats.m_frame_bytes / 1024
+			<< " KB, attachments " << stats.m_attachment_bytes / 1024 << " KB, other " << stats.m_other_bytes / 1024 << " KB\n";
+
+		std::cout << "  " << stats.m_allocation_count << " allocations in " << stats.m_block_count << " blocks, " << stats.m_unused_bytes / 1024 << " KB free in "
+			<< stats.m_unused_range_count << " ranges (" << stats.m_fragmented_bytes / 1024 << " KB fragmented)\n";
+	}
+
+	void Engine::begin_defragmentation()
+	{
+		std::vector<VmaAllocation> allocations;
+		allocations.reserve(m_buffers.size() + m_images.size());
+
+		for (const AllocatedBuffer& buffer : m_buffers.get_dense())
+		{
+			allocations.push_back(buffer.m_allocation_data);
+		}
+
+		for (const AllocatedImage& image : m_images.get_dense())
+		{
+			allocations.push_back(image.m_allocation_data);
+		}
+
+		if (allocations.empty())
+		{
+			return;
+		}
+
+		// every move is a GPU copy made by the engine (optimal tiling images can not be moved as raw memory), so there are no CPU moves and moves never overlap.
+		// note : the moves are planned by the first pass, and limited per pass by begin_defragmentation_pass
+		VmaDefragmentationInfo2 defragmentation_info = {};
+		defragmentation_info.flags = VMA_DEFRAGMENTATION_FLAG_INCREMENTAL;
+		defragmentation_info.allocationCount = static_cast<uint32_t>(allocations.size());
+		defragmentation_info.pAllocations = allocations.data();
+		defragmentation_info.maxGpuBytesToMove = VK_WHOLE_SIZE;
+		defragmentation_info.maxGpuAllocationsToMove = UINT32_MAX;
+
+		const VkResult result = vmaDefragmentationBegin(m_vma_allocator, &defragmentation_info, &m_defragmentation_stats, &m_defragmentation_context);
+
+		// VK_NOT_READY : moves are left for the passes
+		if (result != VK_NOT_READY)
+		{
+			m_defragmentation_context = nullptr;
 
-				last_mesh = game_object.m_mesh;
+			if (result != VK_SUCCESS)
+			{
+				std::cerr << "Vulkan Error : " << vk::Result(result) << std::endl;
+			}
+		}
+	}
+
+	void Engine::step_defragmentation(vk::CommandBuffer command_buffer)
+	{
+		// the previous pass is committed once the frame that copied its allocations (the last one reading the old places) has finished
+		if (m_defragmentation_pass_pending)
+		{
+			if (get_completed_submission_value() < m_defragmentation_pass_value)
+			{
+				return;
+			}
+
+			end_defragmentation_pass(false);
+		}
+
+		if (m_defragmentation_context != nullptr)
+		{
+			begin_defragmentation_pass(command_buffer, m_config.m_memory.m_defragmentation_moves_per_frame);
+		}
+	}
+
+	void Engine::begin_defragmentation_pass(vk::CommandBuffer command_buffer, uint32_t max_moves)
+	{
+		std::vector<VmaDefragmentationPassMoveInfo> moves(std::max(max_moves, 1u));
+
+		VmaDefragmentationPassInfo pass_info = {};
+		pass_info.moveCount = static_cast<uint32_t>(moves.size());
+		pass_info.pMoves = moves.data();
+
+		VK_CHECK(vmaBeginDefragmentationPass(m_vma_allocator, m_defragmentation_context, &pass_info));
+
+		// a pass without moves means everything is moved (or the plan could not be made for some memory types), there is nothing left to do either way
+		if (pass_info.moveCount == 0)
+		{
+			end_defragmentation_pass(true);
+			return;
+		}
+
+		// the new buffer / image of each move is bound to the place the allocation moves to
+		std::vector<std::pair<AllocatedBuffer*, vk::Buffer>> buffer_moves;
+		std::vector<std::pair<Texture*, vk::Image>> texture_moves;
+
+		for (uint32_t i = 0; i < pass_info.moveCount; i++)
+		{
+			const VmaDefragmentationPassMoveInfo& move = moves[i];
+
+			std::vector<AllocatedBuffer>& buffers = m_buffers.get_dense();
+			auto buffer = std::find_if(buffers.begin(), buffers.end(), [&](const AllocatedBuffer& mesh_buffer) { return mesh_buffer.m_allocation_data == move.allocation; });
+
+			if (buffer != buffers.end())
+			{
+				vk::BufferCreateInfo buffer_create_info = {};
+				buffer_create_info.size = buffer->m_size;
+				buffer_create_info.usage = buffer->m_usage;
+
+				vk::Buffer new_buffer = m_device.createBuffer(buffer_create_info);
+
+				// note : the requirements match the moved allocation (same create info), they are only queried since binding expects it
+				[[maybe_unused]] vk::MemoryRequirements requirements = m_device.getBufferMemoryRequirements(new_buffer);
+				m_device.bindBufferMemory(new_buffer, move.memory, move.offset);
+
+				buffer_moves.emplace_back(&(*buffer), new_buffer);
+				continue;
+			}
+
+			std::vector<Texture>& textures = m_textures.get_dense();
+			auto texture = std::find_if(textures.begin(), textures.end(), [&](const Texture& moved_texture)
+			{
+				const AllocatedImage *image = m_images.get(moved_texture.m_image);
+				return image != nullptr && image->m_allocation_data == move.allocation;
+			});
+
+			if (texture == textures.end())
+			{
+				throw std::runtime_error("Defragmentation moved an allocation that is not owned by a mesh or texture");
+			}
+
+			vk::Image new_image = m_device.createImage(create_texture_image_info(texture->m_format, texture->m_width, texture->m_height, texture->m_mip_count));
+
+			[[maybe_unused]] vk::MemoryRequirements requirements = m_device.getImageMemoryRequirements(new_image);
+			m_device.bindImageMemory(new_image, move.memory, move.offset);
+
+			texture_moves.emplace_back(&(*texture), new_image);
+		}
+
+		// buffers are looked up through their handle when draws are recorded, so frames in flight keep using the old buffers (only read, like the copy
+		// does) and no wait is needed. Texture views are rewritten in place in the bindless / material sets, which the frames in flight still use.
+		if (!texture_moves.empty())
+		{
+			for (FrameData& frame_data : m_frames)
+			{
+				wait_for_frame(frame_data);
+			}
+		}
+
+		// copies run at the start of the frame, before anything reads the new places
+		for (const auto& [buffer, new_buffer] : buffer_moves)
+		{
+			command_buffer.copyBuffer(buffer->m_buffer, new_buffer, vk::BufferCopy{0, 0, buffer->m_size});
+		}
+
+		vk::MemoryBarrier buffer_barrier = {};
+		buffer_barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+		buffer_barrier.dstAccessMask = vk::AccessFlagBits::eVertexAttributeRead | vk::AccessFlagBits::eIndexRead;
+
+		command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eVertexInput, {}, buffer_barrier, nullptr, nullptr);
+
+		if (!texture_moves.empty())
+		{
+			// every level of the old images : shader read -> transfer source, and of the new ones : undefined -> transfer destination
+			std::vector<vk::ImageMemoryBarrier> image_barriers;
+
+			for (const auto& [texture, new_image] : texture_moves)
+			{
+				vk::ImageMemoryBarrier barrier = {};
+				barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.subresourceRange = vk::ImageSubresourceRange{vk::ImageAspectFlagBits::eColor, 0, texture->m_mip_count, 0, 1};
+
+				barrier.image = m_images.get(texture->m_image)->m_image;
+				barrier.oldLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+				barrier.newLayout = vk::ImageLayout::eTransferSrcOptimal;
+				barrier.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+				image_barriers.push_back(barrier);
+
+				barrier.image = new_image;
+				barrier.oldLayout = vk::ImageLayout::eUndefined;
+				barrier.newLayout = vk::ImageLayout::eTransferDstOptimal;
+				barrier.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
+				image_barriers.push_back(barrier);
+			}
+
+			command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer, {}, nullptr, nullptr, image_barriers);
+
+			for (const auto& [texture, new_image] : texture_moves)
+			{
+				std::vector<vk::ImageCopy> copy_regions;
+				for (uint32_t mip = 0; mip < texture->m_mip_count; mip++)
+				{
+					vk::ImageCopy copy_region = {};
+					copy_region.srcSubresource = vk::ImageSubresourceLayers{vk::ImageAspectFlagBits::eColor, mip, 0, 1};
+					copy_region.dstSubresource = copy_region.srcSubresource;
+					copy_region.extent = vk::Extent3D{std::max(1u, texture->m_width >> mip), std::max(1u, texture->m_height >> mip), 1};
+
+					copy_regions.push_back(copy_region);
+				}
+
+				command_buffer.copyImage(m_images.get(texture->m_image)->m_image, vk::ImageLayout::eTransferSrcOptimal, new_image, vk::ImageLayout::eTransferDstOptimal, copy_regions);
+			}
+
+			// new images : transfer destination -> shader read (the old ones are destroyed)
+			image_barriers.clear();
+
+			for (const auto& [texture, new_image] : texture_moves)
+			{
+				vk::ImageMemoryBarrier barrier = {};
+				barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.subresourceRange = vk::ImageSubresourceRange{vk::ImageAspectFlagBits::eColor, 0, texture->m_mip_count, 0, 1};
+				barrier.image = new_image;
+				barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+				barrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+				barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+				barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+
+				image_barriers.push_back(barrier);
+			}
+
+			command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader, {}, nullptr, nullptr, image_barriers);
+		}
+
+		// the old buffers / images are replaced right away, and destroyed once the copies (and the frames in flight) are done with them
+		for (const auto& [buffer, new_buffer] : buffer_moves)
+		{
+			destroy_deferred(buffer->m_buffer);
+			buffer->m_buffer = new_buffer;
+		}
+
+		for (const auto& [texture, new_image] : texture_moves)
+		{
+			AllocatedImage *image = m_images.get(texture->m_image);
+
+			vk::ImageViewCreateInfo view_create_info = init::create_image_view_info(texture->m_format, new_image, vk::ImageAspectFlagBits::eColor);
+			view_create_info.subresourceRange.levelCount = texture->m_mip_count;
+
+			vk::ImageView new_view = m_device.createImageView(view_create_info);
+
+			destroy_deferred(texture->m_view);
+			destroy_deferred(image->m_image);
+
+			image->m_image = new_image;
+			texture->m_view = new_view;
+
+			// the texture keeps its bindless slot (materials refer to it by index), and the sets of the materials sampling it are rewritten.
+			// note : the frame being recorded has not bound any set yet
+			vk::DescriptorImageInfo image_info{};
+			image_info.imageView = new_view;
+			image_info.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+
+			if (texture->m_bindless_index != BINDLESS_INVALID_INDEX)
+			{
+				vk::WriteDescriptorSet image_write = init::write_descriptor_image(vk::DescriptorType::eSampledImage, m_bindless_descriptor_set, &image_info, 1);
+				image_write.dstArrayElement = texture->m_bindless_index;
+
+				m_device.updateDescriptorSets(1, &image_write, 0, nullptr);
+			}
+
+			for (const Material& material : m_materials.get_dense())
+			{
+				if (!material.m_texture_set || m_textures.get(material.m_diffuse_texture) != texture)
+				{
+					continue;
+				}
+
+				image_info.sampler = material.m_texture_sampler;
+
+				vk::WriteDescriptorSet texture_write = init::write_descriptor_image(vk::DescriptorType::eCombinedImageSampler, material.m_texture_set, &image_info, 0);
+				m_device.updateDescriptorSets(1, &texture_write, 0, nullptr);
+			}
+		}
+
+		// the old places are read by the copies until command_buffer's submission has finished
+		m_defragmentation_pass_pending = true;
+		m_defragmentation_pass_value = get_pending_submission_value();
+	}
+
+	void Engine::end_defragmentation_pass(bool last_pass)
+	{
+		// the allocations now point to their new place, and the memory they leave is freed (empty blocks are released)
+		const VkResult result = vmaEndDefragmentationPass(m_vma_allocator, m_defragmentation_context);
+		m_defragmentation_pass_pending = false;
+
+		if (result == VK_SUCCESS || last_pass)
+		{
+			vmaDefragmentationEnd(m_vma_allocator, m_defragmentation_context);
+			m_defragmentation_context = nullptr;
+
+			std::cout << "Defragmentation : " << m_defragmentation_stats.allocationsMoved << " allocations moved (" << m_defragmentation_stats.bytesMoved / 1024 << " KB), "
+				<< m_defragmentation_stats.deviceMemoryBlocksFreed << " blocks freed (" << m_defragmentation_stats.bytesFreed / 1024 << " KB)\n";
+		}
+	}
+
+	void Engine::finish_defragmentation()
+	{
+		// outside of the frame loop : each pass is copied with an immediate submission and committed right away
+		while (m_defragmentation_context != nullptr)
+		{
+			m_device.waitIdle();
+
+			if (m_defragmentation_pass_pending)
+			{
+				end_defragmentation_pass(false);
+				continue;
+			}
+
+			immediate_submit([&](vk::CommandBuffer command_buffer)
+			{
+				begin_defragmentation_pass(command_buffer, m_config.m_memory.m_defragmentation_moves_per_frame);
+			});
+		}
+	}
+
+	void Engine::build_depth_pyramid(vk::CommandBuffer command_buffer)
+	{
+		// note : the render graph moves the depth buffer to sampled (and back to attachment for the late phase), only the levels are synchronized here
+		command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_depth_reduce_pipeline);
+
+		vk::MemoryBarrier level_barrier = {};
+		level_barrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+		level_barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+
+		// level 0 reduces the rendered area of the depth buffer (the whole buffer without dynamic resolution)
+		uint32_t input_size[2] = {m_render_extent.width, m_render_extent.height};
+
+		for (uint32_t level = 0; level < m_depth_pyramid_mip_count; level++)
+		{
+			const uint32_t level_width = std::max(1u, m_depth_pyramid_extent.width >> level);
+			const uint32_t level_height = std::max(1u, m_depth_pyramid_extent.height >> level);
+
+			command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_depth_reduce_pipeline_layout, 0, 1, &m_depth_reduce_descriptor_sets[level], 0, nullptr);
+			command_buffer.pushConstants(m_depth_reduce_pipeline_layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(input_size), input_size);
+			command_buffer.dispatch((level_width + 7) / 8, (level_height + 7) / 8, 1);
+
+			input_size[0] = level_width;
+			input_size[1] = level_height;
+
+			// each level is the input of the next one
+			if (level + 1 < m_depth_pyramid_mip_count)
+			{
+				command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, {}, level_barrier, nullptr, nullptr);
 			}
-			
-			command_buffer.draw(static_cast<uint32_t>(game_object.m_mesh->m_vertices.size()), 1, 0, i);
 		}
 	}
 
@@ -959,7 +4356,48 @@ namespace halo
 		return m_frames[m_frame_number % MAX_FRAMES_IN_FLIGHT];
 	}
 
-	AllocatedBuffer Engine::create_buffer(size_t allocation_size, vk::BufferUsageFlagBits usage, VmaMemoryUsage memory_usage)
+	void Engine::wait_for_frame(FrameData& frame_data)
+	{
+		if (m_timeline_sync_enabled)
+		{
+			VK_CHECK(m_graphics_timeline.wait(frame_data.m_submission_value, ONE_SECOND));
+			return;
+		}
+
+		VK_CHECK(m_device.waitForFences(frame_data.m_render_fence, true, ONE_SECOND));
+		m_completed_submission_value = std::max(m_completed_submission_value, frame_data.m_submission_value);
+	}
+
+	uint64_t Engine::get_pending_submission_value() const
+	{
+		if (m_timeline_sync_enabled)
+		{
+			return m_graphics_timeline.get_last_signal_value() + 1;
+		}
+
+		return static_cast<uint64_t>(m_frame_number) + 1;
+	}
+
+	uint64_t Engine::get_completed_submission_value()
+	{
+		if (m_timeline_sync_enabled)
+		{
+			return m_graphics_timeline.get_completed_value();
+		}
+
+		// non blocking poll of the in flight frames' fences.
+		for (FrameData& frame_data : m_frames)
+		{
+			if (frame_data.m_submission_value > m_completed_submission_value && m_device.getFenceStatus(frame_data.m_render_fence) == vk::Result::eSuccess)
+			{
+				m_completed_submission_value = frame_data.m_submission_value;
+			}
+		}
+
+		return m_completed_submission_value;
+	}
+
+	AllocatedBuffer Engine::create_buffer(size_t allocation_size, vk::BufferUsageFlags usage, VmaMemoryUsage memory_usage)
 	{
 		vk::BufferCreateInfo buffer_create_info = {};
 		buffer_create_info.size = allocation_size;
@@ -975,8 +4413,10 @@ namespace halo
 		VK_CHECK(vmaCreateBuffer(m_vma_allocator, &create_info, &allocation_create_info, &buffer, &allocated_buffer.m_allocation_data, nullptr));
 
 		allocated_buffer.m_buffer = buffer;
+		allocated_buffer.m_size = allocation_size;
+		allocated_buffer.m_usage = usage;
 
-		m_deletion_list.push_function(CREATE_LAMBDA_FUNCTION(vmaDestroyBuffer(m_vma_allocator, static_cast<VkBuffer>(allocated_buffer.m_buffer), allocated_buffer.m_allocation_data)));
+		m_deletion_queue.push(allocated_buffer);
 		return allocated_buffer;
 	}
 
@@ -1003,8 +4443,38 @@ namespace halo
 		{
 			m_device.destroySwapchainKHR(m_swapchain);
 
-			// clear deletion list
-			m_deletion_list.clear_deletor_list();
+			// the allocations of a running defragmentation can only be freed once it ends
+			finish_defragmentation();
+
+			// resources still in the pools are owned by the engine until shutdown
+			for (const AllocatedBuffer& buffer : m_buffers.get_dense())
+			{
+				m_deletion_queue.push(buffer);
+			}
+
+			for (const AllocatedImage& image : m_images.get_dense())
+			{
+				m_deletion_queue.push(image);
+			}
+
+			// pushed after the images, so views are destroyed first
+			for (const Texture& texture : m_textures.get_dense())
+			{
+				m_deletion_queue.push(texture.m_view);
+			}
+
+			// destroy everything left in the deletion queue
+			m_deletion_queue.flush_all();
+
+			m_render_graph.clean();
+
+			for (FrameData& frame_data : m_frames)
+			{
+				frame_data.m_descriptor_allocator.clean();
+			}
+
+			m_descriptor_allocator.clean();
+			m_descriptor_layout_cache.clean();
 		}
 
 		vmaDestroyAllocator(m_vma_allocator);
@@ -88,12 +88,12 @@ namespace halo::init
 		return create_info;
 	}
 
-	vk::PipelineMultisampleStateCreateInfo create_multisampling_info()
+	vk::PipelineMultisampleStateCreateInfo create_multisampling_info(vk::SampleCountFlagBits samples)
 	{
 		vk::PipelineMultisampleStateCreateInfo create_info = {};
 
 		create_info.sampleShadingEnable = false;
-		create_info.rasterizationSamples = vk::SampleCountFlagBits::e1;
+		create_info.rasterizationSamples = samples;
 		create_info.minSampleShading = 1.0f;
 		create_info.pSampleMask = nullptr;
 		create_info.alphaToCoverageEnable = false;
@@ -140,7 +140,7 @@ namespace halo::init
 		return create_info;
 	}
 
-	vk::ImageCreateInfo create_image_info(vk::Format format, vk::Extent3D extent, vk::ImageUsageFlagBits usage)
+	vk::ImageCreateInfo create_image_info(vk::Format format, vk::Extent3D extent, vk::ImageUsageFlags usage)
 	{
 		vk::ImageCreateInfo  create_info = {};
 
@@ -213,4 +213,33 @@ namespace halo::init
 
 		return descriptor_set_write;
 	}
+
+	vk::WriteDescriptorSet write_descriptor_image(vk::DescriptorType type, vk::DescriptorSet descriptor_set, vk::DescriptorImageInfo* image_info, uint32_t binding)
+	{
+		vk::WriteDescriptorSet descriptor_set_write{};
+		descriptor_set_write.dstBinding = binding;
+		descriptor_set_write.dstSet = descriptor_set;
+		descriptor_set_write.descriptorCount = 1;
+		descriptor_set_write.descriptorType = type;
+		descriptor_set_write.pImageInfo = image_info;
+
+		return descriptor_set_write;
+	}
+
+	vk::SamplerCreateInfo create_sampler_info(vk::Filter filter, vk::SamplerAddressMode address_mode)
+	{
+		vk::SamplerCreateInfo create_info = {};
+		create_info.magFilter = filter;
+		create_info.minFilter = filter;
+		create_info.mipmapMode = filter == vk::Filter::eLinear ? vk::SamplerMipmapMode::eLinear : vk::SamplerMipmapMode::eNearest;
+
+		create_info.addressModeU = address_mode;
+		create_info.addressModeV = address_mode;
+		create_info.addressModeW = address_mode;
+
+		create_info.minLod = 0.0f;
+		create_info.maxLod = VK_LOD_CLAMP_NONE;
+
+		return create_info;
+	}
 }
\ No newline at end of file
@@ -0,0 +1,141 @@
+#include "../include/job_system.h"
+
+#include <algorithm>
+
+namespace halo
+{
+	JobSystem::JobSystem(uint32_t worker_count)
+	{
+		if (worker_count == 0)
+		{
+			const uint32_t hardware_thread_count = std::thread::hardware_concurrency();
+			worker_count = hardware_thread_count > 1 ? hardware_thread_count - 1 : 0;
+		}
+
+		m_workers.reserve(worker_count);
+		for (uint32_t i = 0; i < worker_count; i++)
+		{
+			m_workers.emplace_back(&JobSystem::worker_loop, this);
+		}
+	}
+
+	JobSystem::~JobSystem()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_quit = true;
+		}
+
+		m_job_condition.notify_all();
+
+		for (std::thread& worker : m_workers)
+		{
+			worker.join();
+		}
+	}
+
+	void JobSystem::parallel_for(size_t count, size_t batch_size, const std::function<void(size_t, size_t)>& function)
+	{
+		if (count == 0)
+		{
+			return;
+		}
+
+		batch_size = std::max<size_t>(batch_size, 1);
+		const size_t batch_count = (count + batch_size - 1) / batch_size;
+
+		// not worth waking up the workers for a single batch
+		if (batch_count == 1 || m_workers.empty())
+		{
+			function(0, count);
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			m_function = &function;
+			m_count = count;
+			m_batch_size = batch_size;
+			m_batch_count = batch_count;
+
+			m_next_batch = 0;
+			m_remaining_batches = batch_count;
+
+			m_job_id++;
+		}
+
+		m_job_condition.notify_all();
+
+		execute_batches(function);
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_done_condition.wait(lock, [&]() { return m_remaining_batches == 0 && m_active_workers == 0; });
+
+		m_function = nullptr;
+	}
+
+	uint32_t JobSystem::get_thread_count() const
+	{
+		return static_cast<uint32_t>(m_workers.size()) + 1;
+	}
+
+	void JobSystem::worker_loop()
+	{
+		uint64_t last_job_id = 0;
+
+		while (true)
+		{
+			const std::function<void(size_t, size_t)>* function = nullptr;
+
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_job_condition.wait(lock, [&]() { return m_quit || m_job_id != last_job_id; });
+
+				if (m_quit)
+				{
+					return;
+				}
+
+				last_job_id = m_job_id;
+				function = m_function;
+
+				// job was already finished by the other threads
+				if (function == nullptr)
+				{
+					continue;
+				}
+
+				m_active_workers++;
+			}
+
+			execute_batches(*function);
+
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_active_workers--;
+			}
+
+			m_done_condition.notify_all();
+		}
+	}
+
+	void JobSystem::execute_batches(const std::function<void(size_t, size_t)>& function)
+	{
+		while (true)
+		{
+			const size_t batch = m_next_batch.fetch_add(1);
+			if (batch >= m_batch_count)
+			{
+				return;
+			}
+
+			const size_t begin = batch * m_batch_size;
+			const size_t end = std::min(begin + m_batch_size, m_count);
+
+			function(begin, end);
+
+			m_remaining_batches.fetch_sub(1);
+		}
+	}
+}
@@ -6,6 +6,14 @@ int main(int argc, char** argv)
 	config.m_window_width = 1080;
 	config.m_window_height = 720;
 	config.m_window_name = "halo";
+	config.m_present_mode = halo::PresentMode::FifoRelaxed;
+	config.m_low_latency_mode = false;
+	config.m_use_timeline_semaphores = false;
+	config.m_occlusion_culling = true;
+	config.m_depth_prepass = true;
+	config.m_optimize_meshes = true;
+	config.m_generate_mesh_lods = true;
+	config.m_scene_light_count = 512;
 
 	// will put most code into a App class in the future, after engine's core features are setup and ready
 	try
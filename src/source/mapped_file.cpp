@@ -0,0 +1,127 @@
+#include "../include/mapped_file.h"
+
+#include <utility>
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+namespace halo
+{
+	MappedFile::~MappedFile()
+	{
+		close();
+	}
+
+	MappedFile::MappedFile(MappedFile&& other) noexcept
+	{
+		*this = std::move(other);
+	}
+
+	MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+	{
+		if (this != &other)
+		{
+			close();
+
+			m_data = std::exchange(other.m_data, nullptr);
+			m_size = std::exchange(other.m_size, 0);
+			m_mapping_handle = std::exchange(other.m_mapping_handle, nullptr);
+		}
+
+		return *this;
+	}
+
+	bool MappedFile::open(const char *file_path)
+	{
+		close();
+
+#ifdef _WIN32
+		HANDLE file = CreateFileA(file_path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+
+		LARGE_INTEGER file_size;
+		if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0)
+		{
+			CloseHandle(file);
+			return false;
+		}
+
+		// the mapping keeps the file alive, so the file handle can be closed right away
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		CloseHandle(file);
+
+		if (mapping == nullptr)
+		{
+			return false;
+		}
+
+		void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (data == nullptr)
+		{
+			CloseHandle(mapping);
+			return false;
+		}
+
+		m_mapping_handle = mapping;
+		m_data = static_cast<const uint8_t*>(data);
+		m_size = static_cast<size_t>(file_size.QuadPart);
+#else
+		int file = ::open(file_path, O_RDONLY);
+		if (file < 0)
+		{
+			return false;
+		}
+
+		struct stat file_stat;
+		if (fstat(file, &file_stat) != 0 || file_stat.st_size == 0)
+		{
+			::close(file);
+			return false;
+		}
+
+		// the mapping stays valid after the descriptor is closed
+		void *data = mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+		::close(file);
+
+		if (data == MAP_FAILED)
+		{
+			return false;
+		}
+
+		m_data = static_cast<const uint8_t*>(data);
+		m_size = static_cast<size_t>(file_stat.st_size);
+#endif
+
+		return true;
+	}
+
+	void MappedFile::close()
+	{
+		if (m_data == nullptr)
+		{
+			return;
+		}
+
+#ifdef _WIN32
+		UnmapViewOfFile(m_data);
+		CloseHandle(static_cast<HANDLE>(m_mapping_handle));
+#else
+		munmap(const_cast<uint8_t*>(m_data), m_size);
+#endif
+
+		m_data = nullptr;
+		m_size = 0;
+		m_mapping_handle = nullptr;
+	}
+}
@@ -3,56 +3,267 @@
 #include <tiny_obj_loader.h>
 
 #include <string>
+#include <filesystem>
 #include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
 
 namespace halo
 {
-	VertexInputLayoutDescription Vertex::get_vertex_input_layout_description()
+	namespace
 	{
-		VertexInputLayoutDescription input_layout_desc = {};
+		// float to IEEE half, rounding to nearest even
+		uint16_t float_to_half(float value)
+		{
+			uint32_t bits;
+			memcpy(&bits, &value, sizeof(float));
 
-		// one main vertex binding
-		vk::VertexInputBindingDescription m_primary_binding_desc = {};
-		m_primary_binding_desc.inputRate = vk::VertexInputRate::eVertex;
-		m_primary_binding_desc.stride = sizeof(Vertex);
-		m_primary_binding_desc.binding = 0;
+			uint32_t sign = (bits >> 16) & 0x8000;
+			uint32_t float_exponent = (bits >> 23) & 0xff;
+			uint32_t mantissa = bits & 0x7fffff;
 
-		input_layout_desc.m_bindings.push_back(m_primary_binding_desc);
+			int32_t exponent = static_cast<int32_t>(float_exponent) - 127 + 15;
 
-		// attribute "position" at location 0
-		vk::VertexInputAttributeDescription position_attribute_desc = {};
-		position_attribute_desc.binding  = 0;
-		position_attribute_desc.format = vk::Format::eR32G32B32Sfloat;
-		position_attribute_desc.location = 0;
-		position_attribute_desc.offset = offsetof(Vertex, m_position);
+			// inf / nan
+			if (float_exponent == 0xff)
+			{
+				return static_cast<uint16_t>(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+			}
+
+			// too large : inf
+			if (exponent >= 31)
+			{
+				return static_cast<uint16_t>(sign | 0x7c00);
+			}
+
+			// subnormal half (or zero)
+			if (exponent <= 0)
+			{
+				if (exponent < -10)
+				{
+					return static_cast<uint16_t>(sign);
+				}
+
+				mantissa |= 0x800000;
+
+				uint32_t shift = static_cast<uint32_t>(14 - exponent);
+				uint32_t half_mantissa = mantissa >> shift;
+				uint32_t remainder = mantissa & ((1u << shift) - 1);
+				uint32_t halfway = 1u << (shift - 1);
+
+				if (remainder > halfway || (remainder == halfway && (half_mantissa & 1)))
+				{
+					half_mantissa++;
+				}
+
+				return static_cast<uint16_t>(sign | half_mantissa);
+			}
+
+			uint32_t half = sign | (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+
+			// note : a carry out of the mantissa correctly bumps the exponent (and turns the largest values into inf)
+			uint32_t remainder = mantissa & 0x1fff;
+			if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+			{
+				half++;
+			}
+
+			return static_cast<uint16_t>(half);
+		}
+
+		int16_t float_to_snorm16(float value)
+		{
+			return static_cast<int16_t>(std::round(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+		}
+
+		uint8_t float_to_unorm8(float value)
+		{
+			return static_cast<uint8_t>(std::round(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+		}
+
+		// octahedral encoding : project onto the octahedron |x| + |y| + |z| = 1 and fold the lower half over the upper one.
+		void encode_octahedral(const math::V3& normal, float& out_x, float& out_y)
+		{
+			float l1_norm = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+			if (l1_norm == 0.0f)
+			{
+				out_x = 0.0f;
+				out_y = 0.0f;
+				return;
+			}
+
+			float x = normal.x / l1_norm;
+			float y = normal.y / l1_norm;
+
+			if (normal.z < 0.0f)
+			{
+				float folded_x = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+				float folded_y = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+
+				x = folded_x;
+				y = folded_y;
+			}
+
+			out_x = x;
+			out_y = y;
+		}
+
+		template <typename T>
+		void append(std::vector<uint8_t>& stream, const T& value)
+		{
+			size_t offset = stream.size();
+			stream.resize(offset + sizeof(T));
+			memcpy(stream.data() + offset, &value, sizeof(T));
+		}
+	}
+
+	uint32_t VertexLayout::get_position_stride() const
+	{
+		return m_position_format == VertexPositionFormat::Float16 ? sizeof(uint16_t) * 4 : sizeof(float) * 3;
+	}
+
+	uint32_t VertexLayout::get_attribute_stride() const
+	{
+		uint32_t normal_size = m_octahedral_normals ? sizeof(int16_t) * 2 : sizeof(float) * 3;
+		uint32_t color_size = m_unorm8_colors ? sizeof(uint8_t) * 4 : sizeof(float) * 3;
+		uint32_t uv_size = m_half_uvs ? sizeof(uint16_t) * 2 : sizeof(float) * 2;
+
+		return normal_size + color_size + uv_size;
+	}
+
+	VertexInputLayoutDescription Vertex::get_vertex_input_layout_description(const VertexLayout& vertex_layout)
+	{
+		VertexInputLayoutDescription input_layout_desc = get_position_input_layout_description(vertex_layout);
+
+		// binding 1 : interleaved normal, color and uv
+		vk::VertexInputBindingDescription attribute_binding_desc = {};
+		attribute_binding_desc.inputRate = vk::VertexInputRate::eVertex;
+		attribute_binding_desc.stride = vertex_layout.get_attribute_stride();
+		attribute_binding_desc.binding = 1;
+
+		input_layout_desc.m_bindings.push_back(attribute_binding_desc);
 
 		// attribute normal at location 1
 		vk::VertexInputAttributeDescription normal_attribute_desc = {};
-		normal_attribute_desc.binding = 0;
-		normal_attribute_desc.format = vk::Format::eR32G32B32Sfloat;
+		normal_attribute_desc.binding = 1;
+		normal_attribute_desc.format = vertex_layout.m_octahedral_normals ? vk::Format::eR16G16Snorm : vk::Format::eR32G32B32Sfloat;
 		normal_attribute_desc.location = 1;
-		normal_attribute_desc.offset  = offsetof(Vertex, m_normal);
+		normal_attribute_desc.offset = 0;
 
 		// attribute color at location 2
 		vk::VertexInputAttributeDescription color_attribute_desc = {};
-		color_attribute_desc.binding = 0;
-		color_attribute_desc.format = vk::Format::eR32G32B32Sfloat;
+		color_attribute_desc.binding = 1;
+		color_attribute_desc.format = vertex_layout.m_unorm8_colors ? vk::Format::eR8G8B8A8Unorm : vk::Format::eR32G32B32Sfloat;
 		color_attribute_desc.location = 2;
-		color_attribute_desc.offset = offsetof(Vertex, m_color);
+		color_attribute_desc.offset = vertex_layout.m_octahedral_normals ? sizeof(int16_t) * 2 : sizeof(float) * 3;
+
+		// attribute uv at location 3
+		vk::VertexInputAttributeDescription uv_attribute_desc = {};
+		uv_attribute_desc.binding = 1;
+		uv_attribute_desc.format = vertex_layout.m_half_uvs ? vk::Format::eR16G16Sfloat : vk::Format::eR32G32Sfloat;
+		uv_attribute_desc.location = 3;
+		uv_attribute_desc.offset = color_attribute_desc.offset + (vertex_layout.m_unorm8_colors ? sizeof(uint8_t) * 4 : sizeof(float) * 3);
 
-		input_layout_desc.m_attributes.clear();
-		input_layout_desc.m_attributes.push_back(position_attribute_desc);
 		input_layout_desc.m_attributes.push_back(normal_attribute_desc);
 		input_layout_desc.m_attributes.push_back(color_attribute_desc);
+		input_layout_desc.m_attributes.push_back(uv_attribute_desc);
+
+		return input_layout_desc;
+	}
+
+	VertexInputLayoutDescription Vertex::get_position_input_layout_description(const VertexLayout& vertex_layout)
+	{
+		VertexInputLayoutDescription input_layout_desc = {};
+
+		// binding 0 : positions only
+		vk::VertexInputBindingDescription position_binding_desc = {};
+		position_binding_desc.inputRate = vk::VertexInputRate::eVertex;
+		position_binding_desc.stride = vertex_layout.get_position_stride();
+		position_binding_desc.binding = 0;
+
+		input_layout_desc.m_bindings.push_back(position_binding_desc);
+
+		// attribute "position" at location 0
+		vk::VertexInputAttributeDescription position_attribute_desc = {};
+		position_attribute_desc.binding = 0;
+		position_attribute_desc.format = vertex_layout.m_position_format == VertexPositionFormat::Float16 ? vk::Format::eR16G16B16A16Sfloat : vk::Format::eR32G32B32Sfloat;
+		position_attribute_desc.location = 0;
+		position_attribute_desc.offset = 0;
+
+		input_layout_desc.m_attributes.push_back(position_attribute_desc);
 
 		return input_layout_desc;
 	}
 
+	void pack_vertices(const std::vector<Vertex>& vertices, const VertexLayout& vertex_layout, std::vector<uint8_t>& position_stream, std::vector<uint8_t>& attribute_stream)
+	{
+		position_stream.clear();
+		attribute_stream.clear();
+
+		position_stream.reserve(vertices.size() * vertex_layout.get_position_stride());
+		attribute_stream.reserve(vertices.size() * vertex_layout.get_attribute_stride());
+
+		for (const Vertex& vertex : vertices)
+		{
+			if (vertex_layout.m_position_format == VertexPositionFormat::Float16)
+			{
+				uint16_t position[4] = {float_to_half(vertex.m_position.x), float_to_half(vertex.m_position.y), float_to_half(vertex.m_position.z), float_to_half(1.0f)};
+				append(position_stream, position);
+			}
+			else
+			{
+				float position[3] = {vertex.m_position.x, vertex.m_position.y, vertex.m_position.z};
+				append(position_stream, position);
+			}
+
+			if (vertex_layout.m_octahedral_normals)
+			{
+				float octahedral_x, octahedral_y;
+				encode_octahedral(vertex.m_normal, octahedral_x, octahedral_y);
+
+				int16_t normal[2] = {float_to_snorm16(octahedral_x), float_to_snorm16(octahedral_y)};
+				append(attribute_stream, normal);
+			}
+			else
+			{
+				float normal[3] = {vertex.m_normal.x, vertex.m_normal.y, vertex.m_normal.z};
+				append(attribute_stream, normal);
+			}
+
+			if (vertex_layout.m_unorm8_colors)
+			{
+				uint8_t color[4] = {float_to_unorm8(vertex.m_color.r), float_to_unorm8(vertex.m_color.g), float_to_unorm8(vertex.m_color.b), 255};
+				append(attribute_stream, color);
+			}
+			else
+			{
+				float color[3] = {vertex.m_color.r, vertex.m_color.g, vertex.m_color.b};
+				append(attribute_stream, color);
+			}
+
+			if (vertex_layout.m_half_uvs)
+			{
+				uint16_t uv[2] = {float_to_half(vertex.m_uv.x), float_to_half(vertex.m_uv.y)};
+				append(attribute_stream, uv);
+			}
+			else
+			{
+				float uv[2] = {vertex.m_uv.x, vertex.m_uv.y};
+				append(attribute_stream, uv);
+			}
+		}
+	}
+
 	void Mesh::load_obj_from_file(const char* file_path)
 	{
 		// code from the example code (new oop based api) from tinyobjloader's github : https://github.com/tinyobjloader/tinyobjloader
 		tinyobj::ObjReaderConfig reader_config;
-		reader_config.mtl_search_path = "./";
+
+		// .mtl files (and the textures they reference) are looked up next to the OBJ
+		const std::filesystem::path obj_directory = std::filesystem::path(file_path).parent_path();
+		reader_config.mtl_search_path = obj_directory.string();
 		
 		tinyobj::ObjReader reader;
 		if (!reader.ParseFromFile(std::string(file_path), reader_config))
@@ -71,7 +282,41 @@ namespace halo
 		auto& attrib = reader.GetAttrib();
 		auto& shapes = reader.GetShapes();
 
-		[[maybe_unused]] auto& materials = reader.GetMaterials();
+		auto& materials = reader.GetMaterials();
+
+		// note : only one material per mesh for now, so the first one with a diffuse texture is used for the whole mesh.
+		for (const tinyobj::material_t& material : materials)
+		{
+			if (!material.diffuse_texname.empty())
+			{
+				m_diffuse_texture_path = (obj_directory / material.diffuse_texname).string();
+				break;
+			}
+		}
+
+		// face corners sharing position, normal and uv become one indexed vertex
+		struct VertexKey
+		{
+			int m_vertex_index;
+			int m_normal_index;
+			int m_texcoord_index;
+
+			bool operator==(const VertexKey&) const = default;
+		};
+
+		struct VertexKeyHash
+		{
+			size_t operator()(const VertexKey& key) const
+			{
+				uint64_t hash = static_cast<uint32_t>(key.m_vertex_index);
+				hash = hash * 0x9e3779b97f4a7c15ull + static_cast<uint32_t>(key.m_normal_index);
+				hash = hash * 0x9e3779b97f4a7c15ull + static_cast<uint32_t>(key.m_texcoord_index);
+
+				return static_cast<size_t>(hash ^ (hash >> 32));
+			}
+		};
+
+		std::unordered_map<VertexKey, uint32_t, VertexKeyHash> unique_vertices;
 
 		// loop over all shapes
 		for (size_t s = 0; s < shapes.size(); s++)
@@ -109,12 +354,27 @@ namespace halo
 					vertex.m_normal.y = ny;
 					vertex.m_normal.z = nz;
 
-					// note : setting colors to be normals for debuggin purposes.
-					vertex.m_color.r = nx;
-					vertex.m_color.g = ny;
-					vertex.m_color.b = nz;
+					// note : setting colors to be normals for debuggin purposes (remapped to [0, 1] so they survive unorm color formats).
+					vertex.m_color.r = nx * 0.5f + 0.5f;
+					vertex.m_color.g = ny * 0.5f + 0.5f;
+					vertex.m_color.b = nz * 0.5f + 0.5f;
 
-					m_vertices.push_back(vertex);
+					// OBJ uvs have a bottom left origin, vulkan images a top left one
+					if (index.texcoord_index >= 0)
+					{
+						vertex.m_uv.x = attrib.texcoords[2 * size_t(index.texcoord_index) + 0];
+						vertex.m_uv.y = 1.0f - attrib.texcoords[2 * size_t(index.texcoord_index) + 1];
+					}
+
+					VertexKey vertex_key{index.vertex_index, index.normal_index, index.texcoord_index};
+
+					auto [unique_vertex, inserted] = unique_vertices.try_emplace(vertex_key, static_cast<uint32_t>(m_vertices.size()));
+					if (inserted)
+					{
+						m_vertices.push_back(vertex);
+					}
+
+					m_indices.push_back(unique_vertex->second);
 				}
 
 				index_offset += fv;
@@ -122,5 +382,13 @@ namespace halo
 				[[maybe_unused]] auto unused = shapes[s].mesh.material_ids[f];
 			}
 		}
+
+		compute_bounds();
+	}
+
+	void Mesh::compute_bounds()
+	{
+		const float *first_position = m_vertices.empty() ? nullptr : &m_vertices[0].m_position.x;
+		halo::compute_bounds(first_position, sizeof(Vertex), m_vertices.size(), m_aabb, m_bounding_sphere);
 	}
-}
\ No newline at end of file
+}
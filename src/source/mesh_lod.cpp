@@ -0,0 +1,516 @@
+#include "../include/mesh_lod.h"
+#include "../include/mesh_optimizer.h"
+#include "../include/camera.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+
+namespace halo
+{
+	namespace
+	{
+		// border edges are constrained by a plane through the edge, perpendicular to the face, weighted so borders barely move.
+		constexpr float BORDER_WEIGHT = 10.0f;
+
+		// sum of squared distances to a set of planes, as the 10 unique coefficients of a symmetric 4 x 4 matrix. m_weight is the sum of the planes' weights.
+		struct Quadric
+		{
+			float m_a00, m_a11, m_a22;
+			float m_a01, m_a02, m_a12;
+			float m_b0, m_b1, m_b2;
+			float m_c;
+			float m_weight;
+		};
+
+		struct Collapse
+		{
+			uint32_t m_from;
+			uint32_t m_to;
+
+			// squared distance
+			float m_error;
+		};
+
+		Quadric make_plane_quadric(const float normal[3], float distance, float weight)
+		{
+			Quadric quadric{};
+			quadric.m_a00 = normal[0] * normal[0] * weight;
+			quadric.m_a11 = normal[1] * normal[1] * weight;
+			quadric.m_a22 = normal[2] * normal[2] * weight;
+			quadric.m_a01 = normal[0] * normal[1] * weight;
+			quadric.m_a02 = normal[0] * normal[2] * weight;
+			quadric.m_a12 = normal[1] * normal[2] * weight;
+			quadric.m_b0 = normal[0] * distance * weight;
+			quadric.m_b1 = normal[1] * distance * weight;
+			quadric.m_b2 = normal[2] * distance * weight;
+			quadric.m_c = distance * distance * weight;
+			quadric.m_weight = weight;
+
+			return quadric;
+		}
+
+		void add_quadric(Quadric& quadric, const Quadric& other)
+		{
+			quadric.m_a00 += other.m_a00;
+			quadric.m_a11 += other.m_a11;
+			quadric.m_a22 += other.m_a22;
+			quadric.m_a01 += other.m_a01;
+			quadric.m_a02 += other.m_a02;
+			quadric.m_a12 += other.m_a12;
+			quadric.m_b0 += other.m_b0;
+			quadric.m_b1 += other.m_b1;
+			quadric.m_b2 += other.m_b2;
+			quadric.m_c += other.m_c;
+			quadric.m_weight += other.m_weight;
+		}
+
+		// weighted mean of the squared distances from the position to the quadric's planes
+		float evaluate_quadric(const Quadric& quadric, const math::V3& position)
+		{
+			float x = position.x;
+			float y = position.y;
+			float z = position.z;
+
+			float result = quadric.m_a00 * x * x + quadric.m_a11 * y * y + quadric.m_a22 * z * z;
+			result += 2.0f * (quadric.m_a01 * x * y + quadric.m_a02 * x * z + quadric.m_a12 * y * z);
+			result += 2.0f * (quadric.m_b0 * x + quadric.m_b1 * y + quadric.m_b2 * z);
+			result += quadric.m_c;
+
+			return quadric.m_weight > 0.0f ? std::abs(result) / quadric.m_weight : 0.0f;
+		}
+
+		void triangle_normal(const math::V3& a, const math::V3& b, const math::V3& c, float normal[3])
+		{
+			float ab[3] = {b.x - a.x, b.y - a.y, b.z - a.z};
+			float ac[3] = {c.x - a.x, c.y - a.y, c.z - a.z};
+
+			normal[0] = ab[1] * ac[2] - ab[2] * ac[1];
+			normal[1] = ab[2] * ac[0] - ab[0] * ac[2];
+			normal[2] = ab[0] * ac[1] - ab[1] * ac[0];
+		}
+
+		uint64_t edge_key(uint32_t a, uint32_t b)
+		{
+			return a < b ? (static_cast<uint64_t>(a) << 32) | b : (static_cast<uint64_t>(b) << 32) | a;
+		}
+
+		// canonical[v] : first vertex with the same position as v. Vertices sharing a position form a circular list through wedges.
+		void build_position_remap(const std::vector<Vertex>& vertices, std::vector<uint32_t>& canonical, std::vector<uint32_t>& wedges)
+		{
+			struct PositionHash
+			{
+				size_t operator()(const std::array<uint32_t, 3>& bits) const
+				{
+					return (static_cast<size_t>(bits[0]) * 73856093u) ^ (static_cast<size_t>(bits[1]) * 19349663u) ^ (static_cast<size_t>(bits[2]) * 83492791u);
+				}
+			};
+
+			std::unordered_map<std::array<uint32_t, 3>, uint32_t, PositionHash> first_vertex;
+			first_vertex.reserve(vertices.size());
+
+			canonical.resize(vertices.size());
+			wedges.resize(vertices.size());
+
+			for (uint32_t vertex = 0; vertex < vertices.size(); vertex++)
+			{
+				std::array<uint32_t, 3> bits;
+				memcpy(&bits[0], &vertices[vertex].m_position.x, sizeof(float));
+				memcpy(&bits[1], &vertices[vertex].m_position.y, sizeof(float));
+				memcpy(&bits[2], &vertices[vertex].m_position.z, sizeof(float));
+
+				uint32_t first = first_vertex.try_emplace(bits, vertex).first->second;
+
+				canonical[vertex] = first;
+				wedges[vertex] = vertex;
+
+				if (first != vertex)
+				{
+					wedges[vertex] = wedges[first];
+					wedges[first] = vertex;
+				}
+			}
+		}
+	}
+
+	std::vector<uint32_t> simplify(const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, size_t target_index_count, float target_error, float& out_error)
+	{
+		out_error = 0.0f;
+
+		std::vector<uint32_t> result = indices;
+		if (result.size() <= target_index_count)
+		{
+			return result;
+		}
+
+		const size_t vertex_count = vertices.size();
+
+		std::vector<uint32_t> canonical;
+		std::vector<uint32_t> wedges;
+		build_position_remap(vertices, canonical, wedges);
+
+		// quadrics (indexed by canonical vertex) : planes of the surrounding faces, weighted by area
+		std::vector<Quadric> quadrics(vertex_count, Quadric{});
+		std::unordered_map<uint64_t, uint32_t> edge_use_counts;
+
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			uint32_t corners[3] = {canonical[result[i + 0]], canonical[result[i + 1]], canonical[result[i + 2]]};
+
+			const math::V3& a = vertices[corners[0]].m_position;
+			const math::V3& b = vertices[corners[1]].m_position;
+			const math::V3& c = vertices[corners[2]].m_position;
+
+			for (int edge = 0; edge < 3; edge++)
+			{
+				edge_use_counts[edge_key(corners[edge], corners[(edge + 1) % 3])]++;
+			}
+
+			float normal[3];
+			triangle_normal(a, b, c, normal);
+
+			float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+			if (length == 0.0f)
+			{
+				continue;
+			}
+
+			for (float& component : normal)
+			{
+				component /= length;
+			}
+
+			float distance = -(normal[0] * a.x + normal[1] * a.y + normal[2] * a.z);
+			Quadric face_quadric = make_plane_quadric(normal, distance, length * 0.5f);
+
+			for (uint32_t corner : corners)
+			{
+				add_quadric(quadrics[corner], face_quadric);
+			}
+		}
+
+		// border edges (used by a single face) get a constraint plane perpendicular to the face
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			uint32_t corners[3] = {canonical[result[i + 0]], canonical[result[i + 1]], canonical[result[i + 2]]};
+
+			float normal[3];
+			triangle_normal(vertices[corners[0]].m_position, vertices[corners[1]].m_position, vertices[corners[2]].m_position, normal);
+
+			float normal_length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+			if (normal_length == 0.0f)
+			{
+				continue;
+			}
+
+			for (int edge = 0; edge < 3; edge++)
+			{
+				uint32_t from = corners[edge];
+				uint32_t to = corners[(edge + 1) % 3];
+
+				if (edge_use_counts[edge_key(from, to)] != 1)
+				{
+					continue;
+				}
+
+				const math::V3& p0 = vertices[from].m_position;
+				const math::V3& p1 = vertices[to].m_position;
+
+				float edge_direction[3] = {p1.x - p0.x, p1.y - p0.y, p1.z - p0.z};
+				float edge_length_squared = edge_direction[0] * edge_direction[0] + edge_direction[1] * edge_direction[1] + edge_direction[2] * edge_direction[2];
+
+				float plane_normal[3] =
+				{
+					edge_direction[1] * normal[2] - edge_direction[2] * normal[1],
+					edge_direction[2] * normal[0] - edge_direction[0] * normal[2],
+					edge_direction[0] * normal[1] - edge_direction[1] * normal[0]
+				};
+
+				float plane_normal_length = std::sqrt(plane_normal[0] * plane_normal[0] + plane_normal[1] * plane_normal[1] + plane_normal[2] * plane_normal[2]);
+				if (plane_normal_length == 0.0f)
+				{
+					continue;
+				}
+
+				for (float& component : plane_normal)
+				{
+					component /= plane_normal_length;
+				}
+
+				float distance = -(plane_normal[0] * p0.x + plane_normal[1] * p0.y + plane_normal[2] * p0.z);
+				Quadric border_quadric = make_plane_quadric(plane_normal, distance, edge_length_squared * BORDER_WEIGHT);
+
+				add_quadric(quadrics[from], border_quadric);
+				add_quadric(quadrics[to], border_quadric);
+			}
+		}
+
+		// best wedge of the target position for a vertex being collapsed (closest normal, so seams keep their attributes as much as possible)
+		auto find_wedge = [&](uint32_t vertex, uint32_t target)
+		{
+			const math::V3& normal = vertices[vertex].m_normal;
+
+			uint32_t best_wedge = target;
+			float best_dot = -std::numeric_limits<float>::max();
+
+			uint32_t wedge = target;
+			do
+			{
+				const math::V3& wedge_normal = vertices[wedge].m_normal;
+				float dot = normal.x * wedge_normal.x + normal.y * wedge_normal.y + normal.z * wedge_normal.z;
+				if (dot > best_dot)
+				{
+					best_dot = dot;
+					best_wedge = wedge;
+				}
+
+				wedge = wedges[wedge];
+			} while (wedge != target);
+
+			return best_wedge;
+		};
+
+		const float target_error_squared = target_error < std::sqrt(std::numeric_limits<float>::max()) ? target_error * target_error : std::numeric_limits<float>::max();
+		float max_error_squared = 0.0f;
+
+		std::vector<Collapse> collapses;
+		std::vector<uint32_t> triangle_offsets(vertex_count + 1);
+		std::vector<uint32_t> adjacent_triangles;
+		std::vector<uint8_t> is_locked(vertex_count);
+		std::vector<uint32_t> collapse_targets(vertex_count);
+
+		// every pass collapses a batch of the cheapest edges whose vertices are not touched by another collapse of the batch, then rebuilds the triangles
+		while (result.size() > target_index_count)
+		{
+			const size_t triangle_count = result.size() / 3;
+
+			collapses.clear();
+			for (size_t i = 0; i < result.size(); i += 3)
+			{
+				for (int edge = 0; edge < 3; edge++)
+				{
+					uint32_t a = canonical[result[i + edge]];
+					uint32_t b = canonical[result[i + (edge + 1) % 3]];
+
+					// every interior edge is seen twice (once per direction) : keep one
+					if (a == b || (a > b && edge_use_counts[edge_key(a, b)] > 1))
+					{
+						continue;
+					}
+
+					Quadric quadric = quadrics[a];
+					add_quadric(quadric, quadrics[b]);
+
+					float error_to_b = evaluate_quadric(quadric, vertices[b].m_position);
+					float error_to_a = evaluate_quadric(quadric, vertices[a].m_position);
+
+					collapses.push_back(error_to_b <= error_to_a ? Collapse{a, b, error_to_b} : Collapse{b, a, error_to_a});
+				}
+			}
+
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& lhs, const Collapse& rhs)
+			{
+				return lhs.m_error < rhs.m_error;
+			});
+
+			// canonical vertex -> triangles of the current result
+			std::fill(triangle_offsets.begin(), triangle_offsets.end(), 0);
+			for (uint32_t index : result)
+			{
+				triangle_offsets[canonical[index] + 1]++;
+			}
+
+			for (size_t vertex = 0; vertex < vertex_count; vertex++)
+			{
+				triangle_offsets[vertex + 1] += triangle_offsets[vertex];
+			}
+
+			adjacent_triangles.resize(result.size());
+			{
+				std::vector<uint32_t> fill_offsets(triangle_offsets.begin(), triangle_offsets.end() - 1);
+				for (size_t i = 0; i < result.size(); i++)
+				{
+					adjacent_triangles[fill_offsets[canonical[result[i]]]++] = static_cast<uint32_t>(i / 3);
+				}
+			}
+
+			// a collapse is rejected if a remaining triangle around the moved vertex would flip
+			auto flips_triangles = [&](uint32_t from, uint32_t to)
+			{
+				for (uint32_t i = triangle_offsets[from]; i < triangle_offsets[from + 1]; i++)
+				{
+					uint32_t triangle = adjacent_triangles[i];
+					uint32_t corners[3] = {canonical[result[triangle * 3 + 0]], canonical[result[triangle * 3 + 1]], canonical[result[triangle * 3 + 2]]};
+
+					// triangles on the collapsed edge disappear
+					if (corners[0] == to || corners[1] == to || corners[2] == to)
+					{
+						continue;
+					}
+
+					float old_normal[3];
+					triangle_normal(vertices[corners[0]].m_position, vertices[corners[1]].m_position, vertices[corners[2]].m_position, old_normal);
+
+					for (uint32_t& corner : corners)
+					{
+						corner = corner == from ? to : corner;
+					}
+
+					float new_normal[3];
+					triangle_normal(vertices[corners[0]].m_position, vertices[corners[1]].m_position, vertices[corners[2]].m_position, new_normal);
+
+					if (old_normal[0] * new_normal[0] + old_normal[1] * new_normal[1] + old_normal[2] * new_normal[2] <= 0.0f)
+					{
+						return true;
+					}
+				}
+
+				return false;
+			};
+
+			std::fill(is_locked.begin(), is_locked.end(), 0);
+			for (uint32_t vertex = 0; vertex < vertex_count; vertex++)
+			{
+				collapse_targets[vertex] = vertex;
+			}
+
+			// each collapse removes about two triangles
+			const size_t collapse_goal = std::max<size_t>((triangle_count - target_index_count / 3) / 2, 1);
+			size_t collapse_count = 0;
+
+			for (const Collapse& collapse : collapses)
+			{
+				if (collapse.m_error > target_error_squared || collapse_count >= collapse_goal)
+				{
+					break;
+				}
+
+				if (is_locked[collapse.m_from] || is_locked[collapse.m_to] || flips_triangles(collapse.m_from, collapse.m_to))
+				{
+					continue;
+				}
+
+				collapse_targets[collapse.m_from] = collapse.m_to;
+				is_locked[collapse.m_from] = 1;
+				is_locked[collapse.m_to] = 1;
+
+				add_quadric(quadrics[collapse.m_to], quadrics[collapse.m_from]);
+				max_error_squared = std::max(max_error_squared, collapse.m_error);
+
+				collapse_count++;
+			}
+
+			if (collapse_count == 0)
+			{
+				break;
+			}
+
+			// move collapsed vertices and drop the triangles that became degenerate
+			std::vector<uint32_t> collapsed_result;
+			collapsed_result.reserve(result.size());
+
+			for (size_t i = 0; i < result.size(); i += 3)
+			{
+				uint32_t triangle[3];
+				for (int corner = 0; corner < 3; corner++)
+				{
+					uint32_t vertex = result[i + corner];
+					uint32_t target = collapse_targets[canonical[vertex]];
+
+					triangle[corner] = target == canonical[vertex] ? vertex : find_wedge(vertex, target);
+				}
+
+				if (canonical[triangle[0]] == canonical[triangle[1]] || canonical[triangle[1]] == canonical[triangle[2]] || canonical[triangle[0]] == canonical[triangle[2]])
+				{
+					continue;
+				}
+
+				collapsed_result.insert(collapsed_result.end(), triangle, triangle + 3);
+			}
+
+			result.swap(collapsed_result);
+
+			// edge use counts of the new topology (border classification stays as it was for the quadrics)
+			edge_use_counts.clear();
+			for (size_t i = 0; i < result.size(); i += 3)
+			{
+				for (int edge = 0; edge < 3; edge++)
+				{
+					edge_use_counts[edge_key(canonical[result[i + edge]], canonical[result[i + (edge + 1) % 3]])]++;
+				}
+			}
+		}
+
+		out_error = std::sqrt(max_error_squared);
+
+		return result;
+	}
+
+	void generate_lods(Mesh& mesh, uint32_t max_lod_count)
+	{
+		const std::vector<uint32_t> base_indices(mesh.m_indices.begin(), mesh.m_indices.end());
+
+		mesh.m_lods.clear();
+		mesh.m_lods.push_back(MeshLod{0, static_cast<uint32_t>(base_indices.size()), 0.0f});
+
+		size_t previous_index_count = base_indices.size();
+		float previous_error = 0.0f;
+
+		// every LOD is simplified from LOD 0, so its error is measured against the original surface
+		for (uint32_t lod = 1; lod < max_lod_count; lod++)
+		{
+			size_t target_index_count = previous_index_count / 2 / 3 * 3;
+			if (target_index_count < 3)
+			{
+				break;
+			}
+
+			float error = 0.0f;
+			std::vector<uint32_t> lod_indices = simplify(base_indices, mesh.m_vertices, target_index_count, std::numeric_limits<float>::max(), error);
+
+			// simplification got stuck (every remaining collapse would flip a triangle) : more LODs would not save anything
+			if (lod_indices.empty() || lod_indices.size() > previous_index_count * 3 / 4)
+			{
+				break;
+			}
+
+			optimize_vertex_cache(lod_indices, mesh.m_vertices.size());
+
+			previous_error = std::max(previous_error, error);
+			mesh.m_lods.push_back(MeshLod{static_cast<uint32_t>(mesh.m_indices.size()), static_cast<uint32_t>(lod_indices.size()), previous_error});
+
+			mesh.m_indices.insert(mesh.m_indices.end(), lod_indices.begin(), lod_indices.end());
+			previous_index_count = lod_indices.size();
+		}
+	}
+
+	const MeshLod& select_lod(const Mesh& mesh, const math::V4& world_sphere, const math::V3& camera_position, float projection_scale, float error_threshold)
+	{
+		// object scale from the ratio of the world / local bounding spheres
+		float scale = mesh.m_bounding_sphere.w > 0.0f ? world_sphere.w / mesh.m_bounding_sphere.w : 1.0f;
+
+		float dx = world_sphere.x - camera_position.x;
+		float dy = world_sphere.y - camera_position.y;
+		float dz = world_sphere.z - camera_position.z;
+
+		// distance to the closest point of the sphere (inside it, use the near plane so the error is as large as it gets)
+		float distance = std::max(std::sqrt(dx * dx + dy * dy + dz * dz) - world_sphere.w, CAMERA_NEAR_PLANE);
+
+		size_t selected_lod = 0;
+		for (size_t lod = 1; lod < mesh.m_lods.size(); lod++)
+		{
+			float projected_error = mesh.m_lods[lod].m_error * scale / distance * projection_scale;
+			if (projected_error > error_threshold)
+			{
+				break;
+			}
+
+			selected_lod = lod;
+		}
+
+		return mesh.m_lods[selected_lod];
+	}
+}
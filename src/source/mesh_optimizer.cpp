@@ -0,0 +1,497 @@
+#include "../include/mesh_optimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace halo
+{
+	namespace
+	{
+		// FIFO cache simulation : a vertex is in the cache if fewer than cache_size misses happened since it was last loaded.
+		class FifoCacheSimulator
+		{
+		public:
+			FifoCacheSimulator(size_t vertex_count, uint32_t cache_size)
+				: m_timestamps(vertex_count, 0), m_time(cache_size + 1), m_cache_size(cache_size)
+			{
+			}
+
+			// returns true on a cache miss
+			bool access(uint32_t vertex)
+			{
+				if (m_time - m_timestamps[vertex] > m_cache_size)
+				{
+					m_timestamps[vertex] = m_time++;
+					return true;
+				}
+
+				return false;
+			}
+
+			void flush()
+			{
+				m_time += m_cache_size + 1;
+			}
+
+		private:
+			std::vector<uint32_t> m_timestamps;
+			uint32_t m_time;
+			uint32_t m_cache_size;
+		};
+
+		uint32_t triangle_misses(FifoCacheSimulator& cache, const uint32_t *triangle)
+		{
+			return static_cast<uint32_t>(cache.access(triangle[0])) + static_cast<uint32_t>(cache.access(triangle[1])) + static_cast<uint32_t>(cache.access(triangle[2]));
+		}
+
+		// scoring constants from Forsyth's article
+		constexpr uint32_t FORSYTH_CACHE_SIZE = 32;
+		constexpr float CACHE_DECAY_POWER = 1.5f;
+		constexpr float LAST_TRIANGLE_SCORE = 0.75f;
+		constexpr float VALENCE_BOOST_SCALE = 2.0f;
+		constexpr float VALENCE_BOOST_POWER = 0.5f;
+
+		float forsyth_vertex_score(int32_t cache_position, uint32_t remaining_triangles)
+		{
+			// no triangle left to draw with this vertex
+			if (remaining_triangles == 0)
+			{
+				return -1.0f;
+			}
+
+			float score = 0.0f;
+			if (cache_position >= 0)
+			{
+				// vertices of the last triangle get a fixed score, so the next triangle does not simply reuse the same edge
+				if (cache_position < 3)
+				{
+					score = LAST_TRIANGLE_SCORE;
+				}
+				else
+				{
+					const float scaler = 1.0f / static_cast<float>(FORSYTH_CACHE_SIZE - 3);
+					score = std::pow(1.0f - static_cast<float>(cache_position - 3) * scaler, CACHE_DECAY_POWER);
+				}
+			}
+
+			// boost vertices with few triangles left, so lone triangles are not left behind
+			score += VALENCE_BOOST_SCALE * std::pow(static_cast<float>(remaining_triangles), -VALENCE_BOOST_POWER);
+
+			return score;
+		}
+	}
+
+	VertexCacheStatistics analyze_vertex_cache(const std::vector<uint32_t>& indices, size_t vertex_count, uint32_t cache_size)
+	{
+		VertexCacheStatistics statistics{};
+
+		size_t triangle_count = indices.size() / 3;
+		if (triangle_count == 0)
+		{
+			return statistics;
+		}
+
+		FifoCacheSimulator cache(vertex_count, cache_size);
+
+		uint32_t transformed_vertex_count = 0;
+		for (size_t triangle = 0; triangle < triangle_count; triangle++)
+		{
+			transformed_vertex_count += triangle_misses(cache, &indices[triangle * 3]);
+		}
+
+		std::vector<uint8_t> is_referenced(vertex_count, 0);
+		uint32_t referenced_vertex_count = 0;
+		for (uint32_t index : indices)
+		{
+			referenced_vertex_count += is_referenced[index] == 0;
+			is_referenced[index] = 1;
+		}
+
+		statistics.m_acmr = static_cast<float>(transformed_vertex_count) / static_cast<float>(triangle_count);
+		statistics.m_atvr = static_cast<float>(transformed_vertex_count) / static_cast<float>(referenced_vertex_count);
+
+		return statistics;
+	}
+
+	void optimize_vertex_cache(std::vector<uint32_t>& indices, size_t vertex_count)
+	{
+		// degenerate triangles (a vertex used by two corners) cover no pixels. Dropping them means every adjacency entry below is a distinct vertex of its triangle,
+		// so a vertex's remaining triangle count is decremented once per triangle drawn.
+		size_t kept_index_count = 0;
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			const uint32_t a = indices[i + 0];
+			const uint32_t b = indices[i + 1];
+			const uint32_t c = indices[i + 2];
+
+			if (a == b || b == c || a == c)
+			{
+				continue;
+			}
+
+			indices[kept_index_count++] = a;
+			indices[kept_index_count++] = b;
+			indices[kept_index_count++] = c;
+		}
+
+		indices.resize(kept_index_count);
+
+		size_t triangle_count = indices.size() / 3;
+		if (triangle_count == 0)
+		{
+			return;
+		}
+
+		// vertex -> triangles adjacency. The triangles of vertex v are adjacent_triangles[triangle_offsets[v] ...], the first remaining_triangles[v] of them not drawn yet.
+		std::vector<uint32_t> triangle_offsets(vertex_count + 1, 0);
+		for (uint32_t index : indices)
+		{
+			triangle_offsets[index + 1]++;
+		}
+
+		for (size_t vertex = 0; vertex < vertex_count; vertex++)
+		{
+			triangle_offsets[vertex + 1] += triangle_offsets[vertex];
+		}
+
+		std::vector<uint32_t> adjacent_triangles(indices.size());
+		std::vector<uint32_t> remaining_triangles(vertex_count, 0);
+		for (size_t i = 0; i < indices.size(); i++)
+		{
+			uint32_t vertex = indices[i];
+			adjacent_triangles[triangle_offsets[vertex] + remaining_triangles[vertex]++] = static_cast<uint32_t>(i / 3);
+		}
+
+		std::vector<int32_t> cache_positions(vertex_count, -1);
+		std::vector<float> vertex_scores(vertex_count);
+		for (size_t vertex = 0; vertex < vertex_count; vertex++)
+		{
+			vertex_scores[vertex] = forsyth_vertex_score(-1, remaining_triangles[vertex]);
+		}
+
+		auto triangle_score = [&](uint32_t triangle)
+		{
+			return vertex_scores[indices[triangle * 3 + 0]] + vertex_scores[indices[triangle * 3 + 1]] + vertex_scores[indices[triangle * 3 + 2]];
+		};
+
+		std::vector<uint8_t> is_triangle_added(triangle_count, 0);
+
+		// the cache holds 3 extra entries while the new triangle's vertices push old ones out
+		uint32_t cache[FORSYTH_CACHE_SIZE + 3];
+		uint32_t cache_count = 0;
+
+		std::vector<uint32_t> output_indices;
+		output_indices.reserve(indices.size());
+
+		size_t dead_end_cursor = 0;
+		int64_t best_triangle = -1;
+
+		// start with the best scoring triangle of the mesh
+		float best_score = -std::numeric_limits<float>::max();
+		for (uint32_t triangle = 0; triangle < triangle_count; triangle++)
+		{
+			float score = triangle_score(triangle);
+			if (score > best_score)
+			{
+				best_score = score;
+				best_triangle = triangle;
+			}
+		}
+
+		while (output_indices.size() < indices.size())
+		{
+			// no candidate around the cache : continue with any triangle not drawn yet
+			if (best_triangle < 0)
+			{
+				while (is_triangle_added[dead_end_cursor])
+				{
+					dead_end_cursor++;
+				}
+
+				best_triangle = static_cast<int64_t>(dead_end_cursor);
+			}
+
+			uint32_t triangle = static_cast<uint32_t>(best_triangle);
+			is_triangle_added[triangle] = 1;
+
+			uint32_t new_cache[FORSYTH_CACHE_SIZE + 3];
+			uint32_t new_cache_count = 0;
+
+			for (uint32_t corner = 0; corner < 3; corner++)
+			{
+				uint32_t vertex = indices[triangle * 3 + corner];
+				output_indices.push_back(vertex);
+
+				// move the triangle out of the vertex's remaining range
+				uint32_t *vertex_triangles = &adjacent_triangles[triangle_offsets[vertex]];
+				uint32_t remaining = remaining_triangles[vertex];
+				for (uint32_t i = 0; i < remaining; i++)
+				{
+					if (vertex_triangles[i] == triangle)
+					{
+						std::swap(vertex_triangles[i], vertex_triangles[remaining - 1]);
+						break;
+					}
+				}
+
+				remaining_triangles[vertex]--;
+
+				if (std::find(new_cache, new_cache + new_cache_count, vertex) == new_cache + new_cache_count)
+				{
+					new_cache[new_cache_count++] = vertex;
+				}
+			}
+
+			// the rest of the old cache follows the new triangle's vertices (in LRU order)
+			for (uint32_t i = 0; i < cache_count; i++)
+			{
+				uint32_t vertex = cache[i];
+				if (std::find(new_cache, new_cache + new_cache_count, vertex) == new_cache + new_cache_count)
+				{
+					new_cache[new_cache_count++] = vertex;
+				}
+			}
+
+			// rescore the vertices in (or just pushed out of) the cache, and pick the best triangle using them
+			best_triangle = -1;
+			best_score = -std::numeric_limits<float>::max();
+
+			for (uint32_t i = 0; i < new_cache_count; i++)
+			{
+				uint32_t vertex = new_cache[i];
+				cache_positions[vertex] = i < FORSYTH_CACHE_SIZE ? static_cast<int32_t>(i) : -1;
+				vertex_scores[vertex] = forsyth_vertex_score(cache_positions[vertex], remaining_triangles[vertex]);
+			}
+
+			for (uint32_t i = 0; i < new_cache_count; i++)
+			{
+				uint32_t vertex = new_cache[i];
+				const uint32_t *vertex_triangles = &adjacent_triangles[triangle_offsets[vertex]];
+
+				for (uint32_t j = 0; j < remaining_triangles[vertex]; j++)
+				{
+					float score = triangle_score(vertex_triangles[j]);
+					if (score > best_score)
+					{
+						best_score = score;
+						best_triangle = vertex_triangles[j];
+					}
+				}
+			}
+
+			cache_count = std::min(new_cache_count, FORSYTH_CACHE_SIZE);
+			std::copy(new_cache, new_cache + cache_count, cache);
+		}
+
+		indices.swap(output_indices);
+	}
+
+	void optimize_overdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, float threshold)
+	{
+		size_t triangle_count = indices.size() / 3;
+		if (triangle_count == 0)
+		{
+			return;
+		}
+
+		// hard boundaries : triangles whose three vertices all miss the cache, so the order before them does not matter for the cache.
+		std::vector<size_t> hard_boundaries = {0};
+		{
+			FifoCacheSimulator cache(vertices.size(), VERTEX_CACHE_SIZE);
+			for (size_t triangle = 0; triangle < triangle_count; triangle++)
+			{
+				if (triangle_misses(cache, &indices[triangle * 3]) == 3 && triangle > 0)
+				{
+					hard_boundaries.push_back(triangle);
+				}
+			}
+
+			hard_boundaries.push_back(triangle_count);
+		}
+
+		// soft boundaries : split a hard cluster as soon as the part so far is cache efficient enough on its own (the cache is flushed at every boundary, as the order of clusters is about to change).
+		std::vector<size_t> cluster_starts;
+		{
+			FifoCacheSimulator cache(vertices.size(), VERTEX_CACHE_SIZE);
+
+			for (size_t i = 0; i + 1 < hard_boundaries.size(); i++)
+			{
+				size_t cluster_begin = hard_boundaries[i];
+				size_t cluster_end = hard_boundaries[i + 1];
+
+				cache.flush();
+
+				uint32_t cluster_misses = 0;
+				for (size_t triangle = cluster_begin; triangle < cluster_end; triangle++)
+				{
+					cluster_misses += triangle_misses(cache, &indices[triangle * 3]);
+				}
+
+				float acmr_threshold = static_cast<float>(cluster_misses) / static_cast<float>(cluster_end - cluster_begin) * threshold;
+
+				cache.flush();
+				cluster_starts.push_back(cluster_begin);
+
+				size_t start = cluster_begin;
+				uint32_t running_misses = 0;
+				for (size_t triangle = cluster_begin; triangle < cluster_end; triangle++)
+				{
+					running_misses += triangle_misses(cache, &indices[triangle * 3]);
+
+					if (triangle + 1 < cluster_end && static_cast<float>(running_misses) / static_cast<float>(triangle + 1 - start) <= acmr_threshold)
+					{
+						start = triangle + 1;
+						running_misses = 0;
+
+						cache.flush();
+						cluster_starts.push_back(start);
+					}
+				}
+			}
+
+			cluster_starts.push_back(triangle_count);
+		}
+
+		// area weighted centroid and normal of every cluster, and of the whole mesh
+		size_t cluster_count = cluster_starts.size() - 1;
+
+		struct ClusterInfo
+		{
+			float m_centroid[3]{};
+			float m_normal[3]{};
+			float m_area{0.0f};
+		};
+
+		std::vector<ClusterInfo> clusters(cluster_count);
+
+		float mesh_centroid[3]{};
+		float mesh_area = 0.0f;
+
+		for (size_t cluster = 0; cluster < cluster_count; cluster++)
+		{
+			ClusterInfo& info = clusters[cluster];
+
+			for (size_t triangle = cluster_starts[cluster]; triangle < cluster_starts[cluster + 1]; triangle++)
+			{
+				const math::V3& a = vertices[indices[triangle * 3 + 0]].m_position;
+				const math::V3& b = vertices[indices[triangle * 3 + 1]].m_position;
+				const math::V3& c = vertices[indices[triangle * 3 + 2]].m_position;
+
+				float ab[3] = {b.x - a.x, b.y - a.y, b.z - a.z};
+				float ac[3] = {c.x - a.x, c.y - a.y, c.z - a.z};
+
+				// twice the area weighted normal
+				float normal[3] = {ab[1] * ac[2] - ab[2] * ac[1], ab[2] * ac[0] - ab[0] * ac[2], ab[0] * ac[1] - ab[1] * ac[0]};
+				float area = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+
+				float centroid[3] = {(a.x + b.x + c.x) / 3.0f, (a.y + b.y + c.y) / 3.0f, (a.z + b.z + c.z) / 3.0f};
+
+				for (int axis = 0; axis < 3; axis++)
+				{
+					info.m_centroid[axis] += centroid[axis] * area;
+					info.m_normal[axis] += normal[axis];
+				}
+
+				info.m_area += area;
+			}
+
+			for (int axis = 0; axis < 3; axis++)
+			{
+				mesh_centroid[axis] += info.m_centroid[axis];
+			}
+
+			mesh_area += info.m_area;
+
+			float inverse_area = info.m_area > 0.0f ? 1.0f / info.m_area : 0.0f;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				info.m_centroid[axis] *= inverse_area;
+			}
+		}
+
+		float inverse_mesh_area = mesh_area > 0.0f ? 1.0f / mesh_area : 0.0f;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			mesh_centroid[axis] *= inverse_mesh_area;
+		}
+
+		// clusters facing away from the center (and far from it) are likely to occlude the others, so they go first
+		std::vector<float> sort_keys(cluster_count);
+		for (size_t cluster = 0; cluster < cluster_count; cluster++)
+		{
+			const ClusterInfo& info = clusters[cluster];
+
+			float normal_length = std::sqrt(info.m_normal[0] * info.m_normal[0] + info.m_normal[1] * info.m_normal[1] + info.m_normal[2] * info.m_normal[2]);
+			float inverse_normal_length = normal_length > 0.0f ? 1.0f / normal_length : 0.0f;
+
+			float key = 0.0f;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				key += (info.m_centroid[axis] - mesh_centroid[axis]) * info.m_normal[axis] * inverse_normal_length;
+			}
+
+			sort_keys[cluster] = key;
+		}
+
+		std::vector<uint32_t> cluster_order(cluster_count);
+		for (size_t cluster = 0; cluster < cluster_count; cluster++)
+		{
+			cluster_order[cluster] = static_cast<uint32_t>(cluster);
+		}
+
+		std::stable_sort(cluster_order.begin(), cluster_order.end(), [&](uint32_t a, uint32_t b)
+		{
+			return sort_keys[a] > sort_keys[b];
+		});
+
+		std::vector<uint32_t> output_indices;
+		output_indices.reserve(indices.size());
+
+		for (uint32_t cluster : cluster_order)
+		{
+			output_indices.insert(output_indices.end(), indices.begin() + cluster_starts[cluster] * 3, indices.begin() + cluster_starts[cluster + 1] * 3);
+		}
+
+		indices.swap(output_indices);
+	}
+
+	void optimize_vertex_fetch(std::vector<uint32_t>& indices, std::vector<Vertex>& vertices)
+	{
+		constexpr uint32_t UNUSED = std::numeric_limits<uint32_t>::max();
+
+		std::vector<uint32_t> remap(vertices.size(), UNUSED);
+
+		std::vector<Vertex> output_vertices;
+		output_vertices.reserve(vertices.size());
+
+		for (uint32_t& index : indices)
+		{
+			if (remap[index] == UNUSED)
+			{
+				remap[index] = static_cast<uint32_t>(output_vertices.size());
+				output_vertices.push_back(vertices[index]);
+			}
+
+			index = remap[index];
+		}
+
+		vertices.swap(output_vertices);
+	}
+
+	MeshOptimizationReport optimize_mesh(Mesh& mesh)
+	{
+		MeshOptimizationReport report{};
+		report.m_before = analyze_vertex_cache(mesh.m_indices, mesh.m_vertices.size());
+
+		optimize_vertex_cache(mesh.m_indices, mesh.m_vertices.size());
+		optimize_overdraw(mesh.m_indices, mesh.m_vertices);
+		optimize_vertex_fetch(mesh.m_indices, mesh.m_vertices);
+
+		report.m_after = analyze_vertex_cache(mesh.m_indices, mesh.m_vertices.size());
+
+		mesh.compute_bounds();
+
+		return report;
+	}
+}
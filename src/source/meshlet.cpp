@@ -0,0 +1,201 @@
+#include "../include/meshlet.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
+namespace halo
+{
+	namespace
+	{
+		uint32_t pack_triangle(uint32_t a, uint32_t b, uint32_t c)
+		{
+			return a | (b << 8) | (c << 16);
+		}
+
+		// builds the meshlets of one index range, appending them to the mesh
+		void build_range_meshlets(Mesh& mesh, uint32_t first_index, uint32_t index_count)
+		{
+			constexpr uint8_t NOT_IN_MESHLET = 0xff;
+
+			// local index of each vertex in the meshlet being built
+			std::vector<uint8_t> local_indices(mesh.m_vertices.size(), NOT_IN_MESHLET);
+
+			std::vector<uint32_t> meshlet_vertices;
+			std::vector<uint32_t> meshlet_triangles;
+
+			auto flush = [&]()
+			{
+				if (meshlet_triangles.empty())
+				{
+					return;
+				}
+
+				Meshlet meshlet{};
+				meshlet.m_vertex_offset = static_cast<uint32_t>(mesh.m_meshlet_data.size());
+				meshlet.m_vertex_count = static_cast<uint32_t>(meshlet_vertices.size());
+				mesh.m_meshlet_data.insert(mesh.m_meshlet_data.end(), meshlet_vertices.begin(), meshlet_vertices.end());
+
+				meshlet.m_triangle_offset = static_cast<uint32_t>(mesh.m_meshlet_data.size());
+				meshlet.m_triangle_count = static_cast<uint32_t>(meshlet_triangles.size());
+				mesh.m_meshlet_data.insert(mesh.m_meshlet_data.end(), meshlet_triangles.begin(), meshlet_triangles.end());
+
+				compute_meshlet_bounds(meshlet, mesh.m_meshlet_data, mesh.m_vertices);
+				mesh.m_meshlets.push_back(meshlet);
+
+				for (uint32_t vertex : meshlet_vertices)
+				{
+					local_indices[vertex] = NOT_IN_MESHLET;
+				}
+
+				meshlet_vertices.clear();
+				meshlet_triangles.clear();
+			};
+
+			for (uint32_t i = first_index; i < first_index + index_count; i += 3)
+			{
+				const uint32_t *triangle = &mesh.m_indices[i];
+
+				uint32_t new_vertex_count = 0;
+				for (int corner = 0; corner < 3; corner++)
+				{
+					bool is_duplicate = (corner > 0 && triangle[corner] == triangle[0]) || (corner > 1 && triangle[corner] == triangle[1]);
+					new_vertex_count += local_indices[triangle[corner]] == NOT_IN_MESHLET && !is_duplicate;
+				}
+
+				if (meshlet_vertices.size() + new_vertex_count > MESHLET_MAX_VERTICES || meshlet_triangles.size() + 1 > MESHLET_MAX_TRIANGLES)
+				{
+					flush();
+				}
+
+				uint32_t local_triangle[3];
+				for (int corner = 0; corner < 3; corner++)
+				{
+					uint32_t vertex = triangle[corner];
+					if (local_indices[vertex] == NOT_IN_MESHLET)
+					{
+						local_indices[vertex] = static_cast<uint8_t>(meshlet_vertices.size());
+						meshlet_vertices.push_back(vertex);
+					}
+
+					local_triangle[corner] = local_indices[vertex];
+				}
+
+				meshlet_triangles.push_back(pack_triangle(local_triangle[0], local_triangle[1], local_triangle[2]));
+			}
+
+			flush();
+		}
+	}
+
+	void build_meshlets(Mesh& mesh)
+	{
+		mesh.m_meshlets.clear();
+		mesh.m_meshlet_data.clear();
+
+		for (MeshLod& lod : mesh.m_lods)
+		{
+			lod.m_first_meshlet = static_cast<uint32_t>(mesh.m_meshlets.size());
+			build_range_meshlets(mesh, lod.m_first_index, lod.m_index_count);
+			lod.m_meshlet_count = static_cast<uint32_t>(mesh.m_meshlets.size()) - lod.m_first_meshlet;
+		}
+	}
+
+	void compute_meshlet_bounds(Meshlet& meshlet, const std::vector<uint32_t>& meshlet_data, const std::vector<Vertex>& vertices)
+	{
+		// sphere : center of the bounding box, radius to the farthest vertex
+		float min_position[3] = {std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max()};
+		float max_position[3] = {-std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max()};
+
+		for (uint32_t i = 0; i < meshlet.m_vertex_count; i++)
+		{
+			const math::V3& position = vertices[meshlet_data[meshlet.m_vertex_offset + i]].m_position;
+			const float components[3] = {position.x, position.y, position.z};
+
+			for (int axis = 0; axis < 3; axis++)
+			{
+				min_position[axis] = std::min(min_position[axis], components[axis]);
+				max_position[axis] = std::max(max_position[axis], components[axis]);
+			}
+		}
+
+		float center[3] = {(min_position[0] + max_position[0]) * 0.5f, (min_position[1] + max_position[1]) * 0.5f, (min_position[2] + max_position[2]) * 0.5f};
+
+		float radius_squared = 0.0f;
+		for (uint32_t i = 0; i < meshlet.m_vertex_count; i++)
+		{
+			const math::V3& position = vertices[meshlet_data[meshlet.m_vertex_offset + i]].m_position;
+
+			float dx = position.x - center[0];
+			float dy = position.y - center[1];
+			float dz = position.z - center[2];
+			radius_squared = std::max(radius_squared, dx * dx + dy * dy + dz * dz);
+		}
+
+		meshlet.m_sphere = math::V4{center[0], center[1], center[2], std::sqrt(radius_squared)};
+
+		// cone : axis is the average face normal, the cutoff comes from the normal deviating the most from it
+		std::vector<std::array<float, 3>> normals;
+		normals.reserve(meshlet.m_triangle_count);
+
+		float axis[3] = {0.0f, 0.0f, 0.0f};
+
+		for (uint32_t i = 0; i < meshlet.m_triangle_count; i++)
+		{
+			uint32_t packed_triangle = meshlet_data[meshlet.m_triangle_offset + i];
+
+			const math::V3& a = vertices[meshlet_data[meshlet.m_vertex_offset + (packed_triangle & 0xff)]].m_position;
+			const math::V3& b = vertices[meshlet_data[meshlet.m_vertex_offset + ((packed_triangle >> 8) & 0xff)]].m_position;
+			const math::V3& c = vertices[meshlet_data[meshlet.m_vertex_offset + ((packed_triangle >> 16) & 0xff)]].m_position;
+
+			float ab[3] = {b.x - a.x, b.y - a.y, b.z - a.z};
+			float ac[3] = {c.x - a.x, c.y - a.y, c.z - a.z};
+
+			std::array<float, 3> normal = {ab[1] * ac[2] - ab[2] * ac[1], ab[2] * ac[0] - ab[0] * ac[2], ab[0] * ac[1] - ab[1] * ac[0]};
+
+			float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+			if (length == 0.0f)
+			{
+				continue;
+			}
+
+			for (int component = 0; component < 3; component++)
+			{
+				normal[component] /= length;
+				axis[component] += normal[component];
+			}
+
+			normals.push_back(normal);
+		}
+
+		float axis_length = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+
+		// no usable cone (degenerate triangles, or normals cancelling out) : a cutoff of 1 is never culled
+		meshlet.m_cone = math::V4{0.0f, 0.0f, 1.0f, 1.0f};
+
+		if (axis_length == 0.0f || normals.empty())
+		{
+			return;
+		}
+
+		for (float& component : axis)
+		{
+			component /= axis_length;
+		}
+
+		float min_dot = 1.0f;
+		for (const std::array<float, 3>& normal : normals)
+		{
+			min_dot = std::min(min_dot, normal[0] * axis[0] + normal[1] * axis[1] + normal[2] * axis[2]);
+		}
+
+		// the cone would span more than a hemisphere
+		if (min_dot <= 0.0f)
+		{
+			return;
+		}
+
+		meshlet.m_cone = math::V4{axis[0], axis[1], axis[2], std::sqrt(1.0f - min_dot * min_dot)};
+	}
+}
@@ -2,7 +2,7 @@
 
 namespace halo
 {
-	vk::Pipeline PipelineBuilder::create_pipeline(vk::Device device, vk::RenderPass render_pass)
+	vk::Pipeline PipelineBuilder::create_pipeline(vk::Device device, vk::RenderPass render_pass, uint32_t subpass)
 	{
 		vk::PipelineViewportStateCreateInfo viewport_state_create_info = {};
 		viewport_state_create_info.viewportCount = 1;
@@ -11,11 +11,15 @@ namespace halo
 		viewport_state_create_info.scissorCount = 1;
 		viewport_state_create_info.pScissors = &m_scissor;
 
+		vk::PipelineDynamicStateCreateInfo dynamic_state_create_info = {};
+		dynamic_state_create_info.dynamicStateCount = static_cast<uint32_t>(m_dynamic_states.size());
+		dynamic_state_create_info.pDynamicStates = m_dynamic_states.data();
+
 		// Dummy color blending
 		vk::PipelineColorBlendStateCreateInfo color_blend_state_create_info = {};
 		color_blend_state_create_info.logicOpEnable = false;
 		color_blend_state_create_info.logicOp = vk::LogicOp::eCopy;
-		color_blend_state_create_info.attachmentCount = 1;
+		color_blend_state_create_info.attachmentCount = m_color_attachment_count;
 		color_blend_state_create_info.pAttachments = &m_color_blend_state_attachment;
 	
 		// combine all the structs ito pipeline
@@ -33,10 +37,11 @@ namespace halo
 		pipeline_create_info.pMultisampleState = &m_multisample_state_info;
 		pipeline_create_info.pColorBlendState = &color_blend_state_create_info;
 		pipeline_create_info.pDepthStencilState = &m_depth_stencil_state_info;
+		pipeline_create_info.pDynamicState = &dynamic_state_create_info;
 
 		pipeline_create_info.layout = m_pipeline_layout;
 		pipeline_create_info.renderPass = render_pass;
-		pipeline_create_info.subpass = 0;
+		pipeline_create_info.subpass = subpass;
 		
 		vk::ResultValue<vk::Pipeline> pipeline = device.createGraphicsPipeline(nullptr, pipeline_create_info);
 		if (pipeline.result != vk::Result::eSuccess)
@@ -46,4 +51,21 @@ namespace halo
 
 		return pipeline.value;
 	}
+
+	vk::Pipeline create_compute_pipeline(vk::Device device, vk::ShaderModule shader_module, vk::PipelineLayout pipeline_layout)
+	{
+		vk::ComputePipelineCreateInfo pipeline_create_info = {};
+		pipeline_create_info.stage.stage = vk::ShaderStageFlagBits::eCompute;
+		pipeline_create_info.stage.module = shader_module;
+		pipeline_create_info.stage.pName = "main";
+		pipeline_create_info.layout = pipeline_layout;
+
+		vk::ResultValue<vk::Pipeline> pipeline = device.createComputePipeline(nullptr, pipeline_create_info);
+		if (pipeline.result != vk::Result::eSuccess)
+		{
+			throw std::runtime_error("Failed to create compute pipeline");
+		}
+
+		return pipeline.value;
+	}
 }
\ No newline at end of file
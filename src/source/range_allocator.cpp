@@ -0,0 +1,101 @@
+#include "../include/range_allocator.h"
+
+#include <algorithm>
+
+namespace halo
+{
+	void RangeAllocator::init(uint32_t capacity)
+	{
+		m_capacity = capacity;
+
+		m_free_ranges.clear();
+		m_retired_ranges.clear();
+
+		if (capacity > 0)
+		{
+			m_free_ranges.push_back(Range{0, capacity});
+		}
+	}
+
+	std::optional<uint32_t> RangeAllocator::allocate(uint32_t size)
+	{
+		if (size == 0)
+		{
+			return 0;
+		}
+
+		auto it = std::find_if(m_free_ranges.begin(), m_free_ranges.end(), [&](const Range& range) { return range.m_size >= size; });
+		if (it == m_free_ranges.end())
+		{
+			return std::nullopt;
+		}
+
+		const uint32_t offset = it->m_offset;
+
+		it->m_offset += size;
+		it->m_size -= size;
+
+		if (it->m_size == 0)
+		{
+			m_free_ranges.erase(it);
+		}
+
+		return offset;
+	}
+
+	void RangeAllocator::release(uint32_t offset, uint32_t size, uint64_t retire_value)
+	{
+		if (size == 0)
+		{
+			return;
+		}
+
+		m_retired_ranges.push_back(RetiredRange{Range{offset, size}, retire_value});
+	}
+
+	void RangeAllocator::reclaim(uint64_t completed_submission_value)
+	{
+		std::erase_if(m_retired_ranges, [&](const RetiredRange& retired_range)
+		{
+			if (retired_range.m_retire_value > completed_submission_value)
+			{
+				return false;
+			}
+
+			free(retired_range.m_range);
+			return true;
+		});
+	}
+
+	void RangeAllocator::free(Range range)
+	{
+		// first free range past the freed one, merged with it and / or the one before when they touch
+		auto next = std::lower_bound(m_free_ranges.begin(), m_free_ranges.end(), range.m_offset, [](const Range& free_range, uint32_t offset) { return free_range.m_offset < offset; });
+
+		if (next != m_free_ranges.begin())
+		{
+			auto previous = std::prev(next);
+			if (previous->m_offset + previous->m_size == range.m_offset)
+			{
+				previous->m_size += range.m_size;
+
+				if (next != m_free_ranges.end() && previous->m_offset + previous->m_size == next->m_offset)
+				{
+					previous->m_size += next->m_size;
+					m_free_ranges.erase(next);
+				}
+
+				return;
+			}
+		}
+
+		if (next != m_free_ranges.end() && range.m_offset + range.m_size == next->m_offset)
+		{
+			next->m_offset = range.m_offset;
+			next->m_size += range.m_size;
+			return;
+		}
+
+		m_free_ranges.insert(next, range);
+	}
+}
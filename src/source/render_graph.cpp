@@ -0,0 +1,602 @@
+#include "../include/render_graph.h"
+
+#include <algorithm>
+#include <iostream>
+#include <queue>
+#include <stdexcept>
+
+namespace halo
+{
+	namespace
+	{
+		struct UsageInfo
+		{
+			vk::PipelineStageFlags m_stages;
+			vk::AccessFlags m_access;
+
+			// eUndefined for buffer only usages
+			vk::ImageLayout m_layout;
+			bool m_write;
+
+			vk::ImageUsageFlags m_image_usage;
+		};
+
+		UsageInfo get_usage_info(RenderGraphUsage usage)
+		{
+			using Stage = vk::PipelineStageFlagBits;
+			using Access = vk::AccessFlagBits;
+			using Layout = vk::ImageLayout;
+			using ImageUsage = vk::ImageUsageFlagBits;
+
+			switch (usage)
+			{
+				case RenderGraphUsage::ColorAttachment:
+					return {Stage::eColorAttachmentOutput, Access::eColorAttachmentRead | Access::eColorAttachmentWrite, Layout::eColorAttachmentOptimal, true, ImageUsage::eColorAttachment};
+
+				case RenderGraphUsage::DepthAttachment:
+					return {Stage::eEarlyFragmentTests | Stage::eLateFragmentTests, Access::eDepthStencilAttachmentRead | Access::eDepthStencilAttachmentWrite, Layout::eDepthStencilAttachmentOptimal, true, ImageUsage::eDepthStencilAttachment};
+
+				case RenderGraphUsage::DepthAttachmentRead:
+					return {Stage::eEarlyFragmentTests | Stage::eLateFragmentTests, Access::eDepthStencilAttachmentRead, Layout::eDepthStencilReadOnlyOptimal, false, ImageUsage::eDepthStencilAttachment};
+
+				case RenderGraphUsage::ComputeSampledRead:
+					return {Stage::eComputeShader, Access::eShaderRead, Layout::eShaderReadOnlyOptimal, false, ImageUsage::eSampled};
+
+				case RenderGraphUsage::FragmentSampledRead:
+					return {Stage::eFragmentShader, Access::eShaderRead, Layout::eShaderReadOnlyOptimal, false, ImageUsage::eSampled};
+
+				case RenderGraphUsage::ComputeStorageRead:
+					return {Stage::eComputeShader, Access::eShaderRead, Layout::eGeneral, false, ImageUsage::eStorage};
+
+				case RenderGraphUsage::ComputeStorageWrite:
+					return {Stage::eComputeShader, Access::eShaderWrite, Layout::eGeneral, true, ImageUsage::eStorage};
+
+				case RenderGraphUsage::ComputeStorageReadWrite:
+					return {Stage::eComputeShader, Access::eShaderRead | Access::eShaderWrite, Layout::eGeneral, true, ImageUsage::eStorage};
+
+				case RenderGraphUsage::FragmentStorageRead:
+					return {Stage::eFragmentShader, Access::eShaderRead, Layout::eGeneral, false, ImageUsage::eStorage};
+
+				case RenderGraphUsage::IndirectRead:
+					return {Stage::eDrawIndirect, Access::eIndirectCommandRead, Layout::eUndefined, false, {}};
+
+				case RenderGraphUsage::IndexRead:
+					return {Stage::eVertexInput, Access::eIndexRead, Layout::eUndefined, false, {}};
+
+				case RenderGraphUsage::TransferRead:
+					return {Stage::eTransfer, Access::eTransferRead, Layout::eTransferSrcOptimal, false, ImageUsage::eTransferSrc};
+
+				case RenderGraphUsage::TransferWrite:
+					return {Stage::eTransfer, Access::eTransferWrite, Layout::eTransferDstOptimal, true, ImageUsage::eTransferDst};
+			}
+
+			throw std::runtime_error("Unknown render graph usage");
+		}
+
+		// only writes need to be made available (flushed) by a barrier
+		constexpr vk::AccessFlags WRITE_ACCESS = vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentWrite
+			| vk::AccessFlagBits::eTransferWrite | vk::AccessFlagBits::eHostWrite | vk::AccessFlagBits::eMemoryWrite;
+	}
+
+	void RenderGraph::init(vk::Device device, VmaAllocator allocator)
+	{
+		m_device = device;
+		m_vma_allocator = allocator;
+	}
+
+	RenderGraphResource RenderGraph::create_image(std::string_view name, const RenderGraphImageDesc& desc)
+	{
+		Resource resource{};
+		resource.m_name = name;
+		resource.m_type = ResourceType::TransientImage;
+		resource.m_desc = desc;
+		resource.m_sync_state = static_cast<uint32_t>(m_sync_states.size());
+
+		m_sync_states.emplace_back();
+		m_resources.push_back(std::move(resource));
+
+		return RenderGraphResource{static_cast<uint32_t>(m_resources.size() - 1)};
+	}
+
+	RenderGraphResource RenderGraph::import_image(std::string_view name, const RenderGraphImportedImage& imported_image)
+	{
+		Resource resource{};
+		resource.m_name = name;
+		resource.m_type = ResourceType::ImportedImage;
+		resource.m_imported = imported_image;
+		resource.m_output = imported_image.m_output;
+		resource.m_sync_state = static_cast<uint32_t>(m_sync_states.size());
+
+		m_sync_states.emplace_back();
+		m_resources.push_back(std::move(resource));
+
+		return RenderGraphResource{static_cast<uint32_t>(m_resources.size() - 1)};
+	}
+
+	RenderGraphResource RenderGraph::import_buffer(std::string_view name, bool output)
+	{
+		Resource resource{};
+		resource.m_name = name;
+		resource.m_type = ResourceType::ImportedBuffer;
+		resource.m_output = output;
+		resource.m_sync_state = static_cast<uint32_t>(m_sync_states.size());
+
+		m_sync_states.emplace_back();
+		m_resources.push_back(std::move(resource));
+
+		return RenderGraphResource{static_cast<uint32_t>(m_resources.size() - 1)};
+	}
+
+	void RenderGraph::set_image(RenderGraphResource resource, vk::Image image)
+	{
+		m_resources[resource.m_index].m_image = image;
+	}
+
+	void RenderGraph::add_pass(std::string_view name, std::vector<RenderGraphAccess> accesses, RecordFunction&& record)
+	{
+		// the barriers of a pass are recorded as one batch, so two uses of a resource in the same pass could not be ordered
+		for (size_t i = 0; i < accesses.size(); i++)
+		{
+			for (size_t j = i + 1; j < accesses.size(); j++)
+			{
+				if (accesses[i].m_resource.m_index == accesses[j].m_resource.m_index)
+				{
+					throw std::runtime_error("Render graph pass uses a resource twice : " + std::string(name));
+				}
+			}
+		}
+
+		Pass pass{};
+		pass.m_name = name;
+		pass.m_accesses = std::move(accesses);
+		pass.m_record = std::move(record);
+
+		m_passes.push_back(std::move(pass));
+	}
+
+	void RenderGraph::compile()
+	{
+		m_pass_order = order_passes(cull_passes());
+
+		for (uint32_t position = 0; position < m_pass_order.size(); position++)
+		{
+			for (const RenderGraphAccess& access : m_passes[m_pass_order[position]].m_accesses)
+			{
+				Resource& resource = m_resources[access.m_resource.m_index];
+				if (resource.m_type != ResourceType::TransientImage)
+				{
+					continue;
+				}
+
+				resource.m_usage |= get_usage_info(access.m_usage).m_image_usage;
+				resource.m_first_use = std::min(resource.m_first_use, position);
+				resource.m_last_use = std::max(resource.m_last_use, position);
+			}
+		}
+
+		create_transient_images();
+	}
+
+	std::vector<uint32_t> RenderGraph::cull_passes() const
+	{
+		// walking backwards from the outputs : a pass is kept if it writes a resource that is an output or used by a kept pass after it.
+		// note : every resource a kept pass uses becomes live (writes may be partial, so earlier writers are kept too).
+		std::vector<bool> live(m_resources.size(), false);
+		for (size_t i = 0; i < m_resources.size(); i++)
+		{
+			live[i] = m_resources[i].m_output;
+		}
+
+		std::vector<uint32_t> kept_passes;
+
+		for (size_t i = m_passes.size(); i-- > 0;)
+		{
+			const Pass& pass = m_passes[i];
+
+			const bool writes_live_resource = std::any_of(pass.m_accesses.begin(), pass.m_accesses.end(), [&](const RenderGraphAccess& access)
+			{
+				return get_usage_info(access.m_usage).m_write && live[access.m_resource.m_index];
+			});
+
+			if (!writes_live_resource)
+			{
+				continue;
+			}
+
+			for (const RenderGraphAccess& access : pass.m_accesses)
+			{
+				live[access.m_resource.m_index] = true;
+			}
+
+			kept_passes.push_back(static_cast<uint32_t>(i));
+		}
+
+		std::reverse(kept_passes.begin(), kept_passes.end());
+		return kept_passes;
+	}
+
+	std::vector<uint32_t> RenderGraph::order_passes(const std::vector<uint32_t>& kept_passes) const
+	{
+		// topological sort of the dependencies between kept passes (both use a resource and at least one writes it). Ready passes run in declaration order.
+		const size_t pass_count = kept_passes.size();
+
+		std::vector<std::vector<uint32_t>> dependents(pass_count);
+		std::vector<uint32_t> dependency_counts(pass_count, 0);
+
+		for (size_t a = 0; a < pass_count; a++)
+		{
+			for (size_t b = a + 1; b < pass_count; b++)
+			{
+				const Pass& first_pass = m_passes[kept_passes[a]];
+				const Pass& second_pass = m_passes[kept_passes[b]];
+
+				bool depends = false;
+				for (const RenderGraphAccess& first_access : first_pass.m_accesses)
+				{
+					for (const RenderGraphAccess& second_access : second_pass.m_accesses)
+					{
+						if (first_access.m_resource.m_index == second_access.m_resource.m_index && (get_usage_info(first_access.m_usage).m_write || get_usage_info(second_access.m_usage).m_write))
+						{
+							depends = true;
+						}
+					}
+				}
+
+				if (depends)
+				{
+					dependents[a].push_back(static_cast<uint32_t>(b));
+					dependency_counts[b]++;
+				}
+			}
+		}
+
+		std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<uint32_t>> ready_passes;
+		for (uint32_t i = 0; i < pass_count; i++)
+		{
+			if (dependency_counts[i] == 0)
+			{
+				ready_passes.push(i);
+			}
+		}
+
+		std::vector<uint32_t> pass_order;
+		pass_order.reserve(pass_count);
+
+		while (!ready_passes.empty())
+		{
+			const uint32_t pass = ready_passes.top();
+			ready_passes.pop();
+
+			pass_order.push_back(kept_passes[pass]);
+
+			for (uint32_t dependent : dependents[pass])
+			{
+				if (--dependency_counts[dependent] == 0)
+				{
+					ready_passes.push(dependent);
+				}
+			}
+		}
+
+		return pass_order;
+	}
+
+	void RenderGraph::create_transient_images()
+	{
+		std::vector<uint32_t> transient_images;
+		VkDeviceSize unaliased_size = 0;
+
+		for (uint32_t i = 0; i < m_resources.size(); i++)
+		{
+			Resource& resource = m_resources[i];
+
+			// images of culled passes only are never created
+			if (resource.m_type != ResourceType::TransientImage || resource.m_first_use == 0xffffffff)
+			{
+				continue;
+			}
+
+			vk::ImageCreateInfo image_create_info{};
+			image_create_info.imageType = vk::ImageType::e2D;
+			image_create_info.format = resource.m_desc.m_format;
+			image_create_info.extent = vk::Extent3D{resource.m_desc.m_extent.width, resource.m_desc.m_extent.height, 1};
+			image_create_info.mipLevels = resource.m_desc.m_mip_count;
+			image_create_info.arrayLayers = resource.m_desc.m_layer_count;
+			image_create_info.samples = resource.m_desc.m_samples;
+			image_create_info.tiling = vk::ImageTiling::eOptimal;
+			image_create_info.usage = resource.m_desc.m_lazily_allocated ? resource.m_usage | vk::ImageUsageFlagBits::eTransientAttachment : resource.m_usage;
+			image_create_info.initialLayout = vk::ImageLayout::eUndefined;
+
+			resource.m_image = m_device.createImage(image_create_info);
+			transient_images.push_back(i);
+		}
+
+		std::vector<VkMemoryRequirements> requirements(m_resources.size());
+		for (uint32_t i : transient_images)
+		{
+			requirements[i] = static_cast<VkMemoryRequirements>(m_device.getImageMemoryRequirements(m_resources[i].m_image));
+			unaliased_size += requirements[i].size;
+		}
+
+		// largest first, each image goes to the first block whose images are all used outside of its lifetime
+		std::sort(transient_images.begin(), transient_images.end(), [&](uint32_t a, uint32_t b) { return requirements[a].size > requirements[b].size; });
+
+		for (uint32_t i : transient_images)
+		{
+			const Resource& resource = m_resources[i];
+
+			auto block = std::find_if(m_memory_blocks.begin(), m_memory_blocks.end(), [&](const MemoryBlock& memory_block)
+			{
+				if (resource.m_desc.m_lazily_allocated || memory_block.m_lazily_allocated || (memory_block.m_requirements.memoryTypeBits & requirements[i].memoryTypeBits) == 0)
+				{
+					return false;
+				}
+
+				return std::all_of(memory_block.m_resources.begin(), memory_block.m_resources.end(), [&](uint32_t other)
+				{
+					return resource.m_last_use < m_resources[other].m_first_use || m_resources[other].m_last_use < resource.m_first_use;
+				});
+			});
+
+			if (block == m_memory_blocks.end())
+			{
+				m_memory_blocks.push_back(MemoryBlock{requirements[i], nullptr, {i}, resource.m_desc.m_lazily_allocated});
+				continue;
+			}
+
+			block->m_requirements.size = std::max(block->m_requirements.size, requirements[i].size);
+			block->m_requirements.alignment = std::max(block->m_requirements.alignment, requirements[i].alignment);
+			block->m_requirements.memoryTypeBits &= requirements[i].memoryTypeBits;
+			block->m_resources.push_back(i);
+		}
+
+		VkDeviceSize aliased_size = 0;
+
+		for (MemoryBlock& memory_block : m_memory_blocks)
+		{
+			VmaAllocationCreateInfo allocation_create_info = {};
+			allocation_create_info.usage = memory_block.m_lazily_allocated ? VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED : VMA_MEMORY_USAGE_GPU_ONLY;
+
+			VkResult result = vmaAllocateMemory(m_vma_allocator, &memory_block.m_requirements, &allocation_create_info, &memory_block.m_allocation, nullptr);
+
+			// most desktop GPUs have no lazily allocated memory type
+			if (result != VK_SUCCESS && memory_block.m_lazily_allocated)
+			{
+				allocation_create_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+				result = vmaAllocateMemory(m_vma_allocator, &memory_block.m_requirements, &allocation_create_info, &memory_block.m_allocation, nullptr);
+			}
+
+			if (result != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to allocate render graph transient memory");
+			}
+
+			aliased_size += memory_block.m_requirements.size;
+
+			// images sharing a block never overlap in time, so they also share its sync state
+			const uint32_t sync_state = static_cast<uint32_t>(m_sync_states.size());
+			m_sync_states.emplace_back();
+
+			for (uint32_t i : memory_block.m_resources)
+			{
+				Resource& resource = m_resources[i];
+
+				vmaBindImageMemory(m_vma_allocator, memory_block.m_allocation, static_cast<VkImage>(resource.m_image));
+
+				vk::ImageViewCreateInfo view_create_info{};
+				view_create_info.image = resource.m_image;
+				view_create_info.viewType = resource.m_desc.m_view_type;
+				view_create_info.format = resource.m_desc.m_format;
+				view_create_info.subresourceRange = vk::ImageSubresourceRange{resource.m_desc.m_aspect, 0, resource.m_desc.m_mip_count, 0, resource.m_desc.m_layer_count};
+
+				resource.m_view = m_device.createImageView(view_create_info);
+				resource.m_sync_state = sync_state;
+			}
+		}
+
+		std::cout << "Render graph : " << m_pass_order.size() << " passes (" << m_passes.size() - m_pass_order.size() << " culled), transient memory : "
+			<< aliased_size / 1024 << " KB (" << unaliased_size / 1024 << " KB without aliasing)\n";
+	}
+
+	void RenderGraph::execute(vk::CommandBuffer command_buffer)
+	{
+		// transient images start every frame without contents, discarded imported images are new images
+		for (Resource& resource : m_resources)
+		{
+			if (resource.m_type == ResourceType::TransientImage)
+			{
+				resource.m_layout = vk::ImageLayout::eUndefined;
+			}
+			else if (resource.m_type == ResourceType::ImportedImage && resource.m_imported.m_discard)
+			{
+				resource.m_layout = vk::ImageLayout::eUndefined;
+				m_sync_states[resource.m_sync_state] = SyncState{resource.m_imported.m_frame_start_stages, {}, {}, {}};
+			}
+		}
+
+		std::vector<vk::ImageMemoryBarrier> image_barriers;
+
+		for (uint32_t pass_index : m_pass_order)
+		{
+			const Pass& pass = m_passes[pass_index];
+
+			vk::PipelineStageFlags src_stages;
+			vk::PipelineStageFlags dst_stages;
+			vk::MemoryBarrier memory_barrier{};
+			bool needs_barrier = false;
+
+			image_barriers.clear();
+
+			for (const RenderGraphAccess& access : pass.m_accesses)
+			{
+				Resource& resource = m_resources[access.m_resource.m_index];
+				SyncState& state = m_sync_states[resource.m_sync_state];
+				const UsageInfo usage = get_usage_info(access.m_usage);
+
+				const bool is_image = resource.m_type != ResourceType::ImportedBuffer;
+				const bool layout_change = is_image && resource.m_layout != usage.m_layout;
+
+				// layout changes and writes wait for every access since the last write (WAW / WAR), reads wait for the last write unless it is already visible to them
+				vk::PipelineStageFlags wait_stages;
+				bool resource_barrier = layout_change;
+
+				if (layout_change || usage.m_write)
+				{
+					wait_stages = state.m_write_stages | state.m_read_stages;
+					resource_barrier = resource_barrier || static_cast<bool>(wait_stages);
+				}
+				else if (state.m_write_stages && ((state.m_read_stages & usage.m_stages) != usage.m_stages || (state.m_visible_access & usage.m_access) != usage.m_access))
+				{
+					wait_stages = state.m_write_stages;
+					resource_barrier = true;
+				}
+
+				if (resource_barrier)
+				{
+					needs_barrier = true;
+					src_stages |= wait_stages;
+					dst_stages |= usage.m_stages;
+
+					if (is_image)
+					{
+						vk::ImageMemoryBarrier image_barrier{};
+						image_barrier.srcAccessMask = state.m_write_access;
+						image_barrier.dstAccessMask = usage.m_access;
+						image_barrier.oldLayout = resource.m_layout;
+						image_barrier.newLayout = usage.m_layout;
+						image_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+						image_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+						image_barrier.image = resource.m_image;
+						image_barrier.subresourceRange = vk::ImageSubresourceRange{resource.m_type == ResourceType::TransientImage ? resource.m_desc.m_aspect : resource.m_imported.m_aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS};
+
+						image_barriers.push_back(image_barrier);
+					}
+					else
+					{
+						memory_barrier.srcAccessMask |= state.m_write_access;
+						memory_barrier.dstAccessMask |= usage.m_access;
+					}
+				}
+
+				if (usage.m_write)
+				{
+					state = SyncState{usage.m_stages, usage.m_access & WRITE_ACCESS, {}, {}};
+				}
+				else if (layout_change)
+				{
+					// a layout transition is a write done by the barrier : later reads in other stages have to wait for it
+					state = SyncState{usage.m_stages, {}, usage.m_stages, usage.m_access};
+				}
+				else
+				{
+					state.m_read_stages |= usage.m_stages;
+					state.m_visible_access |= usage.m_access;
+				}
+
+				if (is_image)
+				{
+					resource.m_layout = usage.m_layout;
+				}
+			}
+
+			if (needs_barrier)
+			{
+				// first use of a resource (nothing to wait for) : only the layout transition
+				if (!src_stages)
+				{
+					src_stages = vk::PipelineStageFlagBits::eTopOfPipe;
+				}
+
+				command_buffer.pipelineBarrier(src_stages, dst_stages, {}, 1, &memory_barrier, 0, nullptr, static_cast<uint32_t>(image_barriers.size()), image_barriers.data());
+			}
+
+			pass.m_record(command_buffer);
+		}
+
+		// discarded imported images are handed over in their final layout (e.g. to presentation)
+		image_barriers.clear();
+		vk::PipelineStageFlags src_stages;
+
+		for (Resource& resource : m_resources)
+		{
+			if (resource.m_type != ResourceType::ImportedImage || !resource.m_imported.m_discard || resource.m_imported.m_final_layout == vk::ImageLayout::eUndefined)
+			{
+				continue;
+			}
+
+			const SyncState& state = m_sync_states[resource.m_sync_state];
+
+			vk::ImageMemoryBarrier image_barrier{};
+			image_barrier.srcAccessMask = state.m_write_access;
+			image_barrier.oldLayout = resource.m_layout;
+			image_barrier.newLayout = resource.m_imported.m_final_layout;
+			image_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			image_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			image_barrier.image = resource.m_image;
+			image_barrier.subresourceRange = vk::ImageSubresourceRange{resource.m_imported.m_aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS};
+
+			image_barriers.push_back(image_barrier);
+			src_stages |= state.m_write_stages | state.m_read_stages;
+
+			resource.m_layout = resource.m_imported.m_final_layout;
+		}
+
+		if (!image_barriers.empty())
+		{
+			if (!src_stages)
+			{
+				src_stages = vk::PipelineStageFlagBits::eTopOfPipe;
+			}
+
+			command_buffer.pipelineBarrier(src_stages, vk::PipelineStageFlagBits::eBottomOfPipe, {}, 0, nullptr, 0, nullptr, static_cast<uint32_t>(image_barriers.size()), image_barriers.data());
+		}
+	}
+
+	vk::Image RenderGraph::get_image(RenderGraphResource resource) const
+	{
+		return m_resources[resource.m_index].m_image;
+	}
+
+	vk::ImageView RenderGraph::get_image_view(RenderGraphResource resource) const
+	{
+		return m_resources[resource.m_index].m_view;
+	}
+
+	vk::DeviceSize RenderGraph::get_memory_size() const
+	{
+		vk::DeviceSize memory_size = 0;
+		for (const MemoryBlock& memory_block : m_memory_blocks)
+		{
+			VmaAllocationInfo allocation_info;
+			vmaGetAllocationInfo(m_vma_allocator, memory_block.m_allocation, &allocation_info);
+
+			memory_size += allocation_info.size;
+		}
+
+		return memory_size;
+	}
+
+	void RenderGraph::clean()
+	{
+		for (Resource& resource : m_resources)
+		{
+			if (resource.m_type != ResourceType::TransientImage || !resource.m_image)
+			{
+				continue;
+			}
+
+			m_device.destroyImageView(resource.m_view);
+			m_device.destroyImage(resource.m_image);
+
+			resource.m_view = nullptr;
+			resource.m_image = nullptr;
+		}
+
+		for (MemoryBlock& memory_block : m_memory_blocks)
+		{
+			vmaFreeMemory(m_vma_allocator, memory_block.m_allocation);
+		}
+
+		m_memory_blocks.clear();
+	}
+}
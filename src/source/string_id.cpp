@@ -0,0 +1,51 @@
+#include "../include/string_id.h"
+
+#include <sstream>
+#include <stdexcept>
+
+#ifndef NDEBUG
+#include <unordered_map>
+#endif
+
+namespace halo
+{
+#ifndef NDEBUG
+	// debug only reverse lookup table (hash -> original string)
+	static std::unordered_map<uint64_t, std::string>& get_reverse_lookup_table()
+	{
+		static std::unordered_map<uint64_t, std::string> reverse_lookup_table;
+		return reverse_lookup_table;
+	}
+#endif
+
+	StringId make_string_id(std::string_view str)
+	{
+		StringId string_id(str);
+
+#ifndef NDEBUG
+		auto [it, inserted] = get_reverse_lookup_table().try_emplace(string_id.m_hash, str);
+		if (!inserted && it->second != str)
+		{
+			throw std::runtime_error("StringId collision between : " + it->second + " and " + std::string(str));
+		}
+#endif
+
+		return string_id;
+	}
+
+	std::string to_string(StringId string_id)
+	{
+#ifndef NDEBUG
+		auto it = get_reverse_lookup_table().find(string_id.m_hash);
+		if (it != get_reverse_lookup_table().end())
+		{
+			return it->second;
+		}
+#endif
+
+		std::stringstream string_stream;
+		string_stream << "0x" << std::hex << string_id.m_hash;
+
+		return string_stream.str();
+	}
+}
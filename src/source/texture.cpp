@@ -0,0 +1,702 @@
+#include "../include/texture.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+namespace halo
+{
+	namespace
+	{
+		constexpr uint32_t TEXTURE_CACHE_MAGIC = 0x58455448; // "HTEX"
+		constexpr uint32_t TEXTURE_CACHE_VERSION = 1;
+
+		struct TextureCacheHeader
+		{
+			uint32_t m_magic;
+			uint32_t m_version;
+			uint64_t m_source_stamp;
+
+			uint32_t m_format;
+			uint32_t m_srgb;
+			uint32_t m_width;
+			uint32_t m_height;
+			uint32_t m_mip_count;
+			uint32_t m_padding;
+		};
+
+		// texel data starts at a 16 byte boundary after the mip table
+		size_t get_cache_data_offset(uint32_t mip_count)
+		{
+			size_t table_end = sizeof(TextureCacheHeader) + sizeof(TextureMip) * mip_count;
+			return (table_end + 15) & ~size_t(15);
+		}
+
+		float srgb_to_linear(float value)
+		{
+			return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+		}
+
+		float linear_to_srgb(float value)
+		{
+			return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+		}
+
+		const std::array<float, 256>& get_srgb_to_linear_table()
+		{
+			static const std::array<float, 256> table = []()
+			{
+				std::array<float, 256> values;
+				for (int i = 0; i < 256; i++)
+				{
+					values[i] = srgb_to_linear(i / 255.0f);
+				}
+
+				return values;
+			}();
+
+			return table;
+		}
+
+		uint8_t to_unorm8(float value)
+		{
+			return static_cast<uint8_t>(std::clamp(value * 255.0f + 0.5f, 0.0f, 255.0f));
+		}
+
+		uint16_t pack_565(const int color[3])
+		{
+			int r = (color[0] * 31 + 127) / 255;
+			int g = (color[1] * 63 + 127) / 255;
+			int b = (color[2] * 31 + 127) / 255;
+
+			return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+		}
+
+		void unpack_565(uint16_t packed, int color[3])
+		{
+			int r = (packed >> 11) & 31;
+			int g = (packed >> 5) & 63;
+			int b = packed & 31;
+
+			color[0] = (r << 3) | (r >> 2);
+			color[1] = (g << 2) | (g >> 4);
+			color[2] = (b << 3) | (b >> 2);
+		}
+
+		void write_u16(uint8_t *out, uint16_t value)
+		{
+			out[0] = static_cast<uint8_t>(value & 0xff);
+			out[1] = static_cast<uint8_t>(value >> 8);
+		}
+
+		// BC1 color block (always in 4 color mode, which is also the only mode of BC3's color block)
+		void compress_color_block(const uint8_t texels[16][4], uint8_t *out)
+		{
+			int min_color[3] = {255, 255, 255};
+			int max_color[3] = {0, 0, 0};
+
+			for (int i = 0; i < 16; i++)
+			{
+				for (int channel = 0; channel < 3; channel++)
+				{
+					min_color[channel] = std::min(min_color[channel], static_cast<int>(texels[i][channel]));
+					max_color[channel] = std::max(max_color[channel], static_cast<int>(texels[i][channel]));
+				}
+			}
+
+			// pull the endpoints in a little : the box corners are rarely texels, and the interpolated entries cover the extremes well enough
+			for (int channel = 0; channel < 3; channel++)
+			{
+				int inset = (max_color[channel] - min_color[channel]) >> 4;
+				min_color[channel] += inset;
+				max_color[channel] -= inset;
+			}
+
+			// the box diagonal from min to max only fits texels that grow together on every channel : flip the channels that go against the widest one.
+			int reference = 0;
+			for (int channel = 1; channel < 3; channel++)
+			{
+				if (max_color[channel] - min_color[channel] > max_color[reference] - min_color[reference])
+				{
+					reference = channel;
+				}
+			}
+
+			float center[3];
+			for (int channel = 0; channel < 3; channel++)
+			{
+				center[channel] = (min_color[channel] + max_color[channel]) * 0.5f;
+			}
+
+			for (int channel = 0; channel < 3; channel++)
+			{
+				if (channel == reference)
+				{
+					continue;
+				}
+
+				float covariance = 0.0f;
+				for (int i = 0; i < 16; i++)
+				{
+					covariance += (texels[i][reference] - center[reference]) * (texels[i][channel] - center[channel]);
+				}
+
+				if (covariance < 0.0f)
+				{
+					std::swap(min_color[channel], max_color[channel]);
+				}
+			}
+
+			uint16_t color0 = pack_565(max_color);
+			uint16_t color1 = pack_565(min_color);
+
+			// color0 > color1 selects the 4 color mode
+			if (color0 < color1)
+			{
+				std::swap(color0, color1);
+			}
+
+			write_u16(out, color0);
+			write_u16(out + 2, color1);
+
+			uint32_t indices = 0;
+
+			if (color0 != color1)
+			{
+				int palette[4][3];
+				unpack_565(color0, palette[0]);
+				unpack_565(color1, palette[1]);
+
+				for (int channel = 0; channel < 3; channel++)
+				{
+					palette[2][channel] = (2 * palette[0][channel] + palette[1][channel] + 1) / 3;
+					palette[3][channel] = (palette[0][channel] + 2 * palette[1][channel] + 1) / 3;
+				}
+
+				for (int i = 0; i < 16; i++)
+				{
+					int best_index = 0;
+					int best_distance = std::numeric_limits<int>::max();
+
+					for (int entry = 0; entry < 4; entry++)
+					{
+						int distance = 0;
+						for (int channel = 0; channel < 3; channel++)
+						{
+							int difference = texels[i][channel] - palette[entry][channel];
+							distance += difference * difference;
+						}
+
+						if (distance < best_distance)
+						{
+							best_distance = distance;
+							best_index = entry;
+						}
+					}
+
+					indices |= static_cast<uint32_t>(best_index) << (2 * i);
+				}
+			}
+
+			for (int byte = 0; byte < 4; byte++)
+			{
+				out[4 + byte] = static_cast<uint8_t>((indices >> (8 * byte)) & 0xff);
+			}
+		}
+
+		// BC3 alpha block in 8 level mode (alpha0 > alpha1)
+		void compress_alpha_block(const uint8_t texels[16][4], uint8_t *out)
+		{
+			int min_alpha = 255;
+			int max_alpha = 0;
+
+			for (int i = 0; i < 16; i++)
+			{
+				min_alpha = std::min(min_alpha, static_cast<int>(texels[i][3]));
+				max_alpha = std::max(max_alpha, static_cast<int>(texels[i][3]));
+			}
+
+			out[0] = static_cast<uint8_t>(max_alpha);
+			out[1] = static_cast<uint8_t>(min_alpha);
+
+			uint64_t indices = 0;
+
+			if (max_alpha != min_alpha)
+			{
+				// index 0 and 1 are the endpoints, 2 to 7 interpolate from alpha0 to alpha1
+				int palette[8];
+				palette[0] = max_alpha;
+				palette[1] = min_alpha;
+
+				for (int i = 1; i < 7; i++)
+				{
+					palette[i + 1] = ((7 - i) * max_alpha + i * min_alpha + 3) / 7;
+				}
+
+				for (int i = 0; i < 16; i++)
+				{
+					int best_index = 0;
+					int best_distance = std::numeric_limits<int>::max();
+
+					for (int entry = 0; entry < 8; entry++)
+					{
+						int distance = std::abs(texels[i][3] - palette[entry]);
+						if (distance < best_distance)
+						{
+							best_distance = distance;
+							best_index = entry;
+						}
+					}
+
+					indices |= static_cast<uint64_t>(best_index) << (3 * i);
+				}
+			}
+
+			for (int byte = 0; byte < 6; byte++)
+			{
+				out[2 + byte] = static_cast<uint8_t>((indices >> (8 * byte)) & 0xff);
+			}
+		}
+
+		bool has_transparency(const Image& image)
+		{
+			for (size_t i = 3; i < image.m_pixels.size(); i += 4)
+			{
+				if (image.m_pixels[i] != 255)
+				{
+					return true;
+				}
+			}
+
+			return false;
+		}
+	}
+
+	const uint8_t *TextureData::get_data() const
+	{
+		return m_file.is_open() ? m_file.get_data() + m_file_data_offset : m_storage.data();
+	}
+
+	size_t TextureData::get_data_size() const
+	{
+		return m_file.is_open() ? m_file.get_size() - m_file_data_offset : m_storage.size();
+	}
+
+	uint32_t get_mip_count(uint32_t width, uint32_t height)
+	{
+		uint32_t mip_count = 1;
+		while ((std::max(width, height) >> mip_count) > 0)
+		{
+			mip_count++;
+		}
+
+		return mip_count;
+	}
+
+	size_t get_texture_level_size(TextureFormat format, uint32_t width, uint32_t height)
+	{
+		const size_t block_count = static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4);
+
+		switch (format)
+		{
+			case TextureFormat::Bc1:
+				return block_count * 8;
+
+			case TextureFormat::Bc3:
+				return block_count * 16;
+
+			default:
+				return static_cast<size_t>(width) * height * 4;
+		}
+	}
+
+	Image load_tga(const char *file_path)
+	{
+		std::ifstream file(file_path, std::ios::binary);
+		if (!file.is_open())
+		{
+			throw std::runtime_error(std::string("Failed to find texture : ") + file_path);
+		}
+
+		std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+		if (bytes.size() < 18)
+		{
+			throw std::runtime_error(std::string("Invalid TGA file : ") + file_path);
+		}
+
+		const uint8_t id_length = bytes[0];
+		const uint8_t color_map_type = bytes[1];
+		const uint8_t image_type = bytes[2];
+		const uint32_t width = bytes[12] | (bytes[13] << 8);
+		const uint32_t height = bytes[14] | (bytes[15] << 8);
+		const uint8_t bits_per_pixel = bytes[16];
+		const uint8_t descriptor = bytes[17];
+
+		// 2 / 10 : truecolor (raw / RLE), 3 / 11 : grayscale (raw / RLE)
+		const bool is_rle = image_type == 10 || image_type == 11;
+		const bool is_grayscale = image_type == 3 || image_type == 11;
+
+		const bool supported_type = image_type == 2 || image_type == 3 || is_rle;
+		const bool supported_depth = is_grayscale ? bits_per_pixel == 8 : (bits_per_pixel == 24 || bits_per_pixel == 32);
+
+		if (color_map_type != 0 || !supported_type || !supported_depth || width == 0 || height == 0)
+		{
+			throw std::runtime_error(std::string("Unsupported TGA file (only truecolor / grayscale, 8 / 24 / 32 bits) : ") + file_path);
+		}
+
+		const uint32_t bytes_per_pixel = bits_per_pixel / 8;
+		const size_t pixel_count = static_cast<size_t>(width) * height;
+
+		size_t cursor = 18 + id_length;
+
+		// pixels in file order (BGR(A) or gray), decoded from RLE packets if needed
+		std::vector<uint8_t> file_pixels(pixel_count * bytes_per_pixel);
+
+		if (is_rle)
+		{
+			size_t pixel = 0;
+			while (pixel < pixel_count)
+			{
+				if (cursor >= bytes.size())
+				{
+					throw std::runtime_error(std::string("Truncated TGA file : ") + file_path);
+				}
+
+				const uint8_t packet_header = bytes[cursor++];
+				const size_t run_length = std::min<size_t>((packet_header & 0x7f) + 1, pixel_count - pixel);
+				const bool is_run = (packet_header & 0x80) != 0;
+
+				const size_t source_size = is_run ? bytes_per_pixel : run_length * bytes_per_pixel;
+				if (cursor + source_size > bytes.size())
+				{
+					throw std::runtime_error(std::string("Truncated TGA file : ") + file_path);
+				}
+
+				for (size_t i = 0; i < run_length; i++)
+				{
+					const uint8_t *source = &bytes[cursor + (is_run ? 0 : i * bytes_per_pixel)];
+					memcpy(&file_pixels[(pixel + i) * bytes_per_pixel], source, bytes_per_pixel);
+				}
+
+				cursor += source_size;
+				pixel += run_length;
+			}
+		}
+		else
+		{
+			if (cursor + file_pixels.size() > bytes.size())
+			{
+				throw std::runtime_error(std::string("Truncated TGA file : ") + file_path);
+			}
+
+			memcpy(file_pixels.data(), &bytes[cursor], file_pixels.size());
+		}
+
+		// rows are stored bottom to top unless bit 5 of the descriptor is set
+		const bool top_to_bottom = (descriptor & 0x20) != 0;
+
+		Image image;
+		image.m_width = width;
+		image.m_height = height;
+		image.m_pixels.resize(pixel_count * 4);
+
+		for (uint32_t y = 0; y < height; y++)
+		{
+			const uint32_t source_row = top_to_bottom ? y : height - 1 - y;
+
+			for (uint32_t x = 0; x < width; x++)
+			{
+				const uint8_t *source = &file_pixels[(static_cast<size_t>(source_row) * width + x) * bytes_per_pixel];
+				uint8_t *destination = &image.m_pixels[(static_cast<size_t>(y) * width + x) * 4];
+
+				if (is_grayscale)
+				{
+					destination[0] = source[0];
+					destination[1] = source[0];
+					destination[2] = source[0];
+					destination[3] = 255;
+				}
+				else
+				{
+					destination[0] = source[2];
+					destination[1] = source[1];
+					destination[2] = source[0];
+					destination[3] = bytes_per_pixel == 4 ? source[3] : 255;
+				}
+			}
+		}
+
+		return image;
+	}
+
+	Image downsample(const Image& image, bool srgb)
+	{
+		const std::array<float, 256>& to_linear = get_srgb_to_linear_table();
+
+		Image result;
+		result.m_width = std::max(1u, image.m_width / 2);
+		result.m_height = std::max(1u, image.m_height / 2);
+		result.m_pixels.resize(static_cast<size_t>(result.m_width) * result.m_height * 4);
+
+		for (uint32_t y = 0; y < result.m_height; y++)
+		{
+			for (uint32_t x = 0; x < result.m_width; x++)
+			{
+				float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+
+				for (uint32_t sample = 0; sample < 4; sample++)
+				{
+					const uint32_t source_x = std::min(x * 2 + (sample & 1), image.m_width - 1);
+					const uint32_t source_y = std::min(y * 2 + (sample >> 1), image.m_height - 1);
+					const uint8_t *source = &image.m_pixels[(static_cast<size_t>(source_y) * image.m_width + source_x) * 4];
+
+					for (int channel = 0; channel < 3; channel++)
+					{
+						sum[channel] += srgb ? to_linear[source[channel]] : source[channel] / 255.0f;
+					}
+
+					sum[3] += source[3] / 255.0f;
+				}
+
+				uint8_t *destination = &result.m_pixels[(static_cast<size_t>(y) * result.m_width + x) * 4];
+
+				for (int channel = 0; channel < 3; channel++)
+				{
+					float average = sum[channel] * 0.25f;
+					destination[channel] = to_unorm8(srgb ? linear_to_srgb(average) : average);
+				}
+
+				destination[3] = to_unorm8(sum[3] * 0.25f);
+			}
+		}
+
+		return result;
+	}
+
+	void compress_image(const Image& image, TextureFormat format, std::vector<uint8_t>& out_blocks)
+	{
+		const uint32_t blocks_x = (image.m_width + 3) / 4;
+		const uint32_t blocks_y = (image.m_height + 3) / 4;
+		const size_t block_size = format == TextureFormat::Bc3 ? 16 : 8;
+
+		size_t offset = out_blocks.size();
+		out_blocks.resize(offset + static_cast<size_t>(blocks_x) * blocks_y * block_size);
+
+		uint8_t texels[16][4];
+
+		for (uint32_t block_y = 0; block_y < blocks_y; block_y++)
+		{
+			for (uint32_t block_x = 0; block_x < blocks_x; block_x++)
+			{
+				for (uint32_t i = 0; i < 16; i++)
+				{
+					const uint32_t x = std::min(block_x * 4 + (i & 3), image.m_width - 1);
+					const uint32_t y = std::min(block_y * 4 + (i >> 2), image.m_height - 1);
+
+					memcpy(texels[i], &image.m_pixels[(static_cast<size_t>(y) * image.m_width + x) * 4], 4);
+				}
+
+				uint8_t *block = &out_blocks[offset];
+
+				if (format == TextureFormat::Bc3)
+				{
+					compress_alpha_block(texels, block);
+					compress_color_block(texels, block + 8);
+				}
+				else
+				{
+					compress_color_block(texels, block);
+				}
+
+				offset += block_size;
+			}
+		}
+	}
+
+	TextureData cook_texture(const Image& image, const TextureSettings& settings)
+	{
+		TextureData texture_data;
+		texture_data.m_srgb = settings.m_srgb;
+		texture_data.m_width = image.m_width;
+		texture_data.m_height = image.m_height;
+
+		if (settings.m_compress)
+		{
+			texture_data.m_format = has_transparency(image) ? TextureFormat::Bc3 : TextureFormat::Bc1;
+		}
+
+		const uint32_t mip_count = settings.m_generate_mips ? get_mip_count(image.m_width, image.m_height) : 1;
+
+		Image level = image;
+
+		for (uint32_t mip = 0; mip < mip_count; mip++)
+		{
+			if (mip > 0)
+			{
+				level = downsample(level, settings.m_srgb);
+			}
+
+			TextureMip texture_mip{};
+			texture_mip.m_width = level.m_width;
+			texture_mip.m_height = level.m_height;
+			texture_mip.m_offset = texture_data.m_storage.size();
+
+			if (texture_data.m_format == TextureFormat::Rgba8)
+			{
+				texture_data.m_storage.insert(texture_data.m_storage.end(), level.m_pixels.begin(), level.m_pixels.end());
+			}
+			else
+			{
+				compress_image(level, texture_data.m_format, texture_data.m_storage);
+			}
+
+			texture_mip.m_size = texture_data.m_storage.size() - texture_mip.m_offset;
+			texture_data.m_mips.push_back(texture_mip);
+		}
+
+		return texture_data;
+	}
+
+	void write_texture_cache(const char *cache_path, const TextureData& texture_data, uint64_t source_stamp)
+	{
+		std::ofstream file(cache_path, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			throw std::runtime_error(std::string("Failed to write texture cache : ") + cache_path);
+		}
+
+		TextureCacheHeader header{};
+		header.m_magic = TEXTURE_CACHE_MAGIC;
+		header.m_version = TEXTURE_CACHE_VERSION;
+		header.m_source_stamp = source_stamp;
+		header.m_format = static_cast<uint32_t>(texture_data.m_format);
+		header.m_srgb = texture_data.m_srgb ? 1 : 0;
+		header.m_width = texture_data.m_width;
+		header.m_height = texture_data.m_height;
+		header.m_mip_count = static_cast<uint32_t>(texture_data.m_mips.size());
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(TextureCacheHeader));
+		file.write(reinterpret_cast<const char*>(texture_data.m_mips.data()), sizeof(TextureMip) * texture_data.m_mips.size());
+
+		const size_t padding = get_cache_data_offset(header.m_mip_count) - sizeof(TextureCacheHeader) - sizeof(TextureMip) * header.m_mip_count;
+		const char zeros[16] = {};
+		file.write(zeros, padding);
+
+		file.write(reinterpret_cast<const char*>(texture_data.get_data()), texture_data.get_data_size());
+
+		if (!file.good())
+		{
+			throw std::runtime_error(std::string("Failed to write texture cache : ") + cache_path);
+		}
+	}
+
+	bool read_texture_cache(const char *cache_path, uint64_t source_stamp, const TextureSettings& settings, TextureData& out_texture_data)
+	{
+		MappedFile file;
+		if (!file.open(cache_path) || file.get_size() < sizeof(TextureCacheHeader))
+		{
+			return false;
+		}
+
+		TextureCacheHeader header;
+		memcpy(&header, file.get_data(), sizeof(TextureCacheHeader));
+
+		if (header.m_magic != TEXTURE_CACHE_MAGIC || header.m_version != TEXTURE_CACHE_VERSION || header.m_source_stamp != source_stamp)
+		{
+			return false;
+		}
+
+		// cooked with other settings
+		const uint32_t expected_mip_count = settings.m_generate_mips ? get_mip_count(header.m_width, header.m_height) : 1;
+		const bool is_compressed = header.m_format == static_cast<uint32_t>(TextureFormat::Bc1) || header.m_format == static_cast<uint32_t>(TextureFormat::Bc3);
+
+		if ((header.m_srgb != 0) != settings.m_srgb || header.m_mip_count != expected_mip_count || is_compressed != settings.m_compress || header.m_format > static_cast<uint32_t>(TextureFormat::Bc3))
+		{
+			return false;
+		}
+
+		const size_t data_offset = get_cache_data_offset(header.m_mip_count);
+		if (file.get_size() < data_offset)
+		{
+			return false;
+		}
+
+		std::vector<TextureMip> mips(header.m_mip_count);
+		memcpy(mips.data(), file.get_data() + sizeof(TextureCacheHeader), sizeof(TextureMip) * header.m_mip_count);
+
+		const size_t data_size = file.get_size() - data_offset;
+		for (const TextureMip& mip : mips)
+		{
+			if (mip.m_offset > data_size || mip.m_size > data_size - mip.m_offset)
+			{
+				return false;
+			}
+		}
+
+		out_texture_data = TextureData{};
+		out_texture_data.m_format = static_cast<TextureFormat>(header.m_format);
+		out_texture_data.m_srgb = header.m_srgb != 0;
+		out_texture_data.m_width = header.m_width;
+		out_texture_data.m_height = header.m_height;
+		out_texture_data.m_mips = std::move(mips);
+		out_texture_data.m_file = std::move(file);
+		out_texture_data.m_file_data_offset = data_offset;
+
+		return true;
+	}
+
+	uint64_t get_source_stamp(const char *file_path)
+	{
+		std::error_code error;
+
+		const uintmax_t file_size = std::filesystem::file_size(file_path, error);
+		if (error)
+		{
+			return 0;
+		}
+
+		const auto write_time = std::filesystem::last_write_time(file_path, error);
+		if (error)
+		{
+			return 0;
+		}
+
+		uint64_t stamp = static_cast<uint64_t>(file_size);
+		stamp = stamp * 0x9e3779b97f4a7c15ull + static_cast<uint64_t>(write_time.time_since_epoch().count());
+
+		return stamp;
+	}
+
+	TextureData load_cooked_texture(const std::string& file_path, const TextureSettings& settings)
+	{
+		const uint64_t source_stamp = get_source_stamp(file_path.c_str());
+		const std::string cache_path = file_path + ".htex";
+
+		TextureData texture_data;
+		if (read_texture_cache(cache_path.c_str(), source_stamp, settings, texture_data))
+		{
+			return texture_data;
+		}
+
+		texture_data = cook_texture(load_tga(file_path.c_str()), settings);
+
+		// note : a read only asset folder only costs the cooking time on every load
+		try
+		{
+			write_texture_cache(cache_path.c_str(), texture_data, source_stamp);
+		}
+		catch (const std::runtime_error& error)
+		{
+			std::cout << error.what() << '\n';
+		}
+
+		return texture_data;
+	}
+}
@@ -0,0 +1,50 @@
+#include "../include/timeline.h"
+
+namespace halo
+{
+	void QueueTimeline::create(vk::Device device)
+	{
+		m_device = device;
+
+		vk::SemaphoreTypeCreateInfo semaphore_type_create_info = {};
+		semaphore_type_create_info.semaphoreType = vk::SemaphoreType::eTimeline;
+		semaphore_type_create_info.initialValue = 0;
+
+		vk::SemaphoreCreateInfo semaphore_create_info = {};
+		semaphore_create_info.pNext = &semaphore_type_create_info;
+
+		m_semaphore = m_device.createSemaphore(semaphore_create_info);
+		m_last_signal_value = 0;
+	}
+
+	uint64_t QueueTimeline::next_signal_value()
+	{
+		return ++m_last_signal_value;
+	}
+
+	uint64_t QueueTimeline::get_last_signal_value() const
+	{
+		return m_last_signal_value;
+	}
+
+	uint64_t QueueTimeline::get_completed_value() const
+	{
+		return m_device.getSemaphoreCounterValue(m_semaphore);
+	}
+
+	vk::Result QueueTimeline::wait(uint64_t value, uint64_t timeout) const
+	{
+		// value 0 is the initial value of the semaphore, so it is always reached.
+		if (value == 0)
+		{
+			return vk::Result::eSuccess;
+		}
+
+		vk::SemaphoreWaitInfo semaphore_wait_info = {};
+		semaphore_wait_info.semaphoreCount = 1;
+		semaphore_wait_info.pSemaphores = &m_semaphore;
+		semaphore_wait_info.pValues = &value;
+
+		return m_device.waitSemaphores(semaphore_wait_info, timeout);
+	}
+}
@@ -0,0 +1,326 @@
+#include "../include/transform_hierarchy.h"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace halo
+{
+	// translation * rotation_z * rotation_y * rotation_x * scale
+	static math::M4 compose_local_matrix(const LocalTransform& local_transform)
+	{
+		math::M4 scale_mat = math::M4(1.0f);
+		scale_mat.data_rc[0][0] = local_transform.m_scale.x;
+		scale_mat.data_rc[1][1] = local_transform.m_scale.y;
+		scale_mat.data_rc[2][2] = local_transform.m_scale.z;
+
+		math::M4 rotation_mat = math::rotate_z(local_transform.m_rotation.z) * math::rotate_y(local_transform.m_rotation.y) * math::rotate_x(local_transform.m_rotation.x);
+
+		return math::translate(local_transform.m_translation) * rotation_mat * scale_mat;
+	}
+
+	TransformNode TransformHierarchy::create_node(const LocalTransform& local_transform, TransformNode parent)
+	{
+		uint32_t node_index;
+		if (!m_free_nodes.empty())
+		{
+			node_index = m_free_nodes.back();
+			m_free_nodes.pop_back();
+		}
+		else
+		{
+			node_index = static_cast<uint32_t>(m_node_generations.size());
+			m_node_generations.push_back(0);
+			m_node_to_slot.push_back(INVALID_INDEX);
+			m_node_parents.push_back(TransformNode{});
+		}
+
+		TransformNode node{};
+		node.m_index = node_index;
+		node.m_generation = m_node_generations[node_index];
+
+		// new nodes are appended. This keeps the depth first order valid for root nodes, but not for children (which must be inside the parent's range).
+		const uint32_t slot = static_cast<uint32_t>(m_local_transforms.size());
+		const bool has_parent = is_alive(parent);
+
+		m_node_to_slot[node_index] = slot;
+		m_node_parents[node_index] = has_parent ? parent : TransformNode{};
+
+		m_local_transforms.push_back(local_transform);
+		m_world_matrices.push_back(math::M4(1.0f));
+		m_parent_slots.push_back(has_parent ? get_slot(parent) : INVALID_INDEX);
+		m_subtree_sizes.push_back(1);
+		m_slot_to_node.push_back(node_index);
+
+		m_dirty_slots.push_back(slot);
+
+		if (has_parent)
+		{
+			m_topology_dirty = true;
+		}
+
+		return node;
+	}
+
+	void TransformHierarchy::destroy_node(TransformNode node)
+	{
+		if (!is_alive(node))
+		{
+			return;
+		}
+
+		// descendants are collected by the next re-sort (they are unreachable from any root).
+		m_slot_to_node[m_node_to_slot[node.m_index]] = INVALID_INDEX;
+		m_node_to_slot[node.m_index] = INVALID_INDEX;
+		m_node_generations[node.m_index]++;
+
+		m_pending_free_nodes.push_back(node.m_index);
+		m_topology_dirty = true;
+	}
+
+	void TransformHierarchy::set_parent(TransformNode node, TransformNode parent)
+	{
+		if (!is_alive(node))
+		{
+			return;
+		}
+
+		// a cycle would make the whole subtree unreachable from any root (and dropped by the next re-sort)
+		for (TransformNode ancestor = parent; is_alive(ancestor); ancestor = m_node_parents[ancestor.m_index])
+		{
+			if (ancestor == node)
+			{
+				throw std::runtime_error("Transform node can not be parented to itself or one of its descendants");
+			}
+		}
+
+		m_node_parents[node.m_index] = is_alive(parent) ? parent : TransformNode{};
+		m_topology_dirty = true;
+	}
+
+	void TransformHierarchy::set_local(TransformNode node, const LocalTransform& local_transform)
+	{
+		if (!is_alive(node))
+		{
+			return;
+		}
+
+		const uint32_t slot = get_slot(node);
+
+		m_local_transforms[slot] = local_transform;
+		m_dirty_slots.push_back(slot);
+	}
+
+	const LocalTransform& TransformHierarchy::get_local(TransformNode node) const
+	{
+		static const LocalTransform DEFAULT_LOCAL_TRANSFORM{};
+
+		if (!is_alive(node))
+		{
+			return DEFAULT_LOCAL_TRANSFORM;
+		}
+
+		return m_local_transforms[get_slot(node)];
+	}
+
+	const math::M4& TransformHierarchy::get_world(TransformNode node) const
+	{
+		static const math::M4 IDENTITY_MATRIX = math::M4(1.0f);
+
+		if (!is_alive(node))
+		{
+			return IDENTITY_MATRIX;
+		}
+
+		return m_world_matrices[get_slot(node)];
+	}
+
+	uint32_t TransformHierarchy::get_slot(TransformNode node) const
+	{
+		const bool alive = is_alive(node);
+		assert(alive && "get_slot called with a destroyed or stale transform node");
+
+		return alive ? m_node_to_slot[node.m_index] : INVALID_INDEX;
+	}
+
+	bool TransformHierarchy::is_alive(TransformNode node) const
+	{
+		return node.m_index < m_node_generations.size() && m_node_generations[node.m_index] == node.m_generation;
+	}
+
+	SlotRange TransformHierarchy::update()
+	{
+		SlotRange changed_range{};
+
+		if (m_topology_dirty)
+		{
+			rebuild_order();
+			recompute_range(0, static_cast<uint32_t>(m_local_transforms.size()));
+
+			m_dirty_slots.clear();
+			m_topology_dirty = false;
+
+			changed_range.m_end = static_cast<uint32_t>(m_local_transforms.size());
+			return changed_range;
+		}
+
+		if (m_dirty_slots.empty())
+		{
+			return changed_range;
+		}
+
+		// each dirty slot invalidates its whole subtree, which is the contiguous range [slot, slot + subtree size).
+		// sorting lets subtrees nested in an already recomputed range be skipped.
+		std::sort(m_dirty_slots.begin(), m_dirty_slots.end());
+
+		uint32_t recomputed_end = 0;
+		for (uint32_t slot : m_dirty_slots)
+		{
+			if (slot < recomputed_end)
+			{
+				continue;
+			}
+
+			recomputed_end = slot + m_subtree_sizes[slot];
+			recompute_range(slot, recomputed_end);
+
+			changed_range.merge(SlotRange{slot, recomputed_end});
+		}
+
+		m_dirty_slots.clear();
+
+		return changed_range;
+	}
+
+	size_t TransformHierarchy::size() const
+	{
+		return m_local_transforms.size();
+	}
+
+	const std::vector<math::M4>& TransformHierarchy::get_world_matrices() const
+	{
+		return m_world_matrices;
+	}
+
+	void TransformHierarchy::rebuild_order()
+	{
+		const uint32_t old_slot_count = static_cast<uint32_t>(m_local_transforms.size());
+
+		// children lists (in node space), in the current slot order so the re-sort is stable
+		std::vector<std::vector<uint32_t>> children(m_node_generations.size());
+		std::vector<uint32_t> roots;
+
+		for (uint32_t slot = 0; slot < old_slot_count; slot++)
+		{
+			const uint32_t node_index = m_slot_to_node[slot];
+			if (node_index == INVALID_INDEX)
+			{
+				continue;
+			}
+
+			const TransformNode parent = m_node_parents[node_index];
+			if (!parent.is_valid())
+			{
+				roots.push_back(node_index);
+			}
+			else if (is_alive(parent))
+			{
+				children[parent.m_index].push_back(node_index);
+			}
+		}
+
+		std::vector<LocalTransform> local_transforms;
+		std::vector<uint32_t> parent_slots;
+		std::vector<uint32_t> subtree_sizes;
+		std::vector<uint32_t> slot_to_node;
+
+		local_transforms.reserve(old_slot_count);
+		parent_slots.reserve(old_slot_count);
+		subtree_sizes.reserve(old_slot_count);
+		slot_to_node.reserve(old_slot_count);
+
+		std::vector<bool> visited(m_node_generations.size(), false);
+
+		// iterative depth first traversal : (node, parent slot). Subtree sizes are filled in when a node is popped for the second time.
+		struct StackEntry
+		{
+			uint32_t m_node_index;
+			uint32_t m_parent_slot;
+			bool m_children_done;
+		};
+
+		std::vector<StackEntry> stack;
+
+		for (uint32_t root : roots)
+		{
+			stack.push_back(StackEntry{root, INVALID_INDEX, false});
+
+			while (!stack.empty())
+			{
+				StackEntry entry = stack.back();
+				stack.pop_back();
+
+				if (entry.m_children_done)
+				{
+					const uint32_t slot = m_node_to_slot[entry.m_node_index];
+					subtree_sizes[slot] = static_cast<uint32_t>(local_transforms.size()) - slot;
+					continue;
+				}
+
+				const uint32_t old_slot = m_node_to_slot[entry.m_node_index];
+				const uint32_t new_slot = static_cast<uint32_t>(local_transforms.size());
+
+				visited[entry.m_node_index] = true;
+
+				local_transforms.push_back(m_local_transforms[old_slot]);
+				parent_slots.push_back(entry.m_parent_slot);
+				subtree_sizes.push_back(1);
+				slot_to_node.push_back(entry.m_node_index);
+
+				// m_node_to_slot is only read for the old slot above, so it can be updated in place
+				m_node_to_slot[entry.m_node_index] = new_slot;
+
+				stack.push_back(StackEntry{entry.m_node_index, entry.m_parent_slot, true});
+
+				const std::vector<uint32_t>& node_children = children[entry.m_node_index];
+				for (auto it = node_children.rbegin(); it != node_children.rend(); it++)
+				{
+					stack.push_back(StackEntry{*it, new_slot, false});
+				}
+			}
+		}
+
+		// nodes not reachable from a root were descendants of destroyed nodes
+		for (uint32_t slot = 0; slot < old_slot_count; slot++)
+		{
+			const uint32_t node_index = m_slot_to_node[slot];
+			if (node_index != INVALID_INDEX && !visited[node_index])
+			{
+				m_node_generations[node_index]++;
+				m_node_to_slot[node_index] = INVALID_INDEX;
+				m_free_nodes.push_back(node_index);
+			}
+		}
+
+		m_free_nodes.insert(m_free_nodes.end(), m_pending_free_nodes.begin(), m_pending_free_nodes.end());
+		m_pending_free_nodes.clear();
+
+		m_local_transforms = std::move(local_transforms);
+		m_parent_slots = std::move(parent_slots);
+		m_subtree_sizes = std::move(subtree_sizes);
+		m_slot_to_node = std::move(slot_to_node);
+		m_world_matrices.resize(m_local_transforms.size());
+	}
+
+	void TransformHierarchy::recompute_range(uint32_t begin, uint32_t end)
+	{
+		// parents precede children, so the parent's world matrix is always up to date here
+		for (uint32_t slot = begin; slot < end; slot++)
+		{
+			const math::M4 local_mat = compose_local_matrix(m_local_transforms[slot]);
+			const uint32_t parent_slot = m_parent_slots[slot];
+
+			m_world_matrices[slot] = parent_slot == INVALID_INDEX ? local_mat : m_world_matrices[parent_slot] * local_mat;
+		}
+	}
+}